@@ -0,0 +1,79 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+
+#include "BlockUpdates.h"
+#include "chunk.h"
+#include "ChunkBlocks.h"
+#include "ChunkProcess.h"
+#include "primitives.h"
+
+using namespace Model;
+
+BlockUpdates Model::gBlockUpdates;
+
+void BlockUpdates::Add(View::Chunk *cp, int dx, int dy, int dz, int type) {
+	Edit e = { (unsigned char)dx, (unsigned char)dy, (unsigned char)dz, (unsigned char)type, 0.0 };
+	fJournals[cp].push_back(e);
+}
+
+void BlockUpdates::AddJelly(View::Chunk *cp, int dx, int dy, int dz, double timeout) {
+	Edit e = { (unsigned char)dx, (unsigned char)dy, (unsigned char)dz, BT_Air, timeout };
+	fJournals[cp].push_back(e);
+}
+
+void BlockUpdates::Replace(View::Chunk *cp, std::shared_ptr<ChunkBlocks> cb) {
+	gChunkProcess.Retire(cp->fChunkBlocks);
+	cp->fChunkBlocks = cb;
+	cp->SetDirty(true);
+	fVersions++;
+}
+
+void BlockUpdates::Apply(void) {
+	for (auto it = fJournals.begin(); it != fJournals.end();) {
+		View::Chunk *cp = it->first;
+		// New data from the server replaces the blocks, so the updates have to wait for it.
+		if (cp->fScheduledForLoading) {
+			fDeferred++;
+			++it;
+			continue;
+		}
+		auto cb = cp->fChunkBlocks->NewVersion();
+		for (auto &e : it->second) {
+			if (e.fJellyTimeout > 0.0)
+				cb->AddTimerJellyBlock(e.dx, e.dy, e.dz, e.fJellyTimeout);
+			cb->CommandBlockUpdate(cp->cc, e.dx, e.dy, e.dz, e.type);
+		}
+		this->Replace(cp, cb);
+		fUpdates += it->second.size();
+		it = fJournals.erase(it);
+	}
+}
+
+void BlockUpdates::TestJellyTimeout(View::Chunk *cp, bool unconditionally) {
+	if (!cp->fChunkBlocks->JellyBlockTimedOut(unconditionally))
+		return;
+	auto cb = cp->fChunkBlocks->NewVersion(); // The timers are moved to the new version
+	cb->RestoreJellyBlocks(unconditionally);
+	this->Replace(cp, cb);
+}
+
+void BlockUpdates::Report(void) {
+	printf("BlockUpdates: %u updates in %u versions, deferred %u times, %d chunks waiting\n", fUpdates, fVersions, fDeferred, int(fJournals.size()));
+	fUpdates = fVersions = fDeferred = 0;
+}
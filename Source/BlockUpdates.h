@@ -0,0 +1,73 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace View {
+	class Chunk;
+}
+
+namespace Model {
+
+class ChunkBlocks;
+
+/// @brief Collect block updates from the server, and apply them once per frame.
+///
+/// All updates of a chunk that arrive in the same frame are applied to a new copy of the ChunkBlocks, which then
+/// replaces the old one. That way, there is only one recomputation for all the changes. Mesh computations can
+/// still be using the old copy, of this chunk or of a neighbor, so it is handed over to ChunkProcess::Retire(). If the
+/// chunk is being loaded, the updates are held back until it is done.
+///
+/// Jelly blocks that time out are restored the same way.
+///
+/// All functions shall be called from the main thread.
+class BlockUpdates {
+public:
+	/// Change a block, dx, dy and dz are relative to the chunk.
+	void Add(View::Chunk *, int dx, int dy, int dz, int type);
+
+	/// Temporarily turn a block into air, for 'timeout' seconds.
+	void AddJelly(View::Chunk *, int dx, int dy, int dz, double timeout);
+
+	/// Apply all updates that are ready. Shall be called once every frame, before drawing.
+	void Apply(void);
+
+	/// Restore the jelly blocks of a chunk that have timed out, or all of them if 'unconditionally'.
+	void TestJellyTimeout(View::Chunk *, bool unconditionally);
+
+	/// Print statistics since the last report.
+	void Report(void);
+private:
+	struct Edit {
+		unsigned char dx, dy, dz, type;
+		double fJellyTimeout; // Zero if not a jelly block
+	};
+	std::map<View::Chunk*, std::vector<Edit>> fJournals;
+
+	unsigned fUpdates = 0, fVersions = 0, fDeferred = 0;
+
+	// Use a new version of the blocks in a chunk
+	void Replace(View::Chunk *, std::shared_ptr<ChunkBlocks>);
+};
+
+extern BlockUpdates gBlockUpdates;
+
+}
@@ -19,8 +19,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <sstream>
+#include <vector>
 
 #include "ChunkBlocks.h"
+#include "ChunkEncoding.h"
 #include "chunk.h"
 #include "assert.h"
 #include "primitives.h"
@@ -51,27 +53,42 @@ static int randomize(int bt, int seed) {
 }
 
 // This is done from a separate process!
-void ChunkBlocks::Uncompress(void) {
+bool ChunkBlocks::Uncompress(void) {
 	int from = 0;
 	int to = 0;
 
 	std::unique_ptr <unsigned char[]>chunkData(new (unsigned char[CHUNK_VOL]));
+	const unsigned char *compressed = fCompressedChunk.get();
+	int size = this->compressSize;
+	std::vector<unsigned char> rle;
+	if (IsEncodedChunk(compressed, size)) {
+		if (!DecodeChunk(compressed, size, rle))
+			return false;
+		compressed = rle.data();
+		size = rle.size();
+	}
 
 	// The data is organized in pairs. First is the block type, then the count of that type.
 	do {
-		int cnt = fCompressedChunk[from+1];
-		// printf("%dx%d ", cnt, fCompressedChunk[from]);
+		if (from+1 >= size)
+			return false;
+		int cnt = compressed[from+1];
+		// printf("%dx%d ", cnt, compressed[from]);
+		if (cnt > CHUNK_VOL - to)
+			return false;
 		for (int i=0; i<cnt; i++) {
 			int copy = to;
-			chunkData[to++] = randomize(fCompressedChunk[from], copy);
+			chunkData[to++] = randomize(compressed[from], copy);
 		}
 		from += 2;
-	} while (from < this->compressSize);
+	} while (from < size);
 
 	// printf("chunk::Uncompress: unpacked size %d, compressed size %d\n", to, this->compressSize);
-	ASSERT(to == CHUNK_VOL);
+	if (to != CHUNK_VOL)
+		return false;
 	fChunkData = std::move(chunkData); // Do this as a last thing, when the uncompress is done
 	fChunk->SetDirty(true);
+	return true;
 }
 
 ChunkBlocks::ChunkBlocks() {
@@ -87,6 +104,22 @@ ChunkBlocks::ChunkBlocks() {
 ChunkBlocks::~ChunkBlocks() {
 }
 
+std::shared_ptr<ChunkBlocks> ChunkBlocks::NewVersion(void) {
+	auto cb = std::make_shared<ChunkBlocks>();
+	cb->flag = flag;
+	cb->fChecksum = fChecksum;
+	cb->fOwner = fOwner;
+	cb->fChunk = fChunk;
+	cb->fChecksumTimeout = fChecksumTimeout;
+	cb->fChecksumTestNeeded = fChecksumTestNeeded;
+	cb->fCompressedChunk = fCompressedChunk;
+	cb->compressSize = compressSize;
+	cb->fChunkData.reset(new unsigned char[CHUNK_VOL]);
+	memcpy(cb->fChunkData.get(), fChunkData.get(), CHUNK_VOL);
+	cb->fJellyBlockList.swap(fJellyBlockList);
+	return cb;
+}
+
 void ChunkBlocks::SetTeleport(int x, int y, int z) {
 	if (fChunkData[INDEX(x,y,z)] == BT_Air)
 		fChunkData[INDEX(x,y,z)] = BT_Teleport;
@@ -144,19 +177,18 @@ void ChunkBlocks::AddTimerJellyBlock(unsigned char dx, unsigned char dy, unsigne
 	fJellyBlockList.push_front(jb);
 }
 
-void ChunkBlocks::TestJellyBlockTimeout(bool unconditionally) {
-	bool updated = false;
-	while(fJellyBlockList.size() > 0) {
+bool ChunkBlocks::JellyBlockTimedOut(bool unconditionally) const {
+	// The timers are sorted, with the oldest one last. If the oldest has not timed out, none have.
+	return !fJellyBlockList.empty() && (unconditionally || fJellyBlockList.back()->timeout <= gCurrentFrameTime);
+}
+
+void ChunkBlocks::RestoreJellyBlocks(bool unconditionally) {
+	while (this->JellyBlockTimedOut(unconditionally)) {
 		JellyBlock *jb = fJellyBlockList.back();
-		// The timers are sorted, with the oldest one last. If the oldest has not timed out, none have.
-		if (jb->timeout > gCurrentFrameTime && !unconditionally)
-			break;
 		this->CommandBlockUpdate(fChunk->cc, jb->dx, jb->dy, jb->dz, jb->type);
 		fJellyBlockList.pop_back();
-		updated = true;
+		delete jb;
 	}
-	if (updated)
-		fChunk->SetDirty(true);
 }
 
 enum {
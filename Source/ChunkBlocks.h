@@ -47,12 +47,13 @@ public:
 	unsigned long fOwner;
 	View::Chunk *fChunk; // The View::Chunk that shall be updated
 	double fChecksumTimeout;
-	std::unique_ptr <unsigned char[]> fCompressedChunk;
+	std::shared_ptr <const unsigned char> fCompressedChunk; // Can be a part of a bigger buffer. Released when no longer needed.
 	int compressSize;
 	std::unique_ptr <unsigned char[]> fChunkData; // The unpacked data
 	bool fChecksumTestNeeded;			  // True if this View::Chunk should verify the checksum from the server.
 
-	void Uncompress(void);
+	// Unpack the compressed data into fChunkData. Return false if the data is corrupt, in which case fChunkData isn't changed.
+	bool Uncompress(void);
 
 	ChunkBlocks();
 	~ChunkBlocks();
@@ -60,8 +61,15 @@ public:
 	// Add timer for a jelly block
 	void AddTimerJellyBlock(unsigned char dx, unsigned char dy, unsigned char dz, double deltaTime);
 
-	// Look at the list of jelly blocks and restore those that have timed out.
-	void TestJellyBlockTimeout(bool unconditionally = false);
+	// Return true if there are jelly blocks that have timed out, or any jelly blocks at all if 'unconditionally'.
+	bool JellyBlockTimedOut(bool unconditionally) const;
+
+	// Restore the jelly blocks that have timed out. This changes the blocks, so it shall only be done in a
+	// new version, see BlockUpdates::TestJellyTimeout().
+	void RestoreJellyBlocks(bool unconditionally);
+
+	// Make a copy of the blocks, that can be changed while this one is still used. The jelly block timers are moved to the copy.
+	std::shared_ptr<ChunkBlocks> NewVersion(void);
 
 	// Update a block in a View::Chunk to another type. Any calls of SetDirty() has  to be done afterwards
 	void CommandBlockUpdate(const ChunkCoord &cc, int dx, int dy, int dz, int type);
@@ -0,0 +1,159 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string.h>
+
+#include "ChunkEncoding.h"
+#include "client_prot.h"
+
+// The header is an empty run, the encoding and the size of the decoded RLE data (4 bytes)
+#define HEADER_SIZE 7
+
+// Every pair of block type and count is at least one block, so the RLE data is at most two bytes for every
+// block of a chunk (CHUNK_VOL in chunk.h). chunk.h isn't included, as it needs OpenGL and the test server uses this file.
+#define MAX_RLE_SIZE (2*32*32*32)
+
+#define MIN_MATCH 4
+#define HASH_BITS 12
+
+// The end of block rules of the LZ4 block format: the last match has to start at least MFLIMIT bytes
+// before the end, and the last LAST_LITERALS bytes are always literals.
+#define MFLIMIT 12
+#define LAST_LITERALS 5
+
+using namespace Model;
+
+static unsigned Read32(const unsigned char *p) {
+	unsigned v;
+	memcpy(&v, p, sizeof v);
+	return v;
+}
+
+static unsigned Hash(unsigned v) {
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths that don't fit in 4 bits of the token are continued with bytes, where 255 means there is more
+static void AddLength(std::vector<unsigned char> &out, int len) {
+	for (; len >= 255; len -= 255)
+		out.push_back(255);
+	out.push_back(len);
+}
+
+// Add a sequence of literals, followed by a match. A match length of 0 means there is no match.
+static void AddSequence(std::vector<unsigned char> &out, const unsigned char *literals, int numLiterals, int offset, int matchLength) {
+	int ml = matchLength > 0 ? matchLength - MIN_MATCH : 0;
+	out.push_back(((numLiterals < 15 ? numLiterals : 15) << 4) | (ml < 15 ? ml : 15));
+	if (numLiterals >= 15)
+		AddLength(out, numLiterals - 15);
+	out.insert(out.end(), literals, literals + numLiterals);
+	if (matchLength == 0)
+		return;
+	out.push_back(offset & 0xFF);
+	out.push_back(offset >> 8);
+	if (ml >= 15)
+		AddLength(out, ml - 15);
+}
+
+void Model::EncodeChunkLZ(const unsigned char *rle, int n, std::vector<unsigned char> &out) {
+	out.clear();
+	out.reserve(HEADER_SIZE + n/2);
+	out.push_back(0);
+	out.push_back(0);
+	out.push_back(CHUNK_ENCODING_LZ);
+	for (int i=0; i<4; i++)
+		out.push_back((n >> (i*8)) & 0xFF);
+
+	// Greedy search, using the last position of every hashed 4 byte sequence
+	int table[1 << HASH_BITS];
+	for (auto &t : table)
+		t = -1;
+	int anchor = 0, i = 0;
+	while (i + MFLIMIT <= n) {
+		unsigned h = Hash(Read32(rle+i));
+		int candidate = table[h];
+		table[h] = i;
+		if (candidate < 0 || i - candidate > 0xFFFF || Read32(rle+candidate) != Read32(rle+i)) {
+			i++;
+			continue;
+		}
+		int len = MIN_MATCH;
+		while (i + len < n - LAST_LITERALS && rle[candidate+len] == rle[i+len])
+			len++;
+		AddSequence(out, rle+anchor, i-anchor, i-candidate, len);
+		i += len;
+		anchor = i;
+	}
+	AddSequence(out, rle+anchor, n-anchor, 0, 0); // The last literals
+}
+
+bool Model::IsEncodedChunk(const unsigned char *data, int n) {
+	return n >= 2 && data[0] == 0 && data[1] == 0;
+}
+
+bool Model::DecodeChunk(const unsigned char *data, int n, std::vector<unsigned char> &rle) {
+	if (n < HEADER_SIZE || data[2] != CHUNK_ENCODING_LZ)
+		return false;
+	unsigned size = data[3] | (data[4] << 8) | (data[5] << 16) | (data[6] << 24);
+	if (size > MAX_RLE_SIZE)
+		return false;
+	rle.resize(size);
+	const unsigned char *ip = data + HEADER_SIZE, *end = data + n;
+	unsigned op = 0;
+	while (ip < end) {
+		unsigned token = *ip++;
+		unsigned numLiterals = token >> 4;
+		if (numLiterals == 15) {
+			unsigned b;
+			do {
+				if (ip == end)
+					return false;
+				b = *ip++;
+				numLiterals += b;
+			} while (b == 255);
+		}
+		if (numLiterals > unsigned(end - ip) || numLiterals > size - op)
+			return false;
+		if (numLiterals > 0)
+			memcpy(&rle[op], ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+		if (ip == end)
+			break; // The last sequence has no match
+		if (end - ip < 2)
+			return false;
+		unsigned offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		unsigned matchLength = token & 15;
+		if (matchLength == 15) {
+			unsigned b;
+			do {
+				if (ip == end)
+					return false;
+				b = *ip++;
+				matchLength += b;
+			} while (b == 255);
+		}
+		matchLength += MIN_MATCH;
+		if (offset == 0 || offset > op || matchLength > size - op)
+			return false;
+		// The match may overlap the output, so it has to be copied one byte at a time
+		for (unsigned i=0; i<matchLength; i++, op++)
+			rle[op] = rle[op - offset];
+	}
+	return op == size;
+}
@@ -0,0 +1,39 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <vector>
+
+//
+// Chunks are normally encoded as pairs of block type and count (RLE). Other encodings can be negotiated
+// with the server, see CHUNK_ENCODING_LZ in client_prot.h. The same data is saved in the local cache.
+//
+
+namespace Model {
+
+/// Compress RLE chunk data with the LZ encoding, including the encoding header.
+void EncodeChunkLZ(const unsigned char *rle, int n, std::vector<unsigned char> &out);
+
+/// Return true if the chunk data uses another encoding than RLE.
+bool IsEncodedChunk(const unsigned char *data, int n);
+
+/// Decode chunk data that uses another encoding than RLE into 'rle'. The data comes from the server
+/// or the cache, and can't be trusted. Return false if it is corrupt, or uses an unknown encoding.
+bool DecodeChunk(const unsigned char *data, int n, std::vector<unsigned char> &rle);
+
+}
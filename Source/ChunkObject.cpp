@@ -45,10 +45,10 @@ using namespace View;
 ChunkObject::ChunkObject() {
 	// Initialize the boundaries to the extreme limits.
 	fBoundXMin = CHUNK_SIZE; fBoundXMax = 0; fBoundYMin = CHUNK_SIZE; fBoundYMax = 0; fBoundZMin = CHUNK_SIZE; fBoundZMax = 0;
-	fNumTree = 0;
-	fNumLamps = 0;
-	fNumFogs = 0;
-	fNumTreasures = 0;
+	for (int i=0; i<ST_Count; i++) {
+		fSpecial[i].first = 0;
+		fSpecial[i].count = 0;
+	}
 	fChunk = 0;
 }
 
@@ -63,179 +63,184 @@ bool ChunkObject::Empty(void) const {
 	return fBoundXMax < fBoundXMin;
 }
 
-void ChunkObject::DrawLamps(StageOneShader *shader, glm::vec3 offset) const {
-	for (int i=0; i<fNumLamps; i++) {
-		float lampx = (float)fLampList[i].x + offset.x;
-		float lampy = (float)fLampList[i].z + offset.y;
-		float lampz = -(float)fLampList[i].y + offset.z;
-		gDrawObjectList.emplace_back(glm::vec3(lampx, lampy, lampz), fLampList[i].type);
-		glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(lampx, lampy, lampz));
-		glBindTexture(GL_TEXTURE_2D, GameTexture::LanternSideId); // For now, also used on top and bottom.
-		switch (fLampList[i].type) {
-		case BT_Lamp1:
-			modelMatrix = glm::scale(modelMatrix, glm::vec3(0.2f, 0.4f, 0.2f));
-			shader->Model(modelMatrix);
-			gLantern.Draw();
-			break;
-		case BT_Lamp2:
-			modelMatrix = glm::scale(modelMatrix, glm::vec3(0.3f, 0.6f, 0.3f));
-			shader->Model(modelMatrix);
-			gLantern.Draw();
-			break;
-		}
+void ChunkObject::DrawLamps(StageOneShader *shader, glm::vec3 offset, const OpenglBuffer &instances) const {
+	const SpecialRange &lamp1 = fSpecial[ST_Lamp1];
+	const SpecialRange &lamp2 = fSpecial[ST_Lamp2];
+	if (lamp1.count == 0 && lamp2.count == 0)
+		return;
+	for (int i=lamp1.first; i<lamp1.first+lamp1.count; i++)
+		gDrawObjectList.emplace_back(fSpecialPos[i] + offset, BT_Lamp1);
+	for (int i=lamp2.first; i<lamp2.first+lamp2.count; i++)
+		gDrawObjectList.emplace_back(fSpecialPos[i] + offset, BT_Lamp2);
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), offset);
+	glBindTexture(GL_TEXTURE_2D, GameTexture::LanternSideId); // For now, also used on top and bottom.
+	if (lamp1.count > 0) {
+		shader->Model(glm::scale(modelMatrix, glm::vec3(0.2f, 0.4f, 0.2f)));
+		gLantern.DrawInstanced(instances, lamp1.first, lamp1.count);
+	}
+	if (lamp2.count > 0) {
+		shader->Model(glm::scale(modelMatrix, glm::vec3(0.3f, 0.6f, 0.3f)));
+		gLantern.DrawInstanced(instances, lamp2.first, lamp2.count);
 	}
 }
 
-void ChunkObject::DrawTreasures(StageOneShader *shader, glm::vec3 offset) const {
-	for (int i=0; i<fNumTreasures; i++) {
-		float x = (float)fTreasureList[i].x + offset.x;
-		float y = (float)fTreasureList[i].z + offset.y + 0.5f;
-		float z = -(float)fTreasureList[i].y + offset.z;
-		gDrawObjectList.emplace_back(glm::vec3(x, y, z), fTreasureList[i].type);
-		glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
-		switch (fTreasureList[i].type) {
-		case BT_Treasure:
-			glBindTexture(GL_TEXTURE_2D, GameTexture::Coin);
-			modelMatrix = glm::scale(modelMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
-			modelMatrix = glm::rotate(modelMatrix, float(gCurrentFrameTime*360), glm::vec3(0,1,0));
-			shader->Model(modelMatrix);
-			gQuadStage1.DrawDoubleSide();
-			break;
-		case BT_Quest:
-			glBindTexture(GL_TEXTURE_2D, GameTexture::Quest);
-			modelMatrix = glm::scale(modelMatrix, glm::vec3(0.6f, 0.6f, 0.6f));
-			modelMatrix = glm::rotate(modelMatrix, float(gCurrentFrameTime*360), glm::vec3(0,1,0));
-			shader->Model(modelMatrix);
-			gQuadStage1.DrawDoubleSide();
-			break;
-		}
+void ChunkObject::DrawTreasures(StageOneShader *shader, glm::vec3 offset, const OpenglBuffer &instances) const {
+	const SpecialRange &treasure = fSpecial[ST_Treasure];
+	const SpecialRange &quest = fSpecial[ST_Quest];
+	if (treasure.count == 0 && quest.count == 0)
+		return;
+	offset.y += 0.5f;
+	for (int i=treasure.first; i<treasure.first+treasure.count; i++)
+		gDrawObjectList.emplace_back(fSpecialPos[i] + offset, BT_Treasure);
+	for (int i=quest.first; i<quest.first+quest.count; i++)
+		gDrawObjectList.emplace_back(fSpecialPos[i] + offset, BT_Quest);
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), offset);
+	if (treasure.count > 0) {
+		glBindTexture(GL_TEXTURE_2D, GameTexture::Coin);
+		glm::mat4 mat = glm::scale(modelMatrix, glm::vec3(0.3f, 0.3f, 0.3f));
+		shader->Model(glm::rotate(mat, float(gCurrentFrameTime*360), glm::vec3(0,1,0)));
+		gQuadStage1.DrawDoubleSideInstanced(instances, treasure.first, treasure.count);
+	}
+	if (quest.count > 0) {
+		glBindTexture(GL_TEXTURE_2D, GameTexture::Quest);
+		glm::mat4 mat = glm::scale(modelMatrix, glm::vec3(0.6f, 0.6f, 0.6f));
+		shader->Model(glm::rotate(mat, float(gCurrentFrameTime*360), glm::vec3(0,1,0)));
+		gQuadStage1.DrawDoubleSideInstanced(instances, quest.first, quest.count);
 	}
 }
 
-void ChunkObject::DrawTrees(StageOneShader *shader, glm::vec3 offset, bool forShadows) const {
+// Used when the trees of a chunk have to be partitioned into billboards and meshes. Only used from the main thread.
+static OpenglBuffer sPartitionBuffer;
+static std::vector<glm::vec3> sPartition;
+
+void ChunkObject::DrawTreeType(StageOneShader *shader, glm::vec3 offset, bool forShadows, const OpenglBuffer &instances, SpecialType type) const {
 	const float billboardLimit = 80.0f;
 	const float billboardShadowLimit = 45.0f;
 	const float rotateShadowBillboard = -45.0f;
 	const float tiltShadowBillboard = -30.0f;
-	bool belowGround = Model::gPlayer.BelowGround();
-	for (int i=0; i<fNumTree; i++) {
-		float treex = (float)fTreeList[i].x + offset.x;
-		float treey = (float)fTreeList[i].z + offset.y;
-		float treez = -(float)fTreeList[i].y + offset.z;
-		glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(treex, treey, treez));
-
-		glm::vec3 player = Model::gPlayer.GetOffsetToChunk();
-		float d = glm::distance(player, glm::vec3(treex, treey, treez));
-		float limit = billboardLimit;
-		if (forShadows)
-			limit = billboardShadowLimit;
-
-		switch (fTreeList[i].type) {
-		case BT_Tuft:
-			if (forShadows && gOptions.fPerformance < 4)
-				continue; // Only show shadow if high performance
-			shader->Model(glm::translate(modelMatrix, glm::vec3(0.0f, 0.65f, 0.0f)));
-			glBindTexture(GL_TEXTURE_2D, GameTexture::TuftOfGrass); // This will be used for trunk and all branches.
-			gTuftOfGrass.DrawStatic();
-			break;
-		case BT_Flowers:
-			if (forShadows && gOptions.fPerformance < 4)
-				continue; // Only show shadow if high performance
-			shader->Model(glm::translate(modelMatrix, glm::vec3(0.0f, 0.65f, 0.0f)));
-			glBindTexture(GL_TEXTURE_2D, GameTexture::Flowers); // This will be used for trunk and all branches.
-			gTuftOfGrass.DrawStatic(); // The same model as "tuft of grass" is used, but with a different texture
-			break;
-		case BT_Tree1:
-			if (d > limit) {
-				float angle = -Model::gPlayer.fAngleHor;
-				Billboard::Predefined picture = Billboard::tree1;
-				if (forShadows) {
-					angle = rotateShadowBillboard;
-					picture = Billboard::tree1Shadow;
-				}
-				modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0, 1, 0));
-				if (forShadows)
-					modelMatrix = glm::rotate(modelMatrix, tiltShadowBillboard, glm::vec3(1, 0, 0));
-				gBillboard.Draw(shader, modelMatrix, picture);
-			} else {
-				shader->Model(modelMatrix);
-				Tree::sfSmallTree.Draw();
-				if ((!gOptions.fDynamicShadows && !gOptions.fStaticShadows) || belowGround) gShadows.Add(treex, treey, treez, 1.5f, 0.8f);
-			}
-			break;
-		case BT_Tree2:
-			if (d > limit) {
-				float angle = -Model::gPlayer.fAngleHor;
-				Billboard::Predefined picture = Billboard::tree2;
-				if (forShadows) {
-					angle = rotateShadowBillboard;
-					picture = Billboard::tree2Shadow;
-				}
-				modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0, 1, 0));
-				if (forShadows)
-					modelMatrix = glm::rotate(modelMatrix, tiltShadowBillboard, glm::vec3(1, 0, 0));
-				gBillboard.Draw(shader, modelMatrix, picture);
-			} else {
-				shader->Model(modelMatrix);
-				Tree::sfMediumTree.Draw();
-				if ((!gOptions.fDynamicShadows && !gOptions.fStaticShadows) || belowGround) gShadows.Add(treex, treey, treez, 3.0f, 0.8f);
-			}
-			break;
-		case BT_Tree3:
-			if (d > limit) {
-				float angle = -Model::gPlayer.fAngleHor;
-				Billboard::Predefined picture = Billboard::tree3;
-				if (forShadows) {
-					angle = rotateShadowBillboard;
-					picture = Billboard::tree3Shadow;
-				}
-				modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0, 1, 0));
-				if (forShadows)
-					modelMatrix = glm::rotate(modelMatrix, tiltShadowBillboard, glm::vec3(1, 0, 0));
-				gBillboard.Draw(shader, modelMatrix, picture);
-			} else {
-				shader->Model(modelMatrix);
-				Tree::sfBigTree.Draw();
-				if ((!gOptions.fDynamicShadows && !gOptions.fStaticShadows) || belowGround) gShadows.Add(treex, treey, treez, 4.0f, 0.8f);
+	const SpecialRange &range = fSpecial[type];
+	if (range.count == 0)
+		return;
+
+	const Tree *tree = 0;
+	Billboard::Predefined picture = Billboard::tree1, shadowPicture = Billboard::tree1Shadow;
+	float shadowSize = 0.0f;
+	switch (type) {
+	case ST_Tree1:
+		tree = &Tree::sfSmallTree; picture = Billboard::tree1; shadowPicture = Billboard::tree1Shadow; shadowSize = 1.5f;
+		break;
+	case ST_Tree2:
+		tree = &Tree::sfMediumTree; picture = Billboard::tree2; shadowPicture = Billboard::tree2Shadow; shadowSize = 3.0f;
+		break;
+	case ST_Tree3:
+		tree = &Tree::sfBigTree; picture = Billboard::tree3; shadowPicture = Billboard::tree3Shadow; shadowSize = 4.0f;
+		break;
+	default:
+		ASSERT(0);
+		return;
+	}
+
+	// Partition the instances into near trees (drawn as a mesh) and far trees (drawn as billboards). Usually, all trees
+	// in a chunk are on the same side of the limit, and the instance buffer of the chunk can be used as it is.
+	glm::vec3 player = Model::gPlayer.GetOffsetToChunk();
+	float limit = billboardLimit;
+	if (forShadows)
+		limit = billboardShadowLimit;
+	int numMesh = 0;
+	for (int i=range.first; i<range.first+range.count; i++) {
+		if (glm::distance(player, fSpecialPos[i] + offset) <= limit)
+			numMesh++;
+	}
+	const OpenglBuffer *buffer = &instances;
+	int first = range.first;
+	if (numMesh > 0 && numMesh < range.count) {
+		sPartition.resize(range.count);
+		int nearInd = 0, farInd = numMesh;
+		for (int i=range.first; i<range.first+range.count; i++) {
+			if (glm::distance(player, fSpecialPos[i] + offset) <= limit)
+				sPartition[nearInd++] = fSpecialPos[i];
+			else
+				sPartition[farInd++] = fSpecialPos[i];
+		}
+		sPartitionBuffer.BindArray(range.count * sizeof sPartition[0], &sPartition[0], GL_STREAM_DRAW);
+		buffer = &sPartitionBuffer;
+		first = 0;
+	}
+
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), offset);
+	if (numMesh > 0) {
+		shader->Model(modelMatrix);
+		tree->DrawInstanced(*buffer, first, numMesh);
+		if ((!gOptions.fDynamicShadows && !gOptions.fStaticShadows) || Model::gPlayer.BelowGround()) {
+			for (int i=first; i<first+numMesh; i++) {
+				glm::vec3 pos = (buffer == &instances ? fSpecialPos[i] : sPartition[i]) + offset;
+				gShadows.Add(pos.x, pos.y, pos.z, shadowSize);
 			}
-			break;
 		}
 	}
+
+	if (numMesh < range.count) {
+		float angle = -Model::gPlayer.fAngleHor;
+		if (forShadows) {
+			angle = rotateShadowBillboard;
+			picture = shadowPicture;
+		}
+		modelMatrix = glm::rotate(modelMatrix, angle, glm::vec3(0, 1, 0));
+		if (forShadows)
+			modelMatrix = glm::rotate(modelMatrix, tiltShadowBillboard, glm::vec3(1, 0, 0));
+		gBillboard.DrawInstanced(shader, modelMatrix, picture, *buffer, first + numMesh, range.count - numMesh);
+	}
+}
+
+void ChunkObject::DrawTrees(StageOneShader *shader, glm::vec3 offset, bool forShadows, const OpenglBuffer &instances) const {
+	const SpecialRange &tuft = fSpecial[ST_Tuft];
+	const SpecialRange &flowers = fSpecial[ST_Flowers];
+	// Only show shadow of tufts and flowers if high performance
+	if ((tuft.count > 0 || flowers.count > 0) && (!forShadows || gOptions.fPerformance >= 4)) {
+		shader->Model(glm::translate(glm::mat4(1.0f), offset + glm::vec3(0.0f, 0.65f, 0.0f)));
+		if (tuft.count > 0) {
+			glBindTexture(GL_TEXTURE_2D, GameTexture::TuftOfGrass);
+			gTuftOfGrass.DrawStaticInstanced(instances, tuft.first, tuft.count);
+		}
+		if (flowers.count > 0) {
+			glBindTexture(GL_TEXTURE_2D, GameTexture::Flowers);
+			gTuftOfGrass.DrawStaticInstanced(instances, flowers.first, flowers.count); // The same model as "tuft of grass" is used, but with a different texture
+		}
+	}
+	this->DrawTreeType(shader, offset, forShadows, instances, ST_Tree1);
+	this->DrawTreeType(shader, offset, forShadows, instances, ST_Tree2);
+	this->DrawTreeType(shader, offset, forShadows, instances, ST_Tree3);
 }
 
 void ChunkObject::FindFogs(glm::vec3 offset) const {
 	// Just find all fogs, they are drawn later in the deferred shader
-	for (int i=0; i<fNumFogs; i++) {
-		float x = (float)fFogList[i].x + offset.x;
-		float y = (float)fFogList[i].z + offset.y;
-		float z = -(float)fFogList[i].y + offset.z;
-		switch (fFogList[i].type) {
-		case BT_SmallFog:
-			gFogs.Add(x, y, z, LAMP1_DIST);
-			break;
-		case BT_BigFog:
-			gFogs.Add(x, y, z, LAMP2_DIST);
-			break;
-		}
+	const SpecialRange &small = fSpecial[ST_SmallFog];
+	for (int i=small.first; i<small.first+small.count; i++) {
+		glm::vec3 pos = fSpecialPos[i] + offset;
+		gFogs.Add(pos.x, pos.y, pos.z, LAMP1_DIST);
+	}
+	const SpecialRange &big = fSpecial[ST_BigFog];
+	for (int i=big.first; i<big.first+big.count; i++) {
+		glm::vec3 pos = fSpecialPos[i] + offset;
+		gFogs.Add(pos.x, pos.y, pos.z, LAMP2_DIST);
 	}
 }
 
 void ChunkObject::FindSpecialObjects(glm::vec3 offset, float radius) const {
-	for (const auto &item : fSpecialObject) {
-		float x = (float)item.x + offset.x;
-		float y = (float)item.z + offset.y;
-		float z = -(float)item.y + offset.z;
-		switch (item.type) {
-		case BT_RedLight:
-			gLightSources.AddRed(x, y, z, radius);
-			break;
-		case BT_BlueLight:
-			gLightSources.AddBlue(x, y, z, radius);
-			break;
-		case BT_GreenLight:
-			gLightSources.AddGreen(x, y, z, radius);
-			break;
-		}
+	const SpecialRange &red = fSpecial[ST_RedLight];
+	for (int i=red.first; i<red.first+red.count; i++) {
+		glm::vec3 pos = fSpecialPos[i] + offset;
+		gLightSources.AddRed(pos.x, pos.y, pos.z, radius);
+	}
+	const SpecialRange &green = fSpecial[ST_GreenLight];
+	for (int i=green.first; i<green.first+green.count; i++) {
+		glm::vec3 pos = fSpecialPos[i] + offset;
+		gLightSources.AddGreen(pos.x, pos.y, pos.z, radius);
+	}
+	const SpecialRange &blue = fSpecial[ST_BlueLight];
+	for (int i=blue.first; i<blue.first+blue.count; i++) {
+		glm::vec3 pos = fSpecialPos[i] + offset;
+		gLightSources.AddBlue(pos.x, pos.y, pos.z, radius);
 	}
 }
 
@@ -503,6 +508,27 @@ static bool MostlyFacingUpwards(const VertexDataf &v) {
 
 #define MAX_SUN_INTENSITY 	230		// 0-255. Don't saturate, to allow a small contribution from ambient light
 
+// Map a block type to the special object type, or -1 if it isn't a special object.
+static int SpecialTypeOf(int bl) {
+	switch(bl) {
+	case BT_Tree1: return ChunkObject::ST_Tree1;
+	case BT_Tree2: return ChunkObject::ST_Tree2;
+	case BT_Tree3: return ChunkObject::ST_Tree3;
+	case BT_Tuft: return ChunkObject::ST_Tuft;
+	case BT_Flowers: return ChunkObject::ST_Flowers;
+	case BT_Lamp1: return ChunkObject::ST_Lamp1;
+	case BT_Lamp2: return ChunkObject::ST_Lamp2;
+	case BT_Treasure: return ChunkObject::ST_Treasure;
+	case BT_Quest: return ChunkObject::ST_Quest;
+	case BT_SmallFog: return ChunkObject::ST_SmallFog;
+	case BT_BigFog: return ChunkObject::ST_BigFog;
+	case BT_RedLight: return ChunkObject::ST_RedLight;
+	case BT_GreenLight: return ChunkObject::ST_GreenLight;
+	case BT_BlueLight: return ChunkObject::ST_BlueLight;
+	}
+	return -1;
+}
+
 // Create an array of struct TriangleSurfacef for each block type. The arguments are used for picking mode.
 // The reason that the chunk pointer is a const is that nothing is allowed be changed in it. This is because this update function
 // is done in a separate process.
@@ -535,12 +561,17 @@ void ChunkObject::FindTriangles(const Chunk *cp, bool pickingMode, int pdx, int
 		ComputeDelta(delta, addNoise, neighbor);
 
 	std::vector<TriangleSurfacef> b[256]; // One list for each block type
+	std::vector<glm::vec3> specialPos[ST_Count]; // One list for each special object type
 	for (int z=0; z<CHUNK_SIZE; z++) for (int x=0; x<CHUNK_SIZE; x++) for (int y=0; y<CHUNK_SIZE; y++) {
 				coding.bitmap.x = x; coding.bitmap.y = y; coding.bitmap.z = z;
 				// NOTICE: in the game server, 'z' is the height, but in OpenGL, 'y' is the height. Because of that,
 				// 'z' and 'y' are changed with each other when creating OpenGL graphics from server coordinates.
 				int bl = cp->GetBlock(x, y, z);
-				if (cp->fChunkBlocks->blockIsComplTransp(bl))
+				int special = SpecialTypeOf(bl);
+				if (special >= 0 && !pickingMode)
+					specialPos[special].push_back(glm::vec3(x, z, -y));
+				bool complTransp = cp->fChunkBlocks->blockIsComplTransp(bl);
+				if (complTransp && special < 0)
 					continue;	// Nothing is drawn from air
 
 				// Update the boundary box. Special care has to be taken because of lamps shining outside of the chunk
@@ -573,6 +604,8 @@ void ChunkObject::FindTriangles(const Chunk *cp, bool pickingMode, int pdx, int
 					if (z > fBoundZMax) fBoundZMax = z;
 					break;
 				}
+				if (complTransp)
+					continue; // A special object, which is not drawn as a block
 				int blxm1, blxp1, blym1, blyp1, blzm1, blzp1; // The nearest blocks to x,y,z. blxm1 means "block at x minus 1".
 
 				// Find all adjacent blocks, in the 6 directions. It can be a hard if the block is in another chunk,
@@ -932,6 +965,19 @@ void ChunkObject::FindTriangles(const Chunk *cp, bool pickingMode, int pdx, int
 					}
 				}
 			}
+
+	// Pack the special objects into one list, sorted on type
+	size_t numSpecial = 0;
+	for (int i=0; i<ST_Count; i++)
+		numSpecial += specialPos[i].size();
+	fSpecialPos.clear();
+	fSpecialPos.reserve(numSpecial);
+	for (int i=0; i<ST_Count; i++) {
+		fSpecial[i].first = fSpecialPos.size();
+		fSpecial[i].count = specialPos[i].size();
+		fSpecialPos.insert(fSpecialPos.end(), specialPos[i].begin(), specialPos[i].end());
+	}
+
 	for (int i=0; i<256; i++) {
 		if (b[i].size() > 0) {
 			fVisibleTriangles[i] = std::move(b[i]);
@@ -944,98 +990,3 @@ void ChunkObject::FindTriangles(const Chunk *cp, bool pickingMode, int pdx, int
 		}
 	}
 }
-
-void ChunkObject::FindSpecialObjects(const Chunk *cp) {
-	fSpecialObject.clear();
-	// First count, then allocate
-	fNumTree = 0;
-	fNumLamps = 0;
-	fNumFogs = 0;
-	fNumTreasures = 0;
-	for (int x=0; x<CHUNK_SIZE; x++) for (int y=0; y<CHUNK_SIZE; y++) for (int z=0; z<CHUNK_SIZE; z++) {
-				int bl = cp->GetBlock(x, y, z);
-				switch(bl) {
-				case BT_Tree1:
-				case BT_Tree2:
-				case BT_Tree3:
-				case BT_Tuft:
-				case BT_Flowers:
-					fNumTree++;
-					break;
-				case BT_Lamp1:
-				case BT_Lamp2:
-					fNumLamps++;
-					break;
-				case BT_SmallFog:
-				case BT_BigFog:
-					fNumFogs++;
-					break;
-				case BT_Treasure:
-				case BT_Quest:
-					fNumTreasures++;
-					break;
-				}
-			}
-	if (fNumTree > 0)
-		fTreeList.reset(new SpecialObject[fNumTree]);
-	if (fNumLamps > 0)
-		fLampList.reset(new SpecialObject[fNumLamps]);
-	if (fNumFogs > 0)
-		fFogList.reset(new SpecialObject[fNumFogs]);
-	if (fNumTreasures > 0)
-		fTreasureList.reset(new SpecialObject[fNumTreasures]);
-	int treeInd = 0, lampInd = 0, fogInd = 0, treasureInd = 0;
-	for (int x=0; x<CHUNK_SIZE; x++) for (int y=0; y<CHUNK_SIZE; y++) for (int z=0; z<CHUNK_SIZE; z++) {
-				int bl = cp->GetBlock(x, y, z);
-				switch(bl) {
-				case BT_Tree1:
-				case BT_Tree2:
-				case BT_Tree3:
-				case BT_Tuft:
-				case BT_Flowers:
-					fTreeList[treeInd].x = x;
-					fTreeList[treeInd].y = y;
-					fTreeList[treeInd].z = z;
-					fTreeList[treeInd].type = bl;
-					// fTreeList[treeInd].ambient = cp->ComputeAmbientLight(x, y, z) + cp->InSunLight(x, y, z) * 0.15; /// @todo Not used
-					treeInd++;
-					break;
-				case BT_Lamp1:
-				case BT_Lamp2:
-					fLampList[lampInd].x = x;
-					fLampList[lampInd].y = y;
-					fLampList[lampInd].z = z;
-					fLampList[lampInd].type = bl;
-					lampInd++;
-					break;
-				case BT_SmallFog:
-				case BT_BigFog: {
-					fFogList[fogInd].x = x;
-					fFogList[fogInd].y = y;
-					fFogList[fogInd].z = z;
-					fFogList[fogInd].type = bl;
-					fogInd++;
-					break;
-				}
-				case BT_Treasure:
-				case BT_Quest:
-					fTreasureList[treasureInd].x = x;
-					fTreasureList[treasureInd].y = y;
-					fTreasureList[treasureInd].z = z;
-					fTreasureList[treasureInd].type = bl;
-					// fTreasureList[treasureInd].ambient = cp->ComputeAmbientLight(x, y, z) + cp->InSunLight(x, y, z) * 0.15; /// @todo Not used
-					treasureInd++;
-					break;
-				case BT_RedLight:
-				case BT_BlueLight:
-				case BT_GreenLight:
-					SpecialObject so;
-					so.x = x;
-					so.y = y;
-					so.z = z;
-					so.type = bl;
-					// so.ambient = 0.0f;  // Not used for colored lights
-					fSpecialObject.push_back(so);
-				}
-			}
-}
@@ -26,6 +26,7 @@
 using std::unique_ptr;
 struct TriangleSurfacef;
 class StageOneShader;
+class OpenglBuffer;
 
 namespace View {
 	class Chunk;
@@ -36,10 +37,12 @@ namespace View {
 /// data and compute what can be drawn from the chunk.
 class ChunkObject {
 public:
-	/// Draw all lamps
-	void DrawLamps(StageOneShader *shader, glm::vec3 offset) const;
-	void DrawTreasures(StageOneShader *shader, glm::vec3 offset) const;
-	void DrawTrees(StageOneShader *shader, glm::vec3 offset, bool forShadows) const;
+	/// Draw all lamps.
+	/// The special objects are drawn instanced, one call for each model type, using the instance
+	/// buffer (created from fSpecialPos) in 'instances'.
+	void DrawLamps(StageOneShader *shader, glm::vec3 offset, const OpenglBuffer &instances) const;
+	void DrawTreasures(StageOneShader *shader, glm::vec3 offset, const OpenglBuffer &instances) const;
+	void DrawTrees(StageOneShader *shader, glm::vec3 offset, bool forShadows, const OpenglBuffer &instances) const;
 	void FindFogs(glm::vec3 offset) const;
 	void FindSpecialObjects(glm::vec3 offset, float radius) const;
 
@@ -61,28 +64,29 @@ public:
 	// True if there are no graphical objects to show in this chunk
 	bool Empty(void) const;
 
-	// To improve the look, many block types are not drawn as blocks, but as a more advanced 3D model (e.g. trees and lamps).
-	void FindSpecialObjects(const View::Chunk *cp);
-
-	// For each special object, save information about it.
-	struct SpecialObject {
-		float ambient;         // Amount of ambient light at this object
-		unsigned char x, y, z; // The local coordinate of the tree
-		unsigned char type;    // Block type
+	// To improve the look, many block types are not drawn as blocks, but as a more advanced 3D model (e.g. trees and lamps),
+	// or as lights and fogs. These special objects are found by FindTriangles(), one entry for each type. The types up to
+	// ST_NumInstanced are drawn instanced with a model.
+	enum SpecialType { ST_Tree1, ST_Tree2, ST_Tree3, ST_Tuft, ST_Flowers, ST_Lamp1, ST_Lamp2, ST_Treasure, ST_Quest,
+		ST_SmallFog, ST_BigFog, ST_RedLight, ST_GreenLight, ST_BlueLight, ST_Count, ST_NumInstanced = ST_SmallFog };
+	struct SpecialRange {
+		int first, count; // Index into fSpecialPos
 	};
-
-	// TODO: These should be std::vector.
-	// Manage objects found in the chunk. It is a static list, decoded when the chunk is loaded.
 	// TODO: These should not be public
-	unique_ptr<SpecialObject[]> fTreeList; int fNumTree;
-	unique_ptr<SpecialObject[]> fLampList; int fNumLamps;
-	unique_ptr<SpecialObject[]> fFogList; int fNumFogs;
-	unique_ptr<SpecialObject[]> fTreasureList; int fNumTreasures;
-	std::vector<SpecialObject> fSpecialObject; // The list of all special objects found in this chunk.
+	SpecialRange fSpecial[ST_Count];
+
+	// Local OpenGL coordinate of all special objects, sorted on SpecialType. It is a static list, decoded when the chunk is loaded.
+	std::vector<glm::vec3> fSpecialPos;
+
+	// The number of special objects drawn instanced. They are first in fSpecialPos, and used to initialize the instance buffer of the chunk.
+	int NumInstanced(void) const { return fSpecial[ST_NumInstanced].first; }
 
 	// Cyclic pointer back to the chunk the data belongs to. TODO: can this be avoided?
 	View::Chunk *fChunk;
 private:
+	// Draw all trees of one type, using billboards for the ones far away.
+	void DrawTreeType(StageOneShader *shader, glm::vec3 offset, bool forShadows, const OpenglBuffer &instances, SpecialType type) const;
+
 	// Code an array of struct TriangleSurfacef.
 	// The arguments are used for selection mode.
 	void FindTriangles(const View::Chunk *cp, bool pickingMode, int pdx, int pdy, int pdz, bool smoothing, bool mergeNormals, bool addNoise);
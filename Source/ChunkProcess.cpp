@@ -21,6 +21,7 @@
 #include "chunk.h"
 #include "ChunkObject.h"
 #include "chunkcache.h"
+#include "ChunkRequests.h"
 #include "assert.h"
 #include "primitives.h"
 #include "player.h"
@@ -149,11 +150,13 @@ void ChunkProcess::Task(void) {
 				ch->fScheduledForComputation = false;
 				continue; // Ignore a recomputation, as the chunk will be loaded by new data anyway, later followed by a new computation
 			}
+			unsigned long seq = fComputationsStarted++;
+			auto computing = fComputing.insert(seq); // Blocks replaced from now on are kept until this is done
 			fMutex.unlock(); // Unlock the mutex while doing some heavy work
 			// printf("ChunkProcess phase 1, size %lu, chunk %d,%d,%d\n", fComputeObjectsInput.size()+1, ch->cc.x, ch->cc.y, ch->cc.z);
 			auto co = View::ChunkObject::Make(ch, false, 0, 0, 0);
-			co->FindSpecialObjects(ch); // This will find light sources, and should be done before FindTriangles().
 			fMutex.lock();
+			fComputing.erase(computing);
 			ASSERT(ch->fScheduledForComputation);
 			co->fChunk = ch;
 			fComputedObjectsOutput.insert(std::move(co)); // Add it to the list of recomputed chunks
@@ -168,17 +171,20 @@ void ChunkProcess::Task(void) {
 			ASSERT(pc->fScheduledForLoading);
 			fMutex.unlock(); // Unlock the mutex while doing some work
 			// printf("ChunkProcess phase 2, size %lu\n", fNewChunksInput.size()+1);
-			nc->Uncompress();
-
-			// Save chunk in cache
-			ChunkCache::cachunk chunkdata;
-			chunkdata.cc = pc->cc;
-			chunkdata.flag = nc->flag;
-			chunkdata.fCheckSum = nc->fChecksum;
-			chunkdata.fOwner = nc->fOwner;
-			chunkdata.compressSize = nc->compressSize;
-			chunkdata.compressedChunk = nc->fCompressedChunk.get();
-			ChunkCache::fgChunkCache.SaveChunkInCache(&chunkdata); // TODO: Use a ChunkProcess::ChunkBlocks as argument instead
+			if (nc->Uncompress()) {
+				// Save chunk in cache
+				ChunkCache::cachunk chunkdata;
+				chunkdata.cc = pc->cc;
+				chunkdata.flag = nc->flag;
+				chunkdata.fCheckSum = nc->fChecksum;
+				chunkdata.fOwner = nc->fOwner;
+				chunkdata.compressSize = nc->compressSize;
+				chunkdata.compressedChunk = nc->fCompressedChunk.get();
+				ChunkCache::fgChunkCache.SaveChunkInCache(&chunkdata); // TODO: Use a ChunkProcess::ChunkBlocks as argument instead
+			}
+			// The compressed data is no longer needed. It usually refers to a receive buffer, which can't be released until
+			// all chunks in it are done.
+			nc->fCompressedChunk.reset();
 			fMutex.lock();
 			ASSERT(nc->fChunk == pc);
 			fNewChunksOutput.insert(nc); // Add it to the list of loaded chunks
@@ -228,9 +234,9 @@ void ChunkProcess::Poll(void) {
 		View::Chunk *cp = co->fChunk;
 		co->fChunk = 0;
 		ASSERT(cp != 0 && cp->fScheduledForComputation); // Should not have been cleared elsewhere.
-		cp->fChunkObject = co;
-		cp->ReleaseOpenGLBuffers();
+		cp->fChunkObject = co; // The old mesh is drawn until the new one has been uploaded
 		cp->fScheduledForComputation = false;
+		fMeshesDone++;
 		// if (gVerbose) printf("ChunkProcess::Poll %d,%d,%d\n", cp->cc.x, cp->cc.y, cp->cc.z);
 	}
 	fComputedObjectsOutput.clear();
@@ -238,17 +244,53 @@ void ChunkProcess::Poll(void) {
 	for (auto it=fNewChunksOutput.begin() ; it != fNewChunksOutput.end(); it++ ) {
 		auto cb = *it;
 		View::Chunk *cp = cb->fChunk;
+		if (cb->fChunkData == nullptr) {
+			// The data was corrupt. Keep the old blocks, and ask the server again.
+			printf("ChunkProcess: Corrupt data for chunk %d,%d,%d, requested again\n", cp->cc.x, cp->cc.y, cp->cc.z);
+			cp->fScheduledForLoading = false;
+			cp->fAwaitingData = true;
+			gChunkRequests.Request(cp);
+			continue;
+		}
+		this->retire(cp->fChunkBlocks);
 		cp->fChunkBlocks = cb;
 		cp->fScheduledForLoading = false;
 		cp->SetDirty(true); // Need to be done after clearing loading flag
 		cp->UpdateNeighborChunks(); // This will now use the new ChunkBlocks
+		fChunksDone++;
 		// if (gVerbose) printf("ChunkProcess::Poll %d,%d,%d\n", cp->cc.x, cp->cc.y, cp->cc.z);
 	}
 	fNewChunksOutput.clear();
 
+	// Release the replaced blocks that no computation can be using any longer.
+	unsigned long oldest = fComputing.empty() ? fComputationsStarted : *fComputing.begin();
+	while (!fRetired.empty() && fRetired.front().first <= oldest)
+		fRetired.pop_front();
+
 	fMutex.unlock();				// Unlock the mutex; this will wakeup the child thread
 }
 
+void ChunkProcess::Retire(shared_ptr<Model::ChunkBlocks> cb) {
+	fMutex.lock();
+	this->retire(std::move(cb));
+	fMutex.unlock();
+}
+
+void ChunkProcess::retire(shared_ptr<Model::ChunkBlocks> cb) {
+	// Computations with a lower sequence number than this may have found 'cb' in the chunk.
+	fRetired.push_back(std::make_pair(fComputationsStarted, std::move(cb)));
+}
+
+void ChunkProcess::Report(void) {
+	fMutex.lock();
+	unsigned computeQueued = fComputeObjectsInput.size(), newQueued = fNewChunksInput.size();
+	fMutex.unlock();
+	printf("ChunkProcess: %u meshes computed, %u chunks loaded, queued %u meshes and %u chunks\n",
+	       fMeshesDone, fChunksDone, computeQueued, newQueued);
+	fMeshesDone = 0;
+	fChunksDone = 0;
+}
+
 void ChunkProcess::AddTaskNewChunk(unique_ptr<Model::ChunkBlocks> cb) {
 	// The chunk may also have been scheduled for computation, but we can't do anything to that here.
 	fMutex.lock();				// Lock the mutex, to get access to the message variable
@@ -21,6 +21,7 @@
 #include <set>
 #include <memory>
 #include <vector>
+#include <utility>
 
 #ifdef WIN32
 #include "mythread.h"
@@ -78,6 +79,13 @@ public:
 	// Load new chunk data into a chunk, but do not recompute it. It will replace the previous one
 	void AddTaskNewChunk(unique_ptr<Model::ChunkBlocks>);
 
+	// A ChunkBlocks has been replaced in a chunk. Mesh computations read the blocks of the chunk and of the chunks
+	// around it without a lock, so the old one is kept until all computations started before now are done.
+	void Retire(shared_ptr<Model::ChunkBlocks>);
+
+	// Print the number of finished jobs since the last report, and the current queue depths
+	void Report(void);
+
 	// Request the processes to terminate
 	void RequestTerminate(void);
 private:
@@ -99,9 +107,17 @@ private:
 	// This is where the computed objects are saved. Use a set, to make sure every element is only ever once in it.
 	std::set<shared_ptr<View::ChunkObject>> fComputedObjectsOutput;
 	std::set<shared_ptr<Model::ChunkBlocks>> fNewChunksOutput;
+	unsigned long fComputationsStarted = 0; // Every mesh computation gets a sequence number
+	std::multiset<unsigned long> fComputing; // The sequence numbers of the mesh computations in progress
+	// Replaced blocks, and the sequence number of the first computation that can't use them.
+	std::deque<std::pair<unsigned long, shared_ptr<Model::ChunkBlocks>>> fRetired;
 	//
 	// End of list of mutex protected variables.
 	// ==============================================================================================================
+
+	unsigned fMeshesDone = 0, fChunksDone = 0; // Statistics, updated by the main thread
+
+	void retire(shared_ptr<Model::ChunkBlocks>); // Same as Retire(), with 'fMutex' already locked
 };
 
 // Create one global process
@@ -0,0 +1,268 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "ChunkRequests.h"
+#include "chunk.h"
+#include "connection.h"
+#include "parse.h"
+#include "client_prot.h"
+#include "primitives.h"
+#include "player.h"
+#include "render.h"
+#include "Options.h"
+#include "modes.h"
+#include "Clock.h"
+
+// Maximum number of chunk requests waiting for an answer from the server
+#define MAX_IN_FLIGHT 32
+
+// A request that hasn't been answered in this time (in seconds) is given up. It will be requested again if still needed.
+#define REQUEST_TIMEOUT 10.0
+
+// Minimum time in seconds between searches for chunks to prefetch
+#define PREFETCH_INTERVAL 0.25
+
+// Maximum number of chunks created by the prefetch every frame. Chunks found in the cache are uncompressed immediately.
+#define PREFETCH_MAX_NEW 8
+
+// Maximum number of chunks in one checksum verification message, and minimum time in seconds between the messages
+#define VERIFY_MAX_CHUNKS 64
+#define VERIFY_INTERVAL 0.1
+
+ChunkRequests gChunkRequests;
+
+void ChunkRequests::Request(View::Chunk *cp) {
+	if (cp->fRequestPending)
+		return;
+	cp->fRequestPending = true;
+	Entry e;
+	e.fChunk = cp;
+	e.fQueued = gCurrentFrameTime;
+	e.fSent = 0.0;
+	e.fPriority = 0.0f;
+	fQueue.push_back(e);
+	if (fQueue.size() > fMaxQueued)
+		fMaxQueued = fQueue.size();
+}
+
+void ChunkRequests::Arrived(View::Chunk *cp) {
+	cp->fAwaitingData = false;
+	if (!cp->fRequestPending) {
+		fUnrequested++; // Usually because of a failed checksum verification
+		return;
+	}
+	cp->fRequestPending = false;
+	for (auto it = fInFlight.begin(); it != fInFlight.end(); ++it) {
+		if (it->fChunk != cp)
+			continue;
+		double now = GetTime();
+		double latency = now - it->fQueued;
+		fLatencyTotal += latency;
+		fNetworkLatencyTotal += now - it->fSent;
+		if (latency > fLatencyMax)
+			fLatencyMax = latency;
+		fArrivedCount++;
+		fInFlight.erase(it);
+		return;
+	}
+	// The chunk was sent before it was requested
+	for (auto it = fQueue.begin(); it != fQueue.end(); ++it) {
+		if (it->fChunk == cp) {
+			fQueue.erase(it);
+			return;
+		}
+	}
+}
+
+void ChunkRequests::Verify(View::Chunk *cp) {
+	if (cp->fVerifyPending)
+		return;
+	cp->fVerifyPending = true;
+	fVerifyQueue.push_back(cp);
+	if (fVerifyQueue.size() > fVerifyMaxQueued)
+		fVerifyMaxQueued = fVerifyQueue.size();
+}
+
+void ChunkRequests::SendVerify(void) {
+	if (fVerifyQueue.empty() || gCurrentFrameTime - fLastVerify < VERIFY_INTERVAL || !gMode.CommunicationAllowed())
+		return;
+	// The message has a header of 3 bytes, followed by 7 bytes for every chunk: the least significant byte of
+	// the chunk coordinates, and the checksum.
+	size_t count = std::min(fVerifyQueue.size(), size_t(VERIFY_MAX_CHUNKS));
+	unsigned char b[3+7*VERIFY_MAX_CHUNKS];
+	int n = 3+7*count;
+	b[0] = n & 0xFF;
+	b[1] = n >> 8;
+	b[2] = CMD_VRFY_CHUNK_CS;
+	unsigned char *p = b+3;
+	for (size_t i = 0; i < count; i++, p += 7) {
+		View::Chunk *cp = fVerifyQueue[i];
+		cp->fVerifyPending = false;
+		unsigned int checksum = cp->fChunkBlocks->fChecksum;
+		p[0] = cp->cc.x & 0xFF;
+		p[1] = cp->cc.y & 0xFF;
+		p[2] = cp->cc.z & 0xFF;
+		p[3] = checksum & 0xFF;
+		p[4] = (checksum >> 8) & 0xFF;
+		p[5] = (checksum >> 16 ) & 0xFF;
+		p[6] = (checksum >> 24 ) & 0xFF;
+	}
+	SendMsg(b, n);
+	fVerifyQueue.erase(fVerifyQueue.begin(), fVerifyQueue.begin() + count);
+	fLastVerify = gCurrentFrameTime;
+	fVerifyMessages++;
+	fVerifyChunks += count;
+}
+
+void ChunkRequests::Cancel(Entry &e) {
+	e.fChunk->fRequestPending = false; // Still waiting for data, so it will be requested again when needed
+	e.fChunk = 0;
+}
+
+void ChunkRequests::Poll(void) {
+	// Give up requests that the server never answered, so that they don't block the window.
+	for (auto &e : fInFlight) {
+		if (gCurrentFrameTime - e.fSent > REQUEST_TIMEOUT) {
+			Cancel(e);
+			fTimeouts++;
+		}
+	}
+	fInFlight.erase(std::remove_if(fInFlight.begin(), fInFlight.end(), [](const Entry &e) { return e.fChunk == 0; }), fInFlight.end());
+
+	ChunkCoord pc;
+	Model::gPlayer.GetChunkCoord(&pc);
+	int range = int(maxRenderDistance / CHUNK_SIZE + 1);
+	this->Prefetch(pc, range);
+	this->SendVerify();
+
+	if (fQueue.empty() || fInFlight.size() >= MAX_IN_FLIGHT)
+		return;
+
+	// The camera looks along the negative z axis of the view matrix. Transform the direction to the server coordinate system.
+	glm::vec3 forward(-gViewMatrix[0][2], gViewMatrix[2][2], -gViewMatrix[1][2]);
+	float max2 = float(range*range); // The player can't see chunks further away than this.
+	for (auto &e : fQueue) {
+		const ChunkCoord &cc = e.fChunk->cc;
+		glm::vec3 d(cc.x - pc.x, cc.y - pc.y, cc.z - pc.z);
+		glm::vec3 dp(cc.x - fPredicted.x, cc.y - fPredicted.y, cc.z - fPredicted.z);
+		float d2 = glm::dot(d, d);
+		if (d2 > max2 && glm::dot(dp, dp) > max2) {
+			Cancel(e);
+			fCancelled++;
+			continue;
+		}
+		// Chunks behind the player count as being up to twice the distance.
+		float weight = d2 > 0.0f ? 1.5f - 0.5f * glm::dot(d, forward) / sqrtf(d2) : 1.0f;
+		e.fPriority = d2 * weight * weight;
+	}
+	fQueue.erase(std::remove_if(fQueue.begin(), fQueue.end(), [](const Entry &e) { return e.fChunk == 0; }), fQueue.end());
+
+	size_t count = std::min(fQueue.size(), MAX_IN_FLIGHT - fInFlight.size());
+	std::partial_sort(fQueue.begin(), fQueue.begin() + count, fQueue.end(), [](const Entry &a, const Entry &b) { return a.fPriority < b.fPriority; });
+	for (size_t i = 0; i < count; i++) {
+		Entry &e = fQueue[i];
+		const ChunkCoord &cc = e.fChunk->cc;
+		// printf("ChunkRequests: Request chunk (%d,%d,%d)\n", cc.x, cc.y, cc.z);
+		unsigned char b[15];
+		b[0] = sizeof b;
+		b[1] = 0;
+		b[2] = CMD_READ_CHUNK;
+		// Even though the chunk coordinates are not unsigned, they can be encoded as such.
+		EncodeUint32(b+3, (unsigned int)cc.x);
+		EncodeUint32(b+7, (unsigned int)cc.y);
+		EncodeUint32(b+11, (unsigned int)cc.z);
+		SendMsg(b, sizeof b);
+		e.fSent = gCurrentFrameTime;
+		fInFlight.push_back(e);
+		fSentCount++;
+	}
+	fQueue.erase(fQueue.begin(), fQueue.begin() + count);
+}
+
+void ChunkRequests::Prefetch(const ChunkCoord &player, int range) {
+	fPredicted = player;
+	if (gOptions.fPrefetchTime <= 0.0f || !Model::gPlayer.KnownPosition())
+		return;
+	glm::dvec3 ahead = Model::gPlayer.GetVelocity() * double(gOptions.fPrefetchTime) / double(CHUNK_SIZE);
+	fPredicted.x += int(floor(ahead.x + 0.5));
+	fPredicted.y += int(floor(ahead.y + 0.5));
+	fPredicted.z += int(floor(ahead.z + 0.5));
+	if (fPredicted.x == player.x && fPredicted.y == player.y && fPredicted.z == player.z)
+		return; // Everything near the predicted position is already in view
+	if (gCurrentFrameTime - fLastPrefetch < PREFETCH_INTERVAL)
+		return;
+
+	// Go through the chunks that will be in view from the predicted position, but are not in view now.
+	int created = 0;
+	for (int dz=-range+1; dz<range; dz++) for (int dx=-range+1; dx<range; dx++) for (int dy=-range+1; dy<range; dy++) {
+				if (dx*dx + dy*dy + dz*dz >= range*range)
+					continue;
+				ChunkCoord cc;
+				cc.x = fPredicted.x + dx;
+				cc.y = fPredicted.y + dy;
+				cc.z = fPredicted.z + dz;
+				int px = cc.x - player.x, py = cc.y - player.y, pz = cc.z - player.z;
+				if (px*px + py*py + pz*pz < range*range)
+					continue; // This one is managed by the normal drawing
+				View::Chunk *cp = ChunkFind(&cc, false);
+				if (cp == 0) {
+					if (created == PREFETCH_MAX_NEW)
+						return; // Continue next frame
+					cp = ChunkFind(&cc, true); // Either loaded from the cache, or requested from the server
+					cp->fPrefetched = true;
+					created++;
+					fPrefetchCount++;
+				} else if (cp->fAwaitingData) {
+					this->Request(cp); // The previous request may have been cancelled
+				} else if (cp->IsDirty() && !cp->fScheduledForLoading) {
+					cp->UpdateGraphics(); // Compute the mesh in advance
+				}
+			}
+	fLastPrefetch = gCurrentFrameTime;
+}
+
+void ChunkRequests::PrefetchUsed(View::Chunk *cp) {
+	cp->fPrefetched = false;
+	fPrefetchUsed++;
+	if (!cp->fAwaitingData)
+		fPrefetchHits++;
+	if (cp->fChunkObject)
+		fPrefetchMeshed++;
+}
+
+void ChunkRequests::Report(void) {
+	printf("ChunkRequests: %d queued (max %u), %d in flight. %u sent, %u arrived, %u cancelled, %u timed out. Latency %.0f ms (max %.0f ms), of which network %.0f ms\n",
+	       int(fQueue.size()), fMaxQueued, int(fInFlight.size()), fSentCount, fArrivedCount, fCancelled, fTimeouts,
+	       fArrivedCount > 0 ? fLatencyTotal * 1000.0 / fArrivedCount : 0.0, fLatencyMax * 1000.0,
+	       fArrivedCount > 0 ? fNetworkLatencyTotal * 1000.0 / fArrivedCount : 0.0);
+	fMaxQueued = fQueue.size();
+	fSentCount = fArrivedCount = fCancelled = fTimeouts = 0;
+	fLatencyTotal = fLatencyMax = fNetworkLatencyTotal = 0.0;
+	printf("ChunkRequests: %u prefetched, %u came into view, of which %u (%.0f%%) had data and %u had a mesh\n",
+	       fPrefetchCount, fPrefetchUsed, fPrefetchHits, fPrefetchUsed > 0 ? 100.0 * fPrefetchHits / fPrefetchUsed : 0.0, fPrefetchMeshed);
+	fPrefetchCount = fPrefetchUsed = fPrefetchHits = fPrefetchMeshed = 0;
+	printf("ChunkRequests: %u checksums verified in %u messages (%u bytes instead of %u), %d queued (max %u), %u unrequested chunks received\n",
+	       fVerifyChunks, fVerifyMessages, 3*fVerifyMessages + 7*fVerifyChunks, 10*fVerifyChunks, int(fVerifyQueue.size()), fVerifyMaxQueued,
+	       fUnrequested);
+	fVerifyMessages = fVerifyChunks = fUnrequested = 0;
+	fVerifyMaxQueued = fVerifyQueue.size();
+}
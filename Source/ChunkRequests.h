@@ -0,0 +1,86 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <vector>
+
+#include "chunk.h"
+
+/// @brief Schedule requests of chunk data from the server.
+///
+/// Chunks are requested from ChunkFind() in whatever order they are needed by the drawing. Instead of sending
+/// the requests immediately, they are queued here. Once every frame, the queue is sorted on distance to the
+/// player, where chunks in the view direction are preferred, and requests are sent until the number of
+/// outstanding requests reach a limit. Chunks that are out of range are removed from the queue, and will be
+/// requested again if they are needed.
+///
+/// When the player is moving, chunks that will come into view along the predicted path are requested
+/// and computed in advance. The look-ahead time is configured by Options::fPrefetchTime.
+///
+/// Verification of chunk checksums is also collected here, and sent several chunks in each message.
+///
+/// All functions shall be called from the main thread.
+class ChunkRequests {
+public:
+	/// Queue a request for the data of a chunk, unless already requested.
+	void Request(View::Chunk *);
+
+	/// The data of a chunk has arrived from the server.
+	void Arrived(View::Chunk *);
+
+	/// Queue a request to the server to verify the checksum of a chunk, unless already queued.
+	void Verify(View::Chunk *);
+
+	/// Send the most important requests. Shall be called once every frame, before the messages are flushed.
+	void Poll(void);
+
+	/// A prefetched chunk is drawn for the first time. Used for statistics.
+	void PrefetchUsed(View::Chunk *);
+
+	/// Print statistics about queue depth and latency since the last report.
+	void Report(void);
+private:
+	struct Entry {
+		View::Chunk *fChunk;
+		double fQueued;   // Time when the chunk was requested
+		double fSent;     // Time when the request was sent to the server
+		float fPriority;  // Lower value is more important
+	};
+	std::vector<Entry> fQueue;     // Requests not sent yet
+	std::vector<Entry> fInFlight;  // Requests sent to the server, waiting for an answer
+	ChunkCoord fPredicted;         // The predicted chunk of the player, used by the prefetch
+	double fLastPrefetch = 0.0;
+	std::vector<View::Chunk*> fVerifyQueue; // Chunks waiting for checksum verification
+	double fLastVerify = 0.0;
+
+	// Statistics since last report
+	unsigned fMaxQueued = 0, fSentCount = 0, fArrivedCount = 0, fCancelled = 0, fTimeouts = 0;
+	double fLatencyTotal = 0.0, fLatencyMax = 0.0, fNetworkLatencyTotal = 0.0;
+	unsigned fPrefetchCount = 0, fPrefetchUsed = 0, fPrefetchHits = 0, fPrefetchMeshed = 0;
+	unsigned fVerifyMessages = 0, fVerifyChunks = 0, fVerifyMaxQueued = 0, fUnrequested = 0;
+
+	void Cancel(Entry &);
+
+	// Find chunks that will come into view along the predicted path of the player.
+	void Prefetch(const ChunkCoord &player, int range);
+
+	// Send one message with the checksums of the queued chunks, if allowed by the throttling.
+	void SendVerify(void);
+};
+
+extern ChunkRequests gChunkRequests;
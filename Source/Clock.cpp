@@ -0,0 +1,48 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <GL/glfw.h>
+#include <chrono>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Clock.h"
+
+static bool sSystemClock = false;
+
+void UseSystemClock(void) {
+	sSystemClock = true;
+}
+
+double GetTime(void) {
+	if (!sSystemClock)
+		return glfwGetTime();
+	static const auto start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void SleepSeconds(double seconds) {
+#ifdef WIN32
+	::Sleep(DWORD(seconds * 1000.0));
+#else
+	usleep(useconds_t(seconds * 1000000.0));
+#endif
+}
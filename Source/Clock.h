@@ -1,4 +1,4 @@
-// Copyright 2012 The Ephenation Authors
+// Copyright 2013 The Ephenation Authors
 //
 // This file is part of Ephenation.
 //
@@ -17,22 +17,12 @@
 
 #pragma once
 
-//
-// This class encapsulates a shader that will add lighting from a point light.
-//
-
-#include "shader.h"
-
-class AddPointLight : public ShaderBase {
-public:
-	AddPointLight();
+/// The time in seconds, the same as glfwGetTime(). When running headless, GLFW is not
+/// initialized, and a clock of our own is used instead. This function is thread safe.
+extern double GetTime(void);
 
-	void Init();
-	// point.xyz is the world cordinate, adn point.w is the strength of the light.
-	void Draw(const glm::vec3 &pos, float strength);
-private:
-	// Callback that defines all uniform and attribute indices.
-	virtual void GetLocations(void);
+/// Sleep the current thread, the same as glfwSleep() but also when GLFW is not initialized.
+extern void SleepSeconds(double seconds);
 
-	GLint fLampIdx;
-};
+/// Stop using the GLFW timer. Shall be called before any other thread is started.
+extern void UseSystemClock(void);
@@ -0,0 +1,236 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <glm/glm.hpp>
+
+namespace Model {
+
+/// @brief A dense store of entities, like monsters or other players, with spatial queries.
+///
+/// The data used for iterating is kept in separate arrays, indexed by a slot number. Slots are
+/// dense, a removed entity is replaced by the last one. Entities are found from the server id
+/// with an open addressed hash table.
+///
+/// Range and cone queries use a uniform grid of one chunk per cell. The grid is hashed into a
+/// fixed number of cells, so entities far apart can share a cell; the exact distance is always
+/// tested. It is rebuilt on the first query after a change, which is normally once per frame.
+///
+/// All coordinates are server coordinates. 'T' is the full object, used for the Object interface.
+template <class T> class EntityStore {
+public:
+	/// Return the slot of an entity, or -1 if not found.
+	int Find(unsigned long id) const {
+		if (fTable.empty())
+			return -1;
+		for (unsigned i = Hash(id);; i = (i+1) & fMask) {
+			const Entry &e = fTable[i];
+			if (e.slot < 0)
+				return -1;
+			if (e.id == id)
+				return e.slot;
+		}
+	}
+
+	/// Add a new entity, and return the slot. The id must not already be in the store.
+	int Add(unsigned long id, std::shared_ptr<T> obj) {
+		if ((fId.size()+1)*2 > fTable.size())
+			Rehash(fTable.empty() ? 64 : fTable.size()*2);
+		int slot = fId.size();
+		fId.push_back(id);
+		fX.push_back(0); fY.push_back(0); fZ.push_back(0);
+		fHp.push_back(0);
+		fLevel.push_back(0);
+		fObject.push_back(obj);
+		Insert(id, slot);
+		fGridValid = false;
+		return slot;
+	}
+
+	/// Remove the entity in a slot. The last entity is moved into this slot.
+	void Remove(int slot) {
+		Erase(fId[slot]);
+		int last = fId.size()-1;
+		if (slot != last) {
+			fId[slot] = fId[last];
+			fX[slot] = fX[last]; fY[slot] = fY[last]; fZ[slot] = fZ[last];
+			fHp[slot] = fHp[last];
+			fLevel[slot] = fLevel[last];
+			fObject[slot] = std::move(fObject[last]);
+			fTable[Lookup(fId[slot])].slot = slot;
+		}
+		fId.pop_back();
+		fX.pop_back(); fY.pop_back(); fZ.pop_back();
+		fHp.pop_back();
+		fLevel.pop_back();
+		fObject.pop_back();
+		fGridValid = false;
+	}
+
+	void SetPosition(int slot, signed long long x, signed long long y, signed long long z) {
+		if (fX[slot] == x && fY[slot] == y && fZ[slot] == z)
+			return;
+		fX[slot] = x; fY[slot] = y; fZ[slot] = z;
+		fGridValid = false;
+	}
+
+	int Size(void) const { return fId.size(); }
+
+	/// Call f(slot) for every entity inside 'radius' from the point.
+	template <class F> void ForRange(signed long long x, signed long long y, signed long long z, double radius, F f) const {
+		this->Query(x, y, z, radius, [&](int slot, double dx, double dy, double dz) { f(slot); });
+	}
+
+	/// Call f(slot) for every entity inside 'radius' from the point, that is also inside a cone
+	/// along 'dir' with the half angle 'angle' (radians).
+	template <class F> void ForCone(signed long long x, signed long long y, signed long long z, glm::vec3 dir, float angle, double radius, F f) const {
+		dir = glm::normalize(dir);
+		double cosAngle = std::cos(angle);
+		this->Query(x, y, z, radius, [&](int slot, double dx, double dy, double dz) {
+			double along = dx*dir.x + dy*dir.y + dz*dir.z;
+			if (along < 0.0 && cosAngle > 0.0)
+				return;
+			double dist = std::sqrt(dx*dx + dy*dy + dz*dz);
+			if (along >= dist * cosAngle)
+				f(slot);
+		});
+	}
+
+	// The data of each slot, indexed by slot number.
+	std::vector<unsigned long> fId;
+	std::vector<signed long long> fX, fY, fZ;
+	std::vector<unsigned char> fHp;
+	std::vector<unsigned int> fLevel;
+	std::vector<std::shared_ptr<T>> fObject;
+private:
+	enum { GRID_BITS = 4, GRID_SIDE = 1<<GRID_BITS, GRID_CELLS = GRID_SIDE*GRID_SIDE*GRID_SIDE };
+	static constexpr signed long long CELL_SIZE = 32*100; // One chunk, in server coordinates
+
+	struct Entry {
+		unsigned long id;
+		int slot; // -1 if the entry is empty
+	};
+	std::vector<Entry> fTable; // Size is a power of two, and at least twice the number of entities
+	unsigned fMask = 0;
+
+	// The grid is a counting sort of the slots on the cells.
+	mutable std::vector<int> fCellStart; // Start index in fCellSlots for every cell, and one extra at the end.
+	mutable std::vector<int> fCellSlots;
+	mutable bool fGridValid = false;
+
+	unsigned Hash(unsigned long id) const {
+		unsigned h = (unsigned)id * 2654435761u;
+		return (h ^ (h >> 16)) & fMask;
+	}
+
+	// The table index of an id that is known to be in the table.
+	unsigned Lookup(unsigned long id) const {
+		unsigned i = Hash(id);
+		while (fTable[i].id != id || fTable[i].slot < 0)
+			i = (i+1) & fMask;
+		return i;
+	}
+
+	void Insert(unsigned long id, int slot) {
+		unsigned i = Hash(id);
+		while (fTable[i].slot >= 0)
+			i = (i+1) & fMask;
+		fTable[i].id = id;
+		fTable[i].slot = slot;
+	}
+
+	// Remove an id, and move following entries back to keep the probe sequences unbroken.
+	void Erase(unsigned long id) {
+		unsigned hole = Lookup(id);
+		for (unsigned i = (hole+1) & fMask; fTable[i].slot >= 0; i = (i+1) & fMask) {
+			unsigned home = Hash(fTable[i].id);
+			// Move the entry if its home position isn't cyclically in (hole, i].
+			if (((i - home) & fMask) >= ((i - hole) & fMask)) {
+				fTable[hole] = fTable[i];
+				hole = i;
+			}
+		}
+		fTable[hole].slot = -1;
+	}
+
+	void Rehash(size_t size) {
+		fTable.assign(size, Entry{0, -1});
+		fMask = size-1;
+		for (size_t slot=0; slot<fId.size(); slot++)
+			Insert(fId[slot], slot);
+	}
+
+	static int CellCoord(signed long long v) {
+		if (v >= 0)
+			return int(v / CELL_SIZE);
+		return -int((-v-1) / CELL_SIZE) - 1;
+	}
+
+	static int Cell(int cx, int cy, int cz) {
+		const int m = GRID_SIDE-1;
+		return ((cx & m) << (2*GRID_BITS)) | ((cy & m) << GRID_BITS) | (cz & m);
+	}
+
+	void BuildGrid(void) const {
+		fCellStart.assign(GRID_CELLS+1, 0);
+		fCellSlots.resize(fId.size());
+		std::vector<int> cell(fId.size());
+		for (size_t slot=0; slot<fId.size(); slot++) {
+			cell[slot] = Cell(CellCoord(fX[slot]), CellCoord(fY[slot]), CellCoord(fZ[slot]));
+			fCellStart[cell[slot]+1]++;
+		}
+		for (int i=0; i<GRID_CELLS; i++)
+			fCellStart[i+1] += fCellStart[i];
+		std::vector<int> next(fCellStart.begin(), fCellStart.end()-1);
+		for (size_t slot=0; slot<fId.size(); slot++)
+			fCellSlots[next[cell[slot]]++] = slot;
+		fGridValid = true;
+	}
+
+	// Call f(slot, dx, dy, dz) for every entity within the radius. The deltas are relative to the point.
+	template <class F> void Query(signed long long x, signed long long y, signed long long z, double radius, F f) const {
+		double r2 = radius * radius;
+		auto test = [&](int slot) {
+			double dx = double(fX[slot] - x), dy = double(fY[slot] - y), dz = double(fZ[slot] - z);
+			if (dx*dx + dy*dy + dz*dz <= r2)
+				f(slot, dx, dy, dz);
+		};
+		signed long long r = (signed long long)radius;
+		int x0 = CellCoord(x-r), x1 = CellCoord(x+r);
+		int y0 = CellCoord(y-r), y1 = CellCoord(y+r);
+		int z0 = CellCoord(z-r), z1 = CellCoord(z+r);
+		if (x1-x0 >= GRID_SIDE || y1-y0 >= GRID_SIDE || z1-z0 >= GRID_SIDE) {
+			// The cells would wrap around, and it is faster to test everything.
+			for (size_t slot=0; slot<fId.size(); slot++)
+				test(slot);
+			return;
+		}
+		if (!fGridValid)
+			this->BuildGrid();
+		for (int cx=x0; cx<=x1; cx++) for (int cy=y0; cy<=y1; cy++) for (int cz=z0; cz<=z1; cz++) {
+					int c = Cell(cx, cy, cz);
+					for (int i=fCellStart[c]; i<fCellStart[c+1]; i++)
+						test(fCellSlots[i]);
+				}
+	}
+};
+
+}
@@ -0,0 +1,51 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace View {
+
+/// @brief The six planes of a view frustum, used for culling of objects.
+/// The planes are extracted from a projection view matrix, which may be a perspective or an orthographic projection.
+class Frustum {
+public:
+	explicit Frustum(const glm::mat4 &projView) {
+		for (int i=0; i<3; i++) {
+			for (int j=0; j<4; j++) {
+				fPlanes[2*i][j] = projView[j][3] + projView[j][i];
+				fPlanes[2*i+1][j] = projView[j][3] - projView[j][i];
+			}
+		}
+		for (auto &p : fPlanes)
+			p /= glm::length(glm::vec3(p));
+	}
+
+	/// Return true if a sphere is completely outside of the frustum.
+	bool SphereOutside(const glm::vec3 &center, float radius) const {
+		for (const auto &p : fPlanes) {
+			if (glm::dot(glm::vec3(p), center) + p.w < -radius)
+				return true;
+		}
+		return false;
+	}
+private:
+	glm::vec4 fPlanes[6]; // Normals point inwards
+};
+
+}
@@ -0,0 +1,59 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <direct.h>
+#endif
+
+#include "Hash.h"
+
+unsigned long long HashBytes(const void *data, size_t size, unsigned long long hash) {
+	const unsigned char *p = static_cast<const unsigned char *>(data);
+	for (size_t i=0; i<size; i++)
+		hash = (hash ^ p[i]) * 1099511628211ULL;
+	return hash;
+}
+
+bool HashFile(const char *filename, unsigned long long &size, unsigned long long &hash) {
+	FILE *f = fopen(filename, "rb");
+	if (f == 0)
+		return false;
+	size = 0;
+	hash = HashBytes(0, 0);
+	unsigned char buff[4096];
+	size_t n;
+	while ((n = fread(buff, 1, sizeof buff, f)) > 0) {
+		hash = HashBytes(buff, n, hash);
+		size += n;
+	}
+	fclose(f);
+	return true;
+}
+
+bool CreateCacheDir(const char *dirName) {
+	// Don't stat() the directory first. On Windows, that fails if the name ends with a path separator.
+#ifdef WIN32
+	int res = _mkdir(dirName);
+#else
+	int res = mkdir(dirName, 0777);
+#endif
+	return res == 0 || errno == EEXIST;
+}
@@ -0,0 +1,33 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <stddef.h>
+
+//
+// Hash functions used to find out if cached data is still valid. They are not cryptographic.
+//
+
+/// Compute a 64 bit FNV-1a hash of a block of memory. Use the result as 'hash' to continue with more data.
+unsigned long long HashBytes(const void *data, size_t size, unsigned long long hash = 14695981039346656037ULL);
+
+/// Compute the hash of the content of a file, and get the size. Return false if the file can't be read.
+bool HashFile(const char *filename, unsigned long long &size, unsigned long long &hash);
+
+/// Create a directory for cached data, if it doesn't exist. Return false if there is no such directory.
+bool CreateCacheDir(const char *dirName);
@@ -0,0 +1,156 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "Headless.h"
+#include "Clock.h"
+#include "chunk.h"
+#include "ChunkBlocks.h"
+#include "ChunkProcess.h"
+#include "ChunkRequests.h"
+#include "BlockUpdates.h"
+#include "connection.h"
+#include "client_prot.h"
+#include "parse.h"
+#include "player.h"
+#include "monsters.h"
+#include "otherplayers.h"
+#include "primitives.h"
+#include "render.h"
+#include "modes.h"
+#include "Options.h"
+#include "worsttime.h"
+
+#define FRAME_TIME (1.0/60.0) // Run at the same speed as a normal frame rate
+#define REPORT_INTERVAL 5.0
+#define WALK_SIDE 20.0        // Seconds walking in each direction, when walking in a square
+
+using namespace Controller;
+
+// Use all chunks inside the viewing distance, the same way as if they were drawn.
+static void RefreshChunks(void) {
+	ChunkCoord player_cc;
+	Model::gPlayer.GetChunkCoord(&player_cc);
+	int range = int(maxRenderDistance / CHUNK_SIZE + 1);
+	// The top chunks first, as they affect the lighting of the chunks below.
+	for (int dz = range; dz >= -range; dz--) for (int dx = -range; dx <= range; dx++) for (int dy = -range; dy <= range; dy++) {
+				if (dx*dx + dy*dy + dz*dz > range*range)
+					continue;
+				ChunkCoord cc;
+				cc.x = player_cc.x + dx;
+				cc.y = player_cc.y + dy;
+				cc.z = player_cc.z + dz;
+				View::Chunk *cp = ChunkFind(&cc, true);
+				Model::gBlockUpdates.TestJellyTimeout(cp, false);
+				cp->Refresh();
+			}
+}
+
+// Turn the player, and tell the server. The angle is in degrees.
+static void SetDirection(float angleHor) {
+	Model::gPlayer.fAngleHor = angleHor;
+	// The view matrix is used to prioritize chunk requests in the looking direction.
+	gViewMatrix = glm::rotate(glm::mat4(1), angleHor, glm::vec3(0.0f, 1.0f, 0.0f));
+	unsigned char b[7];
+	unsigned short angleHorRad = (unsigned short)(angleHor / 360.0f * 2.0f * M_PI * 100);
+	b[0] = sizeof b;
+	b[1] = 0;
+	b[2] = CMD_SET_DIR;
+	EncodeUint16(b+3, angleHorRad);
+	EncodeUint16(b+5, 0);
+	SendMsg(b, sizeof b);
+}
+
+// The resident memory of the process, in MB. Only available on Linux.
+static double ResidentMemory(void) {
+#ifdef unix
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f == 0)
+		return 0.0;
+	unsigned long size = 0, resident = 0;
+	if (fscanf(f, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return double(resident) * sysconf(_SC_PAGESIZE) / 1024.0 / 1024.0;
+#else
+	return 0.0;
+#endif
+}
+
+void Controller::RunHeadless(double duration, bool walk) {
+	maxRenderDistance = gOptions.fViewingDistance;
+	double start = GetTime(), lastReport = start, lastTurn = start;
+	unsigned frames = 0;
+	bool loginDone = false;
+	while (gMode.Get() != GameMode::ESC && (duration == 0.0 || GetTime() - start < duration)) {
+		static WorstTime tm(" Mainloop");
+		tm.Start();
+		gCurrentFrameTime = GetTime();
+		while (ListenForServerMessages())
+			continue;
+		Model::gBlockUpdates.Apply();
+		if (!loginDone && gMode.Get() == GameMode::LOGIN) {
+			PerformLoginProcedure("", "", "", true);
+			loginDone = true;
+			if (walk) {
+				SetDirection(0.0f);
+				unsigned char b[] = { 0x03, 0x00, CMD_START_FWD };
+				SendMsg(b, sizeof b);
+				lastTurn = gCurrentFrameTime;
+			}
+		}
+		if (walk && loginDone && gCurrentFrameTime - lastTurn > WALK_SIDE) {
+			SetDirection(Model::gPlayer.fAngleHor + 90.0f);
+			lastTurn = gCurrentFrameTime;
+		}
+		gChunkProcess.Poll();
+		Model::gPlayer.UpdatePositionSmooth();
+		Model::gMonsters.Cleanup();
+		Model::gOtherPlayers.Cleanup();
+		if (Model::gPlayer.KnownPosition())
+			RefreshChunks();
+		gChunkRequests.Poll();
+		FlushMessages();
+		frames++;
+		tm.Stop();
+
+		if (gCurrentFrameTime - lastReport > REPORT_INTERVAL) {
+			double elapsed = gCurrentFrameTime - lastReport;
+			printf("Headless: %.0f s, %.1f frames/s, %u chunks in memory, %.1f MB resident\n", gCurrentFrameTime - start,
+			       frames / elapsed, unsigned(ChunkCount()), ResidentMemory());
+			ReportNetworkStatistics();
+			gChunkRequests.Report();
+			gChunkProcess.Report();
+			Model::gBlockUpdates.Report();
+			if (gDebugOpenGL)
+				WorstTime::Report();
+			fflush(stdout);
+			frames = 0;
+			lastReport = gCurrentFrameTime;
+		}
+		double remaining = gCurrentFrameTime + FRAME_TIME - GetTime();
+		if (remaining > 0.0)
+			SleepSeconds(remaining);
+	}
+}
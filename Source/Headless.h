@@ -0,0 +1,33 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+namespace Controller {
+
+/// @brief Run the game without a window or OpenGL context, used for soak testing and benchmarking.
+///
+/// Everything except the graphics is done as usual: messages from the server are parsed, chunks are
+/// requested, unpacked, saved in the cache and meshed, but the meshes are never uploaded. All chunks
+/// inside the viewing distance are used, not only the visible ones. The player logs in as a test user,
+/// and either follows the position from the server (or a replay), or walks in a square if 'walk' is true.
+///
+/// Throughput, queue depths and memory usage are reported every 5 seconds. Return when the connection
+/// is lost, or after 'duration' seconds if it is not 0.
+void RunHeadless(double duration, bool walk);
+
+}
@@ -0,0 +1,675 @@
+// Copyright 2012-2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#define ASSIMP3
+
+// The Assimp import was moved here from ManageAnimation, to make it possible to use it from the
+// modelconverter tool, which doesn't use OpenGL.
+
+#ifdef ASSIMP3
+    #include <assimp/Importer.hpp>
+    #include <assimp/scene.h>       // Output data structure
+    #include <assimp/postprocess.h>
+#else
+    #include <assimp/assimp.hpp>      // C++ importer interface
+    #include <assimp/aiScene.h>       // Output data structure
+    #include <assimp/aiPostProcess.h> // Post processing flags
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <map>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ModelFile.h"
+#include "Hash.h"
+#include "primitives.h"
+
+using namespace View;
+
+#define MODELFILE_VERSION 1
+#define SECTION_ALIGNMENT 16 // All sections start at an offset that is a multiple of this
+
+const char *ModelFile::BakedSuffix = ".bin";
+
+// The header of the data. It is followed by the sections, in the order they are found in Parse().
+struct ModelFile::Header {
+	char magic[4];
+	unsigned version;
+	unsigned normalize;
+	unsigned usingBones;
+	unsigned numVertices;
+	unsigned numIndices;
+	unsigned numMeshes;
+	unsigned numBones;       // Total number of bones for all meshes
+	unsigned numJoints;
+	unsigned numAnimations;
+	unsigned namesSize;      // Size of the joint names, each one terminated by a null byte
+	unsigned unused;
+	unsigned long long sourceSize; // Used to find out if the source has changed since the baking
+	unsigned long long sourceHash;
+};
+
+static const char sMagic[4] = { 'E', 'P', 'H', 'M' };
+
+static size_t Align(size_t n) {
+	return (n + SECTION_ALIGNMENT-1) & ~size_t(SECTION_ALIGNMENT-1);
+}
+
+static void CopyaiMat(const aiMatrix4x4 *from, glm::mat4 &to) {
+	// OpenGL (and glm) uses column major order, but Assimp uses row major order.
+	to[0][0] = from->a1; to[1][0] = from->a2; to[2][0] = from->a3; to[3][0] = from->a4;
+	to[0][1] = from->b1; to[1][1] = from->b2; to[2][1] = from->b3; to[3][1] = from->b4;
+	to[0][2] = from->c1; to[1][2] = from->c2; to[2][2] = from->c3; to[3][2] = from->c4;
+	to[0][3] = from->d1; to[1][3] = from->d2; to[2][3] = from->d3; to[3][3] = from->d4;
+}
+
+static void NormalizeWeights(glm::vec3 &w, int n) {
+	if (n == 0)
+		return;
+	float sum = 0;
+	for (int i=0; i<n; i++)
+		sum += w[i];
+	for (int i=0; i<n; i++)
+		w[i] /= sum;
+}
+
+static void CopyaiQuat(glm::mat4 &dest, const aiQuaternion &quat) {
+	glm::quat q(quat.w, quat.x, quat.y, quat.z);
+	dest = glm::mat4_cast(q);
+}
+
+static void PrintMatrix(int indent, const glm::mat4 &mat) {
+	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][0], mat[1][0], mat[2][0], mat[3][0]);
+	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][1], mat[1][1], mat[2][1], mat[3][1]);
+	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][2], mat[1][2], mat[2][2], mat[3][2]);
+	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][3], mat[1][3], mat[2][3], mat[3][3]);
+}
+
+// Traverse the node tree, and find the node with the given name.
+static aiNode *FindNode(aiNode *node, const char *name) {
+	if (strcmp(name, node->mName.data) == 0)
+		return node;
+
+	for (unsigned int i=0; i < node->mNumChildren; i++) {
+		aiNode *res = FindNode(node->mChildren[i], name);
+		if (res != 0)
+			return res;
+	}
+
+	return 0; // Not found
+}
+
+// Print out the complete hierarchical node tree
+static void DumpNodeTree(int level, const aiNode *node) {
+	printf("%*sNode '%s', %d meshes ", level*4, "", node->mName.data, node->mNumMeshes);
+	if (node->mNumMeshes > 0) {
+		printf("(");
+		for (unsigned m = 0; m < node->mNumMeshes; m++)
+			printf("%d ", node->mMeshes[m]);
+		printf(")");
+	}
+	printf("\n");
+
+	// Recursively print children
+	for (unsigned int i=0; i < node->mNumChildren; i++) {
+		DumpNodeTree(level+1, node->mChildren[i]);
+	}
+}
+
+// Iterate through the node tree and compute all mesh relative matrices. The matrix of the armature is saved in 'armature'.
+static void FindMeshTransformations(int level, glm::mat4 *meshmatrix, glm::mat4 &armature, const glm::mat4 &base, const aiNode *node) {
+	glm::mat4 delta;
+	CopyaiMat(&node->mTransformation, delta);
+	glm::mat4 result = base * delta;
+	if (strcmp(node->mName.data, "Armature") == 0)
+		armature = result;
+	if (gVerbose) {
+		printf("%*sNode '%s' relative\n", level, "", node->mName.data);
+		PrintMatrix(level, delta);
+		printf("%*sGives\n", level, "");
+		PrintMatrix(level, result);
+	}
+
+	// Transform all meshes belonging to this node
+	for (unsigned int i=0; i<node->mNumMeshes; i++) {
+		unsigned int m = node->mMeshes[i];
+		meshmatrix[m] = result;
+	}
+
+	// last step, update all children.
+	for (unsigned int i=0; i < node->mNumChildren; i++) {
+		FindMeshTransformations(level+1, meshmatrix, armature, result, node->mChildren[i]);
+	}
+}
+
+ModelFile::ModelFile() : fData(0), fSize(0), fMapped(0), fHeader(0), fVertices(0), fWeights(0), fJoints(0), fIndices(0), fMeshes(0), fBones(0) {
+}
+
+ModelFile::~ModelFile() {
+	this->Release();
+}
+
+void ModelFile::Release(void) {
+	if (fMapped) {
+#ifdef WIN32
+		UnmapViewOfFile(fMapped);
+#else
+		munmap(fMapped, fSize);
+#endif
+	}
+	fMapped = 0;
+	fOwned.clear();
+	fData = 0;
+	fSize = 0;
+	fHeader = 0;
+	fJointNames.clear();
+	fAnimations.clear();
+}
+
+bool ModelFile::Fail(const char *fmt, ...) {
+	char buff[1000];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buff, sizeof buff, fmt, args);
+	va_end(args);
+	fError = buff;
+	return false;
+}
+
+bool ModelFile::Import(const char *filename, bool normalize) {
+	this->Release();
+	fError.clear();
+	// Create an instance of the Importer class
+	Assimp::Importer importer;
+
+	unsigned int flags = aiProcess_JoinIdenticalVertices|aiProcess_Triangulate|aiProcess_FixInfacingNormals|aiProcess_ValidateDataStructure|
+	                     aiProcess_GenNormals|aiProcess_LimitBoneWeights;
+	// |aiProcess_OptimizeMeshes
+	if (normalize)
+		flags |= aiProcess_PreTransformVertices; // This flag will remove all bones.
+	importer.SetPropertyBool(AI_CONFIG_PP_PTV_NORMALIZE, true); // TODO: This is only used for aiProcess_PreTransformVertices
+	importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 3); // The shader can only handle three weights for each vertice.
+	const aiScene* scene = importer.ReadFile( filename, flags);
+	if (scene == 0)
+		return this->Fail("assimp loading %s: %s", filename, importer.GetErrorString());
+
+	Header header;
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, sMagic, sizeof sMagic);
+	header.version = MODELFILE_VERSION;
+	header.normalize = normalize;
+	HashFile(filename, header.sourceSize, header.sourceHash);
+
+	// Number of vertices and number of indices
+	int vertexSize = 0, indexSize = 0;
+	if (gVerbose) {
+		printf("\nScene: %s (%s)*******************\n", scene->mRootNode->mName.data, filename);
+		printf("%d materials, %d meshes, %d animations, %d textures\n", scene->mNumMaterials, scene->mNumMeshes, scene->mNumAnimations, scene->mNumTextures);
+	}
+
+	//**********************************************************************
+	// Count how much data is needed. All indices and vetices are saved in
+	// the same buffer.
+	//**********************************************************************
+
+	// All joints are ordered. Map from bone name to joint number. Only bones actually used in a mesh are saved here.
+	std::map<std::string, unsigned int> boneIndex;
+	std::vector<Mesh> meshes(scene->mNumMeshes);
+	std::vector<Bone> bones;
+	for (unsigned int i=0; i<scene->mNumMeshes; i++) {
+		aiMesh *m = scene->mMeshes[i];
+		if (m->mNumBones > 0)
+			header.usingBones = 1; // True if any mesh uses bones
+		aiMaterial *mat = scene->mMaterials[m->mMaterialIndex];
+		aiColor3D c (0.f,0.f,0.f);
+		mat->Get(AI_MATKEY_COLOR_DIFFUSE, c);
+		meshes[i].colour = glm::vec4(c.r, c.g, c.b, 1.0f);
+		indexSize += m->mNumFaces * 3; // Always 3 indices for each face (triangle).
+		vertexSize += m->mNumVertices;
+		if (gVerbose)
+			printf("\tMesh %d ('%s'): %d faces, %d vertices\n", i, m->mName.data, m->mNumFaces, m->mNumVertices);
+
+		// Find all animation bones in all meshes. They may have been seen in another mesh already.
+		meshes[i].firstBone = bones.size();
+		meshes[i].numBones = m->mNumBones;
+		for (unsigned int j=0; j < m->mNumBones; j++) {
+			aiBone *aib = m->mBones[j];
+			// Add the bone to the global list of bones if it isn't already there.
+			auto it = boneIndex.find(aib->mName.data);
+			unsigned int jointIndex = boneIndex.size();
+			if (it == boneIndex.end())
+				boneIndex[aib->mName.data] = jointIndex;
+			else
+				jointIndex = it->second;
+
+			Bone bone = Bone();
+			bone.joint = jointIndex;
+			CopyaiMat(&aib->mOffsetMatrix, bone.offset);
+			bones.push_back(bone);
+		}
+	}
+	if (gVerbose)
+		printf("Total vertices needed: %d, index count %d\n", vertexSize, indexSize);
+
+	// Find all mesh transformations and update the bones matrix dependency on parents
+	std::vector<glm::mat4> meshmatrix(scene->mNumMeshes);
+	glm::mat4 armature(1);
+	FindMeshTransformations(0, meshmatrix.data(), armature, glm::mat4(1), scene->mRootNode);
+	if (gVerbose)
+		DumpNodeTree(0, scene->mRootNode);
+
+	// Copy all vertex data into one big buffer and all index data into another buffer
+	std::vector<VertexDataf> vertexData(vertexSize);
+	std::vector<unsigned short> indexData(indexSize);
+	int vertexOffset = 0, indexOffset = 0;
+	int previousOffset = 0; // The index offset for the current mesh
+
+	// Skinning data. Allocate even if not using bones.
+	std::vector<char> numWeights(vertexSize);
+	std::vector<glm::vec3> weights(vertexSize, glm::vec3(0.0f));
+	std::vector<float> joints(vertexSize*3); // Up to 4 joints per vertex, but only three are used.
+
+	//**********************************************************************
+	// Traverse the meshes again, generating the vertex data
+	//**********************************************************************
+
+	for (unsigned int i=0; i<scene->mNumMeshes; i++) {
+		aiMesh *m = scene->mMeshes[i];
+		if (gVerbose) {
+			printf("Mesh %d: %d faces, %d vertices, mtl index %d\n", i, m->mNumFaces, m->mNumVertices, m->mMaterialIndex);
+			printf("    Transformation matrix:\n");
+			PrintMatrix(4, meshmatrix[i]);
+			printf("\n");
+		}
+
+		// Copy faces, but only those that are proper triangles.
+		unsigned int numTriangles = 0; // The number of found triangles.
+		for (unsigned int face=0; face < m->mNumFaces; face++) {
+			if (m->mFaces[face].mNumIndices != 3)
+				continue; // Only allow triangles
+			// m->mFaces[face].mIndices is a local index into the current mesh. Value 0 will thus
+			// adress the first vertex in the current mesh. As all vertices are stored in the same buffer,
+			// an offset need to be added to get the correct index of the vertex.
+			indexData[indexOffset++] = m->mFaces[face].mIndices[0] + previousOffset;
+			indexData[indexOffset++] = m->mFaces[face].mIndices[1] + previousOffset;
+			indexData[indexOffset++] = m->mFaces[face].mIndices[2] + previousOffset;
+			numTriangles++;
+		}
+		meshes[i].numFaces = numTriangles;
+
+		// Copy all vertices
+		for (unsigned int v = 0; v < m->mNumVertices; v++) {
+			glm::vec4 v1(m->mVertices[v].x, m->mVertices[v].y, m->mVertices[v].z, 1);
+			glm::vec4 v2 = meshmatrix[i] * v1;
+			vertexData[vertexOffset].SetVertex(glm::vec3(v2));
+			glm::vec4 n1(m->mNormals[v].x, m->mNormals[v].y, m->mNormals[v].z, 1);
+			glm::vec4 n2 = meshmatrix[i] * glm::normalize(n1);
+			vertexData[vertexOffset].SetNormal(glm::vec3(n2));
+			if (m->mTextureCoords[0] != 0) {
+				vertexData[vertexOffset].SetTexture(m->mTextureCoords[0][v].x, m->mTextureCoords[0][v].y);
+			} else {
+				vertexData[vertexOffset].SetTexture(0,0);
+			}
+			vertexData[vertexOffset].SetIntensity(255);
+			vertexData[vertexOffset].SetAmbient(100);
+			vertexOffset++;
+		}
+
+		// Every animation bone in Assimp data structures have a list of weights and vertex index.
+		// We want the weights, 0-3 of them, sorted on vertices instead.
+		// Iterate through all bones used in this mesh, and copy weights to respective vertex data.
+		for (unsigned j=0; j < m->mNumBones; j++) {
+			Bone &bone = bones[meshes[i].firstBone + j];
+			bone.offset *= glm::inverse(meshmatrix[i]);
+			aiBone *aib = m->mBones[j];
+			if (gVerbose) {
+				printf("    Offset for mesh %d %s (%d) joint %d:\n", i, aib->mName.data, j, bone.joint);
+				PrintMatrix(4, bone.offset);
+			}
+			for (unsigned k=0; k < aib->mNumWeights; k++) {
+				int v = aib->mWeights[k].mVertexId + previousOffset; // Add the local vertex number in the current mesh to the offset to get the global number
+				int w = numWeights[v]++;
+				// Because AI_CONFIG_PP_LBW_MAX_WEIGHTS is maximized to 3, There can't be more than 3 weights for a vertex
+				// unless there is a bug in Assimp.
+				if (w >= 3)
+					return this->Fail("Too many bone weights on vertice %d, bone %s, model %s", v, aib->mName.data, filename);
+				weights[v][w] = aib->mWeights[k].mWeight;
+				joints[v*3 + w] = bone.joint;
+			}
+		}
+		previousOffset = vertexOffset;
+	}
+	for (int j=0; j < vertexSize; j++)
+		NormalizeWeights(weights[j], numWeights[j]);
+
+	// Decode animation information
+	unsigned int numMeshBones = boneIndex.size();
+	if (numMeshBones > 0 && scene->mNumAnimations == 0)
+		return this->Fail("%s: Bones but no animations", filename);
+	if (scene->mNumAnimations > 0) {
+		if (numMeshBones == 0)
+			return this->Fail("%s: No mesh bones", filename);
+		if (gVerbose)
+			printf("Parsing %d animations\n", scene->mNumAnimations);
+	}
+
+	header.numVertices = vertexSize;
+	header.numIndices = indexOffset;
+	header.numMeshes = scene->mNumMeshes;
+	header.numBones = bones.size();
+	header.numJoints = numMeshBones;
+	header.numAnimations = scene->mNumAnimations;
+	std::vector<const char *> names(numMeshBones);
+	for (auto &bone : boneIndex) {
+		names[bone.second] = bone.first.c_str();
+		header.namesSize += bone.first.size() + 1;
+	}
+	this->Append(&header, sizeof header);
+	this->Append(vertexData.data(), vertexSize * sizeof vertexData[0]);
+	this->Append(weights.data(), vertexSize * sizeof weights[0]);
+	this->Append(joints.data(), vertexSize * 3 * sizeof joints[0]);
+	this->Append(indexData.data(), indexOffset * sizeof indexData[0]);
+	this->Append(meshes.data(), meshes.size() * sizeof meshes[0]);
+	this->Append(bones.data(), bones.size() * sizeof bones[0]);
+	std::string allNames;
+	for (auto name : names)
+		allNames.append(name, strlen(name)+1);
+	this->Append(allNames.data(), allNames.size());
+
+	//**********************************************************************
+	// Decode the animations
+	// There may be more animated bones than used by meshes.
+	//**********************************************************************
+	for (unsigned int i=0; i < scene->mNumAnimations; i++) {
+		aiAnimation *aia = scene->mAnimations[i];
+		Animation anim;
+		memset(&anim, 0, sizeof anim);
+		strncpy(anim.name, aia->mName.data, sizeof anim.name - 1);
+		anim.keysPerSecond = aia->mTicksPerSecond;
+		anim.duration = aia->mDuration;
+
+		// The number of keys has to be the same for all channels. This is a limitation if it is going to be possible to
+		// pre compute all matrices.
+		unsigned numChannels = aia->mNumChannels;
+		if (numChannels == 0)
+			return this->Fail("no animation channels for %s, %s", aia->mName.data, filename);
+		if (numChannels != numMeshBones)
+			return this->Fail("%s animation %d: Can only handle when all bones are used (%d out of %d)", filename, i, numChannels, numMeshBones);
+		unsigned int numKeys = aia->mChannels[0]->mNumPositionKeys;
+		anim.numKeys = numKeys;
+		struct channel {
+			glm::mat4 mat; // Relative transformation matrix to parent
+			channel *parent;
+			aiNodeAnim *node;
+			unsigned joint;
+#define UNUSEDCHANNEL 0xFFFF
+		};
+		std::vector<channel> channels(numChannels); // This is the list of all bones in this animation
+		// Only joints used by a mesh have key frame matrices. They are saved for all keys of one joint at a time.
+		std::vector<unsigned char> animated(numMeshBones);
+		std::vector<glm::mat4> matrices(numMeshBones*numKeys, glm::mat4(1));
+		// Check that there are the same number of keys for all channels, and allocate transformation matrices
+		bool foundOneBone = false;
+		for (unsigned int j=0; j < numChannels; j++) {
+			aiNodeAnim *ain = aia->mChannels[j];
+			if (ain->mNumPositionKeys != numKeys || ain->mNumRotationKeys != numKeys || ain->mNumScalingKeys != numKeys)
+				return this->Fail("%s Bad animation setup: Pos keys %d, rot keys %d, scaling keys %d", filename, ain->mNumPositionKeys, ain->mNumRotationKeys, ain->mNumScalingKeys);
+			channels[j].node = ain;
+			channels[j].parent = 0;
+			auto it = boneIndex.find(ain->mNodeName.data);
+			if (it == boneIndex.end()) {
+				// Skip this channel (bone animation)
+				channels[j].joint = UNUSEDCHANNEL; // Mark it as not used
+				continue;
+			}
+			foundOneBone = true;
+			unsigned int joint = it->second;
+			animated[joint] = 1;
+			channels[j].joint = joint;
+		}
+		if (!foundOneBone)
+			return this->Fail("%s animation %d no bones used", filename, i);
+
+		// Find the parent for each animation node
+		for (unsigned j=0; j<numChannels; j++) {
+			aiNode *n = FindNode(scene->mRootNode, channels[j].node->mNodeName.data);
+			if (n == 0 || n->mParent == 0)
+				continue; // No parent
+			n = n->mParent;
+			for (unsigned p=0; p<numChannels; p++) {
+				if (p == j || strcmp(n->mName.data, channels[p].node->mNodeName.data) != 0)
+					continue;
+				// Found it!
+				channels[j].parent = &channels[p];
+				break;
+			}
+		}
+
+		std::vector<double> times(numKeys);
+		// The first key frame doesn't always start at time 0
+		double firstKeyTime = channels[0].node->mPositionKeys[0].mTime;
+		for (unsigned k=0; k < numKeys; k++) {
+			times[k] = channels[0].node->mPositionKeys[k].mTime - firstKeyTime;
+			for (unsigned int j=0; j < numChannels; j++) {
+				aiNodeAnim *ain = channels[j].node;
+				glm::mat4 R;
+				CopyaiQuat(R, ain->mRotationKeys[k].mValue);
+				glm::mat4 T = glm::translate(glm::mat4(1), glm::vec3(ain->mPositionKeys[k].mValue.x, ain->mPositionKeys[k].mValue.y, ain->mPositionKeys[k].mValue.z));
+				glm::mat4 S = glm::scale(glm::mat4(1), glm::vec3(ain->mScalingKeys[k].mValue.x, ain->mScalingKeys[k].mValue.y, ain->mScalingKeys[k].mValue.z));
+				channels[j].mat = T * R * S;
+				if (gVerbose) {
+					printf("     Key %d animation bone %s relative\n", k, channels[j].node->mNodeName.data);
+					PrintMatrix(10, channels[j].mat);
+				}
+			}
+			// Iterate through each animation bone and compute the transformation matrix using parent matrix.
+			for (unsigned int j=0; j < numChannels; j++) {
+				unsigned joint = channels[j].joint;
+				glm::mat4 mat(1);
+				for (channel *node = &channels[j]; node; node = node->parent) {
+					mat = node->mat * mat;
+				}
+				mat = armature * mat;
+				if (joint != UNUSEDCHANNEL) {
+					matrices[joint*numKeys + k] = mat;
+					if (gVerbose) {
+						printf("     Key %d animation bone %s channel %d absolute\n", k, channels[j].node->mNodeName.data, j);
+						PrintMatrix(10, mat);
+					}
+				}
+			}
+		}
+		this->Append(&anim, sizeof anim);
+		this->Append(times.data(), numKeys * sizeof times[0]);
+		this->Append(animated.data(), numMeshBones);
+		this->Append(matrices.data(), matrices.size() * sizeof matrices[0]);
+	}
+
+	fData = fOwned.data();
+	fSize = fOwned.size();
+	if (!this->Parse())
+		return this->Fail("ModelFile::Import %s: Inconsistent data", filename);
+	return true;
+}
+
+void ModelFile::Append(const void *data, size_t size) {
+	const char *p = static_cast<const char *>(data);
+	fOwned.insert(fOwned.end(), p, p+size);
+	fOwned.resize(Align(fOwned.size()));
+}
+
+const char *ModelFile::Section(size_t &offset, size_t size) const {
+	if (offset > fSize || size > fSize - offset)
+		return 0;
+	const char *p = fData + offset;
+	offset = Align(offset + size);
+	return p;
+}
+
+bool ModelFile::Parse(void) {
+	size_t offset = 0;
+	fHeader = reinterpret_cast<const Header *>(this->Section(offset, sizeof (Header)));
+	if (fHeader == 0 || memcmp(fHeader->magic, sMagic, sizeof sMagic) != 0 || fHeader->version != MODELFILE_VERSION)
+		return false;
+	const Header &h = *fHeader;
+	fVertices = reinterpret_cast<const VertexDataf *>(this->Section(offset, h.numVertices * sizeof (VertexDataf)));
+	fWeights = reinterpret_cast<const glm::vec3 *>(this->Section(offset, h.numVertices * sizeof (glm::vec3)));
+	fJoints = reinterpret_cast<const float *>(this->Section(offset, h.numVertices * 3 * sizeof (float)));
+	fIndices = reinterpret_cast<const unsigned short *>(this->Section(offset, h.numIndices * sizeof (unsigned short)));
+	fMeshes = reinterpret_cast<const Mesh *>(this->Section(offset, h.numMeshes * sizeof (Mesh)));
+	fBones = reinterpret_cast<const Bone *>(this->Section(offset, h.numBones * sizeof (Bone)));
+	const char *names = this->Section(offset, h.namesSize);
+	if (fVertices == 0 || fWeights == 0 || fJoints == 0 || fIndices == 0 || fMeshes == 0 || fBones == 0 || names == 0)
+		return false;
+
+	fJointNames.clear();
+	for (const char *p = names; p < names + h.namesSize; p += strlen(p) + 1) {
+		if (memchr(p, 0, names + h.namesSize - p) == 0)
+			return false; // Not terminated
+		fJointNames.push_back(p);
+	}
+	if (fJointNames.size() != h.numJoints)
+		return false;
+
+	// Verify the references, to make it safe to use the data
+	for (unsigned i=0; i < h.numMeshes; i++) {
+		if (fMeshes[i].firstBone > h.numBones || fMeshes[i].numBones > h.numBones - fMeshes[i].firstBone)
+			return false;
+	}
+	for (unsigned i=0; i < h.numBones; i++) {
+		if (fBones[i].joint >= h.numJoints)
+			return false;
+	}
+
+	fAnimations.resize(h.numAnimations);
+	for (auto &anim : fAnimations) {
+		anim.info = reinterpret_cast<const Animation *>(this->Section(offset, sizeof (Animation)));
+		if (anim.info == 0 || anim.info->numKeys == 0)
+			return false;
+		anim.times = reinterpret_cast<const double *>(this->Section(offset, anim.info->numKeys * sizeof (double)));
+		anim.animated = reinterpret_cast<const unsigned char *>(this->Section(offset, h.numJoints));
+		anim.matrices = reinterpret_cast<const glm::mat4 *>(this->Section(offset, size_t(h.numJoints) * anim.info->numKeys * sizeof (glm::mat4)));
+		if (anim.times == 0 || anim.animated == 0 || anim.matrices == 0)
+			return false;
+	}
+	return true;
+}
+
+bool ModelFile::Load(const char *filename, const char *source, bool normalize) {
+	this->Release();
+	fError.clear();
+#ifdef WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false; // No baked file, which is not an error
+	DWORD size = GetFileSize(file, 0);
+	HANDLE mapping = CreateFileMapping(file, 0, PAGE_READONLY, 0, 0, 0);
+	CloseHandle(file);
+	if (mapping == 0)
+		return this->Fail("%s: Failed to map", filename);
+	fMapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping); // The view keeps the mapping
+	if (fMapped == 0)
+		return this->Fail("%s: Failed to map", filename);
+#else
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false; // No baked file, which is not an error
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return this->Fail("%s: Failed to read", filename);
+	}
+	size_t size = st.st_size;
+	void *p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping remains
+	if (p == MAP_FAILED)
+		return this->Fail("%s: Failed to map", filename);
+	fMapped = p;
+#endif
+	fData = static_cast<const char *>(fMapped);
+	fSize = size;
+	if (!this->Parse()) {
+		this->Release();
+		return this->Fail("%s: Not a baked model of this version", filename);
+	}
+	if (fHeader->normalize != unsigned(normalize)) {
+		this->Release();
+		return this->Fail("%s: Baked with other flags", filename);
+	}
+	unsigned long long sourceSize, sourceHash;
+	if (HashFile(source, sourceSize, sourceHash) && (sourceSize != fHeader->sourceSize || sourceHash != fHeader->sourceHash)) {
+		this->Release();
+		return this->Fail("%s: Baked from another version of %s", filename, source);
+	}
+	return true;
+}
+
+bool ModelFile::Save(const char *filename) const {
+	FILE *f = fopen(filename, "wb");
+	if (f == 0)
+		return false;
+	bool ok = fwrite(fData, 1, fSize, f) == fSize;
+	if (fclose(f) != 0)
+		ok = false;
+	return ok;
+}
+
+bool ModelFile::UsingBones(void) const {
+	return fHeader->usingBones != 0;
+}
+
+unsigned ModelFile::NumVertices(void) const {
+	return fHeader->numVertices;
+}
+
+unsigned ModelFile::NumIndices(void) const {
+	return fHeader->numIndices;
+}
+
+unsigned ModelFile::NumMeshes(void) const {
+	return fHeader->numMeshes;
+}
+
+unsigned ModelFile::NumJoints(void) const {
+	return fHeader->numJoints;
+}
+
+unsigned ModelFile::NumAnimations(void) const {
+	return fHeader->numAnimations;
+}
+
+const glm::mat4 *ModelFile::KeyMatrices(unsigned anim, unsigned joint) const {
+	const AnimationSections &a = fAnimations[anim];
+	if (!a.animated[joint])
+		return 0;
+	return a.matrices + joint * a.info->numKeys;
+}
@@ -0,0 +1,136 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct VertexDataf;
+
+namespace View {
+
+/// @brief The data of a model, in the form needed by ManageAnimation.
+/// The data is either imported with Assimp from the original model file, or loaded from a baked
+/// file made by the modelconverter tool. A baked file is mapped into memory, and the vertex data
+/// can be uploaded to OpenGL directly from the mapping. An imported model is kept in memory in the
+/// same layout, which is also what is saved.
+class ModelFile {
+public:
+	struct Mesh {
+		glm::vec4 colour;   // The colour of this mesh
+		unsigned numFaces;  // Number of triangles used by this mesh
+		unsigned firstBone; // Index into the bone table of the first bone used by this mesh
+		unsigned numBones;  // Number of bones used by this mesh
+		unsigned unused;
+	};
+
+	struct Bone {
+		glm::mat4 offset;   // Offset to mesh
+		unsigned joint;
+		unsigned unused[3];
+	};
+
+	struct Animation {
+		char name[64];
+		double keysPerSecond;
+		double duration;    // Number of ticks
+		unsigned numKeys;
+		unsigned unused;
+	};
+
+	ModelFile();
+	~ModelFile();
+
+	/// Import a model with Assimp.
+	/// normalize: Normalize the size to 1.0. Doesn't work for animations.
+	/// Return false if it failed, with a description in Error().
+	bool Import(const char *filename, bool normalize);
+
+	/// Load a baked model file. It is only accepted if it was made from the same content as 'source',
+	/// using the same 'normalize'. A missing 'source' is not a problem.
+	/// Return false if it can't be used. Error() is empty if there was no baked file.
+	bool Load(const char *filename, const char *source, bool normalize);
+
+	/// Save the model as a baked file.
+	bool Save(const char *filename) const;
+
+	const std::string &Error(void) const { return fError; }
+
+	bool UsingBones(void) const;
+	unsigned NumVertices(void) const;
+	unsigned NumIndices(void) const;
+	unsigned NumMeshes(void) const;
+	unsigned NumJoints(void) const;
+	unsigned NumAnimations(void) const;
+
+	const VertexDataf *Vertices(void) const { return fVertices; }
+	const glm::vec3 *Weights(void) const { return fWeights; } // Skin weights for each vertex, up to 3.
+	const float *Joints(void) const { return fJoints; } // Three joint indices for each vertex.
+	const unsigned short *Indices(void) const { return fIndices; }
+	const Mesh *Meshes(void) const { return fMeshes; }
+	const Bone *Bones(void) const { return fBones; }
+	const char *JointName(unsigned joint) const { return fJointNames[joint]; }
+	const Animation *GetAnimation(unsigned anim) const { return fAnimations[anim].info; }
+	const double *Times(unsigned anim) const { return fAnimations[anim].times; } // The time stamps of the key frames
+
+	/// Get the absolute transformation matrix of all key frames for a joint, or 0 if the joint isn't animated.
+	const glm::mat4 *KeyMatrices(unsigned anim, unsigned joint) const;
+
+	/// The suffix added to the name of a model file, to get the name of the baked file.
+	static const char *BakedSuffix;
+private:
+	struct Header;
+	struct AnimationSections {
+		const Animation *info;
+		const double *times;
+		const unsigned char *animated; // For each joint, true if there are key frame matrices
+		const glm::mat4 *matrices;     // The key frame matrices, all keys for one joint at a time
+	};
+
+	const char *fData;          // All data, either mapped or owned.
+	size_t fSize;
+	void *fMapped;              // Memory mapping of a baked file
+	std::vector<char> fOwned;   // The data of an imported model
+	std::string fError;
+
+	const Header *fHeader;
+	const VertexDataf *fVertices;
+	const glm::vec3 *fWeights;
+	const float *fJoints;
+	const unsigned short *fIndices;
+	const Mesh *fMeshes;
+	const Bone *fBones;
+	std::vector<const char *> fJointNames;
+	std::vector<AnimationSections> fAnimations;
+
+	// Find the sections of the data. Return false if the data is broken.
+	bool Parse(void);
+
+	// Get the next section of the data, and update the offset. Return 0 if outside of the data.
+	const char *Section(size_t &offset, size_t size) const;
+
+	// Add a section to the data of an imported model.
+	void Append(const void *data, size_t size);
+
+	// Define the error message, and return false.
+	bool Fail(const char *fmt, ...);
+	void Release(void);
+};
+
+}
@@ -48,6 +48,11 @@ bool OpenglBuffer::BindArray(GLsizeiptr size, const GLvoid *data, GLenum usage)
 	return this->GetSize() == size;
 }
 
+void OpenglBuffer::BindArray(void) const {
+	ASSERT(fBufferId != 0);
+	glBindBuffer(GL_ARRAY_BUFFER, fBufferId);
+}
+
 bool OpenglBuffer::BindElementsArray(GLsizeiptr size, const GLvoid *data, GLenum usage) {
 #ifdef DEBUG
 	if (gDebugOpenGL) {
@@ -69,6 +74,31 @@ void OpenglBuffer::ArraySubData(GLintptr offset, GLsizeiptr size, const GLvoid *
 	glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
 }
 
+void *OpenglBuffer::MapArrayRange(GLintptr offset, GLsizeiptr size, GLbitfield access) {
+	ASSERT(fBufferId != 0);
+	glBindBuffer(GL_ARRAY_BUFFER, fBufferId);
+	return glMapBufferRange(GL_ARRAY_BUFFER, offset, size, access);
+}
+
+void OpenglBuffer::UnmapArray(void) {
+	ASSERT(fBufferId != 0);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+void OpenglBuffer::CopySubData(const OpenglBuffer &src, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) {
+	ASSERT(fBufferId != 0 && src.fBufferId != 0);
+	glBindBuffer(GL_COPY_READ_BUFFER, src.fBufferId);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, fBufferId);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, readOffset, writeOffset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void OpenglBuffer::TexBuffer(GLenum internalFormat) const {
+	ASSERT(fBufferId != 0);
+	glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, fBufferId);
+}
+
 int OpenglBuffer::GetSize() const {
 	int bufferSize = 0;
 	glGetBufferParameteriv(fTarget, GL_BUFFER_SIZE, &bufferSize);
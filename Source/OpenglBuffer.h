@@ -31,8 +31,26 @@ public:
 	/// Bind GL_ELEMENT_ARRAY_BUFFER, allocate and load with data (if any)
 	bool BindElementsArray(GLsizeiptr size, const GLvoid *data, GLenum usage = GL_STATIC_DRAW);
 
+	/// Bind GL_ARRAY_BUFFER, keeping the current content
+	void BindArray(void) const;
+
 	/// Bind GL_ARRAY_BUFFER and load data
 	void ArraySubData(GLintptr offset, GLsizeiptr size, const GLvoid *data);
+
+	/// Bind GL_ARRAY_BUFFER and map a range of it for writing
+	void *MapArrayRange(GLintptr offset, GLsizeiptr size, GLbitfield access);
+
+	/// Unmap the buffer currently bound to GL_ARRAY_BUFFER
+	void UnmapArray(void);
+
+	/// Let the GPU copy data from another buffer into this one
+	void CopySubData(const OpenglBuffer &src, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+
+	/// True if the buffer has been allocated
+	bool Defined() const { return fBufferId != 0; }
+
+	/// Use the buffer as storage for the texture currently bound to GL_TEXTURE_BUFFER
+	void TexBuffer(GLenum internalFormat) const;
 	int GetSize() const;
 	void Release();
 private:
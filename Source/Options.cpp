@@ -79,12 +79,6 @@ bool Options::ParseOneOption(const string &key, const string &arg) {
 		fSoundFxVolume = atoi(arg.c_str());
 	else if (key == "Graphics.performance")
 		fNewPerformance = fPerformance = atoi(arg.c_str());
-	else if (key == "Graphics.maxlamps")
-		fMaxLamps = atoi(arg.c_str());
-	else if (key == "Graphics.maxshadows")
-		fMaxShadows = atoi(arg.c_str());
-	else if (key == "Graphics.maxfogs")
-		fMaxFog = atoi(arg.c_str());
 	else if (key == "Graphics.fullscreen")
 		fFullScreen = atoi(arg.c_str());
 	else if (key == "Graphics.ambient")
@@ -101,6 +95,8 @@ bool Options::ParseOneOption(const string &key, const string &arg) {
 		fStaticShadows = atoi(arg.c_str());
 	else if (key == "Graphics.AnisotropicFiltering")
 		fAnisotropicFiltering = atoi(arg.c_str());
+	else if (key == "Graphics.PrefetchTime")
+		fPrefetchTime = atof(arg.c_str());
 	else if (key == "Player.position") {
 		char *end = 0;
 		fPlayerX = strtoll(arg.c_str(), &end, 10);
@@ -184,9 +180,6 @@ void Options::Save(void) {
 	optionsFile << "# Control graphics settings\n";
 	optionsFile << "[Graphics]\n";
 	optionsFile << "performance=" << fPerformance << endl;
-	optionsFile << "maxlamps=" << fMaxLamps << endl;
-	optionsFile << "maxshadows=" << fMaxShadows << endl;
-	optionsFile << "maxfogs=" << fMaxFog << endl;
 	optionsFile << "fullscreen=" << fFullScreen << endl;
 	optionsFile << "ambient=" << fAmbientLight << endl;
 	optionsFile << "SmoothTerrain=" << fSmoothTerrain << endl;
@@ -195,6 +188,7 @@ void Options::Save(void) {
 	optionsFile << "DynamicShadows=" << fDynamicShadows << endl;
 	optionsFile << "StaticShadows=" << fStaticShadows << endl;
 	optionsFile << "AnisotropicFiltering=" << fAnisotropicFiltering << endl;
+	optionsFile << "PrefetchTime=" << fPrefetchTime << endl;
 	optionsFile << endl;
 	optionsFile << "# Remember some last known player data\n";
 	optionsFile << "[Player]\n";
@@ -203,7 +197,7 @@ void Options::Save(void) {
 }
 
 Options::Options(void) : fViewingDistance(50), fWindowWidth(1024), fWindowHeight(768), fFontSize(12), fMsgWinTransparency(30), fMusicVolume(35),
-	fMusicOn(1), fSoundFxVolume(100), fEnableTestbutton(0), fPerformance(2), fMaxLamps(25), fMaxShadows(15), fMaxFog(10), fFileName("") {
+	fMusicOn(1), fSoundFxVolume(100), fEnableTestbutton(0), fPerformance(2), fFileName("") {
 	fFullScreen = 0;
 	fCameraDistance = 5.0; // Initialize to a little behind the player
 	fAmbientLight = 20;
@@ -216,6 +210,7 @@ Options::Options(void) : fViewingDistance(50), fWindowWidth(1024), fWindowHeight
 	fWhitePoint = 8.0f;
 	fExposure = 1.0f;
 	fVSYNC = 0;
+	fPrefetchTime = 3.0f;
 	fPlayerX = 0;
 	fPlayerY = 0;
 	fPlayerZ = 0;
@@ -248,25 +243,21 @@ void Options::UpdatePerformance(int perf) {
 	default:
 	case 1:
 		fViewingDistance = 75;
-		fMaxLamps = 50; fMaxShadows = 8; fMaxFog = 4;
 		fDynamicShadows = 0;
 		fStaticShadows = 0;
 		break;
 	case 2:
 		fViewingDistance = 110;
-		fMaxLamps = 100; fMaxShadows = 20; fMaxFog = 10;
 		fDynamicShadows = 0;
 		fStaticShadows = 1;
 		break;
 	case 3:
 		fViewingDistance = 135;
-		fMaxLamps = 150; fMaxShadows = 40; fMaxFog = 30;
 		fDynamicShadows = 0;
 		fStaticShadows = 1;
 		break;
 	case 4:
 		fViewingDistance = 160;
-		fMaxLamps = 300; fMaxShadows = MAX_RENDER_SHADOWS; fMaxFog = MAX_RENDER_FOGS;
 		fDynamicShadows = 1;
 		fStaticShadows = 0;
 		break;
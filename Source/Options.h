@@ -57,7 +57,6 @@ public:
 	int fEnableTestbutton;
 	int fPerformance; // A value from 1 to 4.
 	int fNewPerformance; // Next time, use this performance
-	int fMaxLamps, fMaxShadows, fMaxFog;
 	int fFullScreen;
 	int fAmbientLight; // Going from 0 to 100
 	int fSmoothTerrain;
@@ -67,6 +66,7 @@ public:
 	int fStaticShadows;    // A simpler version of dynamic shadows.
 	int fAnisotropicFiltering;
 	int fVSYNC;
+	float fPrefetchTime; // Chunks along the predicted path of the player this many seconds ahead are loaded in advance
 	int fOculusRift;
 	unsigned fNumThreads; // Not really configurable
 	signed long long fPlayerX, fPlayerY, fPlayerZ; // Remember the last known player position
@@ -21,6 +21,7 @@
 
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <vector>
@@ -283,33 +284,6 @@ void SoundControl::Init(void) {
 	alGenSources(SNumSources, fSources);
 	CheckForError("alGenSources failed!");
 
-	// Fill sound buffers and connect sources as configured
-	// Initialize settings for the sources
-	for( idx=0; idx < (int)NELEM(fSoundBuffers); idx++ ) {
-#ifdef MUSIC_DEBUG
-		printf( "Loading %i - %s\n", idx, fSoundBuffers[idx].fileName );
-#endif
-		fBuffers[fSoundBuffers[idx].bufferId] = alutCreateBufferFromFile(fSoundBuffers[idx].fileName);
-
-		CheckForError("alutCreateBufferFromFile failed");
-		//if(alGetError() != AL_NO_ERROR) {
-		//	ErrorDialog("SoundControl: alutCreateBufferFromFile for buffer %i failed!\n", fSoundBuffers[idx].bufferId);
-		//}
-
-		if( fSoundBuffers[idx].sourceId >= 0 ) {
-#ifdef MUSIC_DEBUG
-			printf( "Attaching buf: %i to src: %i\n", fSoundBuffers[idx].bufferId, fSoundBuffers[idx].sourceId );
-#endif
-
-			alSourcei(fSources[fSoundBuffers[idx].sourceId], AL_BUFFER, fBuffers[fSoundBuffers[idx].bufferId]);
-			CheckForError("SC: Buffering");
-			SrcBaseConfig(fSources[fSoundBuffers[idx].sourceId]);
-			CheckForError("SC: Init sound buffers");
-			alSourcei(fSources[fSoundBuffers[idx].sourceId], AL_LOOPING, fSoundBuffers[idx].looping);
-			CheckForError("SC: Set looping for sound buffer");
-		}
-	} // Loop over buffers to load audio and set up sources as configured
-
 	// Genereate generic sources
 	alGenSources(SNumEnvSrc, fEnvironmentSources);
 	alGenSources(SNumCreatureSrc, fCreatureSources);
@@ -350,6 +324,61 @@ void SoundControl::Init(void) {
 		fSongCount[fSoundtrack[idx].musicType]++;
 	}
 
+	// The sound effects are loaded by LoadBuffers() and InitBuffers()
+}
+
+void SoundControl::LoadBuffers(void) {
+	if (fAudioEnabled || !fDecodedSounds.empty())
+		return; // alutInit failed, or the files are already decoded
+	for(int idx=0; idx < (int)NELEM(fSoundBuffers); idx++ ) {
+		DecodedSound sound;
+		sound.data = alutLoadMemoryFromFile(fSoundBuffers[idx].fileName, &sound.format, &sound.size, &sound.frequency);
+		if (sound.data == 0)
+			printf("SoundControl: Failed to load %s: %s\n", fSoundBuffers[idx].fileName, alutGetErrorString(alutGetError()));
+		fDecodedSounds.push_back(sound);
+	}
+}
+
+void SoundControl::InitBuffers(void) {
+	if (fAudioEnabled)
+		return; // alutInit failed
+	this->LoadBuffers(); // In case it wasn't done in advance
+	int idx;
+
+	// Fill sound buffers and connect sources as configured
+	// Initialize settings for the sources
+	for( idx=0; idx < (int)NELEM(fSoundBuffers); idx++ ) {
+#ifdef MUSIC_DEBUG
+		printf( "Loading %i - %s\n", idx, fSoundBuffers[idx].fileName );
+#endif
+		DecodedSound &sound = fDecodedSounds[idx];
+		if (sound.data != 0) {
+			ALuint &buffer = fBuffers[fSoundBuffers[idx].bufferId];
+			alGenBuffers(1, &buffer);
+			alBufferData(buffer, sound.format, sound.data, sound.size, ALsizei(sound.frequency));
+			free(sound.data);
+		}
+
+		CheckForError("alBufferData failed");
+		//if(alGetError() != AL_NO_ERROR) {
+		//	ErrorDialog("SoundControl: alutCreateBufferFromFile for buffer %i failed!\n", fSoundBuffers[idx].bufferId);
+		//}
+
+		if( fSoundBuffers[idx].sourceId >= 0 ) {
+#ifdef MUSIC_DEBUG
+			printf( "Attaching buf: %i to src: %i\n", fSoundBuffers[idx].bufferId, fSoundBuffers[idx].sourceId );
+#endif
+
+			alSourcei(fSources[fSoundBuffers[idx].sourceId], AL_BUFFER, fBuffers[fSoundBuffers[idx].bufferId]);
+			CheckForError("SC: Buffering");
+			SrcBaseConfig(fSources[fSoundBuffers[idx].sourceId]);
+			CheckForError("SC: Init sound buffers");
+			alSourcei(fSources[fSoundBuffers[idx].sourceId], AL_LOOPING, fSoundBuffers[idx].looping);
+			CheckForError("SC: Set looping for sound buffer");
+		}
+	} // Loop over buffers to load audio and set up sources as configured
+	fDecodedSounds.clear();
+
 	/* For portability, explicitly create threads in a joinable state */
 	pthread_attr_setdetachstate(&fAttr, PTHREAD_CREATE_JOINABLE);
 	pthread_create(&fThread, &fAttr, SoundControl::Thread, (void *)this); // This starts the child thread
@@ -811,6 +840,10 @@ void SoundControl::SetCreatureSound(SoundObject creatureType,unsigned long id, f
 	pthread_mutex_unlock(&fMutex);				// Unlock the mutex
 }
 
+bool SoundControl::CreatureNear(float dx, float dy, float dz) {
+	return dx*dx + dy*dy + dz*dz < SOUND_DISTANCE_MAX*4;
+}
+
 void SoundControl::RemoveCreatureSound(SoundObject creatureType,unsigned long id) {
 	int x;
 
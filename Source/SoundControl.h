@@ -19,6 +19,7 @@
 
 #include <pthread.h>
 #include <semaphore.h>
+#include <vector>
 
 #ifdef unix
 #include <AL/al.h>
@@ -62,6 +63,13 @@ public:
 
 	void Init(void);
 
+	// Decode the sound effect files, to be used by InitBuffers(). OpenAL isn't used, so this can be done
+	// by another thread after Init().
+	void LoadBuffers(void);
+
+	// Create the sound effect buffers, and start the sound thread.
+	void InitBuffers(void);
+
 	// Play a sound. The request may fail, unless 'force' is true.
 	void RequestSound(Sound, bool force = false);
 	void RequestTrigSound(const char *);
@@ -70,6 +78,9 @@ public:
 	void SetEnvironmentSound(SoundObject soundType,unsigned long id, float dx, float dy, float dz);
 	void RemoveEnvironmentSound(SoundObject,unsigned long);
 	void RemoveCreatureSound(SoundObject,unsigned long);
+	// True if a creature at the relative position (server coordinates) is near enough to be handled.
+	// There is a margin, so that creatures are known before they can be heard.
+	static bool CreatureNear(float dx, float dy, float dz);
 	void RequestMusicMode(MusicMode);
 	void SwitchMusicStatus(void);
 
@@ -179,6 +190,15 @@ private:
 
 	static SoundBuffer fSoundBuffers[];
 
+	// A sound effect file decoded by LoadBuffers()
+	struct DecodedSound {
+		ALvoid *data;
+		ALenum format;
+		ALsizei size;
+		ALfloat frequency;
+	};
+	std::vector<DecodedSound> fDecodedSounds; // One for each in fSoundBuffers
+
 	struct MusicList {
 		char id[5];
 		MusicMode musicType;
@@ -0,0 +1,55 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/// @brief A lock free queue with a single producer thread and a single consumer thread.
+///
+/// The queue has a fixed capacity, which must be a power of two. The producer owns the tail
+/// and the consumer owns the head, so no locking is needed.
+template <class T, unsigned Capacity> class SpscQueue {
+public:
+	/// Add an element. Return false if the queue is full. Only to be called by the producer.
+	bool Push(T &&item) {
+		unsigned tail = fTail.load(std::memory_order_relaxed);
+		if (tail - fHead.load(std::memory_order_acquire) == Capacity)
+			return false;
+		fItems[tail % Capacity] = std::move(item);
+		fTail.store(tail+1, std::memory_order_release);
+		return true;
+	}
+
+	/// Remove the oldest element. Return false if the queue is empty. Only to be called by the consumer.
+	bool Pop(T &item) {
+		unsigned head = fHead.load(std::memory_order_relaxed);
+		if (head == fTail.load(std::memory_order_acquire))
+			return false;
+		item = std::move(fItems[head % Capacity]);
+		fHead.store(head+1, std::memory_order_release);
+		return true;
+	}
+
+	/// Approximate number of elements, may be called from any thread
+	unsigned Size() const { return fTail.load(std::memory_order_acquire) - fHead.load(std::memory_order_acquire); }
+private:
+	static_assert((Capacity & (Capacity-1)) == 0, "Capacity must be a power of two");
+	T fItems[Capacity];
+	std::atomic<unsigned> fHead{0}, fTail{0};
+};
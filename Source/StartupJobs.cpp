@@ -0,0 +1,145 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+
+#include "StartupJobs.h"
+#include "Clock.h"
+#include "assert.h"
+
+int StartupJobs::Add(const char *name, Function work, Function finish, const std::vector<int> &after) {
+	Job job;
+	job.name = name;
+	job.work = work;
+	job.finish = finish;
+	job.state = Waiting;
+	job.thread = -1;
+	job.workStart = job.workEnd = job.finishStart = job.finishEnd = 0.0;
+	for (int id : after) {
+		ASSERT(id >= 0 && id < int(fJobs.size())); // Only earlier jobs, so there can be no cycles
+		job.after.push_back(id);
+	}
+	fJobs.push_back(job);
+	return fJobs.size()-1;
+}
+
+bool StartupJobs::Ready(const Job &job) const {
+	for (int id : job.after) {
+		if (fJobs[id].state != Done)
+			return false;
+	}
+	return true;
+}
+
+int StartupJobs::NextWork(void) const {
+	for (unsigned i=0; i<fJobs.size(); i++) {
+		const Job &job = fJobs[i];
+		if (job.state == Waiting && job.work && this->Ready(job))
+			return i;
+	}
+	return -1;
+}
+
+int StartupJobs::NextFinish(void) const {
+	for (unsigned i=0; i<fJobs.size(); i++) {
+		const Job &job = fJobs[i];
+		if (job.state == Worked || (job.state == Waiting && !job.work && this->Ready(job)))
+			return i;
+	}
+	return -1;
+}
+
+void *StartupJobs::ThreadStatic(StartupJobs *p) {
+	p->Worker();
+	return 0;
+}
+
+void StartupJobs::Worker(void) {
+	std::unique_lock<std::mutex> lock(fMutex);
+	int thread = fNumThreads++;
+	while (fJobsDone < fJobs.size()) {
+		int i = this->NextWork();
+		if (i < 0) {
+			fCondLock.wait(lock);
+			continue;
+		}
+		Job &job = fJobs[i];
+		job.state = Working;
+		job.thread = thread;
+		job.workStart = GetTime();
+		lock.unlock(); // The vector is not changed while running, so 'job' is still valid.
+		job.work();
+		lock.lock();
+		job.workEnd = GetTime();
+		if (job.finish) {
+			job.state = Worked;
+		} else {
+			job.state = Done;
+			fJobsDone++;
+		}
+		fCondLock.notify_all();
+	}
+	lock.unlock();
+}
+
+void StartupJobs::Run(unsigned numThreads) {
+	fStart = GetTime();
+	if (numThreads == 0)
+		numThreads = 1;
+	std::vector<std::thread> threads;
+	for (unsigned i=0; i<numThreads; i++)
+		threads.push_back(std::thread(StartupJobs::ThreadStatic, this));
+
+	std::unique_lock<std::mutex> lock(fMutex);
+	while (fJobsDone < fJobs.size()) {
+		int i = this->NextFinish();
+		if (i < 0) {
+			fCondLock.wait(lock);
+			continue;
+		}
+		Job &job = fJobs[i];
+		job.state = Finishing;
+		job.finishStart = GetTime();
+		lock.unlock();
+		if (job.finish)
+			job.finish();
+		lock.lock();
+		job.finishEnd = GetTime();
+		job.state = Done;
+		fJobsDone++;
+		fCondLock.notify_all(); // Other jobs may be waiting for this one
+	}
+	lock.unlock();
+
+	for (auto &thread : threads)
+		thread.join();
+	fEnd = GetTime();
+}
+
+void StartupJobs::Report(void) const {
+	printf("Startup time line, %.0f ms total:\n", (fEnd-fStart)*1000.0);
+	for (const Job &job : fJobs) {
+		printf("  %-20s", job.name);
+		if (job.work)
+			printf(" work %6.1f-%6.1f (thread %d)", (job.workStart-fStart)*1000.0, (job.workEnd-fStart)*1000.0, job.thread);
+		else
+			printf(" %30s", "");
+		if (job.finish)
+			printf(" main %6.1f-%6.1f", (job.finishStart-fStart)*1000.0, (job.finishEnd-fStart)*1000.0);
+		printf("\n");
+	}
+}
@@ -0,0 +1,75 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <vector>
+#include <functional>
+
+#ifdef WIN32
+#include "mythread.h"
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+/// @brief Run the loading of assets at startup as a graph of jobs.
+///
+/// A job has two parts, both optional. The 'work' is done by a pool of worker threads, and may only
+/// decode files and build data in memory. The 'finish' is done by the thread calling Run(), which
+/// owns the OpenGL and OpenAL contexts. That is where objects are created from the prepared data.
+///
+/// A job is not started until the jobs it depends on are completely done, including the finish.
+/// The time line of all jobs is saved, to be shown by Report().
+class StartupJobs {
+public:
+	typedef std::function<void(void)> Function;
+
+	/// Add a job, where 'after' are jobs that have to be done first. Return an identifier of the job.
+	int Add(const char *name, Function work, Function finish, const std::vector<int> &after = std::vector<int>());
+
+	/// Run all jobs, using 'numThreads' worker threads. Return when all jobs are done.
+	void Run(unsigned numThreads);
+
+	/// Print the time line of the jobs, in milliseconds from the start.
+	void Report(void) const;
+private:
+	enum State { Waiting, Working, Worked, Finishing, Done };
+	struct Job {
+		const char *name;
+		Function work, finish;
+		std::vector<int> after;
+		State state;
+		int thread;                                  // The worker doing the work
+		double workStart, workEnd, finishStart, finishEnd;
+	};
+	std::vector<Job> fJobs;
+	double fStart = 0.0, fEnd = 0.0;
+
+	// The following are guarded by 'fMutex'.
+	std::mutex fMutex;
+	std::condition_variable fCondLock;
+	unsigned fJobsDone = 0;
+	int fNumThreads = 0;                             // Used to number the worker threads
+
+	bool Ready(const Job &) const;
+	int NextWork(void) const;                        // Find a job for a worker thread, -1 if none.
+	int NextFinish(void) const;                      // Find a job for the main thread, -1 if none.
+	static void *ThreadStatic(StartupJobs *p);
+	void Worker(void);
+};
@@ -0,0 +1,178 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include "mythread.h"
+#else
+#include <mutex>
+#endif
+
+#include "TextureCache.h"
+#include "imageloader.h"
+#include "Hash.h"
+#include "primitives.h"
+
+#define TEXTURECACHE_VERSION 1 // Update this if the processing of textures is changed
+#define MAX_LEVELS 16
+
+// The header of an entry. It is followed by the pixels of all levels.
+struct CacheHeader {
+	char magic[4];
+	unsigned version;
+	unsigned flags;
+	unsigned format;
+	unsigned numLevels;
+	unsigned unused;
+	unsigned long long sourceSize;
+	unsigned long long sourceTime; // Modification time of the source, to avoid computing the hash if not changed
+	unsigned long long sourceHash;
+	unsigned width[MAX_LEVELS], height[MAX_LEVELS];
+};
+
+static const char sMagic[4] = { 'E', 'P', 'H', 'T' };
+static std::mutex sSaveMutex; // Textures may be saved by more than one thread at the same time
+
+TextureCache TextureCache::fgTextureCache;
+
+static int BytesPerPixel(unsigned format) {
+	if (format == GL_BGR || format == GL_RGB)
+		return 3;
+	return 4;
+}
+
+void TextureCache::SetCacheDir(const std::string &dirName) {
+	if (!CreateCacheDir(dirName.c_str()))
+		return; // No cache
+	fCacheDir = dirName;
+}
+
+std::string TextureCache::EntryName(const char *fileName, unsigned flags) const {
+	unsigned long long hash = HashBytes(fileName, strlen(fileName));
+	hash = HashBytes(&flags, sizeof flags, hash);
+	char name[40];
+	snprintf(name, sizeof name, "t%016llx", hash);
+	return fCacheDir + name;
+}
+
+bool TextureCache::Load(const char *fileName, unsigned flags, Entry &entry) {
+	if (fCacheDir.empty())
+		return false;
+	struct stat source;
+	if (stat(fileName, &source) != 0)
+		return false;
+	std::string name = this->EntryName(fileName, flags);
+	FILE *f = fopen(name.c_str(), "rb");
+	if (f == 0)
+		return false;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (size < long(sizeof (CacheHeader))) {
+		fclose(f);
+		return false;
+	}
+	entry.data.reset(new char[size]);
+	bool ok = fread(entry.data.get(), 1, size, f) == size_t(size);
+	fclose(f);
+	if (!ok)
+		return false;
+
+	CacheHeader *header = reinterpret_cast<CacheHeader *>(entry.data.get());
+	if (memcmp(header->magic, sMagic, sizeof sMagic) != 0 || header->version != TEXTURECACHE_VERSION || header->flags != flags ||
+	        header->numLevels == 0 || header->numLevels > MAX_LEVELS)
+		return false;
+	if (header->sourceSize != (unsigned long long)source.st_size)
+		return false;
+	if (header->sourceTime != (unsigned long long)source.st_mtime) {
+		// The bitmap may have been copied. Compare the content, and remember the new time if it is the same.
+		unsigned long long sourceSize, sourceHash;
+		if (!HashFile(fileName, sourceSize, sourceHash) || sourceHash != header->sourceHash)
+			return false;
+		header->sourceTime = source.st_mtime;
+		f = fopen(name.c_str(), "r+b");
+		if (f != 0) {
+			fwrite(header, sizeof *header, 1, f);
+			fclose(f);
+		}
+	}
+
+	int bytesPerPixel = BytesPerPixel(header->format);
+	size_t offset = sizeof (CacheHeader);
+	entry.format = header->format;
+	entry.levels.clear();
+	for (unsigned i=0; i < header->numLevels; i++) {
+		Level level;
+		level.width = header->width[i];
+		level.height = header->height[i];
+		level.pixels = reinterpret_cast<const unsigned char *>(entry.data.get() + offset);
+		offset += size_t(level.width) * level.height * bytesPerPixel;
+		if (offset > size_t(size))
+			return false; // Truncated
+		entry.levels.push_back(level);
+	}
+	return true;
+}
+
+void TextureCache::Save(const char *fileName, unsigned flags, const std::vector<std::shared_ptr<Image> > &levels) {
+	if (fCacheDir.empty() || levels.empty() || levels.size() > MAX_LEVELS)
+		return;
+	struct stat source;
+	CacheHeader header;
+	memset(&header, 0, sizeof header);
+	if (stat(fileName, &source) != 0 || !HashFile(fileName, header.sourceSize, header.sourceHash))
+		return;
+	memcpy(header.magic, sMagic, sizeof sMagic);
+	header.version = TEXTURECACHE_VERSION;
+	header.flags = flags;
+	header.format = levels[0]->fFormat;
+	header.numLevels = levels.size();
+	header.sourceTime = source.st_mtime;
+	for (unsigned i=0; i < levels.size(); i++) {
+		header.width[i] = levels[i]->width;
+		header.height[i] = levels[i]->height;
+	}
+
+	// Write to a temporary name first, to never leave a broken entry.
+	std::string name = this->EntryName(fileName, flags);
+	std::string tmpName = name + ".tmp";
+	sSaveMutex.lock();
+	FILE *f = fopen(tmpName.c_str(), "wb");
+	if (f == 0) {
+		sSaveMutex.unlock();
+		return;
+	}
+	bool ok = fwrite(&header, sizeof header, 1, f) == 1;
+	int bytesPerPixel = BytesPerPixel(header.format);
+	for (auto &level : levels) {
+		size_t size = size_t(level->width) * level->height * bytesPerPixel;
+		if (fwrite(level->pixels.get(), 1, size, f) != size)
+			ok = false;
+	}
+	if (fclose(f) != 0)
+		ok = false;
+	remove(name.c_str()); // Needed on Windows, where rename doesn't replace
+	if (!ok || rename(tmpName.c_str(), name.c_str()) != 0)
+		remove(tmpName.c_str());
+	else if (gVerbose)
+		printf("TextureCache: Saved %s with %d levels\n", fileName, header.numLevels);
+	sSaveMutex.unlock();
+}
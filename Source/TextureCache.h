@@ -0,0 +1,60 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+
+class Image;
+
+/// @brief A cache on disk of textures where all processing is done.
+/// Decoding a bitmap, applying premultiplied alpha and computing special mipmaps is only needed the
+/// first time. An entry is found from the file name and the texture flags, and it is only used if
+/// the source bitmap is unchanged. An entry is loaded with one read.
+class TextureCache {
+public:
+	/// One mipmap level of a cached texture
+	struct Level {
+		int width, height;
+		const unsigned char *pixels;
+	};
+
+	/// A texture loaded from the cache
+	struct Entry {
+		unsigned format;           // The pixel format, GL_BGR or GL_BGRA
+		std::vector<Level> levels; // First is the full size image
+		std::unique_ptr<char[]> data;
+	};
+
+	static TextureCache fgTextureCache;
+
+	/// Define where to save the cache. The directory is created if it doesn't exist.
+	void SetCacheDir(const std::string &);
+
+	/// Find a cached texture from a bitmap file and the texture flags.
+	/// Return false if there is none, or if the bitmap has changed.
+	bool Load(const char *fileName, unsigned flags, Entry &);
+
+	/// Save a texture made from a bitmap file with the texture flags. 'levels' are the mipmaps, if any.
+	void Save(const char *fileName, unsigned flags, const std::vector<std::shared_ptr<Image> > &levels);
+private:
+	std::string fCacheDir; // Empty if there is no cache
+
+	std::string EntryName(const char *fileName, unsigned flags) const;
+};
@@ -0,0 +1,306 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "VertexArena.h"
+#include "primitives.h"
+#include "assert.h"
+#include "shaders/StageOneShader.h"
+#include "shaders/ChunkShaderPicking.h"
+#include "ui/Error.h"
+
+using namespace View;
+
+// Number of vertices in a standard arena. Bigger meshes get an arena of their own.
+#define ARENA_SIZE (1<<20)
+
+// All ranges are a multiple of this number of vertices, to reduce fragmentation.
+#define GRANULARITY 64
+
+// Number of frames before a freed range is reused
+#define RECLAIM_DELAY 3
+
+// Size of the staging ring buffer, in bytes. Bigger uploads bypass it.
+#define STAGING_SIZE (8*1024*1024)
+
+VertexArena View::gVertexArena;
+
+VertexArena::~VertexArena() {
+	for (auto &f : fFences)
+		glDeleteSync(f.fSync);
+	for (auto &a : fArenas) {
+		if (a->fVao != 0)
+			glDeleteVertexArrays(1, &a->fVao);
+		if (a->fVaoPicking != 0)
+			glDeleteVertexArrays(1, &a->fVaoPicking);
+	}
+}
+
+int VertexArena::NewArena(GLsizei size) {
+	// Reuse a slot of a released arena, if there is one
+	unsigned ind;
+	for (ind=0; ind < fArenas.size(); ind++) {
+		if (fArenas[ind]->fSize == 0)
+			break;
+	}
+	if (ind == fArenas.size())
+		fArenas.push_back(std::unique_ptr<Arena>(new Arena));
+	Arena *a = fArenas[ind].get();
+	if (!a->fBuffer.BindArray(size * sizeof(VertexDataf), 0, GL_DYNAMIC_DRAW)) {
+		checkError("VertexArena::NewArena");
+		ErrorDialog("VertexArena::NewArena: Failed to allocate %d vertices\n", size);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	a->fSize = size;
+	a->fUsed = 0;
+	a->fFree.clear();
+	a->fFree[0] = size;
+	if (gVerbose)
+		printf("VertexArena::NewArena %d: %d vertices\n", ind, size);
+	return ind;
+}
+
+VertexArena::Range VertexArena::Allocate(GLsizei count) {
+	Range r;
+	if (count <= 0)
+		return r;
+	count = (count + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+	// Find the smallest free range that is big enough.
+	int bestArena = -1;
+	std::map<GLint, GLsizei>::iterator best;
+	for (unsigned i=0; i < fArenas.size(); i++) {
+		auto &freeList = fArenas[i]->fFree;
+		for (auto it = freeList.begin(); it != freeList.end(); it++) {
+			if (it->second >= count && (bestArena == -1 || it->second < best->second)) {
+				bestArena = i;
+				best = it;
+			}
+		}
+	}
+	if (bestArena == -1) {
+		bestArena = this->NewArena(count > ARENA_SIZE ? count : ARENA_SIZE);
+		best = fArenas[bestArena]->fFree.begin();
+	}
+	Arena *a = fArenas[bestArena].get();
+	r.fArena = bestArena;
+	r.fFirst = best->first;
+	r.fCount = count;
+	GLsizei remaining = best->second - count;
+	a->fFree.erase(best);
+	if (remaining > 0)
+		a->fFree[r.fFirst + count] = remaining;
+	a->fUsed += count;
+	return r;
+}
+
+void VertexArena::Upload(const Range &range, GLint offset, GLsizei count, const VertexDataf *data) {
+	ASSERT(range.Valid() && offset + count <= range.fCount);
+	Arena *a = fArenas[range.fArena].get();
+	GLsizeiptr size = count * sizeof(VertexDataf);
+	GLintptr dest = (range.fFirst + offset) * sizeof(VertexDataf);
+	fUploadedFrame += size;
+	if (size > STAGING_SIZE) {
+		// Too big for the staging buffer, let the driver take care of it.
+		a->fBuffer.BindArray();
+		a->fBuffer.ArraySubData(dest, size, data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+	if (!fStaging.Defined())
+		fStaging.BindArray(STAGING_SIZE, 0, GL_STREAM_DRAW);
+	GLintptr src = this->StagingAlloc(size);
+	// The fences guarantee that the GPU is no longer using this part of the buffer, so there is no need to synchronize.
+	void *p = fStaging.MapArrayRange(src, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (p == 0) {
+		checkError("VertexArena::Upload map");
+		ErrorDialog("VertexArena::Upload: Failed to map %d bytes of the staging buffer\n", int(size));
+	}
+	memcpy(p, data, size);
+	fStaging.UnmapArray();
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	a->fBuffer.CopySubData(fStaging, src, dest, size);
+}
+
+GLintptr VertexArena::StagingAlloc(GLsizeiptr size) {
+	// Skip the end of the buffer if there isn't room for all data
+	GLsizeiptr padding = 0;
+	if (fStagingHead + size > STAGING_SIZE)
+		padding = STAGING_SIZE - fStagingHead;
+	while (fStagingUsed + padding + size > STAGING_SIZE) {
+		if (fFences.empty()) {
+			// The current frame has used all of the buffer. Add a fence, to be able to wait for it.
+			Fence f;
+			f.fSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			f.fBytes = fStagingFrame;
+			fFences.push_back(f);
+			fStagingFrame = 0;
+		}
+		this->StagingReclaim(true);
+	}
+	if (padding > 0)
+		fStagingHead = 0;
+	GLintptr ret = fStagingHead;
+	fStagingHead += size;
+	fStagingUsed += padding + size;
+	fStagingFrame += padding + size;
+	return ret;
+}
+
+void VertexArena::StagingReclaim(bool wait) {
+	while (!fFences.empty()) {
+		Fence &f = fFences.front();
+		GLenum res = glClientWaitSync(f.fSync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GLuint64(1000000000) : 0);
+		if (res == GL_TIMEOUT_EXPIRED) {
+			if (!wait)
+				break;
+			continue; // Keep waiting
+		}
+		if (res == GL_WAIT_FAILED)
+			checkError("VertexArena::StagingReclaim");
+		if (res == GL_CONDITION_SATISFIED)
+			fStagingWaits++; // The GPU was not done yet
+		glDeleteSync(f.fSync);
+		fStagingUsed -= f.fBytes;
+		fFences.pop_front();
+		if (wait)
+			break; // Only wait for one frame at a time
+	}
+}
+
+void VertexArena::Free(Range &range) {
+	if (!range.Valid())
+		return;
+	Pending p;
+	p.fRange = range;
+	p.fFrame = fFrame;
+	fPending.push_back(p);
+	range = Range();
+}
+
+void VertexArena::Reclaim(const Range &range) {
+	Arena *a = fArenas[range.fArena].get();
+	auto &freeList = a->fFree;
+	GLint first = range.fFirst;
+	GLsizei count = range.fCount;
+	// Merge with the following free range, if adjacent
+	auto next = freeList.lower_bound(first);
+	if (next != freeList.end() && next->first == first + count) {
+		count += next->second;
+		next = freeList.erase(next);
+	}
+	// Merge with the previous free range, if adjacent
+	if (next != freeList.begin()) {
+		auto prev = next;
+		prev--;
+		if (prev->first + prev->second == first) {
+			first = prev->first;
+			count += prev->second;
+			freeList.erase(prev);
+		}
+	}
+	freeList[first] = count;
+	a->fUsed -= range.fCount;
+	ASSERT(a->fUsed >= 0);
+
+	if (a->fUsed == 0 && range.fArena > 0) {
+		// Release arenas that are no longer needed, except the first one.
+		a->fBuffer.Release();
+		if (a->fVao != 0)
+			glDeleteVertexArrays(1, &a->fVao);
+		if (a->fVaoPicking != 0)
+			glDeleteVertexArrays(1, &a->fVaoPicking);
+		a->fVao = 0;
+		a->fVaoPicking = 0;
+		a->fSize = 0;
+		a->fFree.clear();
+	}
+}
+
+void VertexArena::BindVertexArray(int arena, ChunkShaderPicking *pickShader) {
+	enum { stride = sizeof(VertexDataf), };
+	Arena *a = fArenas[arena].get();
+	GLuint &vao = pickShader ? a->fVaoPicking : a->fVao;
+	if (vao != 0) {
+		glBindVertexArray(vao);
+		return;
+	}
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+	a->fBuffer.BindArray();
+	if (pickShader) {
+		pickShader->EnableVertexAttribArray();
+		// The normals are stored in "char", but they are in practice of type "unsigned char", and we don't
+		// want OpenGL to convert them to signed char.
+		pickShader->NormalAttribPointer(GL_UNSIGNED_BYTE, stride, VertexDataf::GetNormalOffset());
+		pickShader->VertexAttribPointer(GL_SHORT, stride, VertexDataf::GetVertexOffset());
+	} else {
+		StageOneShader::EnableVertexAttribArray();
+		StageOneShader::VertexAttribPointer();
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexArena::EndFrame(void) {
+	while (!fPending.empty() && fFrame - fPending.front().fFrame >= RECLAIM_DELAY) {
+		this->Reclaim(fPending.front().fRange);
+		fPending.pop_front();
+	}
+	if (fStagingFrame > 0) {
+		Fence f;
+		f.fSync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		f.fBytes = fStagingFrame;
+		fFences.push_back(f);
+		fStagingFrame = 0;
+	}
+	this->StagingReclaim(false);
+	if (fUploadedFrame > fUploadedMax)
+		fUploadedMax = fUploadedFrame;
+	fUploadedTotal += fUploadedFrame;
+	fUploadedFrame = 0;
+	fFrame++;
+}
+
+void VertexArena::Report(void) {
+	size_t total = 0, used = 0, free = 0, largestFree = 0, freeBlocks = 0;
+	int arenas = 0;
+	for (auto &a : fArenas) {
+		if (a->fSize == 0)
+			continue;
+		arenas++;
+		total += a->fSize;
+		used += a->fUsed;
+		for (auto &f : a->fFree) {
+			free += f.second;
+			freeBlocks++;
+			if (size_t(f.second) > largestFree)
+				largestFree = f.second;
+		}
+	}
+	// Fragmentation is the part of the free memory that can't be used for the biggest possible allocation
+	float fragmentation = free > 0 ? 100.0f * (1.0f - float(largestFree)/free) : 0.0f;
+	unsigned frames = fFrame - fReportFrame;
+	const float mb = 1024.0f*1024.0f / sizeof(VertexDataf);
+	printf("VertexArena: %d arenas %.1f MB, used %.1f MB, free %.1f MB in %d blocks (%.0f%% fragmented), %d pending. Upload %.1f kB/frame (max %.1f kB), %d staging waits\n",
+	       arenas, total/mb, used/mb, free/mb, int(freeBlocks), fragmentation, int(fPending.size()),
+	       frames > 0 ? fUploadedTotal/1024.0f/frames : 0.0f, fUploadedMax/1024.0f, fStagingWaits);
+	fStagingWaits = 0;
+	fUploadedTotal = 0;
+	fUploadedMax = 0;
+	fReportFrame = fFrame;
+}
@@ -0,0 +1,133 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <GL/glew.h>
+
+#include "OpenglBuffer.h"
+
+struct VertexDataf;
+class ChunkShaderPicking;
+
+namespace View {
+
+/// @brief A pool of big vertex buffers, from which the chunk meshes are allocated.
+///
+/// Allocating and deleting one OpenGL buffer and vertex array object for every block type of
+/// every chunk is expensive, and chunks come and go all the time when the player moves around.
+/// Instead, a few big buffers (arenas) are allocated, and a chunk mesh is a range of vertices in one
+/// of them. Every arena has a vertex array object that is shared by all meshes, and the meshes
+/// are drawn using the first vertex of the range.
+///
+/// A freed range is not reused until a few frames later, as the GPU may still be drawing from it.
+///
+/// New vertex data is first written to a staging ring buffer, and then copied by the GPU into the arena.
+/// That way, the driver never has to wait for the arena to become idle, or make a private copy of the data.
+/// Every frame using the staging buffer is protected by a fence, and the memory is reused when the fence
+/// has been passed.
+///
+/// All functions must be called from the main thread.
+class VertexArena {
+public:
+	/// A range of vertices in one of the arenas
+	struct Range {
+		int fArena = -1;
+		GLint fFirst = 0;   // First vertex in the arena
+		GLsizei fCount = 0; // Number of vertices, rounded up to the allocation granularity
+		bool Valid() const { return fArena >= 0; }
+	};
+
+	~VertexArena();
+
+	/// Allocate room for a number of vertices. The content is undefined.
+	Range Allocate(GLsizei count);
+
+	/// Copy vertices into a range, using the staging buffer.
+	/// @param range The allocated range
+	/// @param offset The first vertex, relative the range, to copy to
+	/// @param count The number of vertices to copy
+	void Upload(const Range &range, GLint offset, GLsizei count, const VertexDataf *data);
+
+	/// Give back a range, and invalidate it. It will be reused when the GPU is done with it.
+	void Free(Range &range);
+
+	/// Bind the vertex array object of an arena.
+	/// @param pickShader If not null, use a vertex array object configured for this picking shader
+	void BindVertexArray(int arena, ChunkShaderPicking *pickShader = 0);
+
+	/// Reclaim old ranges. Shall be called once every frame.
+	void EndFrame(void);
+
+	/// Print statistics about the arenas and the uploads since last report.
+	void Report(void);
+
+	/// Number of bytes uploaded since the start of this frame
+	size_t UploadedThisFrame(void) const { return fUploadedFrame; }
+private:
+	struct Arena {
+		OpenglBuffer fBuffer;
+		GLuint fVao = 0, fVaoPicking = 0;
+		GLsizei fSize = 0;               // Number of vertices, 0 if the arena is not allocated
+		GLsizei fUsed = 0;               // Number of allocated vertices, including pending frees
+		std::map<GLint, GLsizei> fFree;  // Free ranges, indexed on the first vertex
+	};
+	std::vector<std::unique_ptr<Arena>> fArenas;
+
+	// Freed ranges waiting for the GPU to finish.
+	struct Pending {
+		Range fRange;
+		unsigned fFrame;
+	};
+	std::deque<Pending> fPending;
+	unsigned fFrame = 0;
+
+	// The staging ring buffer. Data is written at fStagingHead, and the fences are used to find
+	// out when the oldest data has been consumed.
+	OpenglBuffer fStaging;
+	GLsizeiptr fStagingHead = 0;
+	GLsizeiptr fStagingUsed = 0;  // Bytes in use, including the current frame
+	GLsizeiptr fStagingFrame = 0; // Bytes used by the current frame
+	struct Fence {
+		GLsync fSync;
+		GLsizeiptr fBytes;        // Bytes released when the fence is passed
+	};
+	std::deque<Fence> fFences;
+	unsigned fStagingWaits = 0;   // Number of times the CPU had to wait for the GPU, since last report
+
+	// Allocate room in the staging buffer, waiting for the GPU if needed. Return the offset.
+	GLintptr StagingAlloc(GLsizeiptr size);
+	// Release staging memory of frames that the GPU has finished.
+	void StagingReclaim(bool wait);
+
+	// Statistics
+	size_t fUploadedFrame = 0;    // Bytes uploaded this frame
+	size_t fUploadedMax = 0;      // The most bytes uploaded in one frame, since last report
+	size_t fUploadedTotal = 0;    // Bytes uploaded since last report
+	unsigned fReportFrame = 0;    // The frame of the last report
+
+	int NewArena(GLsizei size);
+	void Reclaim(const Range &);
+};
+
+extern VertexArena gVertexArena;
+
+}
@@ -15,14 +15,22 @@
 // along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <GL/glew.h>
+#include <algorithm>
 
 #include "animationmodels.h"
 #include "textures.h"
-#include "shaders/AnimationShader.h"
-#include "imageloader.h"
 
 using namespace View;
 
+void AnimationModels::Load() {
+	ManageAnimation::Preload("models/frog.dae", false);
+	ManageAnimation::Preload("models/morran.dae", false);
+	ManageAnimation::Preload("models/alien.dae", false);
+	PreloadBitmapForModels("models/alien_body.bmp");
+	PreloadBitmapForModels("models/alien_teeth.bmp");
+	PreloadBitmapForModels("models/alien_spikes.bmp");
+}
+
 void AnimationModels::Init() {
 	for (unsigned i=0; i < LAST; i++) {
 		auto data = new Data;
@@ -45,12 +53,36 @@ void AnimationModels::Init() {
 	fModels.at(Alien)->textures.push_back(this->LoadTexture("alien_teeth.bmp"));  // Teeth
 	fModels.at(Alien)->textures.push_back(this->LoadTexture("alien_spikes.bmp")); // Spikes
 
-	fShader = AnimationShader::Make();
+	fShader = AnimationInstancedShader::Make();
 }
 
-void AnimationModels::Draw(AnimationModelId id, const glm::mat4 &modelMatrix, double animationStart, bool dead) const {
+void AnimationModels::Draw(std::vector<Instance> &instances) const {
+	if (instances.empty())
+		return;
+	std::sort(instances.begin(), instances.end(), [](const Instance &a, const Instance &b) { return a.id < b.id; });
+
+	// Find the poses first, as the bone palettes of the models are uploaded when drawing.
+	fInstanceData.resize(instances.size());
+	for (unsigned i=0; i < instances.size(); i++) {
+		const Instance &inst = instances[i];
+		ManageAnimation *model = fModels[inst.id]->model.get();
+		fInstanceData[i].model = inst.modelMatrix;
+		model->Align(fInstanceData[i].model);
+		fInstanceData[i].pose = model->PoseIndex(inst.animationStart, inst.dead);
+	}
+	fInstanceBuffer.BindArray(fInstanceData.size() * sizeof fInstanceData[0], &fInstanceData[0], GL_STREAM_DRAW);
+
 	fShader->EnableProgram();
-	fModels[id]->model->DrawAnimation(fShader, modelMatrix, animationStart, dead, &fModels[id]->textures[0]);
+	unsigned first = 0;
+	while (first < instances.size()) {
+		AnimationModelId id = instances[first].id;
+		unsigned last = first+1;
+		while (last < instances.size() && instances[last].id == id)
+			last++;
+		const Data *data = fModels[id].get();
+		data->model->DrawAnimationInstanced(fShader, fInstanceBuffer, first, last-first, &data->textures[0]);
+		first = last;
+	}
 	fShader->DisableProgram();
 }
 
@@ -61,8 +93,7 @@ AnimationModels::~AnimationModels() {
 
 GLuint AnimationModels::LoadTexture(const string &file) {
 	string path = "models/" + file;
-	auto bmp = loadBMP(path.c_str());
-	GLuint texture = LoadBitmapForModels(bmp);
+	GLuint texture = LoadBitmapForModels(path.c_str());
 	fLocalTextures.push_back(texture);
 	return texture;
 }
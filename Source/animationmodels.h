@@ -27,10 +27,12 @@
 #include <glm/glm.hpp>
 
 #include "manageanimation.h"
+#include "OpenglBuffer.h"
+#include "shaders/AnimationInstancedShader.h"
 
 using std::string;
 
-class AnimationShader;
+class AnimationInstancedShader;
 
 namespace View {
 
@@ -38,13 +40,25 @@ namespace View {
 /// The main purpose for now is to know what textures to use.
 class AnimationModels {
 public:
+	/// Read the model and texture files in advance, to be used by Init(). OpenGL isn't used, so this can
+	/// be done by other threads.
+	static void Load(void);
 	void Init(void);
 	enum AnimationModelId {
 		Frog, Morran, Alien,
 		LAST // This one must always come last
 	};
 
-	void Draw(AnimationModelId id, const glm::mat4 &modelMatrix, double animationStart, bool dead) const;
+	struct Instance {
+		AnimationModelId id;
+		glm::mat4 modelMatrix;
+		double animationStart;
+		bool dead;
+	};
+
+	/// Draw a list of instances. The list is sorted on model, and all instances of a model are drawn
+	/// with one instanced draw call for each mesh.
+	void Draw(std::vector<Instance> &instances) const;
 	~AnimationModels();
 private:
 	struct Data { // TODO: Shouldn't it be enough with a forward declaration of this struct?
@@ -54,7 +68,9 @@ private:
 	std::vector<std::unique_ptr<Data> > fModels;
 	std::vector<GLuint> fLocalTextures; // This is textures allocated locally for animations only
 
-	AnimationShader *fShader; // Singleton, do not destroy
+	AnimationInstancedShader *fShader; // Singleton, do not destroy
+	mutable OpenglBuffer fInstanceBuffer; // Per instance data, updated for every Draw()
+	mutable std::vector<AnimationInstancedShader::Instance> fInstanceData;
 
 	// Load a local texture.
 	GLuint LoadTexture(const string &);
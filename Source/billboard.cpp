@@ -238,3 +238,17 @@ void Billboard::Draw(StageOneShader *shader, const glm::mat4 &modelMatrix, enum
 	gQuadStage1.DrawSingleSide();
 	shader->TextureOffsetMulti(0, 0, 1.0f); // Restore default
 }
+
+void Billboard::DrawInstanced(StageOneShader *shader, const glm::mat4 &modelMatrix, enum Predefined picture, const OpenglBuffer &instances, int first, int count) {
+	int ind = fPredefined[picture];
+	float srcY0 = float(ROW(ind)) / fNumPictures;
+	float srcX0 = float(COL(ind)) / fNumPictures;
+	glm::mat4 model = modelMatrix;
+	model = glm::translate(model, glm::vec3(0, 10, 0));
+	model = glm::scale(model, glm::vec3(20, 20, 20));
+	shader->Model(model);
+	shader->TextureOffsetMulti(srcX0, srcY0, 1.0f/fNumPictures);
+	gBillboard.BindTexture();
+	gQuadStage1.DrawSingleSideInstanced(instances, first, count);
+	shader->TextureOffsetMulti(0, 0, 1.0f); // Restore default
+}
@@ -23,6 +23,7 @@
 #include <vector>
 
 class StageOneShader;
+class OpenglBuffer;
 
 class Billboard {
 public:
@@ -47,6 +48,9 @@ public:
 	void InitializeTextures(StageOneShader *);
 
 	void Draw(StageOneShader *shader, const glm::mat4 &modelMatrix, enum Predefined picture);
+
+	// Draw 'count' billboards of the same picture, using per instance offsets from 'instances' starting at 'first'.
+	void DrawInstanced(StageOneShader *shader, const glm::mat4 &modelMatrix, enum Predefined picture, const OpenglBuffer &instances, int first, int count);
 private:
 	GLuint fboAtlas, fboTemp;
 	GLuint fAtlasId; // The texture of the complete atlas
@@ -21,12 +21,14 @@
 #include <math.h>
 #include <string.h>
 #include <map>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform2.hpp>
 
 #include "chunk.h"
 #include "chunkcache.h"
+#include "ChunkRequests.h"
 #include "connection.h"
 #include "parse.h"
 #include "textures.h"
@@ -39,9 +41,14 @@
 #include "SuperChunkManager.h"
 #include "client_prot.h"
 #include "modes.h"
+#include "player.h"
+#include "worsttime.h"
 
 #define cChecksumTimeout 15.0
 
+// Number of bytes of chunk meshes that may be uploaded every frame. The nearest chunk is always uploaded.
+#define UPLOAD_BUDGET (2*1024*1024)
+
 using namespace View;
 
 // Find out if a block at (ox,oy,oz) is in a line of sight of the sky, as given by the direction (dx,dy,dz).
@@ -202,8 +209,12 @@ void Chunk::MakeAllChunksDirty(void) {
 Chunk* ChunkFind(const ChunkCoord *cc, bool force) {
 	auto it = sWorldCache.find(*cc);
 
-	if (it != sWorldCache.end())
-		return it->second;
+	if (it != sWorldCache.end()) {
+		Chunk *cp = it->second;
+		if (force && cp->fAwaitingData)
+			gChunkRequests.Request(cp); // A previous request may have been cancelled
+		return cp;
+	}
 
 	if (!force) {
 		// It wasn't found, and it will be ignored if it isn't available
@@ -218,11 +229,14 @@ Chunk* ChunkFind(const ChunkCoord *cc, bool force) {
 
 	// Check for chunk in cache
 	auto cb = ChunkCache::fgChunkCache.LoadChunkFromCache(cc);
+	if (cb != nullptr) {
+		cb->fChunk = pc;    // Needed by Uncompress
+		if (!cb->Uncompress())
+			cb.reset(); // A corrupt file in the cache, ignore it
+	}
 	if (cb != nullptr) {
 		// printf("ChunkFind: Load chunk from cache (%d,%d,%d)\n", cc->x, cc->y, cc->z);
 		cb->fChecksumTestNeeded = true; // Checksum need to be tested, as the chunk may have changed on the server
-		cb->fChunk = pc;    // Needed by Uncompress
-		cb->Uncompress();
 		pc->fChunkBlocks = cb;
 
 		sWorldCache[pc->cc] = pc;
@@ -245,20 +259,37 @@ Chunk* ChunkFind(const ChunkCoord *cc, bool force) {
 
 		sWorldCache[pc->cc] = pc;
 		// Initiate the action to get the chunk from the server. It will arrive a little later on.
-		//printf("ChunkFind: Request chunk (%d,%d,%d)\n", cc->x, cc->y, cc->z);
-		unsigned char b[15];
-		b[0] = sizeof b;
-		b[1] = 0;
-		b[2] = CMD_READ_CHUNK;
-		EncodeUint32(b+3, (unsigned int)cc->x);
-		EncodeUint32(b+7, (unsigned int)cc->y);
-		EncodeUint32(b+11, (unsigned int)cc->z);
-		SendMsg(b, sizeof b);
+		pc->fAwaitingData = true;
+		gChunkRequests.Request(pc);
 	}
 
 	return pc;
 }
 
+size_t ChunkCount(void) {
+	return sWorldCache.size();
+}
+
+void Chunk::Refresh(void) {
+	if (fPrefetched)
+		gChunkRequests.PrefetchUsed(this);
+
+	if (this->IsDirty() && !this->fScheduledForLoading) {
+		this->UpdateGraphics();
+	}
+
+	ASSERT(fChunkBlocks);
+	auto cb = fChunkBlocks;
+	// ASSERT(cb);
+
+	if (gMode.CommunicationAllowed() && cb->fChecksumTestNeeded && gCurrentFrameTime > cb->fChecksumTimeout) {
+		// This chunk need to verify the checksum. The request is sent together with other chunks.
+		cb->fChecksumTestNeeded = false;
+		cb->fChecksumTimeout = gCurrentFrameTime+cChecksumTimeout; // Reset checksum timer when request is sent
+		gChunkRequests.Verify(this);
+	}
+}
+
 void Chunk::Draw(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type dlType) {
 	// printf("chunk::Draw buffers for (%d,%d,%d)\n", this->cc.x, this->cc.y, this->cc.z);
 	if (this->fPrev_gl) {
@@ -276,51 +307,58 @@ void Chunk::Draw(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type
 	sfBusyList_gl = this;
 	this->fPrev_gl = &sfBusyList_gl;
 
-	if (this->IsDirty() && !this->fScheduledForLoading) {
-		this->UpdateGraphics();
-	}
+	this->Refresh();
 
-	ASSERT(fChunkBlocks);
-	auto cb = fChunkBlocks;
-	// ASSERT(cb);
+	if (!fChunkObject)
+		return; // There are no grapical objects to draw.
 
-	if (gMode.CommunicationAllowed() && cb->fChecksumTestNeeded && gCurrentFrameTime > cb->fChecksumTimeout) {
-		// This chunk need to verify the checksum
-		cb->fChecksumTestNeeded = false;
-		cb->fChecksumTimeout = gCurrentFrameTime+cChecksumTimeout; // Reset checksum timer when request is sent
+	if (dlType == DL_Picking) {
+		// The picking triangles are only used once, so they are uploaded and drawn immediately, without
+		// disturbing the normal mesh.
+		auto mesh = UploadMesh(*fChunkObject);
+		DrawMesh(*fChunkObject, mesh, shader, pickShader, dlType);
+		View::gVertexArena.Free(mesh);
+		return;
+	}
 
-		// TODO: Put this is another wrapper and send several requests at the same time...
-		unsigned char b[10];
-		b[0] = sizeof b;
-		b[1] = 0;
-		b[2] = CMD_VRFY_CHUNK_CS;
-		b[3] = this->cc.x & 0xFF;
-		b[4] = this->cc.y & 0xFF;
-		b[5] = this->cc.z & 0xFF;
-		b[6] = cb->fChecksum & 0xFF;
-		b[7] = (cb->fChecksum >> 8) & 0xFF;
-		b[8] = (cb->fChecksum >> 16 ) & 0xFF;
-		b[9] = (cb->fChecksum >> 24 ) & 0xFF;
-		// printf("Sending checksum: %u\n", this->fCheckSum );
-		SendMsg(b, sizeof b);
+	if (fMeshObject != fChunkObject && !fUploadRequested) {
+		// It may be that this->fScheduledForComputation or this->fScheduledForLoading is true, but it is not a common thing,
+		// so we may as well find something to draw. Until the upload is done, the previous mesh (if any) is used.
+		fUploadRequested = true;
+		sfUploadRequests.push_back(this);
 	}
 
-	if (!fChunkObject)
-		return; // There are no grapical objects to draw.
+	if (fBuffersDefined)
+		DrawMesh(*fMeshObject, fMesh, shader, pickShader, dlType);
+}
 
-	if (!this->fBuffersDefined) {
-		// It may be that this->fScheduledForComputation or this->fScheduledForLoading is true, but it is not a common thing,
-		// so we may as well find something to draw.
-		if (dlType == DL_Picking)
-			this->PrepareOpenGL(0, pickShader, dlType);
-		else
-			this->PrepareOpenGL(shader, 0, dlType);
+View::VertexArena::Range Chunk::UploadMesh(const ChunkObject &co) {
+	// All block types are allocated as one range, and drawn using the first vertex of the block type.
+	GLsizei total = 0;
+	for (int blockType = 1; blockType < 256; blockType++)
+		total += co.VertexSize(blockType);
+	auto mesh = View::gVertexArena.Allocate(total);
+	GLint first = 0;
+	for (int blockType = 1; blockType < 256; blockType++) {
+		int triSize = co.VertexSize(blockType);
+		if (triSize == 0)
+			continue; // No blocks of this type to draw.
+		View::gVertexArena.Upload(mesh, first, triSize, co.fVisibleTriangles[blockType][0].v);
+		first += triSize;
 	}
+	return mesh;
+}
 
+void Chunk::DrawMesh(const ChunkObject &co, const View::VertexArena::Range &mesh, StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type dlType) {
+	if (!mesh.Valid())
+		return; // Only special objects in this chunk
+	View::gVertexArena.BindVertexArray(mesh.fArena, dlType == DL_Picking ? pickShader : 0);
+	GLint first = mesh.fFirst;
 	for (int blockType = 1; blockType < 256; blockType++) {
-		int triSize = fChunkObject->VertexSize(blockType);
+		int triSize = co.VertexSize(blockType);
 		if (triSize == 0)
 			continue; // No blocks of this type to draw.
+		first += triSize; // Start of next block type
 		if (Model::ChunkBlocks::blockIsSemiTransp(blockType) && dlType == DL_NoTransparent)
 			continue;
 		if (!Model::ChunkBlocks::blockIsSemiTransp(blockType) && dlType == DL_OnlyTransparent)
@@ -331,8 +369,7 @@ void Chunk::Draw(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type
 		}
 
 		glBindTexture(GL_TEXTURE_2D, BlockTypeTotextureId[blockType]);
-		glBindVertexArray(fVao[blockType]);
-		glDrawArrays(GL_TRIANGLES, 0, triSize);
+		glDrawArrays(GL_TRIANGLES, first - triSize, triSize);
 		gNumDraw++;
 		gDrawnQuads += triSize/3;
 		if (dlType == DL_OnlyTransparent && (blockType == BT_Water || blockType == BT_BrownWater)) {
@@ -344,21 +381,22 @@ void Chunk::Draw(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type
 }
 
 void Chunk::DrawObjects(StageOneShader *shader, int dx, int dy, int dz, bool forShadows) const {
-	if (!fChunkObject)
+	if (!fBuffersDefined)
 		return; // Nothing to show yet
 
 	// Create the offset in OpenGL coordinates
 	glm::vec3 offset(dx*CHUNK_SIZE + 0.5f, dz*CHUNK_SIZE, - dy*CHUNK_SIZE - 0.5f);
 
-	fChunkObject->DrawTrees(shader, offset, forShadows);
+	// The instance buffer belongs to the mesh object
+	fMeshObject->DrawTrees(shader, offset, forShadows, fInstanceBuffer);
 
 	if (forShadows)
 		return; // Skip the rest of the objects
 
-	fChunkObject->FindSpecialObjects(offset, 12.0f);
-	fChunkObject->FindFogs(offset);
-	fChunkObject->DrawLamps(shader, offset);
-	fChunkObject->DrawTreasures(shader, offset);
+	fMeshObject->FindSpecialObjects(offset, 12.0f);
+	fMeshObject->FindFogs(offset);
+	fMeshObject->DrawLamps(shader, offset, fInstanceBuffer);
+	fMeshObject->DrawTreasures(shader, offset, fInstanceBuffer);
 }
 
 Chunk::~Chunk() {
@@ -369,52 +407,28 @@ Chunk::~Chunk() {
 void Chunk::ReleaseOpenGLBuffers(void) {
 	if (!this->fBuffersDefined)
 		return;
-	glDeleteVertexArrays(256, fVao); // A buffer with value 0 is ignored.
-	for (int blockType = 0; blockType < 256; blockType++) {
-		fOpenglBuffers[blockType].Release();
-		fVao[blockType] = 0;
-	}
+	View::gVertexArena.Free(fMesh); // The range is reused a few frames later, when the GPU is done with it.
+	fInstanceBuffer.Release();
+	fMeshObject.reset();
 	this->fBuffersDefined = false;
 }
 
-void Chunk::PrepareOpenGL(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type dlType) {
+void Chunk::PrepareOpenGL(void) {
 	this->ReleaseOpenGLBuffers(); // Release the old buffers, if any.
 	fBuffersDefined = true;
 	// printf("PrepareOpenGL: chunk (%d,%d,%d)\n", this->cc.x, this->cc.y, this->cc.z);
 
-	enum { stride = sizeof(VertexDataf), };
-
 	ASSERT(fChunkObject);
-	for (int blockType = 1; blockType < 256; blockType++) {
-		int triSize = fChunkObject->VertexSize(blockType);
-		if (triSize == 0)
-			continue; // No blocks of this type to draw.
-		glGenVertexArrays(1, &fVao[blockType]);
-		glBindVertexArray(fVao[blockType]);
-		// Can't release vertex buffer, as it may be reused after a call to chunk::ReleaseOpenGLBuffers().
-		// check that data size in VBO is the same as the input array, if not return 0 and delete VBO
-		if (!fOpenglBuffers[blockType].BindArray(triSize * sizeof(VertexDataf), &fChunkObject->fVisibleTriangles[blockType][0])) {
-			checkError("Chunk::PrepareOpenGL data size mismatch");
-			ErrorDialog("Chunk::PrepareOpenGL: Data size %d is mismatch with input array %d\n", fOpenglBuffers[blockType].GetSize(), triSize * sizeof(VertexDataf));
-		}
-
-		switch(dlType) {
-		case DL_Picking:
-			pickShader->EnableVertexAttribArray();
-			// The normals are stored in "char", but they are in practice of type "unsigned char", and we don't
-			// want OpenGL to convert them to signed char.
-			pickShader->NormalAttribPointer(GL_UNSIGNED_BYTE, stride, VertexDataf::GetNormalOffset());
-			pickShader->VertexAttribPointer(GL_SHORT, stride, VertexDataf::GetVertexOffset());
-			break;
-		case DL_NoTransparent:
-		case DL_OnlyTransparent:
-			shader->EnableVertexAttribArray();
-			shader->VertexAttribPointer();
-			break;
-		}
-		// glBindBuffer(GL_ARRAY_BUFFER, 0);  // Deprecated
+	fMeshObject = fChunkObject;
+	fMesh = UploadMesh(*fChunkObject);
+
+	// The instance buffer is not part of any VAO, it is attached to the VAO of the model when drawing.
+	int numInstances = fChunkObject->NumInstanced();
+	const auto &instances = fChunkObject->fSpecialPos;
+	if (numInstances > 0 && !fInstanceBuffer.BindArray(numInstances * sizeof instances[0], &instances[0])) {
+		checkError("Chunk::PrepareOpenGL instance data size mismatch");
+		ErrorDialog("Chunk::PrepareOpenGL: Instance data size %d is mismatch with input array %d\n", fInstanceBuffer.GetSize(), numInstances * sizeof instances[0]);
 	}
-	glBindVertexArray(0);
 }
 
 Chunk::Chunk() {
@@ -424,13 +438,42 @@ Chunk::Chunk() {
 	fDirty = false;
 	fScheduledForComputation = false;
 	fScheduledForLoading = false;
-	for (int i=0; i<256; i++) {
-		fVao[i] = 0;
-	}
+	fAwaitingData = false;
+	fRequestPending = false;
+	fPrefetched = false;
+	fVerifyPending = false;
+	fUploadRequested = false;
 }
 
 Chunk *Chunk::sfBusyList_gl = 0;
 Chunk *Chunk::sfBusyListOld_gl = 0;
+std::vector<Chunk*> Chunk::sfUploadRequests;
+
+void Chunk::UploadRequested_gl(void) {
+	if (sfUploadRequests.empty())
+		return;
+	static WorstTime tm("ChunkUpld");
+	tm.Start();
+	ChunkCoord player_cc;
+	Model::gPlayer.GetChunkCoord(&player_cc);
+	auto dist2 = [&player_cc](const Chunk *cp) {
+		int dx = cp->cc.x - player_cc.x, dy = cp->cc.y - player_cc.y, dz = cp->cc.z - player_cc.z;
+		return dx*dx + dy*dy + dz*dz;
+	};
+	std::sort(sfUploadRequests.begin(), sfUploadRequests.end(), [&dist2](const Chunk *a, const Chunk *b) {
+		return dist2(a) < dist2(b);
+	});
+	size_t start = View::gVertexArena.UploadedThisFrame();
+	for (Chunk *cp : sfUploadRequests) {
+		cp->fUploadRequested = false;
+		if (View::gVertexArena.UploadedThisFrame() - start >= UPLOAD_BUDGET)
+			continue; // Skip the rest, they will be requested again if still visible
+		if (cp->fChunkObject && cp->fChunkObject != cp->fMeshObject)
+			cp->PrepareOpenGL();
+	}
+	sfUploadRequests.clear();
+	tm.Stop();
+}
 
 // Find out what chunks are currently not drawn, and release OpenGL buffers for them
 void Chunk::DegradeBusyList_gl(void) {
@@ -461,7 +504,6 @@ void Chunk::PushTriangles(shared_ptr<const ChunkObject> co) {
 	}
 	fPushedValues = fChunkObject;
 	fChunkObject = co;
-	this->ReleaseOpenGLBuffers();
 }
 
 void Chunk::PopTriangles(void) {
@@ -469,7 +511,6 @@ void Chunk::PopTriangles(void) {
 	if (!fPushedValues) {
 		ErrorDialog("Chunk::PopTriangles: Pop without a push first");
 	}
-	this->ReleaseOpenGLBuffers();
 	fChunkObject = fPushedValues;
 	fPushedValues.reset();
 }
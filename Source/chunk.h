@@ -19,11 +19,13 @@
 
 #include <GL/glew.h>
 #include <memory>
+#include <vector>
 
 #include "render.h"
 #include "ChunkBlocks.h"
 #include "ChunkObject.h"
 #include "OpenglBuffer.h"
+#include "VertexArena.h"
 
 #define CHUNK_SIZE 32
 #define WORLD_HEIGHT 8 // World height measured in chunks
@@ -160,18 +162,25 @@ public:
 
 	bool fScheduledForComputation;
 	bool fScheduledForLoading;
+	bool fAwaitingData;    // True until the chunk data has been received from the server
+	bool fRequestPending;  // True while the chunk data is requested, see ChunkRequests
+	bool fPrefetched;      // Created by the prefetch, and not drawn yet
+	bool fVerifyPending;   // Waiting in ChunkRequests for the checksum to be verified
 
 	/// Information about graphical objects.
 	/// The referenced object is a 'const', as the content must not change asynchronously.
 	shared_ptr<const ChunkObject> fChunkObject;
 
-	/// The actual blocks in the chunk. The content may change asynchronously, so it can't be a const.
+	/// The actual blocks in the chunk. Mesh computations read them from other threads, so changes are done in a
+	/// new version that replaces this one, and the old one is handed over to ChunkProcess::Retire(). See BlockUpdates.
 	shared_ptr<Model::ChunkBlocks> fChunkBlocks;
 
-	/// OpenGL data. One Vertex Array Object for each block type. Usually, only a limited number of the block
-	/// types are needed.
-	OpenglBuffer fOpenglBuffers[256]; // TODO: Use one single buffer
-	GLuint fVao[256];
+	/// OpenGL data. All block types are stored in one range of a shared vertex arena, one after the other.
+	/// The data is created from fMeshObject, which is not always the same as fChunkObject. When a new
+	/// fChunkObject has been computed, the old one is drawn until the new one has been uploaded.
+	View::VertexArena::Range fMesh;
+	shared_ptr<const ChunkObject> fMeshObject;
+	OpenglBuffer fInstanceBuffer; // Offsets of the special objects, used for instanced drawing.
 	bool fBuffersDefined;
 
 	Chunk();
@@ -195,6 +204,10 @@ public:
 	/// Interpret the binary chunk definition and transform it into graphical objects. OpenGL is done elsewhere.
 	void UpdateGraphics(void);
 
+	/// Keep the chunk up to date: compute the graphics if dirty and verify the checksum when needed.
+	/// Done by Draw(), and by the headless mode instead of drawing.
+	void Refresh(void);
+
 	/// Draw the chunk itself
 	void Draw(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type dlType);
 
@@ -205,11 +218,15 @@ public:
 	/// Draw all objects in the chunk. If 'forShadows' is true, skip doing things that shall not be
 	/// used in the shadow map. dx, dy and dz is the relative distance to the player chunk.
 	void DrawObjects(StageOneShader *shader, int dx, int dy, int dz, bool forShadows) const;
-	void PrepareOpenGL(StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type dlType);
+	void PrepareOpenGL(void);
 	void ReleaseOpenGLBuffers(void);
 
 	/// Unload all old chunks, and then move all chunks from the current busy list to the old busy list
 	static void DegradeBusyList_gl(void);
+
+	/// Upload the meshes requested by Draw() this frame, nearest first, until the budget is used up.
+	/// The rest are requested again next time they are drawn.
+	static void UploadRequested_gl(void);
 	void SetDirty(bool flag);             // Update the fDirty flag
 	bool IsDirty(void) const { return fDirty; }
 	static void MakeAllChunksDirty(void); // Force all chunk to be recomputed.
@@ -235,7 +252,13 @@ private:
 	Chunk **fPrev_gl;		// The previous item in the list.
 	static Chunk *sfBusyList_gl; // The linked list of chunks that was used in the last draw operation.
 	static Chunk *sfBusyListOld_gl; // The linked list of chunks with active OpenGL buffers, but not use for drawing currently.
+	bool fUploadRequested;  // True if the chunk is in sfUploadRequests
+	static std::vector<Chunk*> sfUploadRequests; // Chunks where fChunkObject needs to be uploaded
 	shared_ptr<const ChunkObject> fPushedValues;
+
+	// Upload all triangles of a chunk object into one range
+	static View::VertexArena::Range UploadMesh(const ChunkObject &);
+	static void DrawMesh(const ChunkObject &, const View::VertexArena::Range &, StageOneShader *shader, ChunkShaderPicking *pickShader, DL_Type dlType);
 };
 
 }
@@ -245,3 +268,6 @@ private:
 /// the server. The content will be empty for a little while. If 'force' is false, a null pointer
 /// will be returned if the Chunk isn't found.
 extern View::Chunk* ChunkFind(const ChunkCoord *coord, bool force);
+
+/// The number of chunks in memory
+extern size_t ChunkCount(void);
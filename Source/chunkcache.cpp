@@ -155,7 +155,7 @@ void ChunkCache::SaveChunkInCache(const cachunk *chunkdata) {
 	static WorstTime tm("SaveChnkCache");
 	tm.Start();
 
-	unsigned char *buffer = chunkdata->compressedChunk;
+	const unsigned char *buffer = chunkdata->compressedChunk;
 	int len = chunkdata->compressSize;
 
 	char *fileName;
@@ -173,9 +173,7 @@ void ChunkCache::SaveChunkInCache(const cachunk *chunkdata) {
 		WriteChunk.write((char *) &chunkdata->fCheckSum, sizeof(chunkdata->fCheckSum));
 		WriteChunk.write((char *) &chunkdata->fOwner, sizeof(chunkdata->fOwner));
 
-		for( int x=0; x<len; x++) {
-			WriteChunk << buffer[x];
-		}
+		WriteChunk.write((const char *)buffer, len);
 	}
 
 	// printf("Cache: %s\n", fileName);
@@ -217,9 +215,10 @@ std::shared_ptr<Model::ChunkBlocks> ChunkCache::LoadChunkFromCache(const ChunkCo
 		ReadChunk.read((char *) &cachedata->fOwner, sizeof(cachedata->fOwner));
 
 		cachedata->compressSize = size-sizeof(cachedata->flag)-sizeof(cachedata->fChecksum)-sizeof(cachedata->fOwner);
-		cachedata->fCompressedChunk.reset(new unsigned char[cachedata->compressSize]);
+		unsigned char *compressed = new unsigned char[cachedata->compressSize];
+		cachedata->fCompressedChunk.reset(compressed, std::default_delete<unsigned char[]>());
 
-		ReadChunk.read((char*)cachedata->fCompressedChunk.get(), cachedata->compressSize);
+		ReadChunk.read((char*)compressed, cachedata->compressSize);
 		ASSERT(ReadChunk.gcount() == cachedata->compressSize);
 		// printf("Cache load: %s size (%i)\n", fileName, size);
 	}
@@ -41,7 +41,7 @@ public:
 		unsigned int fCheckSum;
 		unsigned long fOwner;
 
-		unsigned char *compressedChunk;
+		const unsigned char *compressedChunk;
 		int compressSize;
 	};
 
@@ -71,6 +71,12 @@
 #define PROT_VER_MAJOR 5 // What major version of the protocol is supported
 #define PROT_VER_MINOR 2 // What minor version of the protocol is supported
 
+// Encodings of the chunk data in CMD_CHUNK_ANSWER, in addition to the default RLE. The client reports supported
+// encodings as a bit mask in a CMD_PROT_VERSION reply. An encoded chunk starts with an empty run (block type 0
+// and count 0), followed by the encoding number.
+#define CHUNK_ENCODING_LZ       1 // The RLE data compressed with LZ77 (LZ4 block format)
+#define CHUNK_ENCODINGS_SUPPORTED (1 << CHUNK_ENCODING_LZ)
+
 // These are the types used by CMD_OBJECT_LIST
 #define ObjTypePlayer 			0
 #define ObjTypeMonster 			1
@@ -23,6 +23,10 @@
 #include <errno.h>
 #include <string.h>
 #include <iostream>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <deque>
 
 #ifdef WIN32
 #include <winsock2.h>
@@ -32,6 +36,17 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#ifdef WIN32
+#include "mythread.h"
+#else
+#include <thread>
+#include <mutex>
 #endif
 
 #include <glm/glm.hpp>
@@ -47,6 +62,9 @@
 #include "crypt.h"
 #include "SoundControl.h"
 #include "errormanager.h"
+#include "ChunkBlocks.h"
+#include "SpscQueue.h"
+#include "Clock.h"
 
 #ifdef WIN32
 static SOCKET sock_fd;
@@ -56,6 +74,76 @@ static int sock_fd;
 
 int gClientAvailMajor, gClientAvailMinor;
 
+// Size of the receive buffer. It must be bigger than the biggest possible message.
+#define RECEIVE_BUFFER_SIZE (256*1024)
+#define MAX_MESSAGE_SIZE (64*1024)
+
+// All available data is read into the receive buffer in one call, and the complete messages are framed
+// directly from the buffer. When there is no room for another message, the partial message at the end
+// is moved to the beginning of the buffer, to be completed by the next read.
+// The compressed data of received chunks refer directly into the buffer. Because of that, a new buffer is
+// allocated if it is still in use when the partial message has to be moved. The receive buffer is only
+// managed by the network thread.
+static std::shared_ptr<unsigned char> sReceiveBuffer;
+static int sReceiveHead = 0; // First byte not yet framed
+static int sReceiveTail = 0; // End of received data
+
+// A message from the server, framed by the network thread
+struct IncomingMessage {
+	std::vector<unsigned char> fData;           // The message without the length, followed by a null byte
+	std::unique_ptr<Model::ChunkBlocks> fChunk; // CMD_CHUNK_ANSWER is pre-parsed by the network thread
+	ChunkCoord fChunkCoord;                     // The coordinate of fChunk
+	std::string fError;                         // An error to report
+	bool fDisconnected = false;                 // The connection is broken
+	double fReceived = 0.0;                     // The time when the network thread received the message
+};
+
+// The queues between the network thread and the main thread
+static SpscQueue<IncomingMessage, 4096> sIncoming;
+static SpscQueue<std::vector<unsigned char>, 4096> sOutgoing;
+
+static std::thread sNetworkThread;
+static std::atomic<bool> sTerminate(false);
+#ifndef WIN32
+static int sWakeupPipe[2] = { -1, -1 };
+#endif
+
+// Messages are collected here by SendMsg(), and handed over to the network thread by FlushMessages().
+static std::vector<unsigned char> sFrameOut;
+
+// Maximum number of buffers sent in one call
+#define MAX_IOVEC 64
+
+// Statistics
+static std::atomic<size_t> sBytesReceived(0); // Updated by the network thread
+static std::atomic<unsigned> sWrites(0);      // Number of write calls, updated by the network thread
+static std::atomic<unsigned> sReceiveBuffers(0); // Number of allocated receive buffers, updated by the network thread
+static unsigned sFlushes = 0;
+static unsigned sSentCount[256];              // Number of messages sent for every command
+static size_t sSentBytes[256];                // Number of bytes sent for every command
+static size_t sMessagesReceived = 0;
+static unsigned sMessagesFrame = 0, sMessagesFrameMax = 0, sFrames = 0;
+static double sLastFrame = -1.0, sLastReport = 0.0;
+static double sMessageReceived = 0.0; // The time when the message being parsed was received
+
+// A recording of the server stream is a file header, followed by one record for every message. A record is
+// the direction, the time in ms since the start of the recording (32 bits, LSB first) and the message itself,
+// starting with the length.
+#define RECORD_RECEIVED 0
+#define RECORD_SENT 1
+static const unsigned char sRecordMagic[8] = { 'E', 'P', 'H', 'R', 'E', 'C', 0, 1 };
+static FILE *sRecordFile = 0;
+static std::mutex sRecordMutex; // Records are added by both the network thread and the main thread
+static double sRecordStart;
+
+// Replaying a recording, instead of using a connection
+static FILE *sReplayFile = 0;
+static bool sReplayFast = false;
+static std::atomic<unsigned> sLoginSent(0); // Number of login commands sent by the client
+
+static void *NetworkThread(void *);
+static void WakeupNetworkThread(void);
+
 void ConnectToServer(const char *host, int port) {
 	struct hostent *server;
 
@@ -113,101 +201,469 @@ void ConnectToServer(const char *host, int port) {
 		auto err = errno;
 		ss << "Failed to connect to server " << err;
 #endif
+		return;
 	}
-}
 
-static std::vector<unsigned char> buff;
+	// The messages are collected and sent together, so there is no need to let the TCP stack delay them.
+	int noDelay = 1;
+	setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, (const char *)&noDelay, sizeof noDelay);
 
-static int ReadBytes(int offset, int n) {
-	static WorstTime tm("LstnSrvrMsgs");
-	tm.Start();
+	// Reading is done without waiting, to get everything available in one call.
 #ifdef WIN32
-	int count = recv(sock_fd, (char *)&buff[offset], n, 0);
+	u_long nonBlocking = 1;
+	ioctlsocket(sock_fd, FIONBIO, &nonBlocking);
 #else
-	int count = read(sock_fd, &buff[offset], n);
+	fcntl(sock_fd, F_SETFL, fcntl(sock_fd, F_GETFL, 0) | O_NONBLOCK);
+	// The pipe is used to wake up the network thread when there is something to send
+	if (pipe(sWakeupPipe) == 0) {
+		fcntl(sWakeupPipe[0], F_SETFL, fcntl(sWakeupPipe[0], F_GETFL, 0) | O_NONBLOCK);
+		fcntl(sWakeupPipe[1], F_SETFL, fcntl(sWakeupPipe[1], F_GETFL, 0) | O_NONBLOCK);
+	}
 #endif
-	tm.Stop();
+	sNetworkThread = std::thread(NetworkThread, (void *)0);
+}
 
-	if (count == 0 || (count<0 && errno == EEXIST)) { // EEXIST can happen on windows if connection is broken
-		gMode.Set(GameMode::ESC);
-		count = 0;
+void CloseServerConnection(void) {
+	if (!sNetworkThread.joinable())
+		return;
+	sTerminate = true;
+	WakeupNetworkThread();
+	sNetworkThread.join();
+	if (sRecordFile) {
+		std::unique_lock<std::mutex> lock(sRecordMutex);
+		fclose(sRecordFile);
+		sRecordFile = 0;
 	}
+	if (sReplayFile) {
+		fclose(sReplayFile);
+		sReplayFile = 0;
+		return; // There was no connection
+	}
+#ifdef WIN32
+	closesocket(sock_fd);
+#else
+	close(sock_fd);
+	close(sWakeupPipe[0]);
+	close(sWakeupPipe[1]);
+#endif
+}
+
+static void Pause(void) {
+#ifdef WIN32
+	Sleep(1);
+#else
+	usleep(1000);
+#endif
+}
+
+static void WakeupNetworkThread(void) {
+#ifndef WIN32
+	if (sWakeupPipe[1] < 0)
+		return; // Replaying, there is no network thread to wake up
+	char c = 0;
+	if (write(sWakeupPipe[1], &c, 1) < 0 && errno != EAGAIN)
+		perror("WakeupNetworkThread");
+#endif
+}
+
+// Read as much as possible. Return the number of bytes, 0 if nothing available and -1 if the connection is broken.
+static int ReadBytes(unsigned char *dest, int n, IncomingMessage &error) {
+#ifdef WIN32
+	int count = recv(sock_fd, (char *)dest, n, 0);
+	bool wouldBlock = count < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	int count = recv(sock_fd, dest, n, 0);
+	bool wouldBlock = count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+
+	if (count == 0 || (count<0 && errno == EEXIST)) // EEXIST can happen on windows if connection is broken
+		return -1;
 	if (count < 0) {
-		if (errno != EAGAIN) {
-			auto &ss = View::gErrorManager.GetStream(true, false);
+		if (!wouldBlock && errno != EINTR) {
+			std::stringstream ss;
 #ifdef WIN32
-			ss << "ListenForServerMessages1: Error " << errno << " length " << count;
+			ss << "ListenForServerMessages1: Error " << WSAGetLastError() << " length " << count;
 #else
 			ss << "ListenForServerMessages1: Error " << errno << "(" << strerror(errno) << "), length" << count;
 #endif
+			error.fError = ss.str();
 		}
 		count = 0; // This is not a fatal error, need to try again
 	}
 	return count;
 }
 
-// We know there is data available to read. Return true if there is a complete message available.
-// Return true, and an empty message, when it is eof.
-// Never do more than one read action, to make sure the read operation never blocks.
-static bool ReadOneMessage(void) {
-	int offset = buff.size();
-	int msgLength = 3;                                // The maximum amount we try to read. No message is smaller than this.
-	if (offset > 2)
-		msgLength = Parseuint16(&buff[0]);            // Info about complete message length is available, try to get it all.
-	buff.resize(msgLength);                           // Prepare as if we succeed to read all we want.
-	int count = ReadBytes(offset, msgLength-offset);
-	buff.resize(offset+count);                        // Adjust to what was actually read
-	if (offset > 2 && offset+count == Parseuint16(&buff[0]))
-		return true;
-	if (count == 0) {
-		// A zero cound indicates end of file, which means connection is down.
-		buff.clear();
-		return true; // An empty message is also complete, sort of
+// Deliver a message to the main thread, waiting if the queue is full. Return false if terminating.
+static bool Deliver(IncomingMessage &&msg) {
+	while (!sIncoming.Push(std::move(msg))) {
+		if (sTerminate)
+			return false;
+		Pause(); // The main thread is behind
 	}
-	return false;
+	return true;
 }
 
-// Listen for a message, and parse it. Return true if there could be more to read.
-bool ListenForServerMessages(void) {
-	// Query the socket to find out if there is anything available to read. Never block!
-	struct timeval timeout;
-	timeout.tv_sec = 0;
-	timeout.tv_usec = 0;
-	int nfds = sock_fd+1;
-	fd_set readfds;
-	FD_ZERO(&readfds);
-	FD_SET(sock_fd, &readfds);
-	int cnt = select(nfds, &readfds, NULL, NULL, &timeout);
-	if (cnt < 0) {
-		if (errno == EINTR)
-			return true;                // "Interrupted system call". Not fatal.
+// Add a message to the recording, if there is one.
+static void Record(unsigned char direction, const unsigned char *msg, int n) {
+	if (sRecordFile == 0)
+		return;
+	unsigned ms = unsigned((GetTime() - sRecordStart) * 1000.0);
+	unsigned char header[5] = { direction, (unsigned char)ms, (unsigned char)(ms >> 8), (unsigned char)(ms >> 16), (unsigned char)(ms >> 24) };
+	std::unique_lock<std::mutex> lock(sRecordMutex);
+	if (sRecordFile == 0)
+		return; // Closed in the meantime
+	fwrite(header, 1, sizeof header, sRecordFile);
+	fwrite(msg, 1, n, sRecordFile);
+}
+
+void StartRecording(const char *fileName) {
+	FILE *f = fopen(fileName, "wb");
+	if (f == 0 || fwrite(sRecordMagic, 1, sizeof sRecordMagic, f) != sizeof sRecordMagic) {
 		auto &ss = View::gErrorManager.GetStream(true, false);
-		ss << "ListenForServerMessages select() failed: errno " << errno;
+		ss << "Failed to create recording " << fileName;
+		if (f)
+			fclose(f);
+		return;
+	}
+	sRecordStart = GetTime();
+	sRecordFile = f;
+}
+
+static std::shared_ptr<unsigned char> NewReceiveBuffer(void) {
+	sReceiveBuffers++;
+	return std::shared_ptr<unsigned char>(new unsigned char[RECEIVE_BUFFER_SIZE], std::default_delete<unsigned char[]>());
+}
+
+// Frame all complete messages in the receive buffer, and deliver them to the main thread.
+// 'received' is the time when the data was read. Return false if the network thread shall stop.
+static bool FrameReceived(double received) {
+	while (sReceiveTail - sReceiveHead >= 2) {
+		unsigned char *msg = sReceiveBuffer.get() + sReceiveHead;
+		int msgLength = Parseuint16(msg);
+		if (msgLength < 3) {
+			IncomingMessage bad;
+			std::stringstream ss;
+			ss << "ListenForServerMessages: Illegal message length " << msgLength;
+			bad.fError = ss.str();
+			bad.fDisconnected = true;
+			Deliver(std::move(bad));
+			return false;
+		}
+		if (sReceiveTail - sReceiveHead < msgLength)
+			break; // Not complete yet
+		Record(RECORD_RECEIVED, msg, msgLength);
+		IncomingMessage m;
+		m.fReceived = received;
+		if (msg[2] == CMD_CHUNK_ANSWER) {
+			// Decode everything that doesn't depend on the state of the main thread. The chunk data is not
+			// copied, it will keep a reference to the receive buffer.
+			m.fChunk = PreParseChunk(std::shared_ptr<const unsigned char>(sReceiveBuffer, msg+3), msgLength-3, &m.fChunkCoord);
+		} else {
+			// Sometimes there is a string. Help with adding a terminating null byte.
+			m.fData.reserve(msgLength-1);
+			m.fData.assign(msg+2, msg+msgLength);
+			m.fData.push_back(0);
+		}
+		sReceiveHead += msgLength;
+		if (!Deliver(std::move(m)))
+			return false;
 	}
-	if (cnt <= 0)
-		return false;                   // Nothing more available for now
-	if (ReadOneMessage()) {
-		if (buff.size() == 0)
-			return false;               // Zero size, the connection is broken.
-		buff.push_back(0);              // Sometimes there is a string. Help with adding a terminating null byte. TODO: Ugly
-		Parse(&buff[2], buff.size()-3); // Exclude the two initial bytes message length and the added 0-byte from the size
-		buff.clear();
+	// Only the network thread can add references to the buffer, so it is safe to test if it is used by someone else.
+	bool inUse = sReceiveBuffer.use_count() > 1;
+	if (sReceiveHead == sReceiveTail && !inUse) {
+		sReceiveHead = sReceiveTail = 0;
+	} else if (RECEIVE_BUFFER_SIZE - sReceiveTail < MAX_MESSAGE_SIZE) {
+		// Move the partial message to the beginning. It is always less than 64 KB.
+		std::shared_ptr<unsigned char> old = sReceiveBuffer; // Keep it until the copy is done
+		if (inUse)
+			sReceiveBuffer = NewReceiveBuffer();
+		memmove(sReceiveBuffer.get(), old.get() + sReceiveHead, sReceiveTail - sReceiveHead);
+		sReceiveTail -= sReceiveHead;
+		sReceiveHead = 0;
 	}
 	return true;
 }
 
-void SendMsg(unsigned char const *b, int n) {
-	static WorstTime tm("SendMsg");
-	tm.Start();
+// The network thread owns the socket. It sends everything queued by SendMsg(), and frames
+// received data into messages for the main thread.
+static void *NetworkThread(void *) {
+	std::deque<std::vector<unsigned char>> out; // Data waiting to be sent, one entry for every flush
+	size_t outOffset = 0;                       // The part of the first entry already sent
+	sReceiveBuffer = NewReceiveBuffer();
+	sReceiveHead = sReceiveTail = 0;
+	while (!sTerminate) {
+		std::vector<unsigned char> msg;
+		while (sOutgoing.Pop(msg))
+			out.push_back(std::move(msg));
+
+		fd_set readfds, writefds;
+		FD_ZERO(&readfds);
+		FD_ZERO(&writefds);
+		FD_SET(sock_fd, &readfds);
+		if (!out.empty())
+			FD_SET(sock_fd, &writefds);
+		int nfds = sock_fd+1;
+		struct timeval timeout;
+		timeout.tv_sec = 0;
 #ifdef WIN32
-	int res = send(sock_fd, (char*)b, n, 0);
+		timeout.tv_usec = 2000; // There is no wake up pipe
 #else
-	int res = write(sock_fd, b, n);
+		timeout.tv_usec = 100000;
+		FD_SET(sWakeupPipe[0], &readfds);
+		if (sWakeupPipe[0] >= nfds)
+			nfds = sWakeupPipe[0]+1;
 #endif
-	tm.Stop();
-	if (res == -1) {
-		perror("write socket");
+		int cnt = select(nfds, &readfds, &writefds, NULL, &timeout);
+		if (cnt < 0) {
+			if (errno == EINTR)
+				continue;                // "Interrupted system call". Not fatal.
+			IncomingMessage m;
+			std::stringstream ss;
+			ss << "ListenForServerMessages select() failed: errno " << errno;
+			m.fError = ss.str();
+			Deliver(std::move(m));
+			Pause();
+			continue;
+		}
+#ifndef WIN32
+		if (FD_ISSET(sWakeupPipe[0], &readfds)) {
+			char buf[64];
+			while (read(sWakeupPipe[0], buf, sizeof buf) > 0)
+				continue;
+		}
+#endif
+		if (FD_ISSET(sock_fd, &writefds)) {
+#ifdef WIN32
+			int res = send(sock_fd, (char*)&out.front()[outOffset], out.front().size()-outOffset, 0);
+#else
+			// Send all buffers in one call
+			struct iovec iov[MAX_IOVEC];
+			int iovcnt = 0;
+			for (auto it = out.begin(); it != out.end() && iovcnt < MAX_IOVEC; it++, iovcnt++) {
+				size_t offset = iovcnt == 0 ? outOffset : 0;
+				iov[iovcnt].iov_base = &(*it)[offset];
+				iov[iovcnt].iov_len = it->size() - offset;
+			}
+			int res = writev(sock_fd, iov, iovcnt);
+#endif
+			if (res > 0) {
+				sWrites++;
+				outOffset += res;
+				// Remove all buffers that are done
+				while (!out.empty() && outOffset >= out.front().size()) {
+					outOffset -= out.front().size();
+					out.pop_front();
+				}
+			} else if (res == -1 && errno != EAGAIN && errno != EINTR) {
+				perror("write socket");
+			}
+		}
+		if (FD_ISSET(sock_fd, &readfds)) {
+			IncomingMessage error;
+			int count = ReadBytes(sReceiveBuffer.get() + sReceiveTail, RECEIVE_BUFFER_SIZE - sReceiveTail, error);
+			if (!error.fError.empty())
+				Deliver(std::move(error));
+			if (count < 0) {
+				// A zero count from recv() indicates end of file, which means connection is down.
+				IncomingMessage m;
+				m.fDisconnected = true;
+				Deliver(std::move(m));
+				break;
+			}
+			sReceiveTail += count;
+			sBytesReceived += count;
+			if (!FrameReceived(GetTime()))
+				break;
+		}
 	}
+	return 0;
+}
+
+// Throw away everything the client wants to send, as there is no server when replaying.
+static void DiscardOutgoing(void) {
+	std::vector<unsigned char> msg;
+	while (sOutgoing.Pop(msg))
+		continue;
+}
+
+// The replay thread takes the place of the network thread. The received messages of the recording are
+// put into the receive buffer, and framed the same way as if they came from the server. Sent messages
+// are not used, except for the login commands. The answers to these can't be delivered until the client
+// has sent them, or the client would be in the wrong mode.
+static void *ReplayThread(void *) {
+	sReceiveBuffer = NewReceiveBuffer();
+	sReceiveHead = sReceiveTail = 0;
+	double begin = GetTime(), start = begin;
+	unsigned loginRecorded = 0, messages = 0;
+	bool broken = false;
+	while (!sTerminate) {
+		DiscardOutgoing();
+		unsigned char header[7]; // Direction, time and message length
+		if (fread(header, 1, sizeof header, sReplayFile) != sizeof header)
+			break; // End of recording
+		double t = (header[1] | header[2] << 8 | header[3] << 16 | unsigned(header[4]) << 24) / 1000.0;
+		int msgLength = Parseuint16(header+5);
+		unsigned char *msg = sReceiveBuffer.get() + sReceiveTail;
+		memcpy(msg, header+5, 2);
+		if (msgLength < 3 || fread(msg+2, 1, msgLength-2, sReplayFile) != size_t(msgLength-2)) {
+			broken = true;
+			break;
+		}
+		if (header[0] == RECORD_SENT) {
+			if (msg[2] != CMD_LOGIN && msg[2] != CMD_RESP_PASSWORD)
+				continue;
+			loginRecorded++;
+			while (sLoginSent < loginRecorded && !sTerminate) {
+				DiscardOutgoing();
+				Pause();
+			}
+			start = GetTime() - t; // The time waiting for the client doesn't count
+			continue;
+		}
+		while (!sReplayFast && GetTime() - start < t && !sTerminate) {
+			DiscardOutgoing();
+			Pause();
+		}
+		sReceiveTail += msgLength;
+		sBytesReceived += msgLength;
+		messages++;
+		if (!FrameReceived(GetTime()))
+			return 0;
+	}
+	if (sTerminate)
+		return 0;
+	printf("Replay: %u messages in %.1f s\n", messages, GetTime() - begin);
+	// End the game the same way as a lost connection
+	IncomingMessage m;
+	if (broken)
+		m.fError = "Replay: broken recording";
+	m.fDisconnected = true;
+	Deliver(std::move(m));
+	return 0;
+}
+
+void ReplayServerMessages(const char *fileName, bool fast) {
+	FILE *f = fopen(fileName, "rb");
+	unsigned char magic[sizeof sRecordMagic];
+	if (f == 0 || fread(magic, 1, sizeof magic, f) != sizeof magic || memcmp(magic, sRecordMagic, sizeof magic) != 0) {
+		auto &ss = View::gErrorManager.GetStream(true, false);
+		ss << "Not a recording: " << fileName;
+		if (f)
+			fclose(f);
+		return;
+	}
+	sReplayFile = f;
+	sReplayFast = fast;
+	sNetworkThread = std::thread(ReplayThread, (void *)0);
+}
+
+double MessageReceivedTime(void) {
+	return sMessageReceived;
+}
+
+// Parse one message received by the network thread. Return true if there could be more to read.
+bool ListenForServerMessages(void) {
+	if (gCurrentFrameTime != sLastFrame) {
+		// First call in a new frame
+		if (sMessagesFrame > sMessagesFrameMax)
+			sMessagesFrameMax = sMessagesFrame;
+		sMessagesFrame = 0;
+		sFrames++;
+		sLastFrame = gCurrentFrameTime;
+	}
+	IncomingMessage msg;
+	if (!sIncoming.Pop(msg))
+		return false; // Nothing more available for now
+	if (!msg.fError.empty()) {
+		auto &ss = View::gErrorManager.GetStream(true, false);
+		ss << msg.fError;
+	}
+	if (msg.fDisconnected) {
+		gMode.Set(GameMode::ESC);
+		return false;
+	}
+	if (msg.fChunk)
+		ParseChunk(msg.fChunkCoord, std::move(msg.fChunk));
+	else if (!msg.fData.empty()) {
+		sMessageReceived = msg.fReceived;
+		Parse(&msg.fData[0], msg.fData.size()-1); // Exclude the added 0-byte from the size
+	}
+	sMessagesReceived++;
+	sMessagesFrame++;
+	return true;
+}
+
+void ReportNetworkStatistics(void) {
+	double now = GetTime();
+	double elapsed = now - sLastReport;
+	if (elapsed <= 0.0 || sFrames == 0)
+		return;
+	size_t bytes = sBytesReceived.exchange(0);
+	printf("Network: received %.1f kB/s, %.1f messages/frame (max %u), %u queued, %u receive buffers allocated\n", bytes/1024.0/elapsed,
+	       double(sMessagesReceived)/sFrames, sMessagesFrameMax, sIncoming.Size(), sReceiveBuffers.exchange(0));
+	unsigned sent = 0;
+	size_t sentBytes = 0;
+	std::stringstream ss;
+	for (int cmd=0; cmd<256; cmd++) {
+		if (sSentCount[cmd] == 0)
+			continue;
+		ss << " " << cmd << ":" << sSentCount[cmd] << "/" << sSentBytes[cmd] << "B";
+		sent += sSentCount[cmd];
+		sentBytes += sSentBytes[cmd];
+		sSentCount[cmd] = 0;
+		sSentBytes[cmd] = 0;
+	}
+	printf("Network: sent %u messages (%.1f kB) in %u flushes and %u writes. Command:count/bytes%s\n",
+	       sent, sentBytes/1024.0, sFlushes, sWrites.exchange(0), ss.str().c_str());
+	sFlushes = 0;
+	sMessagesReceived = 0;
+	sMessagesFrameMax = 0;
+	sFrames = 0;
+	sLastReport = now;
+}
+
+// Return true for commands that are not urgent, and are often sent in big numbers. These are
+// sent at the end of the frame.
+static bool Deferrable(unsigned char cmd) {
+	switch(cmd) {
+	case CMD_READ_CHUNK:
+	case CMD_VRFY_CHUNK_CS:
+	case CMD_VRFY_SUPERCHUNCK_CS:
+	case CMD_REQ_PLAYER_INFO:
+	case CMD_SET_DIR:
+		return true;
+	}
+	return false;
+}
+
+void SendMsg(unsigned char const *b, int n, bool flush) {
+	if (n >= 3) {
+		sSentCount[b[2]]++;
+		sSentBytes[b[2]] += n;
+		if (b[2] == CMD_LOGIN || b[2] == CMD_RESP_PASSWORD)
+			sLoginSent++;
+	}
+	Record(RECORD_SENT, b, n);
+	sFrameOut.insert(sFrameOut.end(), b, b+n);
+	// Everything collected so far is sent together with a command that can't wait, to keep the order.
+	if (flush || n < 3 || !Deferrable(b[2]))
+		FlushMessages();
+}
+
+void FlushMessages(void) {
+	if (sFrameOut.empty())
+		return;
+	static WorstTime tm("FlushMsgs");
+	tm.Start();
+	// The network thread does the actual sending.
+	sFlushes++;
+	while (!sOutgoing.Push(std::move(sFrameOut))) {
+		WakeupNetworkThread();
+		Pause(); // The network thread is behind
+	}
+	sFrameOut.clear(); // The moved vector is in a valid but unspecified state
+	WakeupNetworkThread();
+	tm.Stop();
 }
 
 static void LoginMessage(const char *id) {
@@ -261,7 +717,7 @@ static void Password(const char *pass, const char *key) {
 
 bool PerformLoginProcedure(const string &email, const string &licencekey, const string &password, bool testOverride) {
 	// Wait for acknowledge from server (in the form of a protocol command)
-	auto beginTime = glfwGetTime();
+	auto beginTime = GetTime();
 	if (gMode.Get() != GameMode::LOGIN) {
 		auto &ss = View::gErrorManager.GetStream(true, false);
 		ss << "Login in wrong state " << gMode.Get();
@@ -271,8 +727,9 @@ bool PerformLoginProcedure(const string &email, const string &licencekey, const
 	LoginMessage(testOverride ? "test0" : email.c_str());
 	gMode.Set(GameMode::PASSWORD);
 	while (gMode.Get() != GameMode::GAME) {
-		glfwSleep(0.01); // Avoid a busy wait
-		ListenForServerMessages(); // Wait for automatic login without password
+		SleepSeconds(0.01); // Avoid a busy wait
+		while (ListenForServerMessages() && gMode.Get() != GameMode::REQ_PASSWD) // Wait for automatic login without password
+			continue;
 		switch (gMode.Get()) {
 		case GameMode::PASSWORD:
 		case GameMode::WAIT_ACK:
@@ -301,7 +758,7 @@ bool PerformLoginProcedure(const string &email, const string &licencekey, const
 			exit(1);
 		}
 	}
-	double connectionDelay = glfwGetTime() - beginTime;
+	double connectionDelay = GetTime() - beginTime;
 	if (connectionDelay > 0.5 && gDebugOpenGL)
 		printf("PerformLoginProcedure connection delay %f\n", connectionDelay);
 	unsigned char b[] = { 0x03, 0x00, CMD_GET_COORDINATE }; // GET_COORDINATE
@@ -24,11 +24,34 @@ using std::string;
 // The major and minor version of the available client
 extern int gClientAvailMajor, gClientAvailMinor;
 
+// Connect, and start the network thread
 extern void ConnectToServer(const char *host, int port);
 
+// Save all messages received from and sent to the server in a file, to be used by ReplayServerMessages().
+extern void StartRecording(const char *fileName);
+
+// Instead of connecting to a server, feed the received messages of a recording to the client. The original
+// timing is used, unless 'fast' is true. Messages sent by the client are thrown away.
+extern void ReplayServerMessages(const char *fileName, bool fast);
+
+// Stop the network thread, and close the connection
+extern void CloseServerConnection(void);
+
+// Parse the next message received by the network thread. Return false if there are no more messages.
 extern bool ListenForServerMessages(void);
 
-extern void SendMsg(const unsigned char *b, int n);
+// The time when the message being parsed was received by the network thread
+extern double MessageReceivedTime(void);
+
+// Print the amount of received data and messages since last call
+extern void ReportNetworkStatistics(void);
+
+// Send a message to the server. Messages that are not urgent are collected, and sent
+// by FlushMessages() at the end of the frame, unless 'flush' is true.
+extern void SendMsg(const unsigned char *b, int n, bool flush = false);
+
+// Send all collected messages. Shall be called once every frame.
+extern void FlushMessages(void);
 
 extern void Password(const unsigned char *key, int len);
 
@@ -71,9 +71,13 @@
 #include "timemeasure.h"
 #include "worsttime.h"
 #include "ChunkProcess.h"
+#include "ChunkRequests.h"
+#include "BlockUpdates.h"
 #include "OculusRift.h"
 #include "Debug.h"
 #include "HudTransformation.h"
+#include "VertexArena.h"
+#include "manageanimation.h"
 
 using namespace Controller;
 using View::SoundControl;
@@ -1021,6 +1025,11 @@ void gameDialog::DrawScreen(bool hideGUI) {
 		if (gCurrentFrameTime > prevPrint + 5.0) {
 			WorstTime::Report();
 			TimeMeasure::Report();
+			View::gVertexArena.Report();
+			ReportNetworkStatistics();
+			gChunkRequests.Report();
+			Model::gBlockUpdates.Report();
+			View::ManageAnimation::ReportPoseCache();
 			prevPrint = gCurrentFrameTime;
 		}
 	}
@@ -1031,6 +1040,7 @@ std::unique_ptr<View::RenderTarget> gameDialog::render() {
 	// Clear list of special effects. It will be added again automatically every frame
 	gShadows.Clear();
 	gFogs.Clear();
+	gLightSources.Clear();
 
 	if (first) {
 		gBillboard.InitializeTextures(fShader);
@@ -182,7 +182,30 @@ shared_ptr<Image> loadBMP(const char* filename, bool booleanAlpha) {
 	return std::make_shared<Image>(std::move(pixels2), width, height, format);
 }
 
-shared_ptr<Image> Image::MipMapNextLevel(void) {
+// Conversion from sRGB to linear, as defined for GL_SRGB textures.
+namespace {
+	struct SrgbTable {
+		float linear[256];
+		SrgbTable() {
+			for (int i=0; i<256; i++) {
+				float f = i/255.0f;
+				linear[i] = f <= 0.04045f ? f/12.92f : powf((f+0.055f)/1.055f, 2.4f);
+			}
+		}
+	};
+}
+
+static float SrgbToLinear(unsigned char c) {
+	static const SrgbTable table; // Initialized once, also when images are decoded by more than one thread
+	return table.linear[c];
+}
+
+static unsigned char LinearToSrgb(float f) {
+	f = f <= 0.0031308f ? f*12.92f : 1.055f*powf(f, 1.0f/2.4f) - 0.055f;
+	return (unsigned char)(f*255.0f + 0.5f);
+}
+
+shared_ptr<Image> Image::MipMapNextLevel(bool srgb) {
 	int colorDepth = 4;
 	if (fFormat == GL_BGR || fFormat == GL_RGB)
 		colorDepth = 3;
@@ -191,16 +214,18 @@ shared_ptr<Image> Image::MipMapNextLevel(void) {
 	unique_ptr<unsigned char[]> newPixels(new unsigned char[newWidth * newHeight * colorDepth]);
 	for(int y = 0; y < newHeight; y++) {
 		for(int x = 0; x < newWidth; x++) {
-			// Compute the sumamry of each color channel, as well as the number of pixels with alpha==1
-			int G = 0, R = 0, B = 0, num = 0;
+			// Compute the sumamry of each color channel, as well as the number of pixels with alpha==1.
+			// The average has to be computed in linear space, without losing precision of dark colors.
+			float sum[3] = { 0.0f, 0.0f, 0.0f };
+			int num = 0;
 			for (int sx = x*2; sx < x*2+2; sx++) {
 				for (int sy = y*2; sy < y*2+2; sy++) {
-					if (colorDepth == 3 || pixels[colorDepth * (width * sy + sx) + 3] == 255) {
+					const unsigned char *p = &pixels[colorDepth * (width * sy + sx)];
+					if (colorDepth == 3 || p[3] == 255) {
 						// This pixel was not transparent
 						num++;
-						B += pixels[colorDepth * (width * sy + sx) + 0];
-						G += pixels[colorDepth * (width * sy + sx) + 1];
-						R += pixels[colorDepth * (width * sy + sx) + 2];
+						for (int c = 0; c < 3; c++)
+							sum[c] += srgb ? SrgbToLinear(p[c]) : p[c]/255.0f;
 					}
 				}
 			}
@@ -210,53 +235,20 @@ shared_ptr<Image> Image::MipMapNextLevel(void) {
 			// If 2 texels (50%) are transparent, then use a random
 			if (num == 2 && ((x+y)&1) == 0)
 				makeTransparent = true;
+			unsigned char *dest = &newPixels[colorDepth * (newWidth * y + x)];
 			if (makeTransparent) {
 				// All pixels were transparent. Use black background.
-				newPixels[colorDepth * (newWidth * y + x) + 0] = 0;
-				newPixels[colorDepth * (newWidth * y + x) + 1] = 0;
-				newPixels[colorDepth * (newWidth * y + x) + 2] = 0;
-				newPixels[colorDepth * (newWidth * y + x) + 3] = 0;
+				for (int c = 0; c < colorDepth; c++)
+					dest[c] = 0;
 			} else {
-				B /= num; G /= num; R /= num;
-				newPixels[colorDepth * (newWidth * y + x) + 0] = B;
-				newPixels[colorDepth * (newWidth * y + x) + 1] = G;
-				newPixels[colorDepth * (newWidth * y + x) + 2] = R;
+				for (int c = 0; c < 3; c++) {
+					float average = sum[c] / num;
+					dest[c] = srgb ? LinearToSrgb(average) : (unsigned char)(average*255.0f + 0.5f);
+				}
 				if (colorDepth == 4)
-					newPixels[colorDepth * (newWidth * y + x) + 3] = 255;
+					dest[3] = 255;
 			}
 		}
 	}
 	return std::make_shared<Image>(std::move(newPixels), newWidth, newHeight, fFormat);
 }
-
-void Image::MakeLinear() {
-	int colorDepth = 4;
-	if (fFormat == GL_BGR || fFormat == GL_RGB)
-		colorDepth = 3;
-	for(int y = 0; y < height; y++) {
-		for(int x = 0; x < width; x++) {
-			for(int c = 0; c < 3; c++) {
-				double color = pixels[colorDepth * (width * y + x) + c]/255.0;
-				double newColor = pow(color, 2.2);
-				ASSERT(color >= 0.0 && color <= 1.0);
-				pixels[colorDepth * (width * y + x) + c] = newColor*255;
-			}
-		}
-	}
-}
-
-void Image::MakeNonLinear() {
-	int colorDepth = 4;
-	if (fFormat == GL_BGR || fFormat == GL_RGB)
-		colorDepth = 3;
-	for(int y = 0; y < height; y++) {
-		for(int x = 0; x < width; x++) {
-			for(int c = 0; c < 3; c++) {
-				double color = pixels[colorDepth * (width * y + x) + c]/255.0;
-				double newColor = pow(color, 0.45);
-				ASSERT(color >= 0.0 && color <= 1.0);
-				pixels[colorDepth * (width * y + x) + c] = newColor*255;
-			}
-		}
-	}
-}
@@ -45,12 +45,8 @@ public:
 
 	// Make a new image, which is a scaled down version. 'width' and 'height' must be a factor of 2.
 	// The algorithm only accepts alpha of 0 or 1. Averaging of colors ignore pixels with alpha 0.
-	shared_ptr<Image> MipMapNextLevel(void);
-
-	// Add gama correction to make the image linear
-	void MakeLinear(void);
-
-	void MakeNonLinear(void);
+	// With 'srgb', the colors are averaged in linear space.
+	shared_ptr<Image> MipMapNextLevel(bool srgb);
 };
 
 //Reads a bitmap image from file. With 'booleanAlpha', the alpha will be set to either 0 or 255.
@@ -0,0 +1,281 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <math.h>
+#include <algorithm>
+
+#include "lightclusters.h"
+#include "primitives.h"
+#include "worsttime.h"
+#include "ui/Error.h"
+
+using namespace View;
+
+// Don't bother waking up the worker threads for a few lights.
+#define MIN_LIGHTS_PER_THREAD 32
+
+// The worker threads are mostly waiting, but there is no use for many of them.
+#define MAX_LIGHT_THREADS 4
+
+LightClusters::LightClusters() {
+	fNearDepth = 1.0f;
+	fDepthScale = 1.0f;
+	for (int i=0; i <= NumKinds; i++)
+		fKindStart[i] = 0;
+}
+
+LightClusters::~LightClusters() {
+	this->RequestTerminate();
+	if (fLightTexture != 0)
+		glDeleteTextures(1, &fLightTexture);
+	if (fClusterTexture != 0)
+		glDeleteTextures(1, &fClusterTexture);
+	if (fIndexTexture != 0)
+		glDeleteTextures(1, &fIndexTexture);
+}
+
+void LightClusters::Init(int numThreads) {
+	// The calling thread will also take a share of the work
+	numThreads = std::min(numThreads, MAX_LIGHT_THREADS) - 1;
+	for (int i=0; i < numThreads; i++) {
+		std::thread t(LightClusters::ThreadStatic, this);
+		fThreads.push_back(std::move(t));
+	}
+}
+
+void LightClusters::Clear() {
+	for (int i=0; i < NumKinds; i++)
+		fLights[i].clear();
+}
+
+void LightClusters::Add(Kind kind, const glm::vec3 &pos, float radius, const glm::vec3 &color) {
+	Light l;
+	l.sphere = glm::vec4(pos, radius);
+	l.color = glm::vec4(color, 0.0f);
+	fLights[kind].push_back(l);
+}
+
+static int SliceOf(float depth, float nearDepth, float scale) {
+	if (depth <= nearDepth)
+		return 0;
+	int s = int(log(depth/nearDepth)*scale);
+	return std::min(s, int(LightClusters::Slices-1));
+}
+
+// Convert a normalized device coordinate into a tile
+static int TileOf(float ndc, int tiles) {
+	int t = int((ndc+1.0f)*0.5f*tiles);
+	return std::max(0, std::min(t, tiles-1));
+}
+
+void LightClusters::Build(const glm::mat4 &view, const glm::mat4 &projection, float farDistance) {
+	static WorstTime tm("LightClstr");
+	tm.Start();
+	fNearDepth = 1.0f;
+	if (farDistance < fNearDepth*2.0f)
+		farDistance = fNearDepth*2.0f;
+	fDepthScale = Slices / log(farDistance/fNearDepth);
+
+	// Find the clusters of every light, and sort the lights on kind.
+	fSorted.clear();
+	fBounds.clear();
+	for (int kind=0; kind < NumKinds; kind++) {
+		fKindStart[kind] = fSorted.size();
+		for (const Light &l : fLights[kind]) {
+			float r = l.sphere.w;
+			glm::vec4 v = view * glm::vec4(glm::vec3(l.sphere), 1.0f);
+			float depth = -v.z;
+			if (depth + r <= 0.0f || depth - r > farDistance)
+				continue; // Behind the camera, or too far away
+			Bounds b;
+			b.s0 = SliceOf(depth - r, fNearDepth, fDepthScale);
+			b.s1 = SliceOf(depth + r, fNearDepth, fDepthScale);
+			if (kind == LocalFog)
+				b.s1 = Slices-1; // The fog is also seen on everything behind it.
+			b.x0 = 0; b.x1 = TilesX-1; b.y0 = 0; b.y1 = TilesY-1;
+			if (depth - r > 0.01f) {
+				// The sphere is completely in front of the camera. Project the corners of the bounding box
+				// to find the screen rectangle.
+				glm::vec2 lo(1.0f), hi(-1.0f);
+				for (int i=0; i<8; i++) {
+					glm::vec4 corner = v + glm::vec4(i&1 ? r : -r, i&2 ? r : -r, i&4 ? r : -r, 0.0f);
+					glm::vec4 clip = projection * corner;
+					glm::vec2 ndc = glm::vec2(clip) / clip.w;
+					lo = glm::min(lo, ndc);
+					hi = glm::max(hi, ndc);
+				}
+				if (lo.x > 1.0f || lo.y > 1.0f || hi.x < -1.0f || hi.y < -1.0f)
+					continue; // Outside of the screen
+				b.x0 = TileOf(lo.x, TilesX); b.x1 = TileOf(hi.x, TilesX);
+				b.y0 = TileOf(lo.y, TilesY); b.y1 = TileOf(hi.y, TilesY);
+			}
+			fSorted.push_back(l);
+			fBounds.push_back(b);
+		}
+	}
+	fKindStart[NumKinds] = fSorted.size();
+
+	// Divide the slices between the threads, and bin the lights.
+	int numPartitions = 1;
+	if (!fThreads.empty() && fSorted.size() >= MIN_LIGHTS_PER_THREAD)
+		numPartitions = fThreads.size() + 1;
+	fPartitions.resize(numPartitions);
+	for (int i=0; i < numPartitions; i++) {
+		fPartitions[i].fFirstSlice = Slices*i/numPartitions;
+		fPartitions[i].fLastSlice = Slices*(i+1)/numPartitions;
+	}
+	if (numPartitions > 1) {
+		fMutex.lock();
+		fGeneration++;
+		fPending = numPartitions-1;
+		fNextPartition = 1;
+		fCondLock.notify_all();
+		fMutex.unlock();
+	}
+	this->BinPartition(fPartitions[0]);
+	if (numPartitions > 1) {
+		std::unique_lock<std::mutex> lock(fMutex);
+		while (fPending > 0)
+			fCondDone.wait(lock);
+		lock.unlock();
+	}
+
+	// Concatenate the partitions. The clusters of the partitions are already in order.
+	fClusterStart.clear();
+	fIndices.clear();
+	for (const Partition &p : fPartitions) {
+		unsigned base = fIndices.size();
+		for (size_t i=0; i < p.fStart.size()-1; i++)
+			fClusterStart.push_back(p.fStart[i] + base);
+		fIndices.insert(fIndices.end(), p.fIndices.begin(), p.fIndices.end());
+	}
+	// Add a sentinel cluster, to define the end of the last cluster
+	for (int i=0; i < NumKinds; i++)
+		fClusterStart.push_back(fIndices.size());
+	this->Upload();
+	tm.Stop();
+}
+
+void LightClusters::BinPartition(Partition &p) {
+	const int tiles = TilesX*TilesY;
+	const int numClusters = (p.fLastSlice - p.fFirstSlice)*tiles;
+	// Count the number of lights of each kind in every cluster
+	p.fStart.assign(numClusters*NumKinds+1, 0);
+	for (int kind=0; kind < NumKinds; kind++) {
+		for (int i=fKindStart[kind]; i < fKindStart[kind+1]; i++) {
+			const Bounds &b = fBounds[i];
+			int s0 = std::max(int(b.s0), p.fFirstSlice), s1 = std::min(int(b.s1), p.fLastSlice-1);
+			for (int s=s0; s<=s1; s++) for (int y=b.y0; y<=b.y1; y++) for (int x=b.x0; x<=b.x1; x++) {
+				int cluster = (s-p.fFirstSlice)*tiles + y*TilesX + x;
+				p.fStart[cluster*NumKinds+kind]++;
+			}
+		}
+	}
+	// Convert the counters into start indices
+	unsigned sum = 0;
+	for (auto &c : p.fStart) {
+		unsigned n = c;
+		c = sum;
+		sum += n;
+	}
+	p.fIndices.resize(sum);
+	p.fCursor = p.fStart;
+	for (int kind=0; kind < NumKinds; kind++) {
+		for (int i=fKindStart[kind]; i < fKindStart[kind+1]; i++) {
+			const Bounds &b = fBounds[i];
+			int s0 = std::max(int(b.s0), p.fFirstSlice), s1 = std::min(int(b.s1), p.fLastSlice-1);
+			for (int s=s0; s<=s1; s++) for (int y=b.y0; y<=b.y1; y++) for (int x=b.x0; x<=b.x1; x++) {
+				int cluster = (s-p.fFirstSlice)*tiles + y*TilesX + x;
+				p.fIndices[p.fCursor[cluster*NumKinds+kind]++] = i;
+			}
+		}
+	}
+}
+
+void LightClusters::Upload(void) {
+	if (fLightTexture == 0) {
+		glGenTextures(1, &fLightTexture);
+		glGenTextures(1, &fClusterTexture);
+		glGenTextures(1, &fIndexTexture);
+	}
+	// Empty buffers are not allowed for texture buffers
+	if (fSorted.empty())
+		fSorted.push_back(Light());
+	if (fIndices.empty())
+		fIndices.push_back(0);
+
+	fLightBuffer.BindArray(fSorted.size()*sizeof fSorted[0], &fSorted[0], GL_STREAM_DRAW);
+	fClusterBuffer.BindArray(fClusterStart.size()*sizeof fClusterStart[0], &fClusterStart[0], GL_STREAM_DRAW);
+	fIndexBuffer.BindArray(fIndices.size()*sizeof fIndices[0], &fIndices[0], GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, fLightTexture);
+	fLightBuffer.TexBuffer(GL_RGBA32F);
+	glBindTexture(GL_TEXTURE_BUFFER, fClusterTexture);
+	fClusterBuffer.TexBuffer(GL_RGBA32UI);
+	glBindTexture(GL_TEXTURE_BUFFER, fIndexTexture);
+	fIndexBuffer.TexBuffer(GL_R32UI);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	checkError("LightClusters::Upload");
+}
+
+void LightClusters::BindTextures(int first) const {
+	glActiveTexture(GL_TEXTURE0 + first);
+	glBindTexture(GL_TEXTURE_BUFFER, fLightTexture);
+	glActiveTexture(GL_TEXTURE0 + first + 1);
+	glBindTexture(GL_TEXTURE_BUFFER, fClusterTexture);
+	glActiveTexture(GL_TEXTURE0 + first + 2);
+	glBindTexture(GL_TEXTURE_BUFFER, fIndexTexture);
+	glActiveTexture(GL_TEXTURE0); // Need to restore it or everything will break.
+}
+
+void *LightClusters::ThreadStatic(LightClusters *p) {
+	p->Task();
+	return 0;
+}
+
+// Wait for a new binning job, do the work for one partition, and report when done.
+void LightClusters::Task(void) {
+	std::unique_lock<std::mutex> lock(fMutex); // This will lock the mutex
+	unsigned done = 0; // The threads are created before the first job, but may start after it
+	while(1) {
+		while (!fTerminate && fGeneration == done)
+			fCondLock.wait(lock);
+		if (fTerminate)
+			break;
+		done = fGeneration;
+		Partition &p = fPartitions[fNextPartition++];
+		lock.unlock(); // Unlock the mutex while doing the work
+		this->BinPartition(p);
+		lock.lock();
+		if (--fPending == 0)
+			fCondDone.notify_one();
+	}
+	lock.unlock();
+}
+
+void LightClusters::RequestTerminate(void) {
+	fMutex.lock();
+	fTerminate = true;
+	fCondLock.notify_all();
+	fMutex.unlock();
+	for (auto it = fThreads.begin(); it != fThreads.end(); it++) {
+		if (it->joinable())
+			it->join();
+	}
+	fThreads.clear();
+}
@@ -0,0 +1,140 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#ifdef WIN32
+#include "mythread.h"
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#include "OpenglBuffer.h"
+
+namespace View {
+
+/// @brief Sort all local light effects of a frame into a grid of view frustum clusters
+///
+/// The view frustum is divided into screen tiles, and every tile is divided into depth slices. The slices
+/// are exponentially distributed, as the resolution is needed mostly near the camera. Every light is
+/// added to all clusters that its sphere can affect, and the result is uploaded as texture buffers.
+/// A deferred shader can then find the lights of a pixel by looking up the cluster, instead of drawing
+/// one light volume for every light.
+///
+/// The binning is shared between the calling thread and a small pool of worker threads. Every thread
+/// handles a range of depth slices, which are contiguous in the cluster list, so no locking is needed
+/// on the result.
+class LightClusters {
+public:
+	/// The kind of light effects. The lights of a cluster are sorted in this order.
+	enum Kind { PointLight, ColoredLight, PointShadow, LocalFog, NumKinds };
+
+	enum { TilesX = 16, TilesY = 8, Slices = 24 };
+
+	LightClusters();
+	~LightClusters();
+
+	/// Create the worker threads
+	void Init(int numThreads);
+
+	/// Forget all lights from the previous frame
+	void Clear();
+
+	/// Add a light effect
+	/// @param kind The type of light effect
+	/// @param pos The world coordinate of the center
+	/// @param radius The radius of the sphere that can be affected
+	/// @param color Tint, only used for colored lights
+	void Add(Kind kind, const glm::vec3 &pos, float radius, const glm::vec3 &color = glm::vec3(0.0f));
+
+	/// Bin all lights into clusters, and upload the result. Must be called from the main thread.
+	/// @param view The view matrix
+	/// @param projection The projection matrix
+	/// @param farDistance Depth of the last slice
+	void Build(const glm::mat4 &view, const glm::mat4 &projection, float farDistance);
+
+	/// Bind the texture buffers to texture units 'first' (lights), 'first+1' (clusters) and 'first+2' (light indices).
+	/// Texture unit 0 is active when returning.
+	void BindTextures(int first) const;
+
+	/// Number of lights of the specified kind that were visible in the last Build()
+	int Count(Kind kind) const { return fKindStart[kind+1] - fKindStart[kind]; }
+
+	/// Depth of the first slice. Everything nearer belongs to the first slice.
+	float NearDepth() const { return fNearDepth; }
+
+	/// The slice of a depth is computed as log(depth/NearDepth())*DepthScale()
+	float DepthScale() const { return fDepthScale; }
+
+	void RequestTerminate();
+private:
+	struct Light {
+		glm::vec4 sphere; // Position and radius
+		glm::vec4 color;
+	};
+	std::vector<Light> fLights[NumKinds];
+
+	// The same lights, in kind order, with the cluster bounds computed by Build()
+	struct Bounds {
+		short x0, x1, y0, y1, s0, s1;
+	};
+	std::vector<Light> fSorted;
+	std::vector<Bounds> fBounds;
+	int fKindStart[NumKinds+1];
+
+	float fNearDepth, fDepthScale;
+
+	// The result from one thread, covering the slices [fFirstSlice, fLastSlice)
+	struct Partition {
+		int fFirstSlice = 0, fLastSlice = 0;
+		std::vector<unsigned> fStart;   // First light index of every kind, for every cluster in the partition
+		std::vector<unsigned> fIndices; // Light indices, relative fStart
+		std::vector<unsigned> fCursor;  // Used when filling fIndices
+	};
+	std::vector<Partition> fPartitions;
+
+	// Bin all lights for the slices of one partition
+	void BinPartition(Partition &);
+
+	// The result, uploaded to texture buffers
+	std::vector<unsigned> fClusterStart;
+	std::vector<unsigned> fIndices;
+	OpenglBuffer fLightBuffer, fClusterBuffer, fIndexBuffer;
+	GLuint fLightTexture = 0, fClusterTexture = 0, fIndexTexture = 0;
+	void Upload(void);
+
+	std::condition_variable fCondLock;       // Used to start the worker threads
+	std::condition_variable fCondDone;       // Used to signal that a worker thread is done
+	std::mutex fMutex;                       // The mutex used for locking
+	std::vector<std::thread> fThreads;       // The worker threads
+	static void *ThreadStatic(LightClusters *p);
+	void Task(void);
+
+	// The following variables must be guarded by 'fMutex'
+	bool fTerminate = false;
+	unsigned fGeneration = 0; // Incremented for every new binning job
+	int fPending = 0;         // Number of worker threads not yet done with the current job
+	int fNextPartition = 0;   // Used by worker threads to find their partition
+};
+
+}
@@ -48,6 +48,7 @@
 #include "DrawText.h"
 #include "shaders/ChunkShader.h"
 #include "shaders/ChunkShaderPicking.h"
+#include "shaders/shader.h"
 #include "primitives.h"
 #include "client_prot.h"
 #include "player.h"
@@ -57,8 +58,13 @@
 #include "SoundControl.h"
 #include "TSExec.h"
 #include "chunkcache.h"
+#include "TextureCache.h"
+#include "StartupJobs.h"
 #include "ChunkProcess.h"
+#include "ChunkRequests.h"
+#include "BlockUpdates.h"
 #include "manageanimation.h"
+#include "animationmodels.h"
 #include "monsters.h"
 #include "uniformbuffer.h"
 #include "billboard.h"
@@ -68,6 +74,9 @@
 #include "OculusRift.h"
 #include "Debug.h"
 #include "shaders/BarrelDistortion.h"
+#include "VertexArena.h"
+#include "Clock.h"
+#include "Headless.h"
 
 #ifndef GL_VERSION_3_2
 #define GL_CONTEXT_CORE_PROFILE_BIT       0x00000001
@@ -238,6 +247,16 @@ static int sOculusRiftMode = 0;
 static int sCalibrateFlag = 0;
 static int sWindowedMode = 0; // Override settings
 
+// Record the server stream, or replay a recording instead of connecting
+static const char *sRecordFile = 0;
+static const char *sReplayFile = 0;
+static int sReplayFast = 0;
+
+// Run without graphics, for benchmarking. Stop after a duration (seconds), if not 0.
+static int sHeadless = 0;
+static int sWalk = 0;
+static double sDuration = 0.0;
+
 const char *sGameDataDirArg = "gamedata";
 static struct option long_options[] = {
 	/* These options set a flag. */
@@ -251,6 +270,12 @@ static struct option long_options[] = {
 	{sGameDataDirArg,		required_argument, NULL, 0},
 	{ "calibrate",	no_argument, &sCalibrateFlag, 1},
 	{ "windowed",	no_argument, &sWindowedMode, 1},
+	{ "record",		required_argument, NULL, 0},
+	{ "replay",		required_argument, NULL, 0},
+	{ "replayfast",	no_argument, &sReplayFast, 1},
+	{ "headless",	no_argument, &sHeadless, 1},
+	{ "duration",	required_argument, NULL, 0},
+	{ "walk",		no_argument, &sWalk, 1},
 	{0, 0, 0, 0}
 };
 
@@ -260,7 +285,15 @@ int main(int argc, char** argv) {
 #else
 	LPLogFile("/tmp/ephenation.log");
 #endif
-	if (!glfwInit()) {
+	// GLFW can't be initialized without a display, so this has to be known before parsing the options.
+	bool headless = false;
+	for (int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "--headless") == 0)
+			headless = true;
+	}
+	if (headless)
+		UseSystemClock();
+	if (!glfwInit() && !headless) {
 		ErrorDialog("Failed to initialize GLFW\n");
 		exit(EXIT_FAILURE);
 	}
@@ -317,9 +350,17 @@ int main(int argc, char** argv) {
 			int chdirSuccess = chdir(optarg);
 			ASSERT(chdirSuccess == 0);
 		}
+		if (strcmp(long_options[option_index].name, "record") == 0)
+			sRecordFile = optarg;
+		if (strcmp(long_options[option_index].name, "replay") == 0)
+			sReplayFile = optarg;
+		if (strcmp(long_options[option_index].name, "duration") == 0)
+			sDuration = atof(optarg);
 	}
 	if (optind < argc)
 		host = argv[optind];
+	if (sReplayFile)
+		host = "replay"; // Use a cache of its own
 #ifdef WIN32
 	if (!gDebugOpenGL && !gVerbose)
 		FreeConsole();
@@ -349,6 +390,13 @@ int main(int argc, char** argv) {
 #endif
 
 	ChunkCache::fgChunkCache.SetCacheDir(cachePath);
+#ifdef WIN32
+	TextureCache::fgTextureCache.SetCacheDir(dataDir + "\\texturecache\\");
+	ShaderBase::SetCacheDir(dataDir + "\\shadercache\\");
+#else
+	TextureCache::fgTextureCache.SetCacheDir(dataDir + "/texturecache/");
+	ShaderBase::SetCacheDir(dataDir + "/shadercache/");
+#endif
 
 	//LPLOG("Game Path: %s", dataDir);
 
@@ -381,9 +429,12 @@ int main(int argc, char** argv) {
 	}
 	glswInit();
 	glswSetPath("shaders/", ".glsl");
-	ConnectToServer(host, port);
-	View::gSoundControl.Init();
-	TSExec::gTSExec.Init(); // This must be called after initiating gSoundControl.
+	if (sRecordFile)
+		StartRecording(sRecordFile);
+	if (sReplayFile)
+		ReplayServerMessages(sReplayFile, sReplayFast != 0);
+	else
+		ConnectToServer(host, port);
 
 	if (gDebugOpenGL)
 		LPLOG("Number of threads: %d", maxThreads);
@@ -392,6 +443,23 @@ int main(int argc, char** argv) {
 		numChunkProc = 1;
 	gChunkProcess.Init(numChunkProc);
 
+	if (sHeadless) {
+		Model::gPlayer.fTestPlayer = true;
+		Controller::RunHeadless(sDuration, sWalk != 0);
+		unsigned char b[] = { 0x03, 0x00, CMD_QUIT };
+		SendMsg(b, sizeof b);
+		gChunkProcess.RequestTerminate();
+		double timer = GetTime();
+		while (gMode.Get() == GameMode::GAME && GetTime() - timer < 2.0) {
+			SleepSeconds(0.1); // Avoid a busy wait
+			while (ListenForServerMessages()) // Wait for acknowledge
+				continue;
+			FlushMessages();
+		}
+		CloseServerConnection();
+		return 0;
+	}
+
 	//glfwOpenWindowHint(GLFW_OPENGL_VERSION_MAJOR, 3);
 	//glfwOpenWindowHint(GLFW_OPENGL_VERSION_MINOR, 3);
 	glfwOpenWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, gDebugOpenGL);
@@ -451,20 +519,40 @@ int main(int argc, char** argv) {
 
 	ComputeRelativeChunksSortedDistances();
 
-	View::ManageAnimation::InitModels();
-
 	Model::gPlayer.loginOk = true;
-	gUniformBuffer.Init();
-	gDrawFont.Init("textures/georgia12"); // Must be done before gGameDialog.
-	GameTexture::Init();
-	Controller::gGameDialog.init(sOculusRiftMode);
-	if (sCalibrateFlag)
-		Controller::gGameDialog.CalibrateMode(Controller::gameDialog::Calibration::Factor);
-	gChunkShaderPicking.Init();
-	Tree::InitStatic();
-	gLantern.Init(true);
-	gQuadStage1.Init();
-	gBillboard.Init();
+
+	// Load all assets. Files are decoded by worker threads, while OpenGL and OpenAL objects are created by this thread.
+	StartupJobs jobs;
+	int sound = jobs.Add("Sound", nullptr, [] { View::gSoundControl.Init(); });
+	jobs.Add("Sound buffers", [] { View::gSoundControl.LoadBuffers(); }, [] {
+		View::gSoundControl.InitBuffers();
+		TSExec::gTSExec.Init(); // This must be called after initiating gSoundControl.
+	}, { sound });
+	int models = jobs.Add("Models", View::ManageAnimation::LoadModels, View::ManageAnimation::InitModels);
+	int animationModels = jobs.Add("Animation models", View::AnimationModels::Load, nullptr, { models }); // Uses the same model files
+	int uniformBuffer = jobs.Add("Uniform buffer", nullptr, [] { gUniformBuffer.Init(); });
+	int font = jobs.Add("Font", nullptr, [] { gDrawFont.Init("textures/georgia12"); }, { uniformBuffer }); // Must be done before gGameDialog.
+	// The textures are the biggest part, and are decoded by all workers.
+	std::vector<int> textureParts;
+	for (unsigned i=0; i<maxThreads; i++)
+		textureParts.push_back(jobs.Add("Texture files", [i, maxThreads] { GameTexture::Load(i, maxThreads); }, nullptr));
+	int textures = jobs.Add("Textures", nullptr, GameTexture::Init, textureParts);
+	int dialog = jobs.Add("Dialog and shaders", nullptr, [] {
+		Controller::gGameDialog.init(sOculusRiftMode);
+		if (sCalibrateFlag)
+			Controller::gGameDialog.CalibrateMode(Controller::gameDialog::Calibration::Factor);
+	}, { models, animationModels, font, textures });
+	jobs.Add("Trees", Tree::CreateStatic, Tree::InitStatic);
+	jobs.Add("Shapes", nullptr, [] {
+		gChunkShaderPicking.Init();
+		gLantern.Init(true);
+		gQuadStage1.Init();
+		gBillboard.Init();
+	}, { dialog });
+	jobs.Run(maxThreads);
+	View::ManageAnimation::ReleasePreloaded();
+	if (gVerbose)
+		jobs.Report();
 
 	View::gSoundControl.RequestMusicMode(View::SoundControl::SMusicModeMenu);
 	glEnable(GL_DEPTH_TEST); // Always enabled by default
@@ -477,18 +565,22 @@ int main(int argc, char** argv) {
 	if (sTestUser)
 		Model::gPlayer.fTestPlayer = true;
 
+	// A replay has to log in automatically, to get the recorded answers from the server.
+	bool autoLogin = sTestUser || sReplayFile;
+
 	// Last thing before starting the game, update the save copy of the options.
 	Options::sfSave = gOptions;
 	while(glfwGetWindowParam(GLFW_OPENED)) {
 		while (ListenForServerMessages())
 			continue;
-		if (sTestUser && gMode.Get() == GameMode::LOGIN) {
+		Model::gBlockUpdates.Apply(); // All block updates received this frame
+		if (autoLogin && gMode.Get() == GameMode::LOGIN) {
 			PerformLoginProcedure("", "", "", true);
-			sTestUser = false; // Try this only once
+			autoLogin = false; // Try this only once
 		}
 		static WorstTime tm(" Mainloop");
 		tm.Start();
-		gCurrentFrameTime = glfwGetTime();
+		gCurrentFrameTime = GetTime();
 		if (gShowPing && gCurrentFrameTime - gLastPing > 5.0) {
 			// It was a request, so we need to send a response
 			unsigned char msg[4];
@@ -496,17 +588,18 @@ int main(int argc, char** argv) {
 			msg[1] = 0;
 			msg[2] = CMD_PING;
 			msg[3] = 0; // 0 means request, 1 means response
+			gLastPing = GetTime();
 			SendMsg(msg, sizeof msg);
-			gLastPing = gCurrentFrameTime;
-			gCurrentPing = 0.0;
-			// Use a busy wait for the response, no time must be lost
-			while (gCurrentPing == 0.0 && glfwGetTime() - gLastPing < 0.5)
-				ListenForServerMessages();
+			// The response is timed by the network thread, and parsed in a later frame
 		}
 
 		Controller::gGameDialog.DrawScreen(sHideGUI);
 
+		View::Chunk::UploadRequested_gl();
 		View::Chunk::DegradeBusyList_gl();
+		gChunkRequests.Poll();
+		FlushMessages(); // Send the requests collected during the frame
+		View::gVertexArena.EndFrame();
 
 		if (gMode.Get() == GameMode::ESC) {
 			if (gDebugOpenGL)
@@ -533,12 +626,14 @@ int main(int argc, char** argv) {
 	// Wait for ack from server, but not indefinitely
 	while (gMode.Get() == GameMode::GAME && glfwGetTime() - timer < 2.0) {
 		glfwSleep(0.1); // Avoid a busy wait
-		ListenForServerMessages(); // Wait for acknowledge
+		while (ListenForServerMessages()) // Wait for acknowledge
+			continue;
 	}
 
 	if (gMode.Get() == GameMode::GAME) {
 		LPLOG("Failed to disconnect from server");
 	}
+	CloseServerConnection();
 
 	// The options will be saved by the destructor.
 	Options::sfSave.fViewingDistance = maxRenderDistance;
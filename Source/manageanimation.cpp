@@ -15,44 +15,44 @@
 // along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
 //
 
-#define ASSIMP3
-
 /// @class ManageAnimation
 /// This is probably the most complicated part of the Ephenation client. One reason
 /// is that model and animation data in Assimp is complex. Another is that the data
 /// has to be converted to a local representation optimized for drawing using a shader.
 /// At first glance, it may look as if Assimp is unecessaery complex. But the data is
 /// really needed, and it has to be organized they way it is. There is a reason for it.
+/// The import with Assimp is done by ModelFile, which can also load a baked model.
 ///
 /// See http://ephenationopengl.blogspot.de/2012/06/doing-animations-in-opengl.html
 ///
 
-#ifdef ASSIMP3
-    #include <assimp/Importer.hpp>
-    #include <assimp/scene.h>       // Output data structure
-    #include <assimp/postprocess.h>
-#else
-    #include <assimp/assimp.hpp>      // C++ importer interface
-    #include <assimp/aiScene.h>       // Output data structure
-    #include <assimp/aiPostProcess.h> // Post processing flags
-#endif
-
 #include <stdio.h>
 #include <GL/glew.h>
 #include <map>
 #include <vector>
+#include <algorithm>
 #include <math.h>
+
+#ifdef WIN32
+#include "mythread.h"
+#else
+#include <mutex>
+#endif
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include "manageanimation.h"
+#include "ModelFile.h"
 #include "shaders/ChunkShader.h"
 #include "shaders/AnimationShader.h"
+#include "shaders/AnimationInstancedShader.h"
 #include "assert.h"
 #include "ui/Error.h"
 #include "primitives.h"
 #include "textures.h"
+#include "Clock.h"
 
 using namespace View;
 
@@ -81,11 +81,22 @@ struct ManageAnimation::Animation {
 	int numKeys;
 	double keysPerSecond;
 	double duration;                  // Number of ticks
+	// The key frames decomposed into rotation, translation and uniform scale, if that is possible. For each key,
+	// there are 8 arrays (quaternion x, y, z, w, translation x, y, z and scale) with one float for each joint.
+	std::unique_ptr<float[]> keyData;
 };
 
+#define POSE_TIME_QUANTUM 0.005 // The resolution of the animation time for cached poses
+#define POSE_DEATH_STEPS 256    // The resolution of the death transformation
+#define POSE_CACHE_SIZE 16      // Initial number of poses for each model and frame
+
+static unsigned sPosesComputed, sPosesReused;
+static double sPoseTime; // Time spent computing poses
+
 ManageAnimation View::gSwordModel1, View::gTuftOfGrass, View::gFrog, View::gMorran, View::gAlien;
 
-ManageAnimation::ManageAnimation() : fRotateXCorrection(0.0f), fNumMeshes(0) {
+ManageAnimation::ManageAnimation() : fRotateXCorrection(0.0f), fNumMeshes(0), fPoseCacheUsed(0), fPoseCacheFrame(-1.0),
+	fPaletteTexture(0), fPaletteFrame(-1.0), fPalettePoses(0) {
 	fVao = 0;
 	fUsingBones = false;
 }
@@ -95,286 +106,144 @@ ManageAnimation::~ManageAnimation() {
 	if (glDeleteVertexArrays != 0) {
 		glDeleteVertexArrays(1, &fVao);
 	}
+	if (fPaletteTexture != 0)
+		glDeleteTextures(1, &fPaletteTexture);
 }
 
-static void CopyaiMat(const aiMatrix4x4 *from, glm::mat4 &to) {
-	// OpenGL (and glm) uses column major order, but Assimp uses row major order.
-	to[0][0] = from->a1; to[1][0] = from->a2; to[2][0] = from->a3; to[3][0] = from->a4;
-	to[0][1] = from->b1; to[1][1] = from->b2; to[2][1] = from->b3; to[3][1] = from->b4;
-	to[0][2] = from->c1; to[1][2] = from->c2; to[2][2] = from->c3; to[3][2] = from->c4;
-	to[0][3] = from->d1; to[1][3] = from->d2; to[2][3] = from->d3; to[3][3] = from->d4;
+// Decompose a matrix into rotation, translation and a uniform scale. Return false if there is a non uniform
+// scaling, shear, mirroring or projection.
+static bool Decompose(const glm::mat4 &m, glm::quat &q, glm::vec3 &t, float &s) {
+	if (m[0][3] != 0.0f || m[1][3] != 0.0f || m[2][3] != 0.0f || m[3][3] != 1.0f)
+		return false;
+	glm::vec3 c0(m[0]), c1(m[1]), c2(m[2]);
+	float s0 = glm::length(c0), s1 = glm::length(c1), s2 = glm::length(c2);
+	s = (s0 + s1 + s2) / 3.0f;
+	const float eps = 1e-3f;
+	if (s == 0.0f || fabsf(s0-s) > eps*s || fabsf(s1-s) > eps*s || fabsf(s2-s) > eps*s)
+		return false;
+	if (fabsf(glm::dot(c0, c1)) > eps*s*s || fabsf(glm::dot(c0, c2)) > eps*s*s || fabsf(glm::dot(c1, c2)) > eps*s*s)
+		return false;
+	glm::mat3 rot(c0/s, c1/s, c2/s);
+	if (glm::determinant(rot) < 0.0f)
+		return false;
+	q = glm::quat_cast(rot);
+	t = glm::vec3(m[3]);
+	return true;
 }
 
-void NormalizeWeights(glm::vec3 &w, int n) {
-	if (n == 0)
-		return;
-	float sum = 0;
-	for (int i=0; i<n; i++)
-		sum += w[i];
-	for (int i=0; i<n; i++)
-		w[i] /= sum;
-}
-
-static void CopyaiQuat(glm::mat4 &dest, const aiQuaternion &quat) {
-	glm::quat q(quat.w, quat.x, quat.y, quat.z);
-	dest = glm::mat4_cast(q);
-}
-
-static void PrintMatrix(int indent, const glm::mat4 &mat) {
-	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][0], mat[1][0], mat[2][0], mat[3][0]);
-	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][1], mat[1][1], mat[2][1], mat[3][1]);
-	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][2], mat[1][2], mat[2][2], mat[3][2]);
-	printf("%*s%5.2f %5.2f %5.2f %5.2f\n", indent, "", mat[0][3], mat[1][3], mat[2][3], mat[3][3]);
+// Blend two decomposed key frames, with 'n' joints each, and produce the joint matrices. The blending
+// is done on plain arrays of floats, where the compiler can use vector instructions. The quaternions
+// are interpolated linearly and then normalized, which is near enough to a slerp for nearby key frames.
+static void BlendDecomposed(const float *a, const float *b, float w, unsigned n, glm::mat4 *out) {
+	float blend[8*n];
+	for (unsigned i=0; i<8*n; i++)
+		blend[i] = a[i] + (b[i]-a[i])*w;
+	float *qx = blend, *qy = blend+n, *qz = blend+2*n, *qw = blend+3*n;
+	const float *tx = blend+4*n, *ty = blend+5*n, *tz = blend+6*n, *s = blend+7*n;
+	for (unsigned j=0; j<n; j++) {
+		float inv = 1.0f / sqrtf(qx[j]*qx[j] + qy[j]*qy[j] + qz[j]*qz[j] + qw[j]*qw[j]);
+		qx[j] *= inv; qy[j] *= inv; qz[j] *= inv; qw[j] *= inv;
+	}
+	for (unsigned j=0; j<n; j++) {
+		float x = qx[j], y = qy[j], z = qz[j], qs = qw[j], sc = s[j];
+		glm::mat4 &m = out[j];
+		m[0][0] = (1 - 2*(y*y + z*z))*sc; m[0][1] = 2*(x*y + qs*z)*sc;     m[0][2] = 2*(x*z - qs*y)*sc;     m[0][3] = 0;
+		m[1][0] = 2*(x*y - qs*z)*sc;     m[1][1] = (1 - 2*(x*x + z*z))*sc; m[1][2] = 2*(y*z + qs*x)*sc;     m[1][3] = 0;
+		m[2][0] = 2*(x*z + qs*y)*sc;     m[2][1] = 2*(y*z - qs*x)*sc;     m[2][2] = (1 - 2*(x*x + y*y))*sc; m[2][3] = 0;
+		m[3][0] = tx[j];                 m[3][1] = ty[j];                 m[3][2] = tz[j];                 m[3][3] = 1;
+	}
 }
 
-#if 0
-static void PrintQuaternion(int indent, const aiQuaternion &quat) {
-	printf("%*sQuaternion [%.2f,%.2f,%.2f,%.2f]\n", indent, "", quat.x, quat.y, quat.z, quat.w);
+// Blend two matrices, used when the key frames can't be decomposed.
+static void BlendMatrices(const glm::mat4 &a, const glm::mat4 &b, float w, glm::mat4 &out) {
+	const float *pa = &a[0][0], *pb = &b[0][0];
+	float *po = &out[0][0];
+	for (int i=0; i<16; i++)
+		po[i] = pa[i] + (pb[i]-pa[i])*w;
 }
-#endif
 
-// Traverse the node tree, and find the node with the given name.
-static aiNode *FindNode(aiNode *node, const char *name) {
-	if (strcmp(name, node->mName.data) == 0)
-		return node;
-
-	for (unsigned int i=0; i < node->mNumChildren; i++) {
-		aiNode *res = FindNode(node->mChildren[i], name);
-		if (res != 0)
-			return res;
+// Models read in advance by other threads, found from file name and normalize flag. The same model
+// can be used by more than one ManageAnimation.
+static std::mutex sPreloadedMutex;
+static std::map<std::pair<std::string, bool>, std::shared_ptr<const ModelFile> > sPreloaded;
+
+// Read a model file. OpenGL isn't used, so this can be done by any thread.
+// If it failed, there is a description in Error() of the returned model.
+static std::unique_ptr<ModelFile> ReadModel(const char *filename, bool normalize) {
+	// Use a baked model made by modelconverter, if there is one. It is much faster than importing with Assimp.
+	std::string baked = std::string(filename) + ModelFile::BakedSuffix;
+	std::unique_ptr<ModelFile> model(new ModelFile);
+	if (model->Load(baked.c_str(), filename, normalize)) {
+		if (gVerbose)
+			printf("ManageAnimation::Init: Using baked model %s\n", baked.c_str());
+	} else {
+		if (!model->Error().empty())
+			printf("ManageAnimation::Init: %s\n", model->Error().c_str());
+		model->Import(filename, normalize);
 	}
-
-	return 0; // Not found
+	return model;
 }
 
-static glm::mat4 armature(1);
-
-// Print out the complete hierarchical node tree
-static void DumpNodeTree(int level, const aiNode *node) {
-	printf("%*sNode '%s', %d meshes ", level*4, "", node->mName.data, node->mNumMeshes);
-	if (node->mNumMeshes > 0) {
-		printf("(");
-		for (unsigned m = 0; m < node->mNumMeshes; m++)
-			printf("%d ", node->mMeshes[m]);
-		printf(")");
-	}
-	printf("\n");
-
-	// Recursively print children
-	for (unsigned int i=0; i < node->mNumChildren; i++) {
-		DumpNodeTree(level+1, node->mChildren[i]);
-	}
+void ManageAnimation::Preload(const char *filename, bool normalize) {
+	auto key = std::make_pair(std::string(filename), normalize);
+	sPreloadedMutex.lock();
+	bool found = sPreloaded.find(key) != sPreloaded.end();
+	sPreloadedMutex.unlock();
+	if (found)
+		return; // Already read
+	std::shared_ptr<const ModelFile> model = ReadModel(filename, normalize);
+	sPreloadedMutex.lock();
+	sPreloaded.insert(std::make_pair(key, model));
+	sPreloadedMutex.unlock();
 }
 
-// Iterate through the node tree and compute all mesh relative matrices.
-void ManageAnimation::FindMeshTransformations(int level, glm::mat4 *meshmatrix, const glm::mat4 &base, const aiNode *node) {
-	glm::mat4 delta;
-	CopyaiMat(&node->mTransformation, delta);
-	glm::mat4 result = base * delta;
-	if (strcmp(node->mName.data, "Armature") == 0)
-		armature = result;
-	if (gVerbose) {
-		printf("%*sNode '%s' relative\n", level, "", node->mName.data);
-		PrintMatrix(level, delta);
-		printf("%*sGives\n", level, "");
-		PrintMatrix(level, result);
-	}
-
-	// Transform all meshes belonging to this node
-	for (unsigned int i=0; i<node->mNumMeshes; i++) {
-		unsigned int m = node->mMeshes[i];
-		meshmatrix[m] = result;
-	}
-
-	// last step, update all children.
-	for (unsigned int i=0; i < node->mNumChildren; i++) {
-		FindMeshTransformations(level+1, meshmatrix, result, node->mChildren[i]);
-	}
+void ManageAnimation::ReleasePreloaded(void) {
+	sPreloadedMutex.lock();
+	sPreloaded.clear();
+	sPreloadedMutex.unlock();
 }
 
 void ManageAnimation::Init(const char *filename, float xRotateCorrection, bool normalize) {
 	this->fRotateXCorrection = xRotateCorrection;
-	// Create an instance of the Importer class
-	Assimp::Importer importer;
-
-	unsigned int flags = aiProcess_JoinIdenticalVertices|aiProcess_Triangulate|aiProcess_FixInfacingNormals|aiProcess_ValidateDataStructure|
-	                     aiProcess_GenNormals|aiProcess_LimitBoneWeights;
-	// |aiProcess_OptimizeMeshes
-	if (normalize)
-		flags |= aiProcess_PreTransformVertices; // This flag will remove all bones.
-	importer.SetPropertyBool(AI_CONFIG_PP_PTV_NORMALIZE, true); // TODO: This is only used for aiProcess_PreTransformVertices
-	importer.SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 3); // The shader can only handle three weights for each vertice.
-	const aiScene* scene = importer.ReadFile( filename, flags);
-	if (scene == 0) {
-		ErrorDialog("assimp loading %s: %s\n", filename, importer.GetErrorString());
+	std::shared_ptr<const ModelFile> preloaded;
+	sPreloadedMutex.lock();
+	auto it = sPreloaded.find(std::make_pair(std::string(filename), normalize));
+	if (it != sPreloaded.end())
+		preloaded = it->second;
+	sPreloadedMutex.unlock();
+	if (!preloaded)
+		preloaded = ReadModel(filename, normalize);
+	const ModelFile &model = *preloaded;
+	if (!model.Error().empty()) {
+		ErrorDialog("ManageAnimation::Init %s\n", model.Error().c_str());
 		return;
 	}
 
-	// Number of vertices and number of indices
-	int vertexSize = 0, indexSize = 0;
-	if (gVerbose) {
-		printf("\nScene: %s (%s)*******************\n", scene->mRootNode->mName.data, filename);
-		printf("%d materials, %d meshes, %d animations, %d textures\n", scene->mNumMaterials, scene->mNumMeshes, scene->mNumAnimations, scene->mNumTextures);
-	}
-
-	//**********************************************************************
-	// Count how much data is needed. All indices and vetices are saved in
-	// the same buffer.
-	//**********************************************************************
-
-	fMeshData.reset(new Mesh[scene->mNumMeshes]);
-	fNumMeshes = scene->mNumMeshes;
-	for (unsigned int i=0; i<scene->mNumMeshes; i++) {
-		aiMesh *m = scene->mMeshes[i];
-		if (m->mNumBones > 0)
-			this->fUsingBones = true; // True if any mesh uses bones
-		aiMaterial *mat = scene->mMaterials[m->mMaterialIndex];
-		aiColor3D c (0.f,0.f,0.f);
-		mat->Get(AI_MATKEY_COLOR_DIFFUSE, c);
-		fMeshData[i].colour = glm::vec4(c.r, c.g, c.b, 1.0f);
-		indexSize += m->mNumFaces * 3; // Always 3 indices for each face (triangle).
-		vertexSize += m->mNumVertices;
-		if (gVerbose)
-			printf("\tMesh %d ('%s'): %d faces, %d vertices\n", i, m->mName.data, m->mNumFaces, m->mNumVertices);
-
-		// Find all animation bones in all meshes. They may have been seen in another mesh already.
-		fMeshData[i].bones.resize(m->mNumBones);
-		for (unsigned int j=0; j < m->mNumBones; j++) {
-			aiBone *aib = m->mBones[j];
-			// Add the bone to the global list of bones if it isn't already there.
-			boneindexIT_t it = fBoneIndex.find(aib->mName.data);
-			unsigned int jointIndex = fBoneIndex.size();
-			if (it == fBoneIndex.end())
-				fBoneIndex[aib->mName.data] = jointIndex;
-			else
-				jointIndex = it->second;
-
-			fMeshData[i].bones[j].jointIndex = jointIndex;
-			CopyaiMat(&aib->mOffsetMatrix, fMeshData[i].bones[j].offset);
-		}
-	}
-	if (gVerbose)
-		printf("Total vertices needed: %d, index count %d\n", vertexSize, indexSize);
-
-	// Find all mesh transformations and update the bones matrix dependency on parents
-	glm::mat4 meshmatrix[scene->mNumMeshes];
-	FindMeshTransformations(0, meshmatrix, glm::mat4(1), scene->mRootNode);
-	if (gVerbose)
-		DumpNodeTree(0, scene->mRootNode);
-
-	// Copy all vertex data into one big buffer and all index data into another buffer
-	VertexDataf vertexData[vertexSize];
-	unsigned short indexData[indexSize];
-	int vertexOffset = 0, indexOffset = 0;
-	int previousOffset = 0; // The index offset for the current mesh
-
-	// Skinning data. Allocate even if not using bones.
-	char numWeights[vertexSize];
-	memset(numWeights, 0, sizeof numWeights);
-	glm::vec3 weights[vertexSize];
-	float joints[vertexSize*3]; // Up to 4 joints per vertex, but only three are used.
-	memset(joints, 0, sizeof joints);
-
-	//**********************************************************************
-	// Traverse the meshes again, generating the vertex data
-	//**********************************************************************
-
-	for (unsigned int i=0; i<scene->mNumMeshes; i++) {
-		aiMesh *m = scene->mMeshes[i];
-		if (gVerbose)
-			printf("Mesh %d: %d faces, %d vertices, mtl index %d\n", i, m->mNumFaces, m->mNumVertices, m->mMaterialIndex);
-#if 1
-		if (gVerbose) {
-#if 0
-			printf("Indices:\n");
-			for (unsigned int face=0; face < m->mNumFaces; face++) {
-				printf("%d:(", m->mFaces[face].mNumIndices);
-				for (unsigned int ind=0; ind < m->mFaces[face].mNumIndices; ind++)
-					printf("%d,", m->mFaces[face].mIndices[ind]);
-				printf("),");
-			}
-			printf("\nVertices:\n");
-			for (unsigned int vert=0; vert < m->mNumVertices; vert++)
-				printf("%6.3f %6.3f %6.3f\n", m->mVertices[vert].x, m->mVertices[vert].y, m->mVertices[vert].z);
-#endif
-			printf("    Transformation matrix:\n");
-			PrintMatrix(4, meshmatrix[i]);
-			printf("\n");
-		}
-#endif
-
-		// Copy faces, but only those that are proper triangles.
-		unsigned int numTriangles = 0; // The number of found triangles.
-		for (unsigned int face=0; face < m->mNumFaces; face++) {
-			if (m->mFaces[face].mNumIndices != 3)
-				continue; // Only allow triangles
-			// m->mFaces[face].mIndices is a local index into the current mesh. Value 0 will thus
-			// adress the first vertex in the current mesh. As all vertices are stored in the same buffer,
-			// an offset need to be added to get the correct index of the vertex.
-			indexData[indexOffset++] = m->mFaces[face].mIndices[0] + previousOffset;
-			indexData[indexOffset++] = m->mFaces[face].mIndices[1] + previousOffset;
-			indexData[indexOffset++] = m->mFaces[face].mIndices[2] + previousOffset;
-			numTriangles++;
-		}
-		fMeshData[i].numFaces = numTriangles;
-
-		// Copy all vertices
-		for (unsigned int v = 0; v < m->mNumVertices; v++) {
-			glm::vec4 v1(m->mVertices[v].x, m->mVertices[v].y, m->mVertices[v].z, 1);
-			glm::vec4 v2 = meshmatrix[i] * v1;
-			vertexData[vertexOffset].SetVertex(glm::vec3(v2));
-			glm::vec4 n1(m->mNormals[v].x, m->mNormals[v].y, m->mNormals[v].z, 1);
-			glm::vec4 n2 = meshmatrix[i] * glm::normalize(n1);
-			vertexData[vertexOffset].SetNormal(glm::vec3(n2));
-			if (m->mTextureCoords[0] != 0) {
-				vertexData[vertexOffset].SetTexture(m->mTextureCoords[0][v].x, m->mTextureCoords[0][v].y);
-			} else {
-				vertexData[vertexOffset].SetTexture(0,0);
-			}
-			vertexData[vertexOffset].SetIntensity(255);
-			vertexData[vertexOffset].SetAmbient(100);
-			vertexOffset++;
-		}
-
-		// Every animation bone in Assimp data structures have a list of weights and vertex index.
-		// We want the weights, 0-3 of them, sorted on vertices instead.
-		// Iterate through all bones used in this mesh, and copy weights to respective vertex data.
-		for (unsigned j=0; j < m->mNumBones; j++) {
-			fMeshData[i].bones[j].offset *= glm::inverse(meshmatrix[i]);
-			aiBone *aib = m->mBones[j];
-			boneindexIT_t it = fBoneIndex.find(aib->mName.data);
-			if (it == fBoneIndex.end())
-				ErrorDialog("Mesh %d bone %s not found", i, aib->mName.data);
-			if (gVerbose) {
-				printf("    Offset for mesh %d %s (%d) joint %d:\n", i, aib->mName.data, j, it->second);
-				PrintMatrix(4, fMeshData[i].bones[j].offset);
-			}
-			for (unsigned k=0; k < aib->mNumWeights; k++) {
-				int v = aib->mWeights[k].mVertexId + previousOffset; // Add the local vertex number in the current mesh to the offset to get the global number
-				int w = numWeights[v]++;
-				// Because AI_CONFIG_PP_LBW_MAX_WEIGHTS is maximized to 3, There can't be more than 3 weights for a vertex
-				// unless there is a bug in Assimp.
-				if (w >= 3)
-					ErrorDialog("Too many bone weights on vertice %d, bone %s, model %s", v, aib->mName.data, filename);
-				weights[v][w] = aib->mWeights[k].mWeight;
-				joints[v*3 + w] = it->second;
-			}
+	fUsingBones = model.UsingBones();
+	fNumMeshes = model.NumMeshes();
+	fMeshData.reset(new Mesh[fNumMeshes]);
+	for (unsigned int i=0; i<fNumMeshes; i++) {
+		const ModelFile::Mesh &m = model.Meshes()[i];
+		fMeshData[i].colour = m.colour;
+		fMeshData[i].numFaces = m.numFaces;
+		fMeshData[i].bones.resize(m.numBones);
+		for (unsigned int j=0; j < m.numBones; j++) {
+			const ModelFile::Bone &bone = model.Bones()[m.firstBone + j];
+			fMeshData[i].bones[j].offset = bone.offset;
+			fMeshData[i].bones[j].jointIndex = bone.joint;
 		}
-		previousOffset = vertexOffset;
 	}
-
-	// Now that the weights are sorted on vertices, it is possible to normalize them. The sum shall be 1.
-	for (int j=0; j < vertexSize; j++)
-		NormalizeWeights(weights[j], numWeights[j]);
-	ASSERT(vertexOffset == vertexSize);
-	ASSERT(indexOffset <= indexSize);
+	fBoneIndex.clear();
+	for (unsigned int j=0; j < model.NumJoints(); j++)
+		fBoneIndex[model.JointName(j)] = j;
 
 	// Allocated the vertex data in OpenGL. The buffer object is used with the following layout:
 	// 1. The usual vertex data, and array of type VertexDataf
 	// 2. Skin weights, array of glm::vec3. 3 floats for each vertex.
 	// 3. Bones index, 4 bytes for each vertex (only 3 used)
-	const int AREA1 = vertexSize*sizeof vertexData[0];
-	const int AREA2 = vertexSize*sizeof weights[0];
+	int vertexSize = model.NumVertices();
+	const int AREA1 = vertexSize*sizeof (VertexDataf);
+	const int AREA2 = vertexSize*sizeof (glm::vec3);
 	const int AREA3 = vertexSize*3*sizeof (float);
 	int bufferSize = AREA1;
 	if (fUsingBones) {
@@ -385,17 +254,17 @@ void ManageAnimation::Init(const char *filename, float xRotateCorrection, bool n
 	if (!fOpenglBuffer.BindArray(bufferSize, 0)) {
 		ErrorDialog("ManageAnimation::Init: Data size is mismatch with input array\n");
 	}
-	fOpenglBuffer.ArraySubData(0, AREA1, vertexData);
+	fOpenglBuffer.ArraySubData(0, AREA1, model.Vertices());
 	if (this->fUsingBones) {
-		glBufferSubData(GL_ARRAY_BUFFER, AREA1, AREA2, weights);
-		glBufferSubData(GL_ARRAY_BUFFER, AREA1+AREA2, AREA3, joints);
+		glBufferSubData(GL_ARRAY_BUFFER, AREA1, AREA2, model.Weights());
+		glBufferSubData(GL_ARRAY_BUFFER, AREA1+AREA2, AREA3, model.Joints());
 	}
 
 	glGenVertexArrays(1, &fVao);
 	glBindVertexArray(fVao);
 	StageOneShader::EnableVertexAttribArray(this->fUsingBones); // Will be remembered in the VAO state
 	// Allocate the index data in OpenGL
-	if (!fIndexBuffer.BindElementsArray(indexSize*sizeof indexData[0], indexData)) {
+	if (!fIndexBuffer.BindElementsArray(model.NumIndices()*sizeof (unsigned short), model.Indices())) {
 		ErrorDialog("ManageAnimation::Init: Data size is mismatch with input array\n");
 	}
 	StageOneShader::VertexAttribPointer();
@@ -411,179 +280,178 @@ void ManageAnimation::Init(const char *filename, float xRotateCorrection, bool n
 		}
 	}
 
-	// Decode animation information
-	unsigned int numMeshBones = fBoneIndex.size();
-	if (numMeshBones > 0 && scene->mNumAnimations == 0)
-		ErrorDialog("ManageAnimation::Init %s: Bones but no animations", filename);
-	if (scene->mNumAnimations > 0) {
-		if (numMeshBones == 0)
-			ErrorDialog("ManageAnimation::Init %s: No mesh bones", filename);
-		if (gVerbose)
-			printf("Parsing %d animations\n", scene->mNumAnimations);
-	}
-
 	//**********************************************************************
-	// Decode the animations
-	// There may be more animated bones than used by meshes.
+	// Copy the animations
 	//**********************************************************************
-	fAnimations.reset(new Animation[scene->mNumAnimations]);
-	for (unsigned int i=0; i < scene->mNumAnimations; i++) {
-		aiAnimation *aia = scene->mAnimations[i];
-		fAnimations[i].name = aia->mName.data;
-		fAnimations[i].keysPerSecond = aia->mTicksPerSecond;
-		fAnimations[i].duration = aia->mDuration;
+	unsigned int numMeshBones = fBoneIndex.size();
+	fAnimations.reset(new Animation[model.NumAnimations()]);
+	for (unsigned int i=0; i < model.NumAnimations(); i++) {
+		const ModelFile::Animation *anim = model.GetAnimation(i);
+		unsigned numKeys = anim->numKeys;
+		fAnimations[i].name = anim->name;
+		fAnimations[i].keysPerSecond = anim->keysPerSecond;
+		fAnimations[i].duration = anim->duration;
+		fAnimations[i].numKeys = numKeys;
+		fAnimations[i].times.reset(new double[numKeys]);
+		std::copy(model.Times(i), model.Times(i) + numKeys, &fAnimations[i].times[0]);
 
 		// Set the size of bones to the actual nutmber of bones used by the meshes, not the total number of bones
 		// in the model.
 		fAnimations[i].bones.reset(new AnimationBone[numMeshBones]);
-
-		// The number of keys has to be the same for all channels. This is a limitation if it is going to be possible to
-		// pre compute all matrices.
-		unsigned numChannels = aia->mNumChannels;
-		if (numChannels == 0)
-			ErrorDialog("ManageAnimation::Init no animation channels for %s, %s", aia->mName.data, filename);
-		if (numChannels != numMeshBones)
-			ErrorDialog("ManageAnimation::Init %s animation %d: Can only handle when all bones are used (%d out of %d)", filename, i, numChannels, numMeshBones);
-		unsigned int numKeys = aia->mChannels[0]->mNumPositionKeys;
-		struct channel {
-			glm::mat4 mat; // Relative transformation matrix to parent
-			channel *parent;
-			aiNodeAnim *node;
-			unsigned joint;
-#define UNUSEDCHANNEL 0xFFFF
-		};
-		channel channels[numChannels]; // This is the list of all bones in this animation
-		// Check that there are the same number of keys for all channels, and allocate transformation matrices
-		bool foundOneBone = false;
-		for (unsigned int j=0; j < numChannels; j++) {
-			aiNodeAnim *ain = aia->mChannels[j];
-			if (ain->mNumPositionKeys != numKeys || ain->mNumRotationKeys != numKeys || ain->mNumScalingKeys != numKeys)
-				ErrorDialog("ManageAnimation::Init %s Bad animation setup: Pos keys %d, rot keys %d, scaling keys %d", filename, ain->mNumPositionKeys, ain->mNumRotationKeys, ain->mNumScalingKeys);
-			channels[j].node = ain;
-			channels[j].parent = 0;
-			boneindexIT_t it = fBoneIndex.find(ain->mNodeName.data);
-			if (it == fBoneIndex.end()) {
-				// Skip this channel (bone animation)
-				channels[j].joint = UNUSEDCHANNEL; // Mark it as not used
+		for (unsigned int j=0; j < numMeshBones; j++) {
+			const glm::mat4 *keys = model.KeyMatrices(i, j);
+			if (keys == 0)
 				continue;
-				// ErrorDialog("ManageAnimation::Init: Unknown bone %s in animation %s for %s", ain->mNodeName.data, fAnimations[i].name.c_str(), filename);
-			}
-			foundOneBone = true;
-			unsigned int joint = it->second;
-			fAnimations[i].bones[joint].frameMatrix.reset(new glm::mat4[numKeys]);
-			channels[j].joint = joint;
-		}
-		if (!foundOneBone)
-			ErrorDialog("ManageAnimation::Init %s animation %d no bones used", filename, i);
-
-		// Find the parent for each animation node
-		for (unsigned j=0; j<numChannels; j++) {
-			aiNode *n = FindNode(scene->mRootNode, channels[j].node->mNodeName.data);
-			if (n == 0 || n->mParent == 0)
-				continue; // No parent
-			n = n->mParent;
-			for (unsigned p=0; p<numChannels; p++) {
-				if (p == j || strcmp(n->mName.data, channels[p].node->mNodeName.data) != 0)
-					continue;
-				// Found it!
-				channels[j].parent = &channels[p];
-				break;
-			}
+			fAnimations[i].bones[j].frameMatrix.reset(new glm::mat4[numKeys]);
+			std::copy(keys, keys + numKeys, &fAnimations[i].bones[j].frameMatrix[0]);
 		}
 
-		fAnimations[i].times.reset(new double[numKeys]);
-		fAnimations[i].numKeys = numKeys;
-		// The first key frame doesn't always start at time 0
-		double firstKeyTime = channels[0].node->mPositionKeys[0].mTime;
-		for (unsigned k=0; k < numKeys; k++) {
-			fAnimations[i].times[k] = channels[0].node->mPositionKeys[k].mTime - firstKeyTime;
-			// printf("Animation key %d at time %.2f\n", k, fAnimations[i].times[k]);
-			for (unsigned int j=0; j < numChannels; j++) {
-				aiNodeAnim *ain = channels[j].node;
-				glm::mat4 R;
-				CopyaiQuat(R, ain->mRotationKeys[k].mValue);
-				glm::mat4 T = glm::translate(glm::mat4(1), glm::vec3(ain->mPositionKeys[k].mValue.x, ain->mPositionKeys[k].mValue.y, ain->mPositionKeys[k].mValue.z));
-				glm::mat4 S = glm::scale(glm::mat4(1), glm::vec3(ain->mScalingKeys[k].mValue.x, ain->mScalingKeys[k].mValue.y, ain->mScalingKeys[k].mValue.z));
-				channels[j].mat = T * R * S;
-				if (gVerbose) {
-					printf("     Key %d animation bone %s relative\n", k, channels[j].node->mNodeName.data);
-					PrintMatrix(10, channels[j].mat);
-				}
-			}
-			// Iterate through each animation bone and compute the transformation matrix using parent matrix.
-			for (unsigned int j=0; j < numChannels; j++) {
-				unsigned joint = channels[j].joint;
-				glm::mat4 mat(1);
-				for (channel *node = &channels[j]; node; node = node->parent) {
-					mat = node->mat * mat;
+		// Decompose the key frames, to blend rotations as quaternions instead of blending matrices.
+		unsigned n = numMeshBones;
+		std::unique_ptr<float[]> keyData(new float[numKeys*8*n]);
+		bool decomposed = true;
+		for (unsigned k=0; k < numKeys && decomposed; k++) {
+			float *d = &keyData[k*8*n];
+			for (unsigned j=0; j < n; j++) {
+				glm::quat q;
+				glm::vec3 t;
+				float s;
+				if (!fAnimations[i].bones[j].frameMatrix || !Decompose(fAnimations[i].bones[j].frameMatrix[k], q, t, s)) {
+					decomposed = false;
+					break;
 				}
-				mat = armature * mat;
-				if (joint != UNUSEDCHANNEL) {
-					fAnimations[i].bones[joint].frameMatrix[k] = mat;
-					if (gVerbose) {
-						printf("     Key %d animation bone %s channel %d absolute\n", k, channels[j].node->mNodeName.data, j);
-						PrintMatrix(10, mat);
-					}
+				if (k > 0) {
+					// Use the same hemisphere as the previous key, or the blending would take the long way around.
+					const float *prev = &keyData[(k-1)*8*n];
+					if (q.x*prev[j] + q.y*prev[n+j] + q.z*prev[2*n+j] + q.w*prev[3*n+j] < 0.0f)
+						q = glm::quat(-q.w, -q.x, -q.y, -q.z);
 				}
+				d[j] = q.x; d[n+j] = q.y; d[2*n+j] = q.z; d[3*n+j] = q.w;
+				d[4*n+j] = t.x; d[5*n+j] = t.y; d[6*n+j] = t.z;
+				d[7*n+j] = s;
 			}
 		}
+		if (decomposed)
+			fAnimations[i].keyData = std::move(keyData);
+		else if (gVerbose)
+			printf("Animation %d in %s can't be decomposed, blending matrices\n", i, filename);
 	}
 }
 
-void ManageAnimation::DrawAnimation(AnimationShader *shader, const glm::mat4 &modelMatrix, double animationStart, bool dead, const GLuint *textures) {
-	glm::mat4 rot = glm::rotate(modelMatrix, fRotateXCorrection, glm::vec3(1, 0, 0));
-	if (!fUsingBones)
-		ErrorDialog("ManageAnimation::Draw called for model without bones");
-	double deathTransform = 0.0;
+unsigned ManageAnimation::FindPose(double animationStart, bool dead) {
+	int death = 0;
 	if (dead) {
-		deathTransform = (gCurrentFrameTime - animationStart)/3.0;
+		double deathTransform = (gCurrentFrameTime - animationStart)/3.0;
 		if (deathTransform > 1.0)
 			deathTransform = 1.0;
 		deathTransform = 1 - deathTransform;
 		deathTransform *= deathTransform; // Higher slope in beginning.
+		death = 1 + int(deathTransform * POSE_DEATH_STEPS); // Never 0 when dead
 		animationStart = gCurrentFrameTime; // disable the other animations
 	}
 	int a = 0; // Can only handle first animation
-	int numKeyFrames = fAnimations[a].numKeys;
-	double totalAnimationTime = fAnimations[a].times[numKeyFrames-1];
+	double totalAnimationTime = fAnimations[a].times[fAnimations[a].numKeys-1];
 	double delta = gCurrentFrameTime - animationStart; // Time since this animation started
-	double animationOffset = fmod(delta, totalAnimationTime); // Compute time offset into current animation.
+	int time = int(fmod(delta, totalAnimationTime) / POSE_TIME_QUANTUM); // Quantised time offset into current animation.
+
+	if (fPoseCacheFrame != gCurrentFrameTime) {
+		// The cache is only valid for one frame
+		fPoseCacheUsed = 0;
+		fPoseCacheFrame = gCurrentFrameTime;
+	}
+	for (unsigned i=0; i<fPoseCacheUsed; i++) {
+		if (fPoseCache[i].time == time && fPoseCache[i].death == death) {
+			sPosesReused++;
+			return i;
+		}
+	}
+	// The cache is never reduced during a frame, as instanced drawing refers to the poses by index.
+	if (fPoseCache.size() < POSE_CACHE_SIZE)
+		fPoseCache.resize(POSE_CACHE_SIZE);
+	if (fPoseCacheUsed == fPoseCache.size())
+		fPoseCache.resize(fPoseCacheUsed*2);
+	unsigned ind = fPoseCacheUsed++;
+	Pose *pose = &fPoseCache[ind];
+	pose->time = time;
+	pose->death = death;
+	pose->matrices.resize(fNumMeshes * fBoneIndex.size());
+	double start = GetTime();
+	this->ComputePose(time, death, &pose->matrices[0]);
+	sPoseTime += GetTime() - start;
+	sPosesComputed++;
+	return ind;
+}
+
+const glm::mat4 *ManageAnimation::GetPose(double animationStart, bool dead) {
+	return &fPoseCache[this->FindPose(animationStart, dead)].matrices[0];
+}
+
+int ManageAnimation::PoseIndex(double animationStart, bool dead) {
+	return this->FindPose(animationStart, dead) * fNumMeshes * fBoneIndex.size();
+}
+
+void ManageAnimation::ComputePose(int time, int death, glm::mat4 *matrices) {
+	int a = 0; // Can only handle first animation
+	const Animation &anim = fAnimations[a];
+	int numKeyFrames = anim.numKeys;
+	double animationOffset = time * POSE_TIME_QUANTUM;
 	// Find the key on the left side
 	int key = 0;
-	while (animationOffset > fAnimations[a].times[key+1])
+	while (key < numKeyFrames-2 && animationOffset > anim.times[key+1])
 		key++;
-	double keyFrameOffset = animationOffset - fAnimations[a].times[key]; // Time offset after key
+	double keyFrameOffset = animationOffset - anim.times[key]; // Time offset after key
 	int keyNext = key+1;
 	if (keyNext >= numKeyFrames)
 		keyNext = numKeyFrames-1; // Safe guard, should not happen
 	// Find the time interval from this key frame to next
-	double keyFrameLength = fAnimations[a].times[keyNext] - fAnimations[a].times[key];
+	double keyFrameLength = anim.times[keyNext] - anim.times[key];
 	// 'w' is a value between 0 and 1, Depending on the distance between previous key frame and next.
-	double w = 1.0;
+	float w = 1.0f;
 	if (keyFrameLength > 0)
 		w = keyFrameOffset / keyFrameLength;
-	shader->Model(rot);
 
 	unsigned int numBonesActual = fBoneIndex.size();
-	glm::mat4 m[numBonesActual];
-	glBindVertexArray(fVao);
-	int indexOffset = 0;
+	fBlendedJoints.resize(numBonesActual);
+	glm::mat4 *joints = &fBlendedJoints[0];
+	if (anim.keyData) {
+		unsigned stride = 8*numBonesActual;
+		BlendDecomposed(&anim.keyData[key*stride], &anim.keyData[keyNext*stride], w, numBonesActual, joints);
+	} else {
+		for (unsigned j=0; j<numBonesActual; j++)
+			BlendMatrices(anim.bones[j].frameMatrix[key], anim.bones[j].frameMatrix[keyNext], w, joints[j]);
+	}
+
+	float deathTransform = float(death-1) / POSE_DEATH_STEPS;
 	for (unsigned int i=0; i<fNumMeshes; i++) {
-		Mesh *mesh = &fMeshData[i];
-		if (mesh->numFaces == 0)
-			continue; // Not normally the case, but can happen for funny models.
-		for (const auto &bone : mesh->bones) {
+		glm::mat4 *m = matrices + i*numBonesActual;
+		for (const auto &bone : fMeshData[i].bones) {
 			unsigned joint = bone.jointIndex;
-			m[joint] = fAnimations[a].bones[joint].frameMatrix[key] * (1-w) + fAnimations[a].bones[joint].frameMatrix[keyNext] * w;
-			m[joint] *= bone.offset;
-			if (dead) {
+			m[joint] = joints[joint] * bone.offset;
+			if (death != 0) {
 				// Work-around for dying animation.
 				m[joint][3][0] *= deathTransform;
 				m[joint][3][1] *= deathTransform;
 				m[joint][3][2] *= deathTransform;
 			}
 		}
-		shader->Bones(m, numBonesActual);
+	}
+}
+
+void ManageAnimation::DrawAnimation(AnimationShader *shader, const glm::mat4 &modelMatrix, double animationStart, bool dead, const GLuint *textures) {
+	glm::mat4 rot = glm::rotate(modelMatrix, fRotateXCorrection, glm::vec3(1, 0, 0));
+	if (!fUsingBones)
+		ErrorDialog("ManageAnimation::Draw called for model without bones");
+	const glm::mat4 *pose = this->GetPose(animationStart, dead);
+	shader->Model(rot);
+
+	unsigned int numBonesActual = fBoneIndex.size();
+	glBindVertexArray(fVao);
+	int indexOffset = 0;
+	for (unsigned int i=0; i<fNumMeshes; i++) {
+		Mesh *mesh = &fMeshData[i];
+		if (mesh->numFaces == 0)
+			continue; // Not normally the case, but can happen for funny models.
+		shader->Bones(pose + i*numBonesActual, numBonesActual);
 
 		if (textures != 0)
 			glBindTexture(GL_TEXTURE_2D, textures[i]);
@@ -594,21 +462,56 @@ void ManageAnimation::DrawAnimation(AnimationShader *shader, const glm::mat4 &mo
 		int n = mesh->numFaces * 3 * sizeof (unsigned short); // Always 3 indices for each face (triangle).
 		indexOffset += n;
 	}
+}
 
-#if 0
-	static double lastTime = 0.0;
-	if (gCurrentFrameTime != lastTime) {
-		printf("numKeyFrames %d totalAnimationTime %.2f delta %.2f animationOffset %.2f key %d keyFrameOffset %.2f keyFrameLength %.2f w %.2f\n",
-			   numKeyFrames, totalAnimationTime, delta, animationOffset, key, keyFrameOffset, keyFrameLength, w);
-#if 0
-		for (unsigned i=0; i<numBonesActual; i++) {
-			printf("Joint %d key %d final matrix:\n", i, key);
-			PrintMatrix(1, m[i]);
-		}
-#endif
-		lastTime = gCurrentFrameTime;
+void ManageAnimation::DrawAnimationInstanced(AnimationInstancedShader *shader, const OpenglBuffer &instances, int first, int count, const GLuint *textures) {
+	if (!fUsingBones)
+		ErrorDialog("ManageAnimation::DrawAnimationInstanced called for model without bones");
+	unsigned int numBonesActual = fBoneIndex.size();
+	if (fPaletteFrame != gCurrentFrameTime || fPalettePoses != fPoseCacheUsed) {
+		// Upload the bone matrices of all poses used in this frame. Every matrix is four texels.
+		if (fPaletteTexture == 0)
+			glGenTextures(1, &fPaletteTexture);
+		unsigned poseSize = fNumMeshes * numBonesActual;
+		fPalette.BindArray(fPoseCacheUsed * poseSize * sizeof (glm::mat4), 0, GL_STREAM_DRAW);
+		for (unsigned i=0; i<fPoseCacheUsed; i++)
+			fPalette.ArraySubData(i * poseSize * sizeof (glm::mat4), poseSize * sizeof (glm::mat4), &fPoseCache[i].matrices[0]);
+		glBindTexture(GL_TEXTURE_BUFFER, fPaletteTexture);
+		fPalette.TexBuffer(GL_RGBA32F);
+		fPaletteFrame = gCurrentFrameTime;
+		fPalettePoses = fPoseCacheUsed;
 	}
-#endif
+	glActiveTexture(GL_TEXTURE0 + AnimationInstancedShader::BonePaletteUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, fPaletteTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(fVao);
+	instances.BindArray();
+	AnimationInstancedShader::InstanceModelAttribPointer(first);
+	int indexOffset = 0;
+	for (unsigned int i=0; i<fNumMeshes; i++) {
+		Mesh *mesh = &fMeshData[i];
+		if (mesh->numFaces == 0)
+			continue; // Not normally the case, but can happen for funny models.
+		shader->MeshOffset(i*numBonesActual);
+		if (textures != 0)
+			glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glDrawElementsInstanced(GL_TRIANGLES, mesh->numFaces*3, GL_UNSIGNED_SHORT, reinterpret_cast<void*>(indexOffset), count);
+		gDrawnQuads += mesh->numFaces*3*count;
+		gNumDraw++;
+		indexOffset += mesh->numFaces * 3 * sizeof (unsigned short); // Always 3 indices for each face (triangle).
+	}
+	AnimationInstancedShader::DisableInstanceModelAttrib();
+	glBindVertexArray(0);
+}
+
+void ManageAnimation::ReportPoseCache(void) {
+	if (sPosesComputed + sPosesReused == 0)
+		return;
+	printf("ManageAnimation: %u poses computed in %.2f ms, %u reused\n", sPosesComputed, sPoseTime*1000.0, sPosesReused);
+	sPosesComputed = 0;
+	sPosesReused = 0;
+	sPoseTime = 0.0;
 }
 
 void ManageAnimation::DrawStatic(void) {
@@ -624,10 +527,33 @@ void ManageAnimation::DrawStatic(void) {
 	gDrawnQuads += faces*3;
 }
 
+void ManageAnimation::DrawStaticInstanced(const OpenglBuffer &instances, int first, int count) {
+	glBindVertexArray(fVao);
+	int faces = 0;
+	for (unsigned int i=0; i<fNumMeshes; i++) {
+		faces += fMeshData[i].numFaces;
+	}
+	instances.BindArray();
+	StageOneShader::InstanceAttribPointer(first);
+	glDrawElementsInstanced(GL_TRIANGLES, faces*3, GL_UNSIGNED_SHORT, 0, count);
+	gNumDraw++;
+	gDrawnQuads += faces*3*count;
+	StageOneShader::DisableInstanceAttrib();
+	glBindVertexArray(0);
+}
+
 void ManageAnimation::Align(glm::mat4 &mat) const {
 	mat = glm::rotate(mat, fRotateXCorrection, glm::vec3(1, 0, 0));
 }
 
+void ManageAnimation::LoadModels(void) {
+	Preload("models/frog.dae", false);
+	Preload("models/morran.dae", false);
+	Preload("models/tuft.obj", true);
+	Preload("models/BasicSword.obj", true);
+	Preload("models/alien.dae", false);
+}
+
 void ManageAnimation::InitModels(void) {
 	gFrog.Init("models/frog.dae", 0.0f, false);
 	gMorran.Init("models/morran.dae", 0.0f, false);
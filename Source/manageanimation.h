@@ -26,13 +26,14 @@
 #include "OpenglBuffer.h"
 
 class AnimationShader;
-class aiNode;
+class AnimationInstancedShader;
 
 namespace View {
 
 /// @brief Implement a loader for animated models, as well as a Draw() function.
 /// The loading is based on Assimp, which actually allows for many different
 /// file formats. As of now, the Collada format has been used (.dae).
+/// A model baked with the modelconverter tool is used instead, if there is one.
 class ManageAnimation {
 public:
 	struct Animation;
@@ -44,16 +45,45 @@ public:
 	/// Initialize a model from a file.
 	/// xRotateCorrection: Compensate for model being rotated wrong around x axis.
 	/// normalize: Normalize the size to 1.0. Doesn't work for animations.
+	/// If the file was loaded by Preload(), that result is used.
 	void Init(const char *filename, float xRotateCorrection, bool normalize);
 
+	/// Read a model file in advance, for later calls of Init() with the same file. OpenGL isn't used, so this
+	/// can be done by other threads. A file that already has been read isn't read again.
+	static void Preload(const char *filename, bool normalize);
+
+	/// Release the models read by Preload(), when all models have been initialized.
+	static void ReleasePreloaded(void);
+
 	/// 'textures' has to be an array of textures, one for each mesh.
 	void DrawAnimation(AnimationShader *shader, const glm::mat4 &modelMatrix, double animationStart, bool dead, const GLuint *textures);
 
+	/// Get the index of the first bone matrix for an animation state, to be used as the pose of an
+	/// AnimationInstancedShader::Instance. The index is valid until the end of the current frame.
+	int PoseIndex(double animationStart, bool dead);
+
+	/// Draw 'count' animated models, using per instance data of type AnimationInstancedShader::Instance from
+	/// 'instances' starting at 'first'. The model matrices shall first be aligned with Align().
+	/// 'textures' has to be an array of textures, one for each mesh.
+	/// The shader program has to first be enabled.
+	void DrawAnimationInstanced(AnimationInstancedShader *shader, const OpenglBuffer &instances, int first, int count, const GLuint *textures);
+
 	/// Use the model, with any shader
 	/// The shader program has to first be enabled.
 	void DrawStatic(void);
+
+	/// Draw 'count' static models, using per instance offsets from 'instances' starting at 'first'.
+	/// The shader program has to first be enabled.
+	void DrawStaticInstanced(const OpenglBuffer &instances, int first, int count);
+	/// Read the files of the global models, without using OpenGL. Thread safe.
+	static void LoadModels(void);
+	/// Initialize the global models, using the files read by LoadModels() if it was called.
 	static void InitModels(void);
 
+	/// Print statistics about the pose cache, and reset the counters. Use the test server with
+	/// --monsters=500 to get a benchmark of a big fight.
+	static void ReportPoseCache(void);
+
 	/// Modify a transformation matrix that will align the model, as needed.
 	void Align(glm::mat4 &mat) const;
 private:
@@ -61,9 +91,6 @@ private:
 	GLuint fVao; // A list of Vertex Attribute Object
 	float fRotateXCorrection; // How much to rotate around the X axis to normalize direction
 
-	// Traverse the node tree. Compute the absolute matrices (the matrices are relative to the parent). Also update meshes.
-	void FindMeshTransformations(int level, glm::mat4 *meshmatrix, const glm::mat4 &base, const aiNode *node);
-
 	bool fUsingBones; // True if bones are used to define mesh positions.
 	std::unique_ptr<Animation[]> fAnimations; // for each animation.
 	unsigned fNumMeshes;
@@ -72,6 +99,31 @@ private:
 	// All joints are ordered. Map from bone name to joint number. Only bones actually used in a mesh are saved here.
 	typedef std::map<std::string, unsigned int>::iterator boneindexIT_t;
 	std::map<std::string, unsigned int> fBoneIndex;
+
+	// Most instances of a model are in the same phase of the animation, like standing still or
+	// moving, which gives the same pose. Poses are saved, and reused during the frame.
+	struct Pose {
+		int time;  // The quantised animation offset
+		int death; // The quantised death transformation, 0 if not dead
+		std::vector<glm::mat4> matrices; // Bone matrices, fBoneIndex.size() for each mesh
+	};
+	std::vector<Pose> fPoseCache;
+	unsigned fPoseCacheUsed;
+	double fPoseCacheFrame; // The frame time the cache is valid for
+	std::vector<glm::mat4> fBlendedJoints; // Scratch area for computing a pose
+
+	// The bone matrices of all cached poses, as a texture buffer used by instanced drawing.
+	OpenglBuffer fPalette;
+	GLuint fPaletteTexture;
+	double fPaletteFrame;   // The frame time the palette was uploaded
+	unsigned fPalettePoses; // The number of poses in the palette
+
+	// Find the cache index of the pose for an animation state, computing it if not in the cache.
+	unsigned FindPose(double animationStart, bool dead);
+
+	// Get the bone matrices of all meshes for an animation state, computing them if not in the cache.
+	const glm::mat4 *GetPose(double animationStart, bool dead);
+	void ComputePose(int time, int death, glm::mat4 *matrices);
 };
 
 extern ManageAnimation gSwordModel1, gTuftOfGrass, gFrog, gMorran, gAlien;
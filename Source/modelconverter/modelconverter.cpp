@@ -0,0 +1,93 @@
+// Copyright 2014 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Bake models into the binary format loaded by ManageAnimation, to avoid importing them with Assimp
+// at every start of the client. The baked file is saved next to the model, with the suffix ".bin".
+// Use "make bakedmodels" in the client directory to bake all models.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <string>
+
+#include "../ModelFile.h"
+#include "../primitives.h"
+
+int gVerbose = 0;
+
+// Used by primitives.h
+void assert_failed(const char *str, const char *file, int linenumber) {
+	fprintf(stderr, "Assert failed: %s %s line %d\n", str, file, linenumber);
+	exit(1);
+}
+
+static int sNormalize = 0;
+
+static struct option long_options[] = {
+	{"normalize", no_argument, &sNormalize, 1},
+	{"verbose",   no_argument, &gVerbose, 1},
+	{0, 0, 0, 0}
+};
+
+static void Usage(void) {
+	printf("Usage: modelconverter [options] model...\n"
+	       "  --normalize       Normalize the size to 1.0. Doesn't work for animations.\n"
+	       "  --verbose         Print the model data\n");
+}
+
+int main(int argc, char **argv) {
+	while (1) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 0: break; // A flag
+		default:
+			Usage();
+			exit(1);
+		}
+	}
+	if (optind >= argc) {
+		Usage();
+		exit(1);
+	}
+	for (int i=optind; i<argc; i++) {
+		const char *source = argv[i];
+		std::string baked = std::string(source) + View::ModelFile::BakedSuffix;
+		View::ModelFile model;
+		if (!model.Import(source, sNormalize)) {
+			fprintf(stderr, "modelconverter: %s\n", model.Error().c_str());
+			exit(1);
+		}
+		if (!model.Save(baked.c_str())) {
+			perror(baked.c_str());
+			exit(1);
+		}
+		// Verify that the client will accept the result
+		View::ModelFile check;
+		if (!check.Load(baked.c_str(), source, sNormalize)) {
+			fprintf(stderr, "modelconverter: %s\n", check.Error().c_str());
+			exit(1);
+		}
+		printf("%s: %u meshes, %u vertices, %u joints, %u animations\n", baked.c_str(), check.NumMeshes(), check.NumVertices(),
+		       check.NumJoints(), check.NumAnimations());
+	}
+	return 0;
+}
@@ -33,6 +33,8 @@
 #include "Options.h"
 #include "animationmodels.h"
 #include "Debug.h"
+#include "render.h"
+#include "Frustum.h"
 
 using std::stringstream;
 using std::shared_ptr;
@@ -53,6 +55,7 @@ struct Monsters::OneMonster : public Object {
 	float fDir; // The direction, in degrees, the monster is facing
 	double fUpdateTime; // The last time when this monster was updated from the server.
 	double lastTimeMoved; // The time when the monster last moved
+	bool fSoundRegistered; // True when the monster is known by SoundControl
 	virtual unsigned long GetId() const { return this->id; }
 	virtual int GetType() const { return ObjTypeMonster; }
 	virtual int GetLevel() const { return this->level; }
@@ -77,10 +80,10 @@ glm::vec3 Monsters::OneMonster::GetPosition() const {
 }
 
 void Monsters::SetMonster(unsigned long id, unsigned char hp, unsigned int level, signed long long x, signed long long y, signed long long z, float dir) {
-	if (fMonsters.find(id) == fMonsters.end()) {
-		fMonsters[id] = std::make_shared<OneMonster>();
-	}
-	auto mon = fMonsters[id];
+	int slot = fMonsters.Find(id);
+	if (slot < 0)
+		slot = fMonsters.Add(id, std::make_shared<OneMonster>());
+	OneMonster *mon = fMonsters.fObject[slot].get();
 
 	// printf("Store info for monster %d in slot %d (max: %d, fMaxIndex %d)\n", id, i, max, fMaxIndex);
 	if (hp != mon->hp)
@@ -94,6 +97,7 @@ void Monsters::SetMonster(unsigned long id, unsigned char hp, unsigned int level
 			mon->y = y;
 			mon->z = z;
 			mon->lastTimeMoved = gCurrentFrameTime;
+			fMonsters.SetPosition(slot, x, y, z);
 		}
 	}
 	mon->id = id;
@@ -101,72 +105,98 @@ void Monsters::SetMonster(unsigned long id, unsigned char hp, unsigned int level
 	mon->level = level;
 	mon->fDir = dir;
 	mon->fUpdateTime = gCurrentFrameTime;
+	fMonsters.fHp[slot] = hp;
+	fMonsters.fLevel[slot] = level;
+
+	// Only monsters near the player are given to SoundControl, as it has a limited number of creatures.
+	float dx = float(mon->x - gPlayer.x), dy = float(mon->y - gPlayer.y), dz = float(mon->z - gPlayer.z);
+	if (View::SoundControl::CreatureNear(dx, dy, dz)) {
+		float size = Size(level)/5.0f; // Value is from 0.2 to 1.0
+		View::gSoundControl.SetCreatureSound(View::SoundControl::SMonster, id, dx, dy, dz, hp==0, size);
+		mon->fSoundRegistered = true;
+	} else if (mon->fSoundRegistered) {
+		View::gSoundControl.RemoveCreatureSound(View::SoundControl::SMonster, id);
+		mon->fSoundRegistered = false;
+	}
 }
 
 shared_ptr<const Object> Monsters::Find(unsigned long id) const {
-	auto it = fMonsters.find(id);
-	if (it == fMonsters.end())
+	int slot = fMonsters.Find(id);
+	if (slot < 0)
 		return nullptr;
-	return it->second;
+	return fMonsters.fObject[slot];
 }
 
-void Monsters::RenderMonsters(bool forShadows, bool selectionMode, const View::AnimationModels *animationModels) const {
+void Monsters::RenderMonsters(bool forShadows, bool selectionMode, const View::AnimationModels *animationModels, const glm::mat4 &projView) const {
 	float sun = 1.0f;
 	if (gPlayer.BelowGround()) {
 		// A gross simplification. If underground, disable all sun.
 		sun = 0.0f;
 	}
-	for (const auto &mon : fMonsters) {
-		unsigned int level = mon.second->level;
-		glm::vec3 pos = mon.second->GetPosition();
+	View::Frustum frustum(projView);
+	static std::vector<View::AnimationModels::Instance> visible; // Reused every frame, to save allocations
+	visible.clear();
+	fMonsters.ForRange(gPlayer.x, gPlayer.y, gPlayer.z, maxRenderDistance * BLOCK_COORD_RES, [&](int slot) {
+		const OneMonster *mon = fMonsters.fObject[slot].get();
+		unsigned int level = fMonsters.fLevel[slot];
+		glm::vec3 pos = mon->GetPosition();
 		float size = this->Size(level);
 
-		glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
-		model = glm::rotate(model, -mon.second->fDir, glm::vec3(0.0f, 1.0f, 0.0f));
-		model = glm::translate(model, glm::vec3(-size/3, 0.0f, size/3));
+		// The monster is approximately 'size' high and wide, standing at 'pos'. Use a margin, as the models differ.
+		if (frustum.SphereOutside(pos + glm::vec3(0.0f, size/2, 0.0f), size + 2.0f))
+			return;
+
+		View::AnimationModels::Instance inst;
+		inst.modelMatrix = glm::translate(glm::mat4(1.0f), pos);
+		inst.modelMatrix = glm::rotate(inst.modelMatrix, -mon->fDir, glm::vec3(0.0f, 1.0f, 0.0f));
+		inst.modelMatrix = glm::translate(inst.modelMatrix, glm::vec3(-size/3, 0.0f, size/3));
 
-		View::AnimationModels::AnimationModelId anim;
 		// Choose a monster model, depending on the level.
 		switch(level % 3) {
 		case 2:
-			anim = View::AnimationModels::AnimationModelId::Alien;
+			inst.id = View::AnimationModels::AnimationModelId::Alien;
 			break;
 		case 1:
-			anim = View::AnimationModels::AnimationModelId::Frog;
+			inst.id = View::AnimationModels::AnimationModelId::Frog;
 			break;
 		case 0:
-			anim = View::AnimationModels::AnimationModelId::Morran;
+			inst.id = View::AnimationModels::AnimationModelId::Morran;
 			break;
 		}
 
-		if (mon.second->IsDead())
-			animationModels->Draw(anim, model, mon.second->lastTimeMoved, true);
-		else if (mon.second->lastTimeMoved + 0.2 > gCurrentFrameTime)
-			animationModels->Draw(anim, model, 0.0, false);
+		inst.dead = fMonsters.fHp[slot] == 0;
+		if (inst.dead)
+			inst.animationStart = mon->lastTimeMoved;
+		else if (mon->lastTimeMoved + 0.2 > gCurrentFrameTime)
+			inst.animationStart = 0.0;
 		else
-			animationModels->Draw(anim, model, gCurrentFrameTime-0.22, false); // Offset in time where model is not in a stride.
+			inst.animationStart = gCurrentFrameTime-0.22; // Offset in time where model is not in a stride.
+		visible.push_back(inst);
 
 		if (forShadows)
-			continue;
+			return;
 		if (!gOptions.fDynamicShadows || sun == 0)
 			gShadows.Add(pos.x, pos.y, pos.z, size);
-	}
+	});
+	animationModels->Draw(visible);
 }
 
 void Monsters::RenderMinimap(const glm::mat4 &miniMap, View::HealthBar *hb) const {
-	for (const auto &mon : fMonsters) {
-		if (mon.second->IsDead())
-			continue;
-		float dx = float(gPlayer.x - mon.second->x)/CHUNK_SIZE/BLOCK_COORD_RES/2;
-		float dy = float(gPlayer.y - mon.second->y)/CHUNK_SIZE/BLOCK_COORD_RES/2;
-		float dz = float(gPlayer.z - mon.second->z)/CHUNK_SIZE/BLOCK_COORD_RES/2;
+	// The radar shows two chunks in every direction. Use a sphere that includes the corners.
+	double radius = 2 * CHUNK_SIZE * BLOCK_COORD_RES * 1.733;
+	fMonsters.ForRange(gPlayer.x, gPlayer.y, gPlayer.z, radius, [&](int slot) {
+		if (fMonsters.fHp[slot] == 0)
+			return;
+		float dx = float(gPlayer.x - fMonsters.fX[slot])/CHUNK_SIZE/BLOCK_COORD_RES/2;
+		float dy = float(gPlayer.y - fMonsters.fY[slot])/CHUNK_SIZE/BLOCK_COORD_RES/2;
+		float dz = float(gPlayer.z - fMonsters.fZ[slot])/CHUNK_SIZE/BLOCK_COORD_RES/2;
 		if (dx > 1.0f || dx < -1.0f || dy > 1.0f || dy < -1.0f || dz > 1.0f || dz < -1.0f)
-			continue; // To far away on the radar
+			return; // To far away on the radar
 		// printf("Monsters::RenderMinimap (%.2f, %.2f, %.2f)\n", dx, dy, dz);
 		glm::mat4 model = glm::translate(miniMap, glm::vec3(0.5f-dx, 0.5f-dy, 0.0f));
 		model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
 		hb->DrawSquare(model, 1.0f, 0.4f, 0.4f, 1.0f);
-	}
+	});
 }
 
 void Monsters::OneMonster::RenderHealthBar(View::HealthBar *hb, float angle) const {
@@ -204,33 +234,47 @@ shared_ptr<const Object> Monsters::GetNext(shared_ptr<const Object> current) con
 	if (current)
 		curr_z = glm::project(current->GetPosition(), gViewMatrix, gProjectionMatrix, viewPort).z;
 	LPLOG("Current z: %f", curr_z);
+
+	// Only monsters inside a cone that encloses the view frustum need to be projected.
+	glm::mat4 camera = glm::inverse(gViewMatrix);
+	glm::vec3 cameraPos(camera[3]), forward(-camera[2]);
+	float tanX = 1.0f / gProjectionMatrix[0][0], tanY = 1.0f / gProjectionMatrix[1][1];
+	float angle = std::atan(std::sqrt(tanX*tanX + tanY*tanY));
+	ChunkCoord cc;
+	gPlayer.GetChunkCoord(&cc);
+	// Convert from OpenGL coordinates, relative to the player chunk, to server coordinates.
+	signed long long x = (signed long long)cc.x*BLOCK_COORD_RES*CHUNK_SIZE + (signed long long)(cameraPos.x*BLOCK_COORD_RES);
+	signed long long y = (signed long long)cc.y*BLOCK_COORD_RES*CHUNK_SIZE - (signed long long)(cameraPos.z*BLOCK_COORD_RES);
+	signed long long z = (signed long long)cc.z*BLOCK_COORD_RES*CHUNK_SIZE + (signed long long)(cameraPos.y*BLOCK_COORD_RES);
+	glm::vec3 dir(forward.x, -forward.z, forward.y);
+
 	shared_ptr<const Object> best, first;
 	float best_z = 1.0f, first_z = 1.0f;
-	for (const auto mon : fMonsters) {
-		auto mp = mon.second;
-		if (current == mp || mon.second->IsDead())
-			continue; // No monster at this slot, or it was the one already selected
+	fMonsters.ForCone(x, y, z, dir, angle, maxRenderDistance * BLOCK_COORD_RES, [&](int slot) {
+		const shared_ptr<OneMonster> &mp = fMonsters.fObject[slot];
+		if (current == mp || fMonsters.fHp[slot] == 0)
+			return; // It was the one already selected, or dead
 		// Transform monster coordinates into projection coordinates
-		glm::vec3 pos = mon.second->GetPosition();
+		glm::vec3 pos = mp->GetPosition();
 		glm::vec3 screen = glm::project(pos, gViewMatrix, gProjectionMatrix, viewPort);
 		LPLOG("Found at: %f,%f,%f", screen.x, screen.y, screen.z);
 		if (screen.z < 0.0f || screen.z > 1.0f)
-			continue;
+			return;
 		// TODO: This test will actually cut off some monsters that are partly visible.
 		if (screen.x < 0.0f || screen.x > 1.0f || screen.y < 0.0f || screen.y > 1.0f)
-			continue;
+			return;
 		if (screen.z < first_z) {
 			first_z = screen.z;
 			first = mp;
 		}
 		// Found a monster visible in the projection. Check the distance
 		if (screen.z < curr_z)
-			continue; // Before the current monster
+			return; // Before the current monster
 		if (screen.z > best_z)
-			continue; // Not as good as best found yet
+			return; // Not as good as best found yet
 		best = mp;
 		best_z = screen.z;
-	}
+	});
 	// If there was no monster after the current selection, choose the one nearest to the player.
 	if (first == 0)
 		first = current;
@@ -246,16 +290,16 @@ shared_ptr<const Object> Monsters::GetNext(shared_ptr<const Object> current) con
 // least every 4s. So monsters that have not had any update in 5s are stale, and should be removed.
 void Monsters::Cleanup(void) {
 	double now = gCurrentFrameTime;
-	auto it = fMonsters.begin();
-	while (it != fMonsters.end()) {
-		if (now - it->second->fUpdateTime < 5.0) {
-			it++;
-		} else {
-			// Remove this monster as a creature in SoundControl
-			// printf("Remove monster %d\n", it->second->id);
-			View::gSoundControl.RemoveCreatureSound(View::SoundControl::SMonster, it->second->id);
-			fMonsters.erase(it++);
-		}
+	// Iterate backwards, as a removed slot is replaced by the last one.
+	for (int slot = fMonsters.Size()-1; slot >= 0; slot--) {
+		const OneMonster *mon = fMonsters.fObject[slot].get();
+		if (now - mon->fUpdateTime < 5.0)
+			continue;
+		// Remove this monster as a creature in SoundControl
+		// printf("Remove monster %d\n", mon->id);
+		if (mon->fSoundRegistered)
+			View::gSoundControl.RemoveCreatureSound(View::SoundControl::SMonster, mon->id);
+		fMonsters.Remove(slot);
 	}
 }
 
@@ -17,10 +17,10 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
 
 #include "object.h"
+#include "EntityStore.h"
 
 class RandomMonster;
 
@@ -36,17 +36,18 @@ namespace Model {
 class Monsters {
 private:
 	struct OneMonster;
-	std::map<unsigned long, std::shared_ptr<OneMonster> > fMonsters;
+	EntityStore<OneMonster> fMonsters;
 public:
 	void Cleanup(void); // Throw away "old" monsters
 
 	// Monster information, identified by 'id'. The coordinates are absolute world coordinates.
 	void SetMonster(unsigned long id, unsigned char hp, unsigned int level, signed long long x, signed long long y, signed long long z, float dir);
 	std::shared_ptr<const Object> Find(unsigned long id) const; // Get a pointer to a monster, or nullptr if not found.
-	void RenderMonsters(bool forShadows, bool selectionMode, const View::AnimationModels *) const; // draw all near monsters
+	// Draw all near monsters that are inside the frustum of 'projView'. For shadows, it is the projection of the shadow map.
+	void RenderMonsters(bool forShadows, bool selectionMode, const View::AnimationModels *, const glm::mat4 &projView) const;
 	void RenderMinimap(const glm::mat4 &model, View::HealthBar *hb) const; // draw all near monsters
 
-	// Find the next monster after 'current', based on distance from player.
+	// Find the next monster after 'current', based on distance from the camera.
 	std::shared_ptr<const Object> GetNext(std::shared_ptr<const Object> current) const;
 
 	// All monsters for a given level has the same size, a value from 1 to 5.
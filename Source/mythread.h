@@ -24,8 +24,6 @@
 #include <semaphore.h>
 #include <assert.h>
 
-class ChunkProcess;
-
 namespace std {
 
 class mutex {
@@ -43,6 +41,8 @@ public:
 	unique_lock(T &lock) : fLock(&lock) {
 		pthread_mutex_lock(&fLock->fMutex);
 	}
+	void lock(void) { pthread_mutex_lock(&fLock->fMutex); }
+	void unlock(void) { pthread_mutex_unlock(&fLock->fMutex); }
 };
 
 class condition_variable {
@@ -59,7 +59,7 @@ class thread {
 	bool valid;
 public:
 	thread() : valid(false) {}
-	thread(void* (*func)(ChunkProcess *p), ChunkProcess *p) : valid(true) {
+	template <class T> thread(void* (*func)(T *p), T *p) : valid(true) {
 		pthread_attr_t attr;
 		pthread_attr_init(&attr);
 		pthread_create(&fThread, &attr, (void* (*)(void*))func, (void *)p);
@@ -69,6 +69,11 @@ public:
 		fThread = other.fThread; valid = other.valid; other.valid = false;
 	}
 	thread(const thread&) = delete; // Copy constructor, don't allow.
+	thread &operator=(thread &&other) { // Move assignment
+		assert(!valid);
+		fThread = other.fThread; valid = other.valid; other.valid = false;
+		return *this;
+	}
 	void join(void) {
 		assert(valid);
 		pthread_join(fThread, NULL);
@@ -37,6 +37,7 @@
 #include "Options.h"
 #include "shaders/AnimationShader.h"
 #include "manageanimation.h"
+#include "Frustum.h"
 
 using std::stringstream;
 using std::endl;
@@ -60,17 +61,18 @@ glm::vec3 OtherPlayers::OneOtherPlayer::GetPosition() const {
 }
 
 void OtherPlayers::SetPlayer(unsigned long id, unsigned char hp, unsigned int level, signed long long x, signed long long y, signed long long z, float dir) {
-	OneOtherPlayer *pl = &fPlayers[id];
-
-	if (pl->id == 0) {
+	int slot = fPlayers.Find(id);
+	if (slot < 0) {
+		slot = fPlayers.Add(id, std::make_shared<OneOtherPlayer>());
 		unsigned char b[7];
 		b[0] = sizeof b;
 		b[1] = 0;
 		b[2] = CMD_REQ_PLAYER_INFO;
 		EncodeUint32(b+3, id);
 		SendMsg(b, sizeof b);
-		pl->id = id;
+		fPlayers.fObject[slot]->id = id;
 	}
+	OneOtherPlayer *pl = fPlayers.fObject[slot].get();
 	// printf("Store info for player %d in slot %d (max: %d, fMaxIndex %d)\n", id, i, max, fMaxIndex);
 	pl->ingame = true;
 	if (pl->x != x || pl->y != y || pl->z != z) {
@@ -80,19 +82,32 @@ void OtherPlayers::SetPlayer(unsigned long id, unsigned char hp, unsigned int le
 			pl->y = y;
 			pl->z = z;
 			pl->lastTimeMoved = gCurrentFrameTime;
+			fPlayers.SetPosition(slot, x, y, z);
 		}
 	}
 	pl->hp = hp;
 	pl->level = level;
 	pl->fDir = dir;
 	pl->fUpdateTime = gCurrentFrameTime;
+	fPlayers.fHp[slot] = hp;
+	fPlayers.fLevel[slot] = level;
+
+	// Only players near the player are given to SoundControl, as it has a limited number of creatures.
+	float dx = float(pl->x - gPlayer.x), dy = float(pl->y - gPlayer.y), dz = float(pl->z - gPlayer.z);
+	if (View::SoundControl::CreatureNear(dx, dy, dz)) {
+		View::gSoundControl.SetCreatureSound(View::SoundControl::SOtherPlayer, id, dx, dy, dz, hp==0, 0.0f);
+		pl->fSoundRegistered = true;
+	} else if (pl->fSoundRegistered) {
+		View::gSoundControl.RemoveCreatureSound(View::SoundControl::SOtherPlayer, id);
+		pl->fSoundRegistered = false;
+	}
 }
 
 void OtherPlayers::SetPlayerName(unsigned long uid, const char *name, int n, int adminLevel) {
-	auto it = fPlayers.find(uid);
-	if (it == fPlayers.end())
+	int slot = fPlayers.Find(uid);
+	if (slot < 0)
 		return; // Give it up. Should not happen
-	it->second.playerName = name;
+	fPlayers.fObject[slot]->playerName = name;
 	// printf("Player %d got name %s and admin level %d\n", uid, fPlayers[ind].playerName, adminLevel);
 }
 
@@ -104,48 +119,50 @@ void OtherPlayers::RenderPlayers(AnimationShader *animShader, bool selectionMode
 	}
 	glBindTexture(GL_TEXTURE_2D, GameTexture::RedColor);
 	animShader->EnableProgram();
-	for (const auto &pl : fPlayers) {
-		if (!pl.second.ingame)
-			continue;
-		glm::vec3 pos = pl.second.GetPosition();
+	View::Frustum frustum(gProjectionMatrix * gViewMatrix);
+	fPlayers.ForRange(gPlayer.x, gPlayer.y, gPlayer.z, maxRenderDistance * BLOCK_COORD_RES, [&](int slot) {
+		const OneOtherPlayer *pl = fPlayers.fObject[slot].get();
+		glm::vec3 pos = pl->GetPosition();
+		if (frustum.SphereOutside(pos + glm::vec3(0.0f, PLAYER_HEIGHT, 0.0f), PLAYER_HEIGHT*2))
+			return;
 
 		glm::mat4 model = glm::translate(glm::mat4(1.0f), pos);
-		model = glm::rotate(model, -pl.second.fDir, glm::vec3(0.0f, 1.0f, 0.0f));
+		model = glm::rotate(model, -pl->fDir, glm::vec3(0.0f, 1.0f, 0.0f));
 		model = glm::scale(model, glm::vec3(PLAYER_HEIGHT, PLAYER_HEIGHT, PLAYER_HEIGHT));
 
-		if (pl.second.IsDead())
-			View::gFrog.DrawAnimation(animShader, model, pl.second.lastTimeMoved, true, 0);
-		else if (pl.second.lastTimeMoved + 0.2 > gCurrentFrameTime)
+		if (fPlayers.fHp[slot] == 0)
+			View::gFrog.DrawAnimation(animShader, model, pl->lastTimeMoved, true, 0);
+		else if (pl->lastTimeMoved + 0.2 > gCurrentFrameTime)
 			View::gFrog.DrawAnimation(animShader, model, 0.0, false, 0);
 		else
 			View::gFrog.DrawAnimation(animShader, model, gCurrentFrameTime-0.22, false, 0); // Offset in time where model is not in a stride.
 
 		if (!gOptions.fDynamicShadows || sun == 0)
 			gShadows.Add(pos.x, pos.y, pos.z, 1.5f);
-	}
+	});
 	animShader->DisableProgram();
 }
 
 void OtherPlayers::RenderPlayerStats(View::HealthBar *hb, float angle) const {
-	for (const auto &pl : fPlayers) {
-		if (pl.second.ingame) {
-			pl.second.RenderHealthBar(hb, angle);
-		}
-	}
+	fPlayers.ForRange(gPlayer.x, gPlayer.y, gPlayer.z, maxRenderDistance * BLOCK_COORD_RES, [&](int slot) {
+		fPlayers.fObject[slot]->RenderHealthBar(hb, angle);
+	});
 }
 
 void OtherPlayers::RenderMinimap(const glm::mat4 &miniMap,View:: HealthBar *hb) const {
-	for (const auto &pl : fPlayers) {
-		if (!pl.second.ingame || pl.second.IsDead())
-			continue;
-		auto pos = pl.second.GetPosition()/2.0f/float(CHUNK_SIZE);
+	// The radar shows two chunks in every direction. Use a sphere that includes the corners.
+	double radius = 2 * CHUNK_SIZE * BLOCK_COORD_RES * 1.733;
+	fPlayers.ForRange(gPlayer.x, gPlayer.y, gPlayer.z, radius, [&](int slot) {
+		if (fPlayers.fHp[slot] == 0)
+			return;
+		auto pos = fPlayers.fObject[slot]->GetPosition()/2.0f/float(CHUNK_SIZE);
 		if (pos.x > 1.0f || pos.x < -1.0f || pos.y > 1.0f || pos.y < -1.0f || pos.z > 1.0f || pos.z < -1.0f)
-			continue; // To far away on the radar
+			return; // To far away on the radar
 		// printf("OtherPlayers::RenderMinimap (%f, %f, %f)\n", pos.x, pos.y, pos.z);
 		glm::mat4 model = glm::translate(miniMap, 0.5f-pos);
 		model = glm::scale(model, glm::vec3(0.05f, 0.05f, 0.05f));
 		hb->DrawSquare(model, 0.0f, 1.0f, 1.0f, 1.0f);
-	}
+	});
 }
 
 void OtherPlayers::OneOtherPlayer::RenderHealthBar(View::HealthBar *hb, float angle) const {
@@ -184,15 +201,17 @@ void OtherPlayers::OneOtherPlayer::RenderHealthBar(View::HealthBar *hb, float an
 // least every 4s. So players that have not had any update in 5s are stale, and should be removed.
 void OtherPlayers::Cleanup(void) {
 	double now = gCurrentFrameTime;
-	for (auto &pl : fPlayers) {
-		if (!pl.second.ingame)
-			continue;
-		if (now - pl.second.fUpdateTime < 5.0)
+	// Iterate backwards, as a removed slot is replaced by the last one.
+	for (int slot = fPlayers.Size()-1; slot >= 0; slot--) {
+		OneOtherPlayer *pl = fPlayers.fObject[slot].get();
+		if (now - pl->fUpdateTime < 5.0)
 			continue;
-		// printf("Found stale player: index %d, id %ld\n", i, pl.second.id);
-		pl.second.ingame = false;
+		// printf("Found stale player: index %d, id %ld\n", slot, pl->id);
+		pl->ingame = false; // There may still be references to it
 
 		// Remove this players as a creature in SoundControl
-		View::gSoundControl.RemoveCreatureSound(View::SoundControl::SOtherPlayer, pl.second.id);
+		if (pl->fSoundRegistered)
+			View::gSoundControl.RemoveCreatureSound(View::SoundControl::SOtherPlayer, pl->id);
+		fPlayers.Remove(slot);
 	}
 }
@@ -18,8 +18,10 @@
 #pragma once
 
 
-#include <map>
 #include <string>
+#include <memory>
+
+#include "EntityStore.h"
 
 namespace View {
 	class HealthBar;
@@ -45,6 +47,7 @@ private:
 		float fDir; // The direction the player is facing, in degrees
 		double fUpdateTime; // The last time when this player was updated from the server.
 		double lastTimeMoved; // The time when the monster last moved
+		bool fSoundRegistered; // True when the player is known by SoundControl
 		std::string playerName;
 		virtual unsigned long GetId() const { return this->id; }
 		virtual int GetType() const { return ObjTypePlayer; }
@@ -55,7 +58,7 @@ private:
 		virtual void RenderHealthBar(View::HealthBar *, float angle) const;
 		virtual bool InGame(void) const { return ingame;}
 	};
-	std::map<unsigned long, OneOtherPlayer> fPlayers;
+	EntityStore<OneOtherPlayer> fPlayers; // Players that are stale are removed
 public:
 	void Cleanup(void);
 	void SetPlayer(unsigned long id, unsigned char hp, unsigned int level, signed long long x, signed long long y, signed long long z, float dir);
@@ -53,8 +53,11 @@ string gParseMessageAtLogin;
 #include "SoundControl.h"
 #include "ui/Error.h"
 #include "ChunkProcess.h"
+#include "ChunkRequests.h"
+#include "BlockUpdates.h"
 #include "SuperChunkManager.h"
 #include "Debug.h"
+#include "Clock.h"
 
 #define NELEM(x) (sizeof x / sizeof x[0])
 
@@ -129,25 +132,29 @@ unsigned long long ParseUint64(const unsigned char *b) {
 
 // 'b' points to the third byte in the message, when comparing to the protocol.
 // 'n' is the number of remaining bytes (total message length minus 3).
-static void ParseChunk(const unsigned char *b, int n) {
+unique_ptr<Model::ChunkBlocks> PreParseChunk(const std::shared_ptr<const unsigned char> &buffer, int n, ChunkCoord *cc) {
+	const unsigned char *b = buffer.get();
 	// DumpBytes(b, n);
 	unique_ptr<Model::ChunkBlocks> nc(new Model::ChunkBlocks); // A temporary ChunkBlock is needed.
 	// Even though the chunk coordinates are not unsigned, they can be parsed as such.
-	ChunkCoord cc;
-	cc.x = ParseUint32(b+12);
-	cc.y = ParseUint32(b+16);
-	cc.z = ParseUint32(b+20);
-	// LPLOG("ParseChunk: Got chunk (%d,%d,%d)", cc.x, cc.y, cc.z);
-	nc->fChunk = ChunkFind(&cc, true); // Server only sends chunk data on demand, which means there should always be a chunk found at this time.
-	// ASSERT(nc->fChunk != 0);        // This assertion did fail, sometimes. Because of that 'true' is used as argument above.
+	cc->x = ParseUint32(b+12);
+	cc->y = ParseUint32(b+16);
+	cc->z = ParseUint32(b+20);
 	nc->flag = ParseUint32(b);
 	nc->fChecksum = ParseUint32(b+4);
 	nc->fChecksumTestNeeded = false;
 	nc->fChecksumTimeout = 0.0;
 	nc->fOwner = ParseUint32(b+8);
-	nc->fCompressedChunk.reset(new unsigned char[n-24]);
-	memcpy(nc->fCompressedChunk.get(), b+24, n-24);
+	nc->fCompressedChunk = std::shared_ptr<const unsigned char>(buffer, b+24); // Refer to the same buffer
 	nc->compressSize = n-24;
+	return nc;
+}
+
+void ParseChunk(const ChunkCoord &cc, unique_ptr<Model::ChunkBlocks> nc) {
+	// LPLOG("ParseChunk: Got chunk (%d,%d,%d)", cc.x, cc.y, cc.z);
+	nc->fChunk = ChunkFind(&cc, true); // Server only sends chunk data on demand, which means there should always be a chunk found at this time.
+	// ASSERT(nc->fChunk != 0);        // This assertion did fail, sometimes. Because of that 'true' is used as argument above.
+	gChunkRequests.Arrived(nc->fChunk);
 	gChunkProcess.AddTaskNewChunk(std::move(nc));
 }
 
@@ -238,10 +245,16 @@ void Parse(const unsigned char *b, int n) {
 	case CMD_REPORT_COORDINATE:
 		Model::gPlayer.SetPosition((signed long long)Parseuint64(b+1), (signed long long)Parseuint64(b+9), (signed long long)Parseuint64(b+17));
 		break;
-	case CMD_CHUNK_ANSWER:
-		ParseChunk(b+1, n-1);
+	case CMD_CHUNK_ANSWER: {
+		// Usually pre-parsed by the network thread
+		ChunkCoord cc;
+		std::shared_ptr<unsigned char> copy(new unsigned char[n-1], std::default_delete<unsigned char[]>());
+		memcpy(copy.get(), b+1, n-1);
+		auto nc = PreParseChunk(copy, n-1, &cc);
+		ParseChunk(cc, std::move(nc));
 		// LPLOG("Parse: Chunk answer %d,%d,%d", pc->cc.x, pc->cc.y, pc->cc.z);
 		break;
+	}
 	case CMD_OBJECT_LIST:
 		// Report of various objects. Usually monsters or other players.
 		for (int i=1; i<n; i += 18) {
@@ -260,21 +273,16 @@ void Parse(const unsigned char *b, int n) {
 				gDebugWindow.Add("Object id %d state %d type %d level %d hp %f moved to relative (%d,%d,%d) dir %f",
 				                 id, state, type, level, (double)hp/255, dx, dy, dz, dir);
 #endif
+				// This will also update the player as a creature in SoundControl
 				Model::gOtherPlayers.SetPlayer(id, hp, level, Model::gPlayer.x+dx, Model::gPlayer.y+dy, Model::gPlayer.z+dz, dir);
-
-				// Update this player as a creature in SoundControl
-				gSoundControl.SetCreatureSound(SoundControl::SOtherPlayer,id,dx,dy,dz,hp==0,0.0f);
 			} else {
 #if 0
 				gDebugWindow.Add("Object id %d state %d type %d level %d hp %f moved to relative (%d,%d,%d) dir %f",
 				                 id, state, type, level, (double)hp/255, dx, dy, dz, dir);
 #endif
 				// Coordinates are relative to the player feet, while Model::gPlayer keeps track of the player head.
+				// This will also update the monster as a creature in SoundControl
 				Model::gMonsters.SetMonster(id, hp, level, Model::gPlayer.x+dx, Model::gPlayer.y+dy, Model::gPlayer.z+dz-(int)(PLAYER_HEIGHT*BLOCK_COORD_RES*2), dir);
-
-				// Update this monster as a creature in SoundControl
-				float size = Model::Monsters::Size(level)/5.0f; // Value is from 0.2 to 1.0
-				gSoundControl.SetCreatureSound(SoundControl::SMonster,id,dx,dy,dz,hp==0,size);
 			}
 		}
 		break;
@@ -286,15 +294,12 @@ void Parse(const unsigned char *b, int n) {
 		View::Chunk *cp = ChunkFind(&cc,false);
 		if (cp == 0)
 			break; // Chunk not found, ignore changes to it.
-		auto cb = cp->fChunkBlocks;
-		if (cb == 0)
-			break;
 		for (int i=13; i<n; i += 4) {
 			int dx = b[i];
 			int dy = b[i+1];
 			int dz = b[i+2];
 			int type = b[i+3];
-			cb->CommandBlockUpdate(cc, dx, dy, dz, type);
+			Model::gBlockUpdates.Add(cp, dx, dy, dz, type); // Applied later, together with other updates
 			if (type == BT_Air)
 				gSoundControl.RequestSound(SoundControl::SRemoveBlock);
 			else
@@ -303,7 +308,6 @@ void Parse(const unsigned char *b, int n) {
 				Controller::gGameDialog.CreateActivatorMessage(dx, dy, dz, cc);
 			}
 		}
-		cp->SetDirty(true);
 		break;
 	}
 	case CMD_MESSAGE:
@@ -352,6 +356,15 @@ void Parse(const unsigned char *b, int n) {
 		gClientAvailMinor = Parseuint16(b+5);
 		gClientAvailMajor = Parseuint16(b+7);
 		LPLOG("Current available client version is %d.%d", gClientAvailMajor, gClientAvailMinor);
+		// Tell the server what chunk encodings are supported, in addition to RLE.
+		unsigned char msg[9];
+		msg[0] = sizeof msg;
+		msg[1] = 0;
+		msg[2] = CMD_PROT_VERSION;
+		EncodeUint16(msg+3, PROT_VER_MINOR);
+		EncodeUint16(msg+5, PROT_VER_MAJOR);
+		EncodeUint16(msg+7, CHUNK_ENCODINGS_SUPPORTED);
+		SendMsg(msg, sizeof msg);
 		if (gMode.Get() == GameMode::INIT)
 			gMode.Set(GameMode::LOGIN);
 		break;
@@ -420,17 +433,12 @@ void Parse(const unsigned char *b, int n) {
 		View::Chunk *pc = ChunkFind(UpdateLSB(&cc, b[3], b[4], b[5]), false);
 		if (pc == 0)
 			break; // Safety precaution
-		auto cb = pc->fChunkBlocks;
-		if (cb == 0)
-			break;
 		for (int i=6; i<n; i += 3) {
 			unsigned char dx = b[i];
 			unsigned char dy = b[i+1];
 			unsigned char dz = b[i+2];
-			cb->AddTimerJellyBlock(dx, dy, dz, double(timeout));
-			cb->CommandBlockUpdate(cc, dx, dy, dz, BT_Air);
+			Model::gBlockUpdates.AddJelly(pc, dx, dy, dz, double(timeout));
 		}
-		pc->SetDirty(true);
 		break;
 	}
 	case CMD_PING: {
@@ -443,7 +451,7 @@ void Parse(const unsigned char *b, int n) {
 			msg[3] = 1; // 0 means request, 1 means response
 			SendMsg(msg, sizeof msg);
 		} else {
-			gCurrentPing = glfwGetTime() - gLastPing;
+			gCurrentPing = MessageReceivedTime() - gLastPing; // Not delayed by the frame rate
 		}
 		break;
 	}
@@ -24,8 +24,14 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 #include "contrib/SimpleSignal/SimpleSignal.h"
 
+struct ChunkCoord;
+namespace Model {
+	class ChunkBlocks;
+}
+
 /// Event generated when the player is hit by a monster
 /// @param dmg The damage in the hit
 /// @param id The id of the monster
@@ -49,6 +55,22 @@ extern Simple::Signal<void (float hor, float vert)> gLoginEvt;
  */
 void Parse(const unsigned char *, int);
 
+/**
+ * @brief Decode a CMD_CHUNK_ANSWER, without using any global state
+ * This can be done by the network thread. The compressed data is not copied, the ChunkBlocks
+ * will keep a reference to the buffer of 'b'.
+ * @param b The message, following the command byte
+ * @param n The number of bytes in 'b'
+ * @param cc The chunk coordinate is returned here
+ */
+std::unique_ptr<Model::ChunkBlocks> PreParseChunk(const std::shared_ptr<const unsigned char> &b, int n, ChunkCoord *cc);
+
+/**
+ * @brief Attach a decoded chunk to its Chunk, and start the processing of it
+ * Must be done from the main thread.
+ */
+void ParseChunk(const ChunkCoord &cc, std::unique_ptr<Model::ChunkBlocks> nc);
+
 /**
  * @brief Parse a 16-bit unsigned from two bytes. LSB first.
  */
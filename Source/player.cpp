@@ -33,6 +33,7 @@
 #include "shaders/StageOneShader.h"
 #include "shaders/AnimationShader.h"
 #include "Options.h"
+#include "Clock.h"
 
 using namespace Model;
 
@@ -144,13 +145,13 @@ void Player::SetPosition(signed long long newx, signed long long newy, signed lo
 	fPrevServerPosition = fServerPosition;
 	fServerPosition = glm::dvec3(double(newx)/BLOCK_COORD_RES, double(newy)/BLOCK_COORD_RES, double(newz)/BLOCK_COORD_RES);
 	fPrevUpdate = fLastUpdate;
-	fLastUpdate = glfwGetTime();
+	fLastUpdate = GetTime();
 	// std::cout << "player::SetPosition at " << fLastUpdate << " delta " << fLastUpdate-fPrevUpdate << std::endl;
 	fKnownPosition = true;
 }
 
 void Player::UpdatePositionSmooth(void) {
-	double now = glfwGetTime();
+	double now = GetTime();
 	double projection = now - 0.1; // Set coordinates matching this time stamp, which is a little backward in time
 	glm::dvec3 res;
 
@@ -177,3 +178,10 @@ void Player::UpdatePositionSmooth(void) {
 bool Player::PlayerIsMoving(void) const {
 	return fMoving;
 }
+
+glm::dvec3 Player::GetVelocity(void) const {
+	double dt = fLastUpdate - fPrevUpdate;
+	if (!fMoving || dt <= 0.0 || dt > 1.0)
+		return glm::dvec3(0.0); // Standing still, or the positions are too old to say anything
+	return (fServerPosition - fPrevServerPosition) / dt;
+}
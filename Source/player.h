@@ -96,6 +96,10 @@ public:
 	bool KnownPosition() const { return fKnownPosition; }
 
 	bool PlayerIsMoving(void) const;
+
+	/// The velocity in blocks per second, computed from the two most recent positions from the server.
+	/// Coordinates are given in the server system.
+	glm::dvec3 GetVelocity(void) const;
 private:
 	glm::dvec3 fServerPosition; // Most recent position of feet as given from server
 	glm::dvec3 fPrevServerPosition;
@@ -47,6 +47,7 @@
 #include "modes.h"
 #include "ChunkObject.h"
 #include "ChunkProcess.h"
+#include "BlockUpdates.h"
 #include "Options.h"
 #include "SuperChunkManager.h"
 #include "SoundControl.h"
@@ -390,11 +391,11 @@ void DrawLandscape(StageOneShader *shader, DL_Type dlType, bool stereoView) {
 		if (dlType == DL_Picking) {
 			// Picking mode. Throw away the previous triangles, and replace it with special triangles used
 			// for the picking mode. These contain colour information to allow identification of cubes.
-			cp->fChunkBlocks->TestJellyBlockTimeout(true);
+			Model::gBlockUpdates.TestJellyTimeout(cp, true);
 			cp->PushTriangles(ChunkObject::Make(cp, true, dx, dy, dz)); // Stash away the old triangles for quick restore
 			gChunkShaderPicking.Model(modelMatrix);
 		} else {
-			cp->fChunkBlocks->TestJellyBlockTimeout(false);
+			Model::gBlockUpdates.TestJellyTimeout(cp, false);
 			shader->Model(modelMatrix);
 		}
 
@@ -559,17 +560,13 @@ void LightSources::AddBlue(float x, float y, float z, float radius) {
 
 Shadows gShadows;
 
-void Shadows::Add(float x, float y, float z, float radius, float limit) {
-	if (fItems.size() < gOptions.fMaxShadows*limit) {
-		fItems.push_back(glm::vec4(x, y, z, radius));
-	}
+void Shadows::Add(float x, float y, float z, float radius) {
+	fItems.push_back(glm::vec4(x, y, z, radius));
 }
 
 Fogs gFogs;
 
 void Fogs::Add(float x, float y, float z, int radius) {
-	if (fItems.size() < MAX_RENDER_FOGS) {
-		fItems.push_back(glm::vec4(x, y, z, radius ));
-	}
+	fItems.push_back(glm::vec4(x, y, z, radius));
 }
 std::vector<DrawObjectList> gDrawObjectList;
@@ -73,9 +73,6 @@ protected:
 	std::vector<glm::vec4> fItems;
 };
 
-#define MAX_RENDER_SHADOWS 200
-#define MAX_RENDER_FOGS 100
-
 // A class that manage special lights.
 class LightSources : public BaseObject {
 public:
@@ -92,8 +89,8 @@ extern LightSources gLightSources;
 // A class that manage shadows beneath monsters and players.
 class Shadows : public BaseObject {
 public:
-	// Add another light source to the list. Optional 'limit' will limit how much of the maximal buffer that is used.
-	void Add(float x, float y, float z, float radius, float limit = 1.0);
+	// Add another shadow to the list.
+	void Add(float x, float y, float z, float radius);
 };
 
 extern Shadows gShadows;
@@ -101,7 +98,7 @@ extern Shadows gShadows;
 // A class that manage shadows beneath monsters and players.
 class Fogs : public BaseObject {
 public:
-	// Add another local fog to the list. Optional 'limit' will limit how much of the maximal buffer that is used.
+	// Add another local fog to the list.
 	void Add(float x, float y, float z, int radius);
 };
 
@@ -37,11 +37,10 @@
 #include "shaders/ChunkShader.h"
 #include "shaders/adddynamicshadow.h"
 #include "shaders/DeferredLighting.h"
-#include "shaders/addpointlight.h"
 #include "shaders/AnimationShader.h"
 #include "shaders/TranspShader.h"
 #include "shaders/addpointshadow.h"
-#include "shaders/addlocalfog.h"
+#include "shaders/clusteredlights.h"
 #include "shaders/addssao.h"
 #include "shaders/downsmpllum.h"
 #include "shaders/gaussblur.h"
@@ -66,6 +65,7 @@
 #include "fboflat.h"
 #include "HudTransformation.h"
 #include "RenderTarget.h"
+#include "lightclusters.h"
 
 #define NELEM(x) (sizeof x / sizeof x[0])
 
@@ -154,12 +154,12 @@ void RenderControl::Init(int lightSamplingFactor, bool stereoView) {
 	fSkyBox->Init();
 	fDeferredLighting.reset(new DeferredLighting);
 	fDeferredLighting->Init();
-	fAddPointLight.reset(new AddPointLight);
-	fAddPointLight->Init();
 	fAddPointShadow.reset(new AddPointShadow);
 	fAddPointShadow->Init();
-	fAddLocalFog.reset(new AddLocalFog);
-	fAddLocalFog->Init();
+	fClusteredLights.reset(new ClusteredLights);
+	fClusteredLights->Init();
+	fLightClusters.reset(new LightClusters);
+	fLightClusters->Init(gOptions.fNumThreads);
 	fAddSSAO.reset(new AddSSAO);
 	fAddSSAO->Init();
 	fScreenSpaceReflection.reset(new ScreenSpaceReflection);
@@ -315,6 +315,7 @@ std::unique_ptr<RenderTarget> RenderControl::Draw(bool underWater, const Model::
 	drawTransparentLandscape(stereoView);
 	if (selectedObject)
 		selectedObject->RenderHealthBar(HealthBar::Make(), Model::gPlayer.fAngleHor);
+	buildLightClusters(); // All lights, shadows and fogs are known now
 
 	// Apply deferred shader filters.
 	glEnable(GL_BLEND);
@@ -430,7 +431,7 @@ void RenderControl::drawMonsters(void) {
 	static TimeMeasure tm("Monst");
 	tm.Start();
 	DrawBuffers(ColAttachRenderTarget, ColAttachPosition, ColAttachNormals, ColAttachSurfaceProps);
-	Model::gMonsters.RenderMonsters(false, false, &fAnimationModels);
+	Model::gMonsters.RenderMonsters(false, false, &fAnimationModels, gProjectionMatrix * gViewMatrix);
 	tm.Stop();
 }
 
@@ -495,43 +496,85 @@ void RenderControl::drawDeferredLighting(bool underWater, float whitepoint) {
 	tm.Stop();
 }
 
-void RenderControl::drawPointLights(void) {
-	static TimeMeasure tm("Pntlght");
-	tm.Start();
-	DrawBuffers(ColAttachLighting);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, fNormalsTexture);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, fPositionTexture);
-	glActiveTexture(GL_TEXTURE0); // Need to restore it or everything will break.
-	glBindTexture(GL_TEXTURE_2D, fCurrentInputColor);
-	glDisable(GL_CULL_FACE);
-	glDepthMask(GL_FALSE);
+void RenderControl::buildLightClusters(void) {
+	fLightClusters->Clear();
 	// Iterate through all the objects, and add lights for some of them
 	for (auto it = gDrawObjectList.begin(); it != gDrawObjectList.end(); it++) {
 		switch(it->type) {
 		case BT_Lamp1:
 			// The coordinate is the base of the lamp. Move light souce a little upwards, to middle of lamp
-			fAddPointLight->Draw(it->pos+glm::vec3(0, 0.2f, 0), LAMP1_DIST);
+			fLightClusters->Add(LightClusters::PointLight, it->pos+glm::vec3(0, 0.2f, 0), LAMP1_DIST);
 			break;
 		case BT_Lamp2:
 			// The coordinate is the base of the lamp. Move light souce a little upwards, to middle of lamp
-			fAddPointLight->Draw(it->pos+glm::vec3(0, 0.3f, 0), LAMP2_DIST);
+			fLightClusters->Add(LightClusters::PointLight, it->pos+glm::vec3(0, 0.3f, 0), LAMP2_DIST);
 			break;
 		case BT_Treasure:
-			if (gOptions.fPerformance > 1) // Inhibit this for the low performance
-				fAddPointLight->Draw(it->pos, 1.5f);
-			break;
 		case BT_Quest:
 			if (gOptions.fPerformance > 1) // Inhibit this for the low performance
-				fAddPointLight->Draw(it->pos, 1.5f);
+				fLightClusters->Add(LightClusters::PointLight, it->pos, 1.5f);
 			break;
 		case BT_Teleport:
 			if (gOptions.fPerformance > 1) // Inhibit this for the low performance
-				fAddPointLight->Draw(it->pos, 3.0f);
+				fLightClusters->Add(LightClusters::PointLight, it->pos, 3.0f);
 			break;
 		}
 	}
+
+	glm::vec4 *list = gLightSources.GetList();
+	int count = gLightSources.GetCount();
+	for (int i=0; i < count; i++) {
+		// The 'w' component contains both the radius and the type of color.
+		int composite = int(list[i].w);
+		int radius = composite % 100;
+		int type = composite - radius;
+		// The color channels that are kept
+		glm::vec3 color;
+		switch (type) {
+		case LightSources::RedOffset:
+			color = glm::vec3(1, 0, 0);
+			break;
+		case LightSources::GreenOffset:
+			color = glm::vec3(0, 1, 0);
+			break;
+		case LightSources::BlueOffset:
+			color = glm::vec3(0, 0, 1);
+			break;
+		default:
+			continue;
+		}
+		fLightClusters->Add(LightClusters::ColoredLight, glm::vec3(list[i]), radius, color);
+	}
+
+	list = gShadows.GetList();
+	count = gShadows.GetCount();
+	for (int i=0; i < count; i++)
+		fLightClusters->Add(LightClusters::PointShadow, glm::vec3(list[i]), list[i].w);
+
+	list = gFogs.GetList();
+	count = gFogs.GetCount();
+	for (int i=0; i < count; i++)
+		fLightClusters->Add(LightClusters::LocalFog, glm::vec3(list[i]), list[i].w);
+
+	fLightClusters->Build(gViewMatrix, gProjectionMatrix, maxRenderDistance);
+}
+
+void RenderControl::drawPointLights(void) {
+	if (fLightClusters->Count(LightClusters::PointLight) == 0)
+		return;
+	static TimeMeasure tm("Pntlght");
+	tm.Start();
+	DrawBuffers(ColAttachLighting);
+	fLightClusters->BindTextures(4);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, fNormalsTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, fPositionTexture);
+	glActiveTexture(GL_TEXTURE0); // Need to restore it or everything will break.
+	glBindTexture(GL_TEXTURE_2D, fCurrentInputColor);
+	glDisable(GL_CULL_FACE);
+	glDepthMask(GL_FALSE);
+	fClusteredLights->Draw(LightClusters::PointLight, *fLightClusters);
 	glDepthMask(GL_TRUE);
 	glEnable(GL_CULL_FACE);
 	tm.Stop();
@@ -587,20 +630,20 @@ void RenderControl::drawDistanceBlurring(void) {
 }
 
 void RenderControl::drawPointShadows(void) {
+	if (fLightClusters->Count(LightClusters::PointShadow) == 0)
+		return;
 	static TimeMeasure tm("Pntshdw");
 	tm.Start();
+	fLightClusters->BindTextures(4);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, fPositionTexture);
 	glActiveTexture(GL_TEXTURE0); // Need to restore it or everything will break.
-	glm::vec4 *list = gShadows.GetList();
-	int count = gShadows.GetCount();
 	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDisable(GL_CULL_FACE);
 	glDepthMask(GL_FALSE);
 	glDisable(GL_DEPTH_TEST);
-	for (int i=0; i < count; i++) {
-		fAddPointShadow->DrawPointShadow(list[i]);
-	}
+	fClusteredLights->Draw(LightClusters::PointShadow, *fLightClusters);
 	glEnable(GL_DEPTH_TEST);
 	glDepthMask(GL_TRUE);
 	glEnable(GL_CULL_FACE);
@@ -609,22 +652,21 @@ void RenderControl::drawPointShadows(void) {
 }
 
 void RenderControl::drawLocalFog(void) {
+	if (fLightClusters->Count(LightClusters::LocalFog) == 0)
+		return;
 	static TimeMeasure tm("LclFog");
 	tm.Start();
+	fLightClusters->BindTextures(4);
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, fPositionTexture);
 	glActiveTexture(GL_TEXTURE0); // Need to restore it or everything will break.
 	glBindTexture(GL_TEXTURE_2D, fDownSampleLumTexture1);
-	glm::vec4 *list = gFogs.GetList();
-	int count = gFogs.GetCount();
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glDisable(GL_CULL_FACE);
 	glDepthMask(GL_FALSE);
 	glDisable(GL_DEPTH_TEST);
-	for (int i=0; i < count; i++) {
-		fAddLocalFog->Draw(list[i]);
-	}
+	fClusteredLights->Draw(LightClusters::LocalFog, *fLightClusters);
 	glEnable(GL_DEPTH_TEST);
 	glDepthMask(GL_TRUE);
 	glEnable(GL_CULL_FACE);
@@ -677,8 +719,11 @@ void RenderControl::drawSelection(const glm::vec3 &coord) {
 }
 
 void RenderControl::drawColoredLights() const {
+	if (fLightClusters->Count(LightClusters::ColoredLight) == 0)
+		return;
 	static TimeMeasure tm("Clrlght");
 	tm.Start();
+	fLightClusters->BindTextures(4);
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, fNormalsTexture);
 	glActiveTexture(GL_TEXTURE1);
@@ -689,26 +734,7 @@ void RenderControl::drawColoredLights() const {
 	glDisable(GL_CULL_FACE);
 	glDepthMask(GL_FALSE);
 	glDisable(GL_DEPTH_TEST);
-	glm::vec4 *list = gLightSources.GetList();
-	int count = gLightSources.GetCount();
-	for (int i=0; i < count; i++) {
-		// The 'w' component contains both the radius and the type of color.
-		int composite = int(list[i].w);
-		int radius = composite % 100;
-		int type = composite - radius;
-		list[i].w = radius; // Only radius shall be sent to the renderer.
-		switch (type) {
-		case LightSources::RedOffset:
-			fAddPointShadow->DrawRedLight(list[i]);
-			break;
-		case LightSources::GreenOffset:
-			fAddPointShadow->DrawGreenLight(list[i]);
-			break;
-		case LightSources::BlueOffset:
-			fAddPointShadow->DrawBlueLight(list[i]);
-			break;
-		}
-	}
+	fClusteredLights->Draw(LightClusters::ColoredLight, *fLightClusters);
 	glEnable(GL_DEPTH_TEST);
 	glDepthMask(GL_TRUE);
 	glEnable(GL_CULL_FACE);
@@ -26,11 +26,10 @@
 class ChunkShader;
 class AddDynamicShadow;
 class DeferredLighting;
-class AddPointLight;
 class AnimationShader;
 class AddPointShadow;
 class SkyBox;
-class AddLocalFog;
+class ClusteredLights;
 class AddSSAO;
 class MainUserInterface;
 class DownSamplingLuminance;
@@ -46,6 +45,7 @@ namespace Model {
 namespace View {
 	class ShadowRender;
 	class RenderTarget;
+	class LightClusters;
 
 /// @brief This is the top level View of the Model/View/Controller
 ///
@@ -134,9 +134,9 @@ private:
 	std::unique_ptr<AddDynamicShadow> fAddDynamicShadow;
 	std::unique_ptr<ShadowRender> fShadowRender;
 	std::unique_ptr<DeferredLighting> fDeferredLighting;
-	std::unique_ptr<AddPointLight> fAddPointLight;
 	std::unique_ptr<AddPointShadow> fAddPointShadow;
-	std::unique_ptr<AddLocalFog> fAddLocalFog;
+	std::unique_ptr<ClusteredLights> fClusteredLights;
+	std::unique_ptr<LightClusters> fLightClusters;
 	std::unique_ptr<AddSSAO> fAddSSAO;
 	std::unique_ptr<SkyBox> fSkyBox;
 	std::unique_ptr<DownSamplingLuminance> fDownSamplingLuminance;
@@ -165,6 +165,7 @@ private:
 	void drawOpaqueLandscape(bool stereoView);
 	void drawDynamicShadows(void);
 	void drawDeferredLighting(bool underWater, float whitepoint);
+	void buildLightClusters(void); // Bin all lights, shadows and fogs of this frame
 	void drawPointLights(void);
 	void drawMonsters(void);
 	void drawTransparentLandscape(bool stereoView);
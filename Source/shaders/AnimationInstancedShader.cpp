@@ -0,0 +1,109 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <GL/glew.h>
+#include <stdio.h>
+
+#include <glm/glm.hpp>
+#include "AnimationInstancedShader.h"
+#include "../primitives.h"
+
+/// Using GLSW to define shader
+static const GLchar *vertexShaderSource[] = {
+	"common.UniformBuffer",
+	"common.DoubleResolutionFunction",
+	"#define VERTEXSCALING "  STR(VERTEXSCALING) "\n", // The is the scaling factor used for vertices
+	"#define NORMALSCALING "  STR(NORMALSCALING) "\n", // The is the scaling factor used for vertices
+	"#define TEXTURESCALING "  STR(TEXTURESCALING) "\n", // The is the scaling factor used for vertices
+	"animationshader.VertexInstanced"
+};
+
+/// Using GLSW to define shader
+static const GLchar *fragmentShaderSource[] = {
+	"common.UniformBuffer",
+	"animationshader.Fragment"
+};
+
+AnimationInstancedShader *AnimationInstancedShader::Make(void) {
+	if (fgSingleton.fMeshOffsetIndex == -1) {
+		const GLsizei vertexShaderLines = sizeof(vertexShaderSource) / sizeof(GLchar*);
+		const GLsizei fragmentShaderLines = sizeof(fragmentShaderSource) / sizeof(GLchar*);
+		fgSingleton.Initglsw("AnimationInstancedShader", vertexShaderLines, vertexShaderSource, fragmentShaderLines, fragmentShaderSource);
+	}
+	return &fgSingleton;
+}
+
+void AnimationInstancedShader::PreLinkCallback(GLuint prg) {
+	// Ensure that the same index for inputs are always used (to enable the use of the same VAO on other shaders).
+	glBindAttribLocation(prg, StageOneShader::Normal, "normal");
+	glBindAttribLocation(prg, StageOneShader::Vertex, "vertex");
+	glBindAttribLocation(prg, StageOneShader::SkinWeights, "weights");
+	glBindAttribLocation(prg, StageOneShader::Joints, "joints");
+	glBindAttribLocation(prg, StageOneShader::InstanceModel, "instanceModel");
+	glBindAttribLocation(prg, StageOneShader::InstancePose, "instancePose");
+}
+
+void AnimationInstancedShader::GetLocations(void) {
+	fMeshOffsetIndex = this->GetUniformLocation("meshOffset");
+	fForShadowmap = this->GetUniformLocation("forShadowmap");
+	fShadowProjView = this->GetUniformLocation("shadowProjViewMat");
+
+	// The following uniforms only need to be initialized once
+	glUniform1i(this->GetUniformLocation("firstTexture"), 0);
+	glUniform1i(this->GetUniformLocation("bonePalette"), BonePaletteUnit);
+	checkError("AnimationInstancedShader::GetLocations");
+}
+
+void AnimationInstancedShader::MeshOffset(int offset) {
+	glUniform1i(fMeshOffsetIndex, offset);
+}
+
+void AnimationInstancedShader::Shadowmap(bool enable, const glm::mat4 &projectionview) {
+	glUniform1i(fForShadowmap, enable);
+	glUniformMatrix4fv(fShadowProjView, 1, GL_FALSE, &projectionview[0][0]);
+}
+
+void AnimationInstancedShader::InstanceModelAttribPointer(int first) {
+	const GLsizei stride = sizeof (Instance);
+	const char *base = (const char *)(first * sizeof (Instance));
+	// A matrix attribute uses four consecutive locations, one for each column.
+	for (int i=0; i<4; i++) {
+		glVertexAttribPointer(StageOneShader::InstanceModel+i, 4, GL_FLOAT, GL_FALSE, stride, base + i*sizeof (glm::vec4));
+		glVertexAttribDivisor(StageOneShader::InstanceModel+i, 1);
+		glEnableVertexAttribArray(StageOneShader::InstanceModel+i);
+	}
+	glVertexAttribIPointer(StageOneShader::InstancePose, 1, GL_INT, stride, base + sizeof (glm::mat4));
+	glVertexAttribDivisor(StageOneShader::InstancePose, 1);
+	glEnableVertexAttribArray(StageOneShader::InstancePose);
+}
+
+void AnimationInstancedShader::DisableInstanceModelAttrib(void) {
+	for (int i=0; i<4; i++)
+		glDisableVertexAttribArray(StageOneShader::InstanceModel+i);
+	glDisableVertexAttribArray(StageOneShader::InstancePose);
+}
+
+AnimationInstancedShader::AnimationInstancedShader() {
+	fMeshOffsetIndex = -1;
+	fForShadowmap = -1;
+	fShadowProjView = -1;
+}
+
+AnimationInstancedShader::~AnimationInstancedShader() {
+}
+
+AnimationInstancedShader AnimationInstancedShader::fgSingleton;
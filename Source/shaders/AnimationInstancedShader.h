@@ -0,0 +1,68 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+//
+// A shader program used for drawing many instances of an animated model in one draw call.
+// The model matrix and the pose are defined per instance, and the bone matrices of all poses
+// are found in a texture buffer. This is a singleton class.
+//
+
+#include "StageOneShader.h"
+
+class AnimationInstancedShader : public StageOneShader {
+public:
+	static AnimationInstancedShader *Make(void);
+
+	/// The data for each instance. The pose is the index of the first bone matrix of the pose.
+	struct Instance {
+		glm::mat4 model;
+		GLint pose;
+	};
+
+	/// The model matrix is defined per instance, see InstanceModelAttribPointer().
+	virtual void Model(const glm::mat4 &) {}
+
+	/// Set the offset from the first bone matrix of a pose to the bones of the current mesh.
+	void MeshOffset(int offset);
+
+	/// The texture unit used for the bone matrices.
+	enum { BonePaletteUnit = 1 };
+
+	// Set to true if the shader is going to be used for making a shadow map
+	void Shadowmap(bool, const glm::mat4 &projectionview);
+
+	// Use a buffer of Instance as per instance data, starting at instance 'first'. A vertex array object
+	// and the buffer must be bound.
+	static void InstanceModelAttribPointer(int first);
+
+	// Stop using per instance data in the currently bound vertex array object.
+	static void DisableInstanceModelAttrib(void);
+protected:
+	virtual void PreLinkCallback(GLuint prg);
+
+private:
+	// Callback that defines all uniform and attribute indices.
+	virtual void GetLocations(void);
+	AnimationInstancedShader(); // Only allow access through the maker.
+	virtual ~AnimationInstancedShader(); // Don't allow destruction as this is a singleton.
+	static AnimationInstancedShader fgSingleton; // This is the singleton instance
+
+	GLint fMeshOffsetIndex;
+	GLint fForShadowmap, fShadowProjView;
+};
@@ -53,6 +53,7 @@ void ChunkShader::PreLinkCallback(GLuint prg) {
 	glBindAttribLocation(prg, StageOneShader::Normal, "normal");
 	glBindAttribLocation(prg, StageOneShader::Vertex, "vertex");
 	glBindAttribLocation(prg, StageOneShader::Material, "material");
+	glBindAttribLocation(prg, StageOneShader::InstanceOffset, "instanceOffset");
 }
 
 void ChunkShader::GetLocations(void) {
@@ -44,6 +44,18 @@ void StageOneShader::EnableVertexAttribArray(bool useBones) {
 	}
 }
 
+void StageOneShader::InstanceAttribPointer(int first) {
+	glVertexAttribPointer(StageOneShader::InstanceOffset, 3, GL_FLOAT, GL_FALSE, sizeof (glm::vec3), (void *)(first * sizeof (glm::vec3)));
+	glVertexAttribDivisor(StageOneShader::InstanceOffset, 1);
+	glEnableVertexAttribArray(StageOneShader::InstanceOffset);
+}
+
+void StageOneShader::DisableInstanceAttrib(void) {
+	glDisableVertexAttribArray(StageOneShader::InstanceOffset);
+	// When not drawing instanced, the shader will use this constant offset.
+	glVertexAttrib3f(StageOneShader::InstanceOffset, 0.0f, 0.0f, 0.0f);
+}
+
 void StageOneShader::EnableProgram(void) {
 	glUseProgram(this->Program());
 }
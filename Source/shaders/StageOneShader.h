@@ -21,7 +21,9 @@
 class StageOneShader: public ShaderBase {
 public:
 	enum InputLocations {
-		Normal, Vertex, SkinWeights, Joints, Material
+		Normal, Vertex, SkinWeights, Joints, Material, InstanceOffset,
+		InstanceModel, // A matrix, which uses four locations
+		InstancePose = InstanceModel+4
 	};
 
 	virtual void Model(const glm::mat4 &) = 0;// Define the Model matrix
@@ -40,6 +42,13 @@ public:
 	// If bones are used, VertexAttribPointerSkinWeights() also has to be called.
 	static void EnableVertexAttribArray(bool useBones = false);
 
+	// Use a buffer of glm::vec3 as a per instance offset, starting at instance 'first'. The offset is added
+	// after the model matrix has been applied. A vertex array object and the buffer must be bound.
+	static void InstanceAttribPointer(int first);
+
+	// Stop using per instance offsets in the currently bound vertex array object.
+	static void DisableInstanceAttrib(void);
+
 	virtual void EnableProgram(void);
 	void DisableProgram(void);
 };
@@ -56,6 +56,58 @@ void main(void)
 	gl_Position = pos;
 }
 
+-- VertexInstanced
+
+// The same as the vertex shader above, but the model matrix and the pose are given for each instance.
+// The bone matrices of all poses are saved in a texture buffer, using four texels for every matrix.
+uniform samplerBuffer bonePalette;
+uniform int meshOffset;   // Offset from the first matrix of a pose to the matrices of the current mesh
+uniform bool forShadowmap = false;
+uniform mat4 shadowProjViewMat;
+in vec4 normal;
+in vec4 vertex; // First 3 are vertex coordinates, the 4:th is texture data coded as two scaled bytes
+in vec3 weights;
+in vec3 joints;
+in mat4 instanceModel;
+in int instancePose;      // The index of the first matrix of the pose
+out vec3 fragmentNormal;
+out vec2 fragmentTexCoord;
+out float extIntensity;
+out float extAmbientLight;
+out vec3 position;
+
+mat4 Bone(float joint) {
+	int ind = (instancePose + meshOffset + int(joint)) * 4;
+	return mat4(texelFetch(bonePalette, ind), texelFetch(bonePalette, ind+1), texelFetch(bonePalette, ind+2), texelFetch(bonePalette, ind+3));
+}
+
+void main(void)
+{
+	vec4 vertexScaled = vec4(vec3(vertex) / VERTEXSCALING, 1);
+	int t1 = int(vertex[3]); // Extract the texture data
+	vec2 tex = vec2(t1&0xFF, t1>>8);
+	vec2 textureScaled = tex / TEXTURESCALING;
+	vec3 normalScaled = normal.xyz / NORMALSCALING;
+	int intens2 = int(normal[3]); // Bit 0 to 3 is sun intensity, 4 to 7 is ambient light
+	if (intens2 < 0) intens2 += 256;
+	mat4 animationMatrix = weights[0] * Bone(joints[0]) + weights[1] * Bone(joints[1]) + weights[2] * Bone(joints[2]);
+	mat4 newModel = instanceModel * animationMatrix;
+	vec4 pos;
+	if (forShadowmap) {
+		pos = shadowProjViewMat * newModel * vertexScaled;
+		pos.xy = DoubleResolution(pos.xy);
+	} else {
+		pos = UBOProjectionviewMatrix * newModel * vertexScaled;
+		// Scale the intensity from [0..255] to [0..1].
+		fragmentTexCoord = textureScaled;
+		extIntensity = (intens2 & 0x0F)/15.0;
+		extAmbientLight = (intens2 >> 4)/15.0;
+		fragmentNormal = normalize((newModel*vec4(normalScaled, 0.0)).xyz);
+	}
+	position = vec3(newModel * vertexScaled); // Copy position to the fragment shader
+	gl_Position = pos;
+}
+
 -- Fragment
 
 uniform sampler2D firstTexture;
@@ -31,6 +31,7 @@ uniform vec3 textOffsMulti = vec3(0,0,1);
 in vec4 normal;
 in vec4 vertex; // First 3 are vertex coordinates, the 4:th is texture data coded as two scaled bytes
 in int material;
+in vec3 instanceOffset; // Used for instanced drawing, otherwise 0
 out vec3 fragmentNormal;
 out vec2 fragmentTexCoord;
 out float extIntensity;
@@ -48,8 +49,9 @@ void main(void)
 	float textMult = textOffsMulti.z;
 	fragmentTexCoord = textureScaled*textMult + textOffsMulti.xy;
 	fragmentNormal = normalize((modelMatrix*vec4(normal.xyz/NORMALSCALING, 0.0)).xyz);
-	gl_Position = UBOProjectionviewMatrix * modelMatrix * vertexScaled;
-	position = vec3(modelMatrix * vertexScaled); // Copy position to the fragment shader
+	vec4 worldPos = modelMatrix * vertexScaled + vec4(instanceOffset, 0);
+	gl_Position = UBOProjectionviewMatrix * worldPos;
+	position = vec3(worldPos); // Copy position to the fragment shader
 	// Scale the intensity from [0..255] to [0..1].
 	extIntensity = (intens2 & 0x0F)/15.0;
 	// "	extIntensity = 0.1;
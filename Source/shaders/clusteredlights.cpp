@@ -0,0 +1,79 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <GL/glew.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glm/glm.hpp>
+#include "../primitives.h"
+#include "clusteredlights.h"
+#include "../ui/Error.h"
+#include "../shapes/quad.h"
+#include "../lightclusters.h"
+
+/// Using GLSW to define shader
+static const GLchar *vertexShaderSource[] = {
+	"clusteredlights.Vertex"
+};
+
+/// Using GLSW to define shader
+static const GLchar *fragmentShaderSource[] = {
+	"common.UniformBuffer",
+	"common.DistanceAlphaBlending",
+	"clusteredlights.Fragment"
+};
+
+ClusteredLights::ClusteredLights() {
+	fModeIdx = -1; fClusterDepthIdx = -1;
+	fPreviousMode = -1;
+}
+
+void ClusteredLights::Init(void) {
+	const GLsizei vertexShaderLines = sizeof(vertexShaderSource) / sizeof(GLchar*);
+	const GLsizei fragmentShaderLines = sizeof(fragmentShaderSource) / sizeof(GLchar*);
+	ShaderBase::Initglsw("ClusteredLights", vertexShaderLines, vertexShaderSource, fragmentShaderLines, fragmentShaderSource);
+	checkError("ClusteredLights::Init");
+}
+
+void ClusteredLights::GetLocations(void) {
+	fModeIdx = this->GetUniformLocation("Umode");
+	fClusterDepthIdx = this->GetUniformLocation("UclusterDepth");
+
+	// The following uniforms only need to be initialized once
+	glUniform1i(this->GetUniformLocation("lumTex"), 0);
+	glUniform1i(this->GetUniformLocation("posTex"), 1);
+	glUniform1i(this->GetUniformLocation("normalTex"), 2);
+	glUniform1i(this->GetUniformLocation("lightTex"), 4);
+	glUniform1i(this->GetUniformLocation("clusterTex"), 5);
+	glUniform1i(this->GetUniformLocation("lightIndexTex"), 6);
+	glUniform3i(this->GetUniformLocation("UclusterGrid"), View::LightClusters::TilesX, View::LightClusters::TilesY, View::LightClusters::Slices);
+
+	checkError("ClusteredLights::GetLocations");
+}
+
+void ClusteredLights::Draw(int kind, const View::LightClusters &clusters) {
+	glUseProgram(this->Program());
+	if (fPreviousMode != kind) {
+		// Remember which was the previous state, to minimize updates
+		fPreviousMode = kind;
+		glUniform1i(fModeIdx, fPreviousMode);
+	}
+	glUniform2f(fClusterDepthIdx, clusters.NearDepth(), clusters.DepthScale());
+	gQuad.Draw();
+	glUseProgram(0);
+}
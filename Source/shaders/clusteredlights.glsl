@@ -0,0 +1,160 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+
+-- Vertex
+
+// This vertex shader will only draw two triangles, giving a full screen.
+// The vertex input is 0,0 in one corner and 1,1 in the other.
+in vec2 vertex;
+out vec2 screen;                          // Screen coordinate
+void main(void)
+{
+	gl_Position = vec4(vertex*2-1, 0, 1); // Transform from interval 0 to 1, to interval -1 to 1.
+	screen = vertex;                      // Copy position to the fragment shader. Only x and y is needed.
+}
+
+-- Fragment
+
+// All lights of the selected kind are combined into one output, giving the same result as if they had been
+// blended one at a time:
+// Mode 0: Point lights, added together.
+// Mode 1: Colored lights, multiplying the color channels.
+// Mode 2: Point shadows below trees, monsters and players. The alpha values are combined.
+// Mode 3: Local fogs. The alpha values are combined, and the luminance is the same for all fogs.
+uniform sampler2D lumTex;          // The blurred luminance map.
+uniform sampler2D posTex;          // World position
+uniform sampler2D normalTex;       // Normals
+uniform samplerBuffer lightTex;    // Two texels for every light. The first is position and radius, the second is the color.
+uniform usamplerBuffer clusterTex; // For every cluster, the index of the first light of every mode. The next cluster defines the end.
+uniform usamplerBuffer lightIndexTex; // Index of the lights in all clusters
+uniform ivec3 UclusterGrid;        // Number of tiles in x and y, and number of depth slices
+uniform vec2 UclusterDepth;        // The depth of the first slice, and the scaling of the logarithmic slices
+uniform int Umode;
+in vec2 screen;                    // The screen position
+layout (location = 0) out vec4 color;
+
+// Compute the cluster of a world position.
+int FindCluster(vec3 worldPos) {
+	float depth = -(UBOViewMatrix * vec4(worldPos, 1)).z;
+	int slice = 0;
+	if (depth > UclusterDepth.x)
+		slice = min(int(log(depth/UclusterDepth.x)*UclusterDepth.y), UclusterGrid.z-1);
+	ivec2 tile = clamp(ivec2(screen*UclusterGrid.xy), ivec2(0), UclusterGrid.xy-1);
+	return (slice*UclusterGrid.y + tile.y)*UclusterGrid.x + tile.x;
+}
+
+// The length of the ray from the camera to the pixel that is inside of the fog.
+float FogRayLength(vec3 worldPos, float vertexDistance, vec4 fog, float radius) {
+	float dist = 0;
+	float cameraToFogDist = distance(UBOCamera.xyz, fog.xyz);
+	if (vertexDistance + radius < cameraToFogDist) return 0; // Quick test if fog is too far away.
+	float pixelToFogDist = distance(worldPos, fog.xyz);
+	if (cameraToFogDist < radius && pixelToFogDist < radius) {
+		dist = vertexDistance; // Simple case, camera and pixel completely inside fog
+	} else {
+		vec3 l = normalize(worldPos-UBOCamera.xyz);
+		float ldotc = dot(l,fog.xyz-UBOCamera.xyz);
+		float tmp = ldotc*ldotc - cameraToFogDist*cameraToFogDist + radius*radius;
+		if (cameraToFogDist > radius && pixelToFogDist > radius && ldotc > 0 && tmp > 0) {
+			float sqrttmp = sqrt(tmp);
+			vec3 entrance = UBOCamera.xyz + l*(ldotc-sqrttmp);
+			if (vertexDistance > distance(UBOCamera.xyz, entrance)) dist = sqrttmp*2;
+		} else if (cameraToFogDist > radius && pixelToFogDist < radius) {
+			vec3 entrance = UBOCamera.xyz + l*(ldotc-sqrt(tmp)); // Outside of fog, looking at pixel inside
+			dist = distance(entrance, worldPos);
+		} else if (cameraToFogDist < radius && pixelToFogDist > radius) {
+			vec3 exit = UBOCamera.xyz + l*(ldotc+sqrt(tmp)); // Inside of fog, looking at pixel outside
+			dist = distance(exit, UBOCamera.xyz);
+		}
+	}
+	return dist;
+}
+
+void main(void)
+{
+	vec4 worldPos = texture(posTex, screen);
+	int cluster = FindCluster(worldPos.xyz);
+	uvec4 start = texelFetch(clusterTex, cluster);
+	int first = int(start[Umode]);
+	int last;
+	if (Umode == 3)
+		last = int(texelFetch(clusterTex, cluster+1).x);
+	else
+		last = int(start[Umode+1]);
+	if (first == last) { discard; return; }
+
+	vec3 normal = texture(normalTex, screen).xyz;
+	float cameraToWorldDistance = length(UBOCamera.xyz-worldPos.xyz);
+	float alpha = DistanceAlphaBlending(UBOViewingDistance, cameraToWorldDistance);
+	// Add some small random delta to the fog radius
+	float delta = (fract(screen.x*812219.65 + screen.y*242328.123)+fract(cameraToWorldDistance*3122.323))*0.3;
+
+	float light = 0;           // Mode 0, the sum of all lights
+	vec3 tint = vec3(1);       // Mode 1, the product of all color changes
+	float transparency = 1;    // Mode 2 and 3, the product of (1-alpha) for all shadows or fogs
+	for (int i=first; i<last; i++) {
+		int idx = int(texelFetch(lightIndexTex, i).r);
+		vec4 point = texelFetch(lightTex, idx*2);
+		float dist = distance(worldPos.xyz, point.xyz);
+		float radius = point.w;
+		switch(Umode) {
+		case 0: // Point light
+			if (dist < radius) {
+				vec3 lampVector = normalize(worldPos.xyz - point.xyz);
+				float mult = clamp(-dot(lampVector, normal), 0, 1);
+				light += 1.5*(1 - dist/radius)*mult;
+			}
+			break;
+		case 1: // Colored light, where the color has 1 for the channels that are kept
+			if (dist < radius) {
+				float f = min(dist/radius/2+0.5, 1);   // 'f' goes from 0.5 to 1, depending on distance.
+				f = 1 - (1-f)*alpha;                   // Blend between colored light radius fading, and skybox distance fading.
+				tint *= mix(vec3(f), vec3(1), texelFetch(lightTex, idx*2+1).rgb);
+			}
+			break;
+		case 2: // Static shadow below trees, monsters and players
+			if (dist < radius && worldPos.y - point.y <= 0.3) { // Don't draw shadow too high on the object itself.
+				float f = (1 - dist/radius)/1.1;       // 'f' goes from 0.91 to 0, depending on distance.
+				transparency *= 1 - alpha*f;
+			}
+			break;
+		case 3: { // Local fog
+			radius += delta;
+			float fogDist = FogRayLength(worldPos.xyz, cameraToWorldDistance, point, radius);
+			// For blending this fog into the far distance, use distance to fog center as criteria, not the pixel behind the fog.
+			float distanceBlending = DistanceAlphaBlending(UBOViewingDistance, distance(UBOCamera.xyz, point.xyz));
+			transparency *= 1 - 0.25*fogDist*fogDist/radius/radius*distanceBlending;
+			break;
+		}
+		}
+	}
+	switch(Umode) {
+	case 0:
+		color = vec4(light, light, light, 1);
+		break;
+	case 1:
+		color = vec4(tint, 1);
+		break;
+	case 2:
+		color = vec4(0, 0, 0, 1-transparency);
+		break;
+	case 3: {
+		float luminance = texture(lumTex, screen).r * 1.05; // Add a small offset to get a little whiter fogs.
+		color = vec4(luminance, luminance, luminance, 1-transparency);
+		break;
+	}
+	}
+}
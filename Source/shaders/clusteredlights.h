@@ -0,0 +1,54 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "shader.h"
+
+namespace View {
+	class LightClusters;
+}
+
+/**
+ * @brief A full screen shader that applies all local light effects of one kind
+ *
+ * The lights are found from the clusters of View::LightClusters, which have to be
+ * bound to texture units 4, 5 and 6. The world positions are expected in unit 1, the normals
+ * in unit 2 and the blurred luminance map (for fogs) in unit 0.
+ *
+ * Proper blending mode has to be configured, depending on the kind:
+ * - Point lights are added to the light map.
+ * - Colored lights are multiplied with the color.
+ * - Point shadows and fogs are alpha blended.
+ */
+class ClusteredLights : public ShaderBase {
+public:
+	ClusteredLights();
+
+	void Init();
+
+	/// Apply all lights of one kind.
+	/// @param kind One of View::LightClusters::Kind
+	/// @param clusters The lights, binned for the current view
+	void Draw(int kind, const View::LightClusters &clusters);
+private:
+	// Callback that defines all uniform and attribute indices.
+	virtual void GetLocations(void);
+
+	GLint fModeIdx, fClusterDepthIdx;
+	int fPreviousMode;
+};
@@ -23,6 +23,14 @@
 #include <GL/glew.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <string>
+#include <memory>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef WIN32
+#include <windows.h>
+#endif
 
 #include "shader.h"
 #include "../uniformbuffer.h"
@@ -31,6 +39,134 @@
 #include "../Debug.h"
 #include "../assert.h"
 #include "../primitives.h"
+#include "../Hash.h"
+#include "../Clock.h"
+
+// The program binary cache. There is one file for every program, which is replaced when it is stale.
+// Binaries depend on the driver, and are only used with the same vendor, renderer and version. The bindings
+// done by PreLinkCallback() are not part of the source, so binaries are also only used with the same executable.
+#define SHADERCACHE_VERSION 2
+
+struct ShaderCacheHeader {
+	char magic[4];
+	unsigned version;
+	unsigned long long key; // Hash of the driver, the executable and the source
+	GLenum binaryFormat;
+	GLint length; // Number of bytes of binary data that follows
+};
+
+static const char sMagic[4] = { 'E', 'P', 'H', 'S' };
+static std::string sCacheDir;          // Empty if there is no cache
+static bool sCacheChecked = false;     // True when sDriverHash is computed and the cache is checked to be supported
+static unsigned long long sDriverHash; // Identifies the driver and the executable
+
+// The binaries can't be used if the driver is updated, or if the executable is different.
+static unsigned long long DriverHash(void) {
+	const unsigned version = SHADERCACHE_VERSION;
+	unsigned long long hash = HashBytes(&version, sizeof version);
+	const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : names) {
+		const char *str = (const char *)glGetString(name);
+		if (str != 0)
+			hash = HashBytes(str, strlen(str)+1, hash);
+	}
+#ifdef WIN32
+	char exe[MAX_PATH];
+	if (GetModuleFileNameA(NULL, exe, sizeof exe) == 0)
+		exe[0] = 0;
+#else
+	const char *exe = "/proc/self/exe";
+#endif
+	struct stat st;
+	if (stat(exe, &st) == 0) {
+		unsigned long long stamp[2] = { (unsigned long long)st.st_size, (unsigned long long)st.st_mtime };
+		hash = HashBytes(stamp, sizeof stamp, hash);
+	}
+	return hash;
+}
+
+static std::string CacheFileName(const char *debug) {
+	return sCacheDir + debug + ".bin";
+}
+
+// Check that program binaries are supported. Can only be done when there is an OpenGL context.
+static bool CacheEnabled(void) {
+	if (!sCacheChecked) {
+		sCacheChecked = true;
+		GLint formats = 0;
+		if (GLEW_ARB_get_program_binary)
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats == 0) {
+			if (gVerbose)
+				printf("ShaderBase: Program binaries not supported, no shader cache\n");
+			sCacheDir.clear();
+		}
+		sDriverHash = DriverHash();
+	}
+	return !sCacheDir.empty();
+}
+
+// Create a program from a cached binary. Return 0 if there is none, if it is stale, or if the driver doesn't accept it.
+static GLuint LoadProgramBinary(const char *debug, unsigned long long key) {
+	FILE *f = fopen(CacheFileName(debug).c_str(), "rb");
+	if (f == 0)
+		return 0;
+	ShaderCacheHeader header;
+	std::unique_ptr<char[]> data;
+	bool ok = fread(&header, sizeof header, 1, f) == 1 && memcmp(header.magic, sMagic, sizeof sMagic) == 0 &&
+	          header.version == SHADERCACHE_VERSION && header.key == key && header.length > 0;
+	if (ok) {
+		data.reset(new char[header.length]);
+		ok = fread(data.get(), 1, header.length, f) == size_t(header.length);
+	}
+	fclose(f);
+	if (!ok)
+		return 0;
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, data.get(), header.length);
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status == GL_FALSE) {
+		glDeleteProgram(program); // The driver rejected it, probably changed in a way not visible in the version
+		return 0;
+	}
+	return program;
+}
+
+static void SaveProgramBinary(const char *debug, unsigned long long key, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::unique_ptr<char[]> data(new char[sizeof (ShaderCacheHeader) + length]);
+	ShaderCacheHeader *header = reinterpret_cast<ShaderCacheHeader *>(data.get());
+	memcpy(header->magic, sMagic, sizeof sMagic);
+	header->version = SHADERCACHE_VERSION;
+	header->key = key;
+	glGetProgramBinary(program, length, &header->length, &header->binaryFormat, data.get() + sizeof (ShaderCacheHeader));
+	if (header->length <= 0)
+		return;
+
+	// Write to a temporary name first, so that a broken file is never used.
+	std::string name = CacheFileName(debug);
+	std::string tmpName = name + ".tmp";
+	FILE *f = fopen(tmpName.c_str(), "wb");
+	if (f == 0)
+		return;
+	size_t size = sizeof (ShaderCacheHeader) + header->length;
+	bool ok = fwrite(data.get(), 1, size, f) == size;
+	if (fclose(f) != 0)
+		ok = false;
+	remove(name.c_str()); // Rename doesn't replace on Windows
+	if (!ok || rename(tmpName.c_str(), name.c_str()) != 0)
+		remove(tmpName.c_str());
+}
+
+void ShaderBase::SetCacheDir(const std::string &dirName) {
+	if (!CreateCacheDir(dirName.c_str()))
+		return; // No cache
+	sCacheDir = dirName;
+}
 
 void ShaderBase::Initglsw(const char *debug, int vertexShaderLines, const char **vertexShaderSource, int fragmentShaderLines, const char **fragmentShaderSource) {
 	const char *loadedVertexLines[vertexShaderLines+1];
@@ -61,11 +197,37 @@ void ShaderBase::Initglsw(const char *debug, int vertexShaderLines, const char *
 }
 
 void ShaderBase::Init(const char *debug, int vertexShaderLines, const char **vertexShaderSource, int fragmentShaderLines, const char **fragmentShaderSource) {
-	GLuint vertexShader = compileShaderSource (GL_VERTEX_SHADER, vertexShaderLines, vertexShaderSource);
-	GLuint fragmentShader = compileShaderSource (GL_FRAGMENT_SHADER, fragmentShaderLines, fragmentShaderSource);
+	double start = GetTime();
+	unsigned long long key = 0;
+	fProgram = 0;
+	bool useCache = CacheEnabled();
+	if (useCache) {
+		// The key is made from all of the source, and the driver.
+		key = sDriverHash;
+		for (int i=0; i<vertexShaderLines; i++)
+			key = HashBytes(vertexShaderSource[i], strlen(vertexShaderSource[i]), key);
+		key = HashBytes("", 1, key); // Separate the vertex shader from the fragment shader
+		for (int i=0; i<fragmentShaderLines; i++)
+			key = HashBytes(fragmentShaderSource[i], strlen(fragmentShaderSource[i]), key);
+		fProgram = LoadProgramBinary(debug, key);
+	}
+
+	if (fProgram != 0) {
+		if (gVerbose)
+			printf("ShaderBase::Init %s: loaded program binary in %.1f ms\n", debug, (GetTime()-start)*1000.0);
+	} else {
+		GLuint vertexShader = compileShaderSource (GL_VERTEX_SHADER, vertexShaderLines, vertexShaderSource);
+		GLuint fragmentShader = compileShaderSource (GL_FRAGMENT_SHADER, fragmentShaderLines, fragmentShaderSource);
+		double compiled = GetTime();
 
-	fProgram = createProgram(debug, vertexShader, fragmentShader);
-	// TODO: glDeleteShader() could probably be called here.
+		fProgram = createProgram(debug, vertexShader, fragmentShader, useCache);
+		// TODO: glDeleteShader() could probably be called here.
+		double linked = GetTime();
+		if (useCache)
+			SaveProgramBinary(debug, key, fProgram);
+		if (gVerbose)
+			printf("ShaderBase::Init %s: compiled in %.1f ms, linked in %.1f ms\n", debug, (compiled-start)*1000.0, (linked-compiled)*1000.0);
+	}
 	glUseProgram(fProgram);
 
 #if 1
@@ -148,8 +310,10 @@ void ShaderBase::linkAndCheck(const char *debug, GLuint program) {
 	}
 }
 
-GLuint ShaderBase::createProgram(const char *debug, GLuint vertexShader, GLuint fragmentShader) {
+GLuint ShaderBase::createProgram(const char *debug, GLuint vertexShader, GLuint fragmentShader, bool retrievable) {
 	GLuint program = glCreateProgram ();
+	if (retrievable)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	if (vertexShader != 0) {
 		glAttachShader (program, vertexShader);
 	}
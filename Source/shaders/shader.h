@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <string>
+
 /**
  * @class ShaderBase
  * @brief An abstract shader class. Inherit it to create new shader programs.
@@ -34,6 +36,12 @@ public:
 	 * @brief Same as Init(), but process all lines with the glsw shader wrangler.
 	 */
 	void Initglsw(const char *debug, int vertexShaderLines, const char **vertexShaderSource, int fragmentShaderLines, const char **fragmentShaderSource);
+
+	/**
+	 * @brief Define where to save linked program binaries. They are used instead of compiling, when the source is unchanged.
+	 * The directory is created if it doesn't exist.
+	 */
+	static void SetCacheDir(const std::string &);
 protected:
 	GLuint Program(void) const { return this->fProgram; }
 
@@ -44,6 +52,7 @@ protected:
 
 	/**
 	 * @brief A callback called before linkage, that can optionally be overrided.
+	 * It isn't called when the program is taken from the program binary cache.
 	 */
 	virtual void PreLinkCallback(GLuint prg) {};
 
@@ -67,5 +76,5 @@ private:
 	void compileAndCheck(GLuint shader);
 	GLuint compileShaderSource(GLenum type, GLsizei count, const GLchar **string);
 	void linkAndCheck(const char *debug, GLuint program);
-	GLuint createProgram(const char *debug, GLuint vertexShader, GLuint fragmentShader);
+	GLuint createProgram(const char *debug, GLuint vertexShader, GLuint fragmentShader, bool retrievable);
 };
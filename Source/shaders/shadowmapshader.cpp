@@ -63,6 +63,7 @@ void ShadowMapShader::PreLinkCallback(GLuint prg) {
 	glBindAttribLocation(prg, StageOneShader::Vertex, "vertex");
 	glBindAttribLocation(prg, StageOneShader::SkinWeights, "weights");
 	glBindAttribLocation(prg, StageOneShader::Joints, "joints");
+	glBindAttribLocation(prg, StageOneShader::InstanceOffset, "instanceOffset");
 }
 
 void ShadowMapShader::GetLocations(void) {
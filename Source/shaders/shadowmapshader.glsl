@@ -22,6 +22,7 @@ uniform mat4 modelMatrix;
 // of atlas bitmaps.
 uniform vec3 textOffsMulti = vec3(0,0,1);
 in vec4 vertex; // First 3 are vertex coordinates, the 4:th is texture data coded as two scaled bytes
+in vec3 instanceOffset; // Used for instanced drawing, otherwise 0
 out vec2 fragmentTexCoord;
 void main(void)
 {
@@ -29,7 +30,7 @@ void main(void)
 	int t1 = int(vertex[3]); // Extract the texture data
 	vec2 tex = vec2(t1&0xFF, t1>>8);
 	vec2 textureScaled = tex / TEXTURESCALING;
-	vec4 pos = projectionViewMatrix * modelMatrix * vertexScaled;
+	vec4 pos = projectionViewMatrix * (modelMatrix * vertexScaled + vec4(instanceOffset, 0));
 	pos.xy = DoubleResolution(pos.xy);
 	gl_Position = pos;
 	float textMult = textOffsMulti.z;
@@ -22,6 +22,7 @@
 #include <glm/gtx/transform2.hpp>
 #include "shaders/shadowmapshader.h"
 #include "shaders/AnimationShader.h"
+#include "shaders/AnimationInstancedShader.h"
 #include "shaders/gaussblur.h"
 #include "primitives.h"
 #include "render.h"
@@ -109,10 +110,16 @@ void ShadowRender::Render(int width, int height, const AnimationModels *animatio
 
 	if (gOptions.fDynamicShadows) {
 		// Don't render dynamic objects in static shadow mode
+		AnimationInstancedShader *instanced = AnimationInstancedShader::Make();
+		instanced->EnableProgram();
+		instanced->Shadowmap(true, fProjViewMatrix);
+		Model::gMonsters.RenderMonsters(true, false, animationModels, fProjViewMatrix);
+		instanced->EnableProgram(); // The program is disabled after drawing the monsters.
+		instanced->Shadowmap(false, fProjViewMatrix);
+
 		AnimationShader *anim = AnimationShader::Make();
 		anim->EnableProgram();
 		anim->Shadowmap(true, fProjViewMatrix);
-		Model::gMonsters.RenderMonsters(true, false, animationModels);
 		Model::gPlayer.Draw(anim, fShader.get(), false, animationModels);
 		anim->EnableProgram(); // This is lost in the player drawing for weapons.
 		anim->Shadowmap(false, fProjViewMatrix);
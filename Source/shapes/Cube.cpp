@@ -152,6 +152,17 @@ void Cube::Draw(void) const {
 	gDrawnQuads += fVisibleTriangles.size();
 }
 
+void Cube::DrawInstanced(const OpenglBuffer &instances, int first, int count) const {
+	glBindVertexArray(fVao);
+	instances.BindArray();
+	StageOneShader::InstanceAttribPointer(first);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, fVisibleTriangles.size()*3, count);
+	gNumDraw++;
+	StageOneShader::DisableInstanceAttrib();
+	glBindVertexArray(0);
+	gDrawnQuads += fVisibleTriangles.size() * count;
+}
+
 void Cube::DrawLines(void) const {
 	glBindVertexArray(fVao);
 	glDrawArrays(GL_LINES, 0, fVisibleTriangles.size()*3);
@@ -29,6 +29,8 @@ public:
 	// Create a list of triangles representing a cube. The size is a unit size.
 	void Init(bool invertedNormals = false);
 	void Draw(void) const; // Draw a cube, using the currently bound texture0.
+	// Draw 'count' cubes, using per instance offsets from 'instances' starting at 'first'.
+	void DrawInstanced(const OpenglBuffer &instances, int first, int count) const;
 	void DrawLines(void) const; // Only draw the edges of the cube.
 private:
 	std::vector<TriangleSurfacef> fVisibleTriangles;
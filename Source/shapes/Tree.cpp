@@ -44,36 +44,46 @@ Tree::~Tree() {
 	}
 }
 
-void Tree::InitStatic() {
-	if (!sfInitialized) {
-		sfInitialized = true;
+void Tree::CreateStatic() {
+	if (!sfCreated) {
+		sfCreated = true;
 		switch (gOptions.fPerformance) {
 		default:
 		case 1:
-			sfBigTree.Init(3, 5, 10.0f);
-			sfMediumTree.Init(2, 4, 6.0f);
-			sfSmallTree.Init(2, 4, 3.0f);
+			sfBigTree.Create(3, 5, 10.0f);
+			sfMediumTree.Create(2, 4, 6.0f);
+			sfSmallTree.Create(2, 4, 3.0f);
 			break;
 		case 2:
-			sfBigTree.Init(4, 4, 10.0f);
-			sfMediumTree.Init(3, 4, 6.0f);
-			sfSmallTree.Init(3, 3, 3.0f);
+			sfBigTree.Create(4, 4, 10.0f);
+			sfMediumTree.Create(3, 4, 6.0f);
+			sfSmallTree.Create(3, 3, 3.0f);
 			break;
 		case 3:
-			sfBigTree.Init(4, 5, 10.0f);
-			sfMediumTree.Init(4, 4, 6.0f);
-			sfSmallTree.Init(3, 4, 3.0f);
+			sfBigTree.Create(4, 5, 10.0f);
+			sfMediumTree.Create(4, 4, 6.0f);
+			sfSmallTree.Create(3, 4, 3.0f);
 			break;
 		case 4:
-			sfBigTree.Init(4, 6, 10.0f);
-			sfMediumTree.Init(4, 5, 6.0f);
-			sfSmallTree.Init(4, 4, 3.0f);
+			sfBigTree.Create(4, 6, 10.0f);
+			sfMediumTree.Create(4, 5, 6.0f);
+			sfSmallTree.Create(4, 4, 3.0f);
 			break;
 		}
 	}
 }
 
-// Don't save leafs to 'this', it will be done by the top node (in the Init function).
+void Tree::InitStatic() {
+	CreateStatic(); // In case it wasn't done in advance
+	if (!sfInitialized) {
+		sfInitialized = true;
+		sfBigTree.Init();
+		sfMediumTree.Init();
+		sfSmallTree.Init();
+	}
+}
+
+// Don't save leafs to 'this', it will be done by the top node (in the Create function).
 void Tree::iter(const glm::mat4 &transf, int numIter, int branching, float height) {
 	if (numIter == 0) {
 		this->AddOneLeaf(transf, height);
@@ -97,10 +107,11 @@ void Tree::iter(const glm::mat4 &transf, int numIter, int branching, float heigh
 }
 
 // Create a tree, and scale it up.
-void Tree::Init(int numIter, int branching, float height) {
-	// Create the geometry
+void Tree::Create(int numIter, int branching, float height) {
 	iter(glm::mat4(1), numIter, branching, height);
+}
 
+void Tree::Init(void) {
 	// Transfer the leaves to a VBO
 	glGenVertexArrays(1, &fVaoLeaf);
 	glBindVertexArray(fVaoLeaf);
@@ -143,6 +154,31 @@ void Tree::Draw(void) const {
 	}
 }
 
+void Tree::DrawInstanced(const OpenglBuffer &instances, int first, int count) const {
+	if (fLeafTriangles.size() > 0) {
+		glBindTexture(GL_TEXTURE_2D, GameTexture::Branch);
+		glBindVertexArray(fVaoLeaf);
+		instances.BindArray();
+		StageOneShader::InstanceAttribPointer(first);
+		gDrawnQuads += fLeafTriangles.size() * count;
+		glDrawArraysInstanced(GL_TRIANGLES, 0, fLeafTriangles.size()*3, count);
+		gNumDraw++;
+		StageOneShader::DisableInstanceAttrib();
+	}
+
+	if (fBranchTriangles.size() > 0) {
+		glBindTexture(GL_TEXTURE_2D, GameTexture::TreeBarkId);
+		glBindVertexArray(fVaoBranch);
+		instances.BindArray();
+		StageOneShader::InstanceAttribPointer(first);
+		gDrawnQuads += fBranchTriangles.size() * count;
+		glDrawArraysInstanced(GL_TRIANGLES, 0, fBranchTriangles.size()*3, count);
+		gNumDraw++;
+		StageOneShader::DisableInstanceAttrib();
+	}
+	glBindVertexArray(0);
+}
+
 void Tree::AddCylinder(int numSegments, const glm::mat4 &transf) {
 	// The form of the cylinder is a radius of size 1 and a height of size 1. Use 'transf' to get other dimensions.
 	// Using 'transf' as normal transformation only works as long as scaling in 'x' and 'z' is the same. Otherwise,
@@ -270,4 +306,4 @@ void Tree::AddOneLeaf(const glm::mat4 &transf, float height) {
 }
 
 Tree Tree::sfBigTree, Tree::sfMediumTree, Tree::sfSmallTree;
-bool Tree::sfInitialized;
+bool Tree::sfInitialized, Tree::sfCreated;
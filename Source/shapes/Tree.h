@@ -25,12 +25,17 @@
 class Tree {
 public:
 	virtual ~Tree();
-	// Create a tree with size of main trunk of 1.0.
+	// Create the geometry of a tree with size of main trunk of 1.0. OpenGL isn't used.
 	// numIter: number if times to split the trunk into branches
 	// branching: How many branches to use for each iteration
-	void Init(int numIter, int branching, float height);
+	void Create(int numIter, int branching, float height);
+	// Transfer the geometry to OpenGL
+	void Init(void);
+	static void CreateStatic(); // Create the geometry of the static trees. Can be done by another thread.
 	static void InitStatic();
 	void Draw(void) const;
+	// Draw 'count' trees, using per instance offsets from 'instances' starting at 'first'.
+	void DrawInstanced(const OpenglBuffer &instances, int first, int count) const;
 
 	static Tree sfBigTree, sfMediumTree, sfSmallTree;
 private:
@@ -39,6 +44,7 @@ private:
 	void AddCylinder(int numSegments, const glm::mat4 &transf);
 	void AddOneLeaf(const glm::mat4 &transf, float height);
 	static bool sfInitialized; // true if the static members are initialized.
+	static bool sfCreated;     // true if the geometry of the static members is created.
 
 	std::vector<TriangleSurfacef> fLeafTriangles;
 	std::vector<TriangleSurfacef> fBranchTriangles;
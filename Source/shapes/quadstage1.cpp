@@ -84,6 +84,28 @@ void QuadStage1::DrawSingleSide(void) const {
 	gDrawnQuads += VERTICES/2;
 }
 
+void QuadStage1::DrawDoubleSideInstanced(const OpenglBuffer &instances, int first, int count) const {
+	glBindVertexArray(fVao);
+	instances.BindArray();
+	StageOneShader::InstanceAttribPointer(first);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, VERTICES, count);
+	gNumDraw++;
+	StageOneShader::DisableInstanceAttrib();
+	glBindVertexArray(0);
+	gDrawnQuads += VERTICES * count;
+}
+
+void QuadStage1::DrawSingleSideInstanced(const OpenglBuffer &instances, int first, int count) const {
+	glBindVertexArray(fVao);
+	instances.BindArray();
+	StageOneShader::InstanceAttribPointer(first);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, VERTICES/2, count);
+	gNumDraw++;
+	StageOneShader::DisableInstanceAttrib();
+	glBindVertexArray(0);
+	gDrawnQuads += VERTICES/2 * count;
+}
+
 void QuadStage1::DrawLines(void) const {
 	glBindVertexArray(fVao);
 	glDrawArrays(GL_LINES, 0, VERTICES);
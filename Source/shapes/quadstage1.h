@@ -32,6 +32,9 @@ public:
 	void DrawDoubleSide(void) const;
 	/// Draw a QuadStage1 single side, using the currently bound texture0.
 	void DrawSingleSide(void) const;
+	/// Draw 'count' quads, using per instance offsets from 'instances' starting at 'first'.
+	void DrawDoubleSideInstanced(const OpenglBuffer &instances, int first, int count) const;
+	void DrawSingleSideInstanced(const OpenglBuffer &instances, int first, int count) const;
 	/// Only draw the edges.
 	void DrawLines(void) const;
 private:
@@ -0,0 +1,606 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// A stand-in for the Ephenation server, used for load testing the client on a single computer. It
+// accepts any login, generates the terrain, and populates the world with a configurable number of
+// monsters and players moving around. Blocks can be changed at a configurable rate.
+// Start the client with "ephenation --testuser localhost".
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "world.h"
+#include "../client_prot.h"
+#include "../ChunkEncoding.h"
+
+#define BLOCK_COORD_RES 100 // Copied from chunk.h
+#define COORDINATE_INTERVAL 0.1 // How often the position of a moving player is reported
+#define WALK_SPEED 5.0       // Blocks per second
+#define ENTITY_RANGE 300     // Entities further away than this (in blocks) are not reported
+#define MAX_OBJECTS_MSG 1000 // Maximum number of objects in one CMD_OBJECT_LIST
+
+static int sPort = 57862;
+static int sMonsters = 100;
+static int sPlayers = 10;
+static double sObjectRate = 10.0;   // CMD_OBJECT_LIST per second
+static double sBlockUpdates = 0.0;  // CMD_BLOCK_UPDATE per second
+static int sBurst = 8;              // Blocks changed in every CMD_BLOCK_UPDATE
+static double sAutoWalk = 0.0;      // Speed of automatic walking, in blocks per second
+static int sRleOnly = 0;
+static int sVerbose = 0;
+
+static World sWorld;
+
+// Statistics, reported and cleared regularly
+static unsigned sChunksSent, sChunksLZ, sVerified, sVerifyFailed, sObjectLists, sBlockUpdateMsgs;
+static size_t sBytesSent, sChunkBytes;
+
+// Monsters and other players, moving in circles around a center.
+struct Entity {
+	unsigned fId;
+	unsigned char fType; // ObjTypePlayer or ObjTypeMonster
+	unsigned fLevel;
+	double fCenterX, fCenterY, fRadius, fSpeed, fPhase;
+	double x, y, z;  // Current position of the feet, in blocks
+	float fDir;      // Looking direction in degrees
+};
+static std::vector<Entity> sEntities;
+
+struct Client {
+	int fSocket;
+	std::vector<unsigned char> fIn;  // Received data not yet parsed
+	std::vector<unsigned char> fOut; // Data waiting to be sent
+	size_t fOutOffset = 0;           // The part of fOut already sent
+	enum { PROT_VERSION, LOGIN, PASSWORD, GAME } fState = PROT_VERSION;
+	unsigned fEncodings = 0;         // Chunk encodings supported by the client, in addition to RLE
+	unsigned fUid;
+	double x, y, z;                  // Position of the feet, in blocks
+	double fAngleHor = 0.0;          // Looking direction, in radians
+	bool fFwd = false, fBwd = false, fLeft = false, fRight = false;
+	double fLastCoordinate = 0.0;
+	std::set<ChunkCoord> fChunks;    // Chunks sent to the client
+	bool fClosed = false;
+};
+static std::vector<std::unique_ptr<Client>> sClients;
+
+static double Now(void) {
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Used by ChunkEncoding.cpp
+void assert_failed(const char *str, const char *file, int linenumber) {
+	fprintf(stderr, "Assert failed: %s %s line %d\n", str, file, linenumber);
+	exit(1);
+}
+
+static void Encode16(unsigned char *b, unsigned v) {
+	b[0] = v & 0xFF;
+	b[1] = (v >> 8) & 0xFF;
+}
+
+static void Encode32(unsigned char *b, unsigned v) {
+	for (int i=0; i<4; i++)
+		b[i] = (v >> (i*8)) & 0xFF;
+}
+
+static void Encode64(unsigned char *b, long long v) {
+	for (int i=0; i<8; i++)
+		b[i] = ((unsigned long long)v >> (i*8)) & 0xFF;
+}
+
+static unsigned Parse32(const unsigned char *b) {
+	return b[0] | b[1] << 8 | b[2] << 16 | unsigned(b[3]) << 24;
+}
+
+// Queue a message. The length is filled in.
+static void Send(Client *c, std::vector<unsigned char> &msg) {
+	Encode16(&msg[0], msg.size());
+	c->fOut.insert(c->fOut.end(), msg.begin(), msg.end());
+}
+
+static void SendCoordinate(Client *c) {
+	std::vector<unsigned char> msg(27);
+	msg[2] = CMD_REPORT_COORDINATE;
+	Encode64(&msg[3], llround(c->x * BLOCK_COORD_RES));
+	Encode64(&msg[11], llround(c->y * BLOCK_COORD_RES));
+	Encode64(&msg[19], llround(c->z * BLOCK_COORD_RES));
+	Send(c, msg);
+	c->fLastCoordinate = Now();
+}
+
+static ChunkCoord ChunkOf(double x, double y, double z) {
+	ChunkCoord cc = { int(floor(x / CHUNK_SIZE)), int(floor(y / CHUNK_SIZE)), int(floor(z / CHUNK_SIZE)) };
+	return cc;
+}
+
+static void SendChunk(Client *c, const ChunkCoord &cc) {
+	std::vector<unsigned char> rle, lz;
+	sWorld.Encode(cc, rle);
+	unsigned checksum = World::Checksum(rle);
+	const std::vector<unsigned char> *data = &rle;
+	if (!sRleOnly && (c->fEncodings & (1 << CHUNK_ENCODING_LZ))) {
+		Model::EncodeChunkLZ(&rle[0], rle.size(), lz);
+		if (lz.size() < rle.size()) {
+			data = &lz;
+			sChunksLZ++;
+		}
+	}
+	std::vector<unsigned char> msg(27);
+	msg[2] = CMD_CHUNK_ANSWER;
+	Encode32(&msg[3], 0);  // Flags
+	Encode32(&msg[7], checksum);
+	Encode32(&msg[11], 0); // Owner
+	Encode32(&msg[15], cc.x);
+	Encode32(&msg[19], cc.y);
+	Encode32(&msg[23], cc.z);
+	msg.insert(msg.end(), data->begin(), data->end());
+	Send(c, msg);
+	c->fChunks.insert(cc);
+	sChunksSent++;
+	sChunkBytes += msg.size();
+}
+
+// Only the least significant byte of the chunk coordinate is sent when verifying. Find the chunk
+// nearest to the player.
+static int NearestLSB(int lsb, int player) {
+	int ret = (player & ~0xFF) | lsb;
+	if (player - ret > 127) ret += 0x100;
+	if (ret - player > 127) ret -= 0x100;
+	return ret;
+}
+
+static void Verify(Client *c, const unsigned char *b, int n) {
+	ChunkCoord player = ChunkOf(c->x, c->y, c->z);
+	for (int i=0; i+7 <= n; i += 7) {
+		ChunkCoord cc = { NearestLSB(b[i], player.x), NearestLSB(b[i+1], player.y), NearestLSB(b[i+2], player.z) };
+		sVerified++;
+		if (Parse32(b+i+3) != sWorld.Checksum(cc)) {
+			sVerifyFailed++;
+			SendChunk(c, cc);
+		}
+	}
+}
+
+static void LoginAck(Client *c) {
+	c->fState = Client::GAME;
+	c->x = 0.5;
+	c->y = 0.5;
+	c->z = sWorld.Height(0, 0) + 1;
+	std::vector<unsigned char> msg(12);
+	msg[2] = CMD_LOGIN_ACK;
+	Encode32(&msg[3], c->fUid);
+	Encode16(&msg[7], 0); // Horizontal angle
+	Encode16(&msg[9], 0); // Vertical angle
+	msg[11] = 0;          // Not admin
+	Send(c, msg);
+
+	std::vector<unsigned char> stats(14);
+	stats[2] = CMD_PLAYER_STATS;
+	stats[3] = 255;       // Hp
+	stats[4] = 0;         // Exp
+	Encode32(&stats[5], 1); // Level
+	Encode32(&stats[9], 0); // Flags
+	stats[13] = 255;      // Mana
+	Send(c, stats);
+	if (sVerbose)
+		printf("Client %u logged in\n", c->fUid);
+}
+
+// Parse one message from a client. 'b' points at the command, and 'n' is the size of the message without the length.
+static void Parse(Client *c, const unsigned char *b, int n) {
+	if (c->fState != Client::GAME) {
+		switch (b[0]) {
+		case CMD_PROT_VERSION:
+			if (n >= 7)
+				c->fEncodings = b[5] | b[6] << 8;
+			c->fState = Client::LOGIN;
+			return;
+		case CMD_LOGIN: {
+			std::vector<unsigned char> msg(3);
+			msg[2] = CMD_REQ_PASSWORD;
+			for (int i=0; i<8; i++)
+				msg.push_back(rand());
+			Send(c, msg);
+			c->fState = Client::PASSWORD;
+			return;
+		}
+		case CMD_RESP_PASSWORD:
+			if (c->fState == Client::PASSWORD)
+				LoginAck(c); // Any password is accepted
+			return;
+		}
+		return;
+	}
+	switch (b[0]) {
+	case CMD_GET_COORDINATE:
+		SendCoordinate(c);
+		break;
+	case CMD_READ_CHUNK:
+		if (n >= 13) {
+			ChunkCoord cc = { int(Parse32(b+1)), int(Parse32(b+5)), int(Parse32(b+9)) };
+			SendChunk(c, cc);
+		}
+		break;
+	case CMD_VRFY_CHUNK_CS:
+		Verify(c, b+1, n-1);
+		break;
+	case CMD_SET_DIR:
+		if (n >= 5)
+			c->fAngleHor = (b[1] | b[2] << 8) / 100.0;
+		break;
+	case CMD_START_FWD: c->fFwd = true; break;
+	case CMD_STOP_FWD: c->fFwd = false; break;
+	case CMD_START_BWD: c->fBwd = true; break;
+	case CMD_STOP_BWD: c->fBwd = false; break;
+	case CMD_START_LFT: c->fLeft = true; break;
+	case CMD_STOP_LFT: c->fLeft = false; break;
+	case CMD_START_RGT: c->fRight = true; break;
+	case CMD_STOP_RGT: c->fRight = false; break;
+	case CMD_PING:
+		if (n >= 2 && b[1] == 0) {
+			std::vector<unsigned char> msg(4);
+			msg[2] = CMD_PING;
+			msg[3] = 1; // Response
+			Send(c, msg);
+		}
+		break;
+	case CMD_REQ_PLAYER_INFO:
+		if (n >= 5) {
+			char name[20];
+			sprintf(name, "Bot%u", Parse32(b+1));
+			std::vector<unsigned char> msg(8);
+			msg[2] = CMD_RESP_PLAYER_NAME;
+			Encode32(&msg[3], Parse32(b+1));
+			msg[7] = 0; // Admin level
+			msg.insert(msg.end(), name, name + strlen(name));
+			Send(c, msg);
+		}
+		break;
+	case CMD_QUIT:
+		c->fClosed = true;
+		break;
+	}
+}
+
+static void Received(Client *c) {
+	size_t offset = 0;
+	while (c->fIn.size() - offset >= 3) {
+		int length = c->fIn[offset] | c->fIn[offset+1] << 8;
+		if (length < 3) {
+			c->fClosed = true;
+			return;
+		}
+		if (c->fIn.size() - offset < size_t(length))
+			break;
+		Parse(c, &c->fIn[offset+2], length-2);
+		offset += length;
+	}
+	c->fIn.erase(c->fIn.begin(), c->fIn.begin() + offset);
+}
+
+static void CreateEntities(void) {
+	for (int i=0; i<sPlayers + sMonsters; i++) {
+		Entity e;
+		bool player = i < sPlayers;
+		e.fId = player ? 1000 + i : 100000 + i;
+		e.fType = player ? ObjTypePlayer : ObjTypeMonster;
+		e.fLevel = 1 + rand() % 20;
+		e.fCenterX = rand() % 200 - 100;
+		e.fCenterY = rand() % 200 - 100;
+		e.fRadius = 5 + rand() % 30;
+		e.fSpeed = (1.0 + rand() % 4) / e.fRadius * (rand() % 2 ? 1 : -1); // Radians per second
+		e.fPhase = rand() % 628 / 100.0;
+		sEntities.push_back(e);
+	}
+}
+
+static void MoveEntities(double now) {
+	for (auto &e : sEntities) {
+		double a = e.fPhase + e.fSpeed * now;
+		e.x = e.fCenterX + e.fRadius * cos(a);
+		e.y = e.fCenterY + e.fRadius * sin(a);
+		e.z = sWorld.Height(int(floor(e.x)), int(floor(e.y))) + 1;
+		// The direction of the movement, which is the tangent of the circle.
+		double dir = e.fSpeed > 0 ? a + M_PI/2 : a - M_PI/2;
+		e.fDir = fmod(dir * 180.0 / M_PI + 720.0, 360.0);
+	}
+}
+
+static void SendObjects(Client *c) {
+	std::vector<unsigned char> msg(3);
+	msg[2] = CMD_OBJECT_LIST;
+	int count = 0;
+	for (auto &e : sEntities) {
+		double dx = e.x - c->x, dy = e.y - c->y, dz = e.z - c->z;
+		if (fabs(dx) > ENTITY_RANGE || fabs(dy) > ENTITY_RANGE || fabs(dz) > ENTITY_RANGE)
+			continue;
+		unsigned char b[18];
+		Encode32(b, e.fId);
+		b[4] = 1;   // State
+		b[5] = e.fType;
+		b[6] = 255; // Hp
+		Encode32(b+7, e.fLevel);
+		Encode16(b+11, short(dx * BLOCK_COORD_RES));
+		Encode16(b+13, short(dy * BLOCK_COORD_RES));
+		Encode16(b+15, short(dz * BLOCK_COORD_RES));
+		b[17] = (unsigned char)(e.fDir / 360.0f * 256.0f);
+		msg.insert(msg.end(), b, b + sizeof b);
+		if (++count == MAX_OBJECTS_MSG) {
+			Send(c, msg);
+			sObjectLists++;
+			msg.resize(3);
+			count = 0;
+		}
+	}
+	if (count > 0) {
+		Send(c, msg);
+		sObjectLists++;
+	}
+}
+
+// Change a number of blocks on the surface of a chunk that the client has.
+static void BlockUpdate(Client *c) {
+	if (c->fChunks.empty())
+		return;
+	auto it = c->fChunks.begin();
+	std::advance(it, rand() % c->fChunks.size());
+	ChunkCoord cc = *it;
+	std::vector<unsigned char> msg(15);
+	msg[2] = CMD_BLOCK_UPDATE;
+	Encode32(&msg[3], cc.x);
+	Encode32(&msg[7], cc.y);
+	Encode32(&msg[11], cc.z);
+	for (int i=0; i<sBurst; i++) {
+		int dx = rand() % CHUNK_SIZE, dy = rand() % CHUNK_SIZE;
+		int dz = sWorld.Height(cc.x*CHUNK_SIZE + dx, cc.y*CHUNK_SIZE + dy) + 1 - cc.z*CHUNK_SIZE;
+		if (dz < 0 || dz >= CHUNK_SIZE)
+			continue; // The surface is not in this chunk
+		unsigned char type = sWorld.GetBlock(cc, dx, dy, dz) == BT_Brick ? BT_Air : BT_Brick;
+		sWorld.SetBlock(cc, dx, dy, dz, type);
+		unsigned char b[4] = { (unsigned char)dx, (unsigned char)dy, (unsigned char)dz, type };
+		msg.insert(msg.end(), b, b + sizeof b);
+	}
+	if (msg.size() == 15)
+		return;
+	// Every client that has the chunk is told.
+	for (auto &other : sClients) {
+		if (other->fState == Client::GAME && other->fChunks.count(cc))
+			Send(other.get(), msg);
+	}
+	sBlockUpdateMsgs++;
+}
+
+// Move the player according to the movement commands, or along the x axis when walking automatically.
+static void MovePlayer(Client *c, double dt, double now) {
+	double fwd = (c->fFwd ? 1 : 0) - (c->fBwd ? 1 : 0);
+	double right = (c->fRight ? 1 : 0) - (c->fLeft ? 1 : 0);
+	double s = sin(c->fAngleHor), co = cos(c->fAngleHor);
+	double vx = (fwd * s + right * co) * WALK_SPEED;
+	double vy = (fwd * co - right * s) * WALK_SPEED;
+	if (sAutoWalk > 0.0) {
+		vx = sAutoWalk;
+		vy = 0.0;
+	}
+	if (vx == 0.0 && vy == 0.0)
+		return;
+	c->x += vx * dt;
+	c->y += vy * dt;
+	c->z = sWorld.Height(int(floor(c->x)), int(floor(c->y))) + 1; // Follow the ground
+	if (now - c->fLastCoordinate >= COORDINATE_INTERVAL)
+		SendCoordinate(c);
+}
+
+static void Accept(int listenSocket) {
+	static unsigned nextUid = 1;
+	int s = accept(listenSocket, 0, 0);
+	if (s < 0)
+		return;
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+	int noDelay = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof noDelay);
+	std::unique_ptr<Client> c(new Client);
+	c->fSocket = s;
+	c->fUid = nextUid++;
+	std::vector<unsigned char> msg(11);
+	msg[2] = CMD_PROT_VERSION;
+	Encode16(&msg[3], PROT_VER_MINOR);
+	Encode16(&msg[5], PROT_VER_MAJOR);
+	Encode16(&msg[7], PROT_VER_MINOR); // Available client version
+	Encode16(&msg[9], PROT_VER_MAJOR);
+	Send(c.get(), msg);
+	if (sVerbose)
+		printf("New connection, client %u\n", c->fUid);
+	sClients.push_back(std::move(c));
+}
+
+static void Report(double elapsed) {
+	printf("Clients %zu: %u chunks (%u LZ) %.1f kB, verified %u (%u wrong), %u object lists, %u block updates, sent %.1f kB/s\n",
+	       sClients.size(), sChunksSent, sChunksLZ, sChunkBytes/1024.0, sVerified, sVerifyFailed, sObjectLists,
+	       sBlockUpdateMsgs, sBytesSent/1024.0/elapsed);
+	sChunksSent = sChunksLZ = sVerified = sVerifyFailed = sObjectLists = sBlockUpdateMsgs = 0;
+	sBytesSent = sChunkBytes = 0;
+}
+
+static struct option long_options[] = {
+	{"port",         required_argument, NULL, 'p'},
+	{"monsters",     required_argument, NULL, 'm'},
+	{"players",      required_argument, NULL, 'o'},
+	{"objectrate",   required_argument, NULL, 'r'},
+	{"blockupdates", required_argument, NULL, 'b'},
+	{"burst",        required_argument, NULL, 'n'},
+	{"walk",         required_argument, NULL, 'w'},
+	{"rle",          no_argument, &sRleOnly, 1},
+	{"verbose",      no_argument, &sVerbose, 1},
+	{0, 0, 0, 0}
+};
+
+static void Usage(void) {
+	printf("Usage: testserver [options]\n"
+	       "  --port=n          Port to listen at (%d)\n"
+	       "  --monsters=n      Number of monsters (%d)\n"
+	       "  --players=n       Number of other players (%d)\n"
+	       "  --objectrate=f    Object lists sent per second (%.1f)\n"
+	       "  --blockupdates=f  Block updates sent per second (%.1f)\n"
+	       "  --burst=n         Blocks changed in every block update (%d)\n"
+	       "  --walk=f          Let the player walk automatically, in blocks per second\n"
+	       "  --rle             Only use the RLE chunk encoding\n"
+	       "  --verbose         Report connections\n",
+	       sPort, sMonsters, sPlayers, sObjectRate, sBlockUpdates, sBurst);
+}
+
+int main(int argc, char **argv) {
+	while (1) {
+		int option_index = 0;
+		int c = getopt_long(argc, argv, "", long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c) {
+		case 0: break; // A flag
+		case 'p': sPort = atoi(optarg); break;
+		case 'm': sMonsters = atoi(optarg); break;
+		case 'o': sPlayers = atoi(optarg); break;
+		case 'r': sObjectRate = atof(optarg); break;
+		case 'b': sBlockUpdates = atof(optarg); break;
+		case 'n': sBurst = atoi(optarg); break;
+		case 'w': sAutoWalk = atof(optarg); break;
+		default:
+			Usage();
+			exit(1);
+		}
+	}
+	signal(SIGPIPE, SIG_IGN);
+	int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+	int reuse = 1;
+	setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof addr);
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(sPort);
+	if (bind(listenSocket, (sockaddr *)&addr, sizeof addr) < 0 || listen(listenSocket, 8) < 0) {
+		perror("testserver");
+		exit(1);
+	}
+	printf("Listening at port %d, %d monsters and %d players\n", sPort, sMonsters, sPlayers);
+	CreateEntities();
+
+	double last = Now(), lastObjects = last, lastReport = last, blockUpdateCredit = 0.0;
+	while (1) {
+		fd_set readfds, writefds;
+		FD_ZERO(&readfds);
+		FD_ZERO(&writefds);
+		FD_SET(listenSocket, &readfds);
+		int nfds = listenSocket + 1;
+		for (auto &c : sClients) {
+			FD_SET(c->fSocket, &readfds);
+			if (c->fOutOffset < c->fOut.size())
+				FD_SET(c->fSocket, &writefds);
+			if (c->fSocket >= nfds)
+				nfds = c->fSocket + 1;
+		}
+		struct timeval timeout = { 0, 10000 };
+		if (select(nfds, &readfds, &writefds, NULL, &timeout) < 0 && errno != EINTR) {
+			perror("select");
+			exit(1);
+		}
+		if (FD_ISSET(listenSocket, &readfds))
+			Accept(listenSocket);
+		for (auto &c : sClients) {
+			if (FD_ISSET(c->fSocket, &readfds)) {
+				unsigned char buf[16384];
+				int n = read(c->fSocket, buf, sizeof buf);
+				if (n <= 0 && !(n < 0 && (errno == EAGAIN || errno == EINTR))) {
+					c->fClosed = true;
+					continue;
+				}
+				if (n > 0) {
+					c->fIn.insert(c->fIn.end(), buf, buf + n);
+					Received(c.get());
+				}
+			}
+		}
+
+		double now = Now();
+		MoveEntities(now);
+		bool sendObjects = sObjectRate > 0.0 && now - lastObjects >= 1.0 / sObjectRate;
+		if (sendObjects)
+			lastObjects = now;
+		blockUpdateCredit += sBlockUpdates * (now - last);
+		for (auto &c : sClients) {
+			if (c->fState != Client::GAME)
+				continue;
+			MovePlayer(c.get(), now - last, now);
+			if (sendObjects)
+				SendObjects(c.get());
+		}
+		for (; blockUpdateCredit >= 1.0; blockUpdateCredit -= 1.0) {
+			Client *c = sClients.empty() ? 0 : sClients[rand() % sClients.size()].get();
+			if (c && c->fState == Client::GAME)
+				BlockUpdate(c);
+		}
+		last = now;
+
+		for (auto &c : sClients) {
+			if (c->fOutOffset < c->fOut.size()) {
+				int n = write(c->fSocket, &c->fOut[c->fOutOffset], c->fOut.size() - c->fOutOffset);
+				if (n > 0) {
+					c->fOutOffset += n;
+					sBytesSent += n;
+				} else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+					c->fClosed = true;
+				}
+				if (c->fOutOffset == c->fOut.size()) {
+					c->fOut.clear();
+					c->fOutOffset = 0;
+				}
+			}
+		}
+		for (size_t i=0; i<sClients.size(); ) {
+			if (sClients[i]->fClosed) {
+				if (sVerbose)
+					printf("Client %u disconnected\n", sClients[i]->fUid);
+				close(sClients[i]->fSocket);
+				sClients.erase(sClients.begin() + i);
+			} else {
+				i++;
+			}
+		}
+		if (now - lastReport >= 10.0) {
+			Report(now - lastReport);
+			lastReport = now;
+		}
+	}
+	return 0;
+}
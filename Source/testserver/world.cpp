@@ -0,0 +1,119 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "world.h"
+#include "../simplexnoise1234.h"
+
+#define WATER_LEVEL 12
+
+// The index of a block in a chunk, the same as used by the client
+#define INDEX(x,y,z) (((x)*CHUNK_SIZE+(y))*CHUNK_SIZE+(z))
+
+// A pseudo random number for a block column, used for the decorations.
+static unsigned Hash(int x, int y) {
+	unsigned h = unsigned(x) * 73856093u ^ unsigned(y) * 19349663u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	return h ^ (h >> 15);
+}
+
+int World::Height(int x, int y) const {
+	float h = 20.0f + 16.0f * snoise2(x / 128.0f, y / 128.0f) + 4.0f * snoise2(x / 32.0f, y / 32.0f) + snoise2(x / 8.0f, y / 8.0f);
+	return int(h);
+}
+
+unsigned char World::Generate(int x, int y, int z, int height) const {
+	if (z > height + 1)
+		return z <= WATER_LEVEL ? BT_Water : BT_Air;
+	if (z == height + 1) {
+		if (z <= WATER_LEVEL)
+			return BT_Water;
+		unsigned r = Hash(x, y) % 400;
+		if (r == 0)
+			return BT_Tree1;
+		if (r < 3)
+			return BT_Flowers;
+		if (r < 13)
+			return BT_Tuft;
+		return BT_Air;
+	}
+	if (z == height && height <= WATER_LEVEL + 1)
+		return BT_Sand;
+	if (z > height - 4)
+		return BT_Soil;
+	return BT_Stone;
+}
+
+unsigned char World::GetBlock(const ChunkCoord &cc, int dx, int dy, int dz) const {
+	auto it = fModified.find(cc);
+	if (it != fModified.end()) {
+		auto it2 = it->second.find(INDEX(dx, dy, dz));
+		if (it2 != it->second.end())
+			return it2->second;
+	}
+	int x = cc.x*CHUNK_SIZE + dx, y = cc.y*CHUNK_SIZE + dy;
+	return Generate(x, y, cc.z*CHUNK_SIZE + dz, Height(x, y));
+}
+
+void World::SetBlock(const ChunkCoord &cc, int dx, int dy, int dz, unsigned char type) {
+	fModified[cc][INDEX(dx, dy, dz)] = type;
+	fChecksums.erase(cc);
+}
+
+void World::Encode(const ChunkCoord &cc, std::vector<unsigned char> &rle) const {
+	unsigned char blocks[CHUNK_VOL];
+	for (int dx=0; dx<CHUNK_SIZE; dx++) {
+		for (int dy=0; dy<CHUNK_SIZE; dy++) {
+			int x = cc.x*CHUNK_SIZE + dx, y = cc.y*CHUNK_SIZE + dy;
+			int height = Height(x, y);
+			for (int dz=0; dz<CHUNK_SIZE; dz++)
+				blocks[INDEX(dx, dy, dz)] = Generate(x, y, cc.z*CHUNK_SIZE + dz, height);
+		}
+	}
+	auto it = fModified.find(cc);
+	if (it != fModified.end()) {
+		for (auto &mod : it->second)
+			blocks[mod.first] = mod.second;
+	}
+	rle.clear();
+	for (int i=0; i<CHUNK_VOL; ) {
+		int count = 1;
+		while (i+count < CHUNK_VOL && count < 255 && blocks[i+count] == blocks[i])
+			count++;
+		rle.push_back(blocks[i]);
+		rle.push_back(count);
+		i += count;
+	}
+}
+
+unsigned World::Checksum(const ChunkCoord &cc) {
+	auto it = fChecksums.find(cc);
+	if (it != fChecksums.end())
+		return it->second;
+	std::vector<unsigned char> rle;
+	Encode(cc, rle);
+	unsigned checksum = Checksum(rle);
+	fChecksums[cc] = checksum;
+	return checksum;
+}
+
+unsigned World::Checksum(const std::vector<unsigned char> &rle) {
+	unsigned h = 2166136261u; // FNV-1a
+	for (unsigned char c : rle)
+		h = (h ^ c) * 16777619u;
+	return h;
+}
@@ -0,0 +1,75 @@
+// Copyright 2013 The Ephenation Authors
+//
+// This file is part of Ephenation.
+//
+// Ephenation is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 3.
+//
+// Ephenation is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Ephenation.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+//
+// The world of the test server. The terrain is generated from simplex noise, and blocks changed
+// by the server are remembered. Chunks are encoded the same way as by the real server.
+//
+
+#define CHUNK_SIZE 32
+#define CHUNK_VOL (CHUNK_SIZE*CHUNK_SIZE*CHUNK_SIZE)
+
+// Block types used by the test server. Copied from chunk.h
+#define BT_Stone	1
+#define BT_Water	2
+#define BT_Air		3
+#define BT_Brick    4
+#define BT_Soil     5
+#define BT_Sand		7
+#define BT_Tree1	8
+#define BT_Tuft     28
+#define BT_Flowers  29
+
+struct ChunkCoord {
+	int x, y, z;
+	bool operator<(const ChunkCoord &other) const {
+		if (x != other.x) return x < other.x;
+		if (y != other.y) return y < other.y;
+		return z < other.z;
+	}
+};
+
+class World {
+public:
+	/// Height of the ground at block (x,y), the first block above it is free.
+	int Height(int x, int y) const;
+
+	/// Block type at offset (dx,dy,dz) in chunk 'cc'
+	unsigned char GetBlock(const ChunkCoord &cc, int dx, int dy, int dz) const;
+
+	/// Change a block in the world
+	void SetBlock(const ChunkCoord &cc, int dx, int dy, int dz, unsigned char type);
+
+	/// Generate the RLE data of a chunk, pairs of block type and count.
+	void Encode(const ChunkCoord &cc, std::vector<unsigned char> &rle) const;
+
+	/// The checksum of a chunk, as reported by the client when verifying.
+	unsigned Checksum(const ChunkCoord &cc);
+
+	/// Checksum of the RLE data
+	static unsigned Checksum(const std::vector<unsigned char> &rle);
+private:
+	unsigned char Generate(int x, int y, int z, int height) const;
+
+	std::map<ChunkCoord, std::map<int, unsigned char>> fModified; // Block index to type, for every changed chunk
+	std::map<ChunkCoord, unsigned> fChecksums;                    // Cached checksums
+};
@@ -18,6 +18,14 @@
 #include <GL/glew.h>
 
 #include <stdlib.h>
+#include <string>
+#include <map>
+
+#ifdef WIN32
+#include "mythread.h"
+#else
+#include <mutex>
+#endif
 
 #include <glm/glm.hpp>
 #include "textures.h"
@@ -28,6 +36,7 @@
 #include <glm/glm.hpp>
 #include "primitives.h"
 #include "Options.h"
+#include "TextureCache.h"
 
 #define NELEM(x) (int)(sizeof x / sizeof x[0])
 
@@ -110,8 +119,69 @@ GLuint GameTexture::Coin, GameTexture::Quest;
 GLuint GameTexture::WEP1Text, GameTexture::WEP2Text, GameTexture::WEP3Text, GameTexture::WEP4Text;
 GLuint GameTexture::MousePointerId;
 
-//Makes the image into a texture, and returns the id of the texture. The texture is returned as bound
-GLuint loadTexture(shared_ptr<Image> image, unsigned fl = 0) {
+// Make a list of the mipmap levels to use for an image. Unless special mipmaps are requested, there is only the image itself.
+static std::vector<shared_ptr<Image> > MakeLevels(shared_ptr<Image> image, unsigned fl) {
+	std::vector<shared_ptr<Image> > levels;
+	levels.push_back(image);
+	if (fl & TF_MIPMAP2) {
+		// The mipmap has to be done in linear space.
+		while (image->width > 1 && image->height > 1) {
+			image = image->MipMapNextLevel((fl & TF_SRGB) != 0);
+			levels.push_back(image);
+		}
+	}
+	return levels;
+}
+
+// A texture that has been decoded, waiting to be transferred to OpenGL.
+struct PreparedTexture {
+	GLenum format;
+	std::vector<TextureCache::Level> levels;
+	TextureCache::Entry entry;              // Owns the pixels when found in the texture cache
+	std::vector<shared_ptr<Image> > images; // Owns the pixels otherwise
+};
+
+// Textures decoded in advance by other threads, found from file name and flags.
+static std::mutex sPreparedMutex;
+static std::multimap<std::pair<std::string, unsigned>, unique_ptr<PreparedTexture> > sPrepared;
+
+static unique_ptr<PreparedTexture> PrepareImage(shared_ptr<Image> image, unsigned fl) {
+	unique_ptr<PreparedTexture> prepared(new PreparedTexture);
+	prepared->format = image->fFormat;
+	prepared->images = MakeLevels(image, fl);
+	for (auto &img : prepared->images) {
+		TextureCache::Level level = { img->width, img->height, img->pixels.get() };
+		prepared->levels.push_back(level);
+	}
+	return prepared;
+}
+
+// Decode a bitmap file. This doesn't use OpenGL, and can be done by any thread.
+// The processed bitmap, including the mipmaps, is taken from the texture cache when possible.
+static unique_ptr<PreparedTexture> PrepareTextureFile(const char *fileName, unsigned fl) {
+	unique_ptr<PreparedTexture> prepared(new PreparedTexture);
+	if (TextureCache::fgTextureCache.Load(fileName, fl, prepared->entry)) {
+		prepared->format = prepared->entry.format;
+		prepared->levels = prepared->entry.levels;
+		return prepared;
+	}
+	prepared = PrepareImage(loadBMP(fileName, (fl & TF_BOOLAPHA) != 0), fl);
+	TextureCache::fgTextureCache.Save(fileName, fl, prepared->images);
+	return prepared;
+}
+
+// Decode a bitmap file, to be used by a later call of LoadTextureFile(). Thread safe.
+static void PreloadTextureFile(const char *fileName, unsigned fl) {
+	auto prepared = PrepareTextureFile(fileName, fl);
+	sPreparedMutex.lock();
+	sPrepared.insert(std::make_pair(std::make_pair(std::string(fileName), fl), std::move(prepared)));
+	sPreparedMutex.unlock();
+}
+
+//Makes the levels into a texture, and returns the id of the texture. The texture is returned as bound
+static GLuint CreateTexture(const PreparedTexture &prepared, unsigned fl) {
+	const std::vector<TextureCache::Level> &levels = prepared.levels;
+	GLenum format = prepared.format;
 	bool mipmap = true;
 	if (fl & TF_NOMIPMAP)
 		mipmap = false;
@@ -126,7 +196,7 @@ GLuint loadTexture(shared_ptr<Image> image, unsigned fl = 0) {
 	}
 	if (fl & TF_SRGB)
 		internalFormat = GL_SRGB;
-	if (image->fFormat == GL_RGBA || image->fFormat == GL_BGRA) {
+	if (format == GL_RGBA || format == GL_BGRA) {
 		if (fl & TF_SRGB)
 			internalFormat = GL_SRGB8_ALPHA8;
 		else
@@ -148,24 +218,38 @@ GLuint loadTexture(shared_ptr<Image> image, unsigned fl = 0) {
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, max);
 		}
 	}
-	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image->width, image->height, 0, image->fFormat, GL_UNSIGNED_BYTE, image->pixels.get());
-	if (fl & TF_MIPMAP2) {
-		for (GLint level = 1; image->width > 1 && image->height > 1; level++) {
-			// The mipmap has to be done in linear space.
-			if (fl & TF_SRGB)
-				image->MakeLinear(); // This bitmap was already transferred to the GPU.
-			image = image->MipMapNextLevel();
-			if (fl & TF_SRGB)
-				image->MakeNonLinear(); // Make down sampled bitmap of SRGB format again, which is what is transferred to the GPU.
-			glTexImage2D(GL_TEXTURE_2D, level, internalFormat, image->width, image->height, 0, image->fFormat, GL_UNSIGNED_BYTE, image->pixels.get());
-		}
-
-	} else if (mipmap) {
+	for (unsigned level = 0; level < levels.size(); level++)
+		glTexImage2D(GL_TEXTURE_2D, level, internalFormat, levels[level].width, levels[level].height, 0, format, GL_UNSIGNED_BYTE, levels[level].pixels);
+	if (levels.size() > 1) {
+		// The chain may stop before 1x1 for textures that are not square.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels.size()-1);
+	} else if (mipmap && !(fl & TF_MIPMAP2)) {
 		glGenerateMipmap(GL_TEXTURE_2D);
 	}
 	return textureId;
 }
 
+//Makes the image into a texture, and returns the id of the texture. The texture is returned as bound
+GLuint loadTexture(shared_ptr<Image> image, unsigned fl = 0) {
+	return CreateTexture(*PrepareImage(image, fl), fl);
+}
+
+// Load a bitmap file into a texture. The texture is returned as bound.
+// Use the decoded bitmap from PreloadTextureFile(), if there is one.
+static GLuint LoadTextureFile(const char *fileName, unsigned fl) {
+	unique_ptr<PreparedTexture> prepared;
+	sPreparedMutex.lock();
+	auto it = sPrepared.find(std::make_pair(std::string(fileName), fl));
+	if (it != sPrepared.end()) {
+		prepared = std::move(it->second);
+		sPrepared.erase(it);
+	}
+	sPreparedMutex.unlock();
+	if (!prepared)
+		prepared = PrepareTextureFile(fileName, fl);
+	return CreateTexture(*prepared, fl);
+}
+
 // Not used currently.
 // Create a simple uniform color image.
 shared_ptr<Image> ColorImage(int red, int green, int blue) {
@@ -196,13 +280,59 @@ shared_ptr<Image> ColorImage(int red, int green, int blue, int alpha) {
 	return std::make_shared<Image>(std::move(pixels), size, size, GL_RGBA);
 }
 
+// Textures not represented by a block type.
+static const struct {
+	GLuint *id;
+	const char *fileName;
+	unsigned flag;
+	bool clamp; // Clamp to edge instead of repeating
+} sOtherTextures[] = {
+	{ &GameTexture::GrassTextureId,   "textures/grass.bmp", TF_SRGB, false },
+	{ &GameTexture::LeafTextureId,    "textures/leaves.bmp", TF_SRGB, false },
+	{ &GameTexture::StoneTexture2Id,  "textures/evenly_worn_stone.bmp", TF_SRGB, false },
+	{ &GameTexture::TreeBarkId,       "textures/tree-bark-texture.bmp", TF_SRGB, false },
+	{ &GameTexture::Sky1Id,           "textures/sky1.bmp", TF_NOMIPMAP|TF_SRGB, true },
+	{ &GameTexture::Sky2Id,           "textures/sky2.bmp", TF_NOMIPMAP|TF_SRGB, true },
+	{ &GameTexture::Sky3Id,           "textures/sky3.bmp", TF_NOMIPMAP|TF_SRGB, true },
+	{ &GameTexture::Sky4Id,           "textures/sky4.bmp", TF_NOMIPMAP|TF_SRGB, true },
+	{ &GameTexture::SkyupId,          "textures/skyup.bmp", TF_NOMIPMAP|TF_SRGB, true },
+	{ &GameTexture::RedScalesId,      "textures/RedScales.bmp", TF_SRGB, false },
+	{ &GameTexture::Morran,           "textures/morran.bmp", TF_SRGB, false },
+	{ &GameTexture::Fur1Id,           "textures/fur1.bmp", TF_SRGB, false },
+	{ &GameTexture::DamageIndication, "textures/DamageIndication.bmp", TF_NOMIPMAP, false },
+	{ &GameTexture::LanternSideId,    "textures/LanternSide.bmp", TF_SRGB, true },
+	{ &GameTexture::InventoryId,      "textures/Inventory.bmp", TF_NOMIPMAP, true },
+	{ &GameTexture::EquipmentId,      "textures/EquipmentIcons.bmp", TF_NOMIPMAP, true },
+	{ &GameTexture::LightBallsHeal,   "textures/LightBallsHeal.bmp", TF_NOMIPMAP, true },
+	{ &GameTexture::RedChunkBorder,   "textures/RedChunkBorder.bmp", TF_SRGB, true },
+	{ &GameTexture::GreenChunkBorder, "textures/GreenChunkBorder.bmp", TF_SRGB, true },
+	{ &GameTexture::BlueChunkBorder,  "textures/BlueChunkBorder.bmp", TF_SRGB, true },
+	{ &GameTexture::CompassRose,      "textures/CompassRose.bmp", TF_NOMIPMAP, true },
+	{ &GameTexture::MousePointerId,   "textures/MousePointer.bmp", TF_NOMIPMAP, false },
+	{ &GameTexture::WEP2,             "textures/WEP2.bmp", TF_NOMIPMAP, true },
+	{ &GameTexture::WEP1,             "textures/WEP1.bmp", TF_NOMIPMAP, true },
+	{ &GameTexture::WEP1Text,         "textures/WEP1Text.bmp", TF_NOMIPMAP, false },
+	{ &GameTexture::WEP2Text,         "textures/WEP2Text.bmp", TF_NOMIPMAP, false },
+	{ &GameTexture::WEP3Text,         "textures/WEP3Text.bmp", TF_NOMIPMAP, false },
+	{ &GameTexture::WEP4Text,         "textures/WEP4Text.bmp", TF_NOMIPMAP, false },
+	{ &GameTexture::Branch,           "textures/branch.bmp", TF_SRGB|TF_MIPMAP2|TF_NEAREST|TF_BOOLAPHA, true },
+};
+
+void GameTexture::Load(int part, int parts) {
+	int i = part;
+	for (; i < NELEM(gameTextures); i += parts) {
+		if (gameTextures[i].fileName)
+			PreloadTextureFile(gameTextures[i].fileName, gameTextures[i].flag);
+	}
+	// Continue with the same stride in the second table
+	for (i -= NELEM(gameTextures); i < NELEM(sOtherTextures); i += parts)
+		PreloadTextureFile(sOtherTextures[i].fileName, sOtherTextures[i].flag);
+}
+
 void GameTexture::Init(void) {
 	for (int i=0; i<NELEM(gameTextures); i++) {
 		if (gameTextures[i].fileName) {
-			bool boolAlpha = false;
-			if (gameTextures[i].flag & TF_BOOLAPHA)
-				boolAlpha = true;
-			GLuint id = loadTexture(loadBMP(gameTextures[i].fileName, boolAlpha), gameTextures[i].flag);
+			GLuint id = LoadTextureFile(gameTextures[i].fileName, gameTextures[i].flag);
 			gameTextures[i].id = id;
 			BlockTypeTotextureId[gameTextures[i].blType] = id;
 		} else switch (gameTextures[i].blType) { // Some textures are created dynamically, not loaded from file
@@ -242,97 +372,19 @@ void GameTexture::Init(void) {
 	Snow = BlockTypeTotextureId[BT_Snow];
 
 	// Now load special textures, not represented by a block type
-	GrassTextureId = loadTexture(loadBMP("textures/grass.bmp"), TF_SRGB);
+	for (auto &tex : sOtherTextures) {
+		*tex.id = LoadTextureFile(tex.fileName, tex.flag);
+		if (tex.clamp) {
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+	}
 	BlockTypeTotextureId[BT_TopSoil] = GrassTextureId;
-
-	LeafTextureId = loadTexture(loadBMP("textures/leaves.bmp"), TF_SRGB);
-//	BlockTypeTotextureId[BT_TopSoil] = LeafTextureId;
-
-	StoneTexture2Id = loadTexture(loadBMP("textures/evenly_worn_stone.bmp"), TF_SRGB);
 	BlockTypeTotextureId[BT_Stone2] = StoneTexture2Id;
-
-	TreeBarkId = loadTexture(loadBMP("textures/tree-bark-texture.bmp"), TF_SRGB);
 	BlockTypeTotextureId[BT_Bark] = TreeBarkId;
 
 	DarkGray = loadTexture(ColorImage(15, 15, 15), TF_NOMIPMAP);
 
-	Sky1Id = loadTexture(loadBMP("textures/sky1.bmp"), TF_NOMIPMAP|TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	Sky2Id = loadTexture(loadBMP("textures/sky2.bmp"), TF_NOMIPMAP|TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	Sky3Id = loadTexture(loadBMP("textures/sky3.bmp"), TF_NOMIPMAP|TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	Sky4Id = loadTexture(loadBMP("textures/sky4.bmp"), TF_NOMIPMAP|TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	SkyupId = loadTexture(loadBMP("textures/skyup.bmp"), TF_NOMIPMAP|TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	RedScalesId = loadTexture(loadBMP("textures/RedScales.bmp"), TF_SRGB);
-	Morran = loadTexture(loadBMP("textures/morran.bmp"), TF_SRGB);
-
-	Fur1Id = loadTexture(loadBMP("textures/fur1.bmp"), TF_SRGB);
-
-	DamageIndication = loadTexture(loadBMP("textures/DamageIndication.bmp"), TF_NOMIPMAP);
-
-	LanternSideId = loadTexture(loadBMP("textures/LanternSide.bmp"), TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	InventoryId = loadTexture(loadBMP("textures/Inventory.bmp"), TF_NOMIPMAP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	EquipmentId = loadTexture(loadBMP("textures/EquipmentIcons.bmp"), TF_NOMIPMAP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	LightBallsHeal = loadTexture(loadBMP("textures/LightBallsHeal.bmp"), TF_NOMIPMAP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	RedChunkBorder = loadTexture(loadBMP("textures/RedChunkBorder.bmp"), TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	GreenChunkBorder = loadTexture(loadBMP("textures/GreenChunkBorder.bmp"), TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	BlueChunkBorder = loadTexture(loadBMP("textures/BlueChunkBorder.bmp"), TF_SRGB);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	CompassRose = loadTexture(loadBMP("textures/CompassRose.bmp"), TF_NOMIPMAP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	MousePointerId = loadTexture(loadBMP("textures/MousePointer.bmp"), TF_NOMIPMAP);
-
-	WEP2 = loadTexture(loadBMP("textures/WEP2.bmp"), TF_NOMIPMAP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	WEP1 = loadTexture(loadBMP("textures/WEP1.bmp"), TF_NOMIPMAP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	WEP1Text = loadTexture(loadBMP("textures/WEP1Text.bmp"), TF_NOMIPMAP);
-	WEP2Text = loadTexture(loadBMP("textures/WEP2Text.bmp"), TF_NOMIPMAP);
-	WEP3Text = loadTexture(loadBMP("textures/WEP3Text.bmp"), TF_NOMIPMAP);
-	WEP4Text = loadTexture(loadBMP("textures/WEP4Text.bmp"), TF_NOMIPMAP);
-
-	Branch = loadTexture(loadBMP("textures/branch.bmp", true), TF_SRGB|TF_MIPMAP2|TF_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
 	// This is just a safety precaution, if there would be an unrecognized block
 	for (int i=0; i<256; i++) {
 		if (BlockTypeTotextureId[i] == 0)
@@ -348,9 +400,13 @@ GLuint LoadBitmapForGui(shared_ptr<Image> img) {
 	return ret;
 }
 
-// Load bitmaps to be used for the GUI.
-GLuint LoadBitmapForModels(shared_ptr<Image> img) {
-	GLuint ret = loadTexture(img, TF_SRGB);
+void PreloadBitmapForModels(const char *fileName) {
+	PreloadTextureFile(fileName, TF_SRGB);
+}
+
+// Load a bitmap file to be used for animated models.
+GLuint LoadBitmapForModels(const char *fileName) {
+	GLuint ret = LoadTextureFile(fileName, TF_SRGB);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	return ret;
@@ -33,6 +33,9 @@ struct GameTexture {
 	const char *descr;
 	unsigned flag;
 
+	// Decode the bitmap files, without using OpenGL. This can be done by several threads, each one doing a 'part' of 'parts'.
+	static void Load(int part = 0, int parts = 1);
+	// Create the textures, using the bitmaps already decoded by Load().
 	static void Init(void);
 	static GLuint GrassTextureId, TuftOfGrass, Flowers;
 	static GLuint LeafTextureId;
@@ -62,5 +65,8 @@ class Image;
 // Load bitmaps to be used for the GUI.
 extern GLuint LoadBitmapForGui(shared_ptr<Image>);
 
-// Load bitmaps to be used for animated models.
-extern GLuint LoadBitmapForModels(shared_ptr<Image>);
+// Load a bitmap file to be used for animated models.
+extern GLuint LoadBitmapForModels(const char *fileName);
+
+// Decode a bitmap file for LoadBitmapForModels() in advance. Thread safe, as OpenGL isn't used.
+extern void PreloadBitmapForModels(const char *fileName);
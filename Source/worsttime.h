@@ -21,6 +21,7 @@
 #include <GL/glfw.h>
 
 #include "primitives.h"
+#include "Clock.h"
 
 /// @brief Measure real worst execution time, and provide a report.
 /// Surround a section of code as follows:
@@ -47,14 +48,14 @@ public:
 	void Start() {
 		if (!gDebugOpenGL)
 			return;
-		fStart = glfwGetTime();
+		fStart = GetTime();
 	}
 
 	/// @brief Stop the timer. The worst case since the last report is saved.
 	void Stop(void) {
 		if (!gDebugOpenGL)
 			return;
-		double delta = glfwGetTime() - fStart;
+		double delta = GetTime() - fStart;
 		if (delta > fResults[fIndex])
 			fResults[fIndex] = delta;
 	}